@@ -0,0 +1,57 @@
+/**
+ * @file include/content_hash.hpp
+ *
+ * @brief Fast 128 bit content hashesbuild_header/
+ */
+#ifndef __CONTENT_HASH_HPP_INCLUDE_GUARD__
+#define __CONTENT_HASH_HPP_INCLUDE_GUARD__
+
+#include <cstddef>
+#include <string>
+
+/** Non-cryptographic 128 bit hashes for detecting identical content
+ * @note The hash is MurmurHash3 (x64, 128 bit variant); it is fast and well distributed,
+ *       but offers no protection against deliberately constructed collisions.
+ * @note Results only depend on the bytes hashed, so they can be stored and compared
+ *       across runs and machines of the same byte order.
+ */
+namespace ContentHash {
+	/** A 128 bit hash value
+	 */
+	typedef struct Hash128_t {
+		unsigned long long low;						///< lower 64 bits
+		unsigned long long high;					///< upper 64 bits
+	} Hash128;
+
+	/** Hash a field of bytes
+	 * @param[in] data A field of size bytes; no alignment required
+	 * @param[in] size Number of bytes
+	 * @param[in] seed Seed value; hashes of different kinds of content should use different seeds
+	 * @return The hash value
+	 */
+	Hash128 Compute(void const* data, size_t size, unsigned int seed);
+	/** Hash a sequence of hash values
+	 * @param[in] hashes A field of n hash values
+	 * @param[in] n Number of hash values
+	 * @param[in] seed Seed value
+	 * @return The hash value of the concatenated hashes
+	 */
+	Hash128 Combine(Hash128 const* hashes, size_t n, unsigned int seed);
+	/** Format a hash value
+	 * @param[in] h The hash value
+	 * @return 32 lower case hex digits, most significant first
+	 */
+	std::string ToString(Hash128 const& h);
+
+	inline bool operator==(Hash128 const& a, Hash128 const& b) {
+		return (a.low == b.low) && (a.high == b.high);
+	}
+	inline bool operator!=(Hash128 const& a, Hash128 const& b) {
+		return !(a == b);
+	}
+	inline bool operator<(Hash128 const& a, Hash128 const& b) {
+		return (a.high < b.high) || ((a.high == b.high) && (a.low < b.low));
+	}
+}
+
+#endif
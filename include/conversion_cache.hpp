@@ -0,0 +1,140 @@
+/**
+ * @file include/conversion_cache.hpp
+ *
+ * @brief Persistent cache for the results of file conversionsbuild_header/
+ */
+#ifndef __CONVERSION_CACHE_HPP_INCLUDE_GUARD__
+#define __CONVERSION_CACHE_HPP_INCLUDE_GUARD__
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "../gbLib/include/gbException.hpp"
+#include "content_hash.hpp"
+
+/** An on-disk cache of conversion outputs, addressed by the content of the inputs
+ */
+class ConversionCache {
+public:
+	/** Identifies a conversion by its inputs and parameters
+	 */
+	class Key {
+	private:
+		std::vector<ContentHash::Hash128> m_parts;	///< hashes of all values added so far
+	public:
+		/** Constructor
+		 * @param[in] conversion Name of the conversion; should be changed whenever
+		 *                       the output of the conversion changes
+		 */
+		Key(char const* conversion);
+		/** Add a field of bytes, e.g. the contents of an input file
+		 * @param[in] data A field of size bytes
+		 * @param[in] size Number of bytes
+		 */
+		void AddBytes(void const* data, size_t size);
+		/** Add the contents of a file
+		 * @param[in] fname Path to the file
+		 * @throw Ghulbus::gbException GB_FAILED indicates a file access error;
+		 */
+		void AddFile(char const* fname);
+		/** Add a string parameter
+		 * @param[in] str A null-terminated string
+		 */
+		void AddString(char const* str);
+		/** Add an integer parameter
+		 * @param[in] value The parameter
+		 */
+		void AddInt(int value);
+		/** Add a floating point parameter
+		 * @param[in] value The parameter
+		 */
+		void AddFloat(float value);
+		/** Get the key
+		 * @return A hash of all values added, in the order they were added
+		 */
+		ContentHash::Hash128 GetHash() const;
+	};
+private:
+	std::string m_directory;						///< path to the cache directory
+	unsigned long long m_max_size;					///< maximum total size of all entries in bytes
+	bool m_hard_links;								///< true if hits are hard linked instead of copied
+public:
+	/** Constructor
+	 * @param[in] directory Path to the cache directory; it is created if it does not exist
+	 * @param[in] max_size Maximum total size of the cached outputs in bytes
+	 * @throw Ghulbus::gbException GB_FAILED the directory could not be created;
+	 */
+	ConversionCache(char const* directory, unsigned long long max_size);
+	/** Choose how outputs are retrieved from the cache
+	 * @param[in] hard_links If true, outputs are hard links to the cached files where the
+	 *                       file system allows it; otherwise they are copies (default)
+	 * @note Hard linked outputs must not be modified in place, as that would modify the
+	 *       cached file as well. Delete them before writing new contents instead.
+	 */
+	void SetHardLinks(bool hard_links);
+	/** Get the directory of the cache
+	 * @return Path to the cache directory
+	 */
+	char const* GetDirectory() const;
+	/** Get the size limit of the cache
+	 * @return Maximum total size of the cached outputs in bytes
+	 */
+	unsigned long long GetMaxSize() const;
+	/** Look up a conversion and, on a hit, reproduce its outputs
+	 * @param[in] key The conversion
+	 * @param[in] outputs A field of n_outputs paths the outputs are written to; existing
+	 *                    files are replaced
+	 * @param[in] n_outputs Number of outputs
+	 * @return True on a hit; false if the conversion is not cached, in which case
+	 *         no output is touched
+	 * @throw Ghulbus::gbException GB_FAILED an output could not be written;
+	 */
+	bool Retrieve(Key const& key, char const* const* outputs, int n_outputs);
+	/** Add the outputs of a conversion to the cache
+	 * @param[in] key The conversion
+	 * @param[in] outputs A field of n_outputs paths to the files produced by the conversion
+	 * @param[in] n_outputs Number of outputs
+	 * @throw Ghulbus::gbException GB_FAILED an output could not be read or the cache
+	 *                             could not be written;
+	 * @note Evict() is called afterwards, so the size limit is kept.
+	 */
+	void Store(Key const& key, char const* const* outputs, int n_outputs);
+	/** Remove least recently used entries until the cache fits its size limit
+	 * @return Total size of the remaining entries in bytes
+	 * @throw Ghulbus::gbException GB_FAILED the cache directory could not be listed;
+	 */
+	unsigned long long Evict();
+private:
+	/** Internal helper function: path of the cached file of output #index of an entry
+	 */
+	std::string GetEntryPath(ContentHash::Hash128 const& key, int index) const;
+	ConversionCache(ConversionCache const&);				///< private copy constructor (not implemented!)
+	ConversionCache& operator=(ConversionCache const&);		///< private copy assignment (not implemented!)
+};
+
+//EXTENSIVE DOCUMENTATION:
+/**
+ * @class ConversionCache
+ * Each entry of the cache holds the output files of one conversion, stored as
+ * <tt>&lt;key&gt;.&lt;index&gt;</tt> directly in the cache directory, with the key in hex.
+ * The key is a hash of everything the outputs depend on, i.e. the contents of the input
+ * files and all conversion parameters, so a cache never has to be invalidated:
+ * changed inputs simply lead to a different key.
+ *
+ * Files are stored under a temporary name and renamed when complete, so several
+ * processes may share a cache directory. A hit updates the modification time of the
+ * cached files; Evict() deletes the entries with the oldest modification time first.
+ * @code
+ * ConversionCache cache("cache", 256 << 20);
+ * ConversionCache::Key key("obj_to_ps2icon");
+ * key.AddFile("foo.obj");
+ * key.AddInt(mesh_index);
+ * char const* outputs[] = { "foo.icn" };
+ * if(!cache.Retrieve(key, outputs, 1)) {
+ *     //... convert foo.obj to foo.icn ...
+ *     cache.Store(key, outputs, 1);
+ * }
+ * @endcode
+ */
+
+#endif
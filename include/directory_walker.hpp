@@ -0,0 +1,66 @@
+/**
+ * @file include/directory_walker.hpp
+ *
+ * @brief Recursive enumeration of the files of a directory treebuild_header/
+ */
+#ifndef __DIRECTORY_WALKER_HPP_INCLUDE_GUARD__
+#define __DIRECTORY_WALKER_HPP_INCLUDE_GUARD__
+
+#include <string>
+#include <vector>
+#include "../gbLib/include/gbException.hpp"
+
+/** Enumerates all regular files below a directory, one at a time
+ * @note Directories are listed lazily, so the memory used only depends on the
+ *       size of the largest directory and the depth of the tree, not on the
+ *       total number of files.
+ */
+class DirectoryWalker {
+private:
+	std::vector<std::string> m_pending_dirs;		///< directories still to be listed (used as stack)
+	std::vector<std::string> m_files;				///< files of the last listed directory not returned yet (reversed)
+public:
+	/** Constructor
+	 * @param[in] root Path to the directory to walk; if it names a regular file,
+	 *                 that file is the only one returned
+	 * @throw Ghulbus::gbException GB_FAILED root does not exist;
+	 * @throw std::bad_alloc
+	 */
+	DirectoryWalker(char const* root);
+	/** Get the next file
+	 * @param[out] path Receives the path of the file, prefixed with the root path
+	 * @return False if all files have been returned
+	 * @throw Ghulbus::gbException GB_FAILED a directory could not be listed; it is skipped
+	 *                             and the walk can be continued by calling Next() again;
+	 * @throw std::bad_alloc
+	 */
+	bool Next(std::string* path);
+	/** Check whether a path names a directory
+	 * @param[in] path The path to check
+	 * @return True for directories; false for everything else, including invalid paths
+	 */
+	static bool IsDirectory(char const* path);
+private:
+	/** Internal helper function: appends the files and subdirectories of a directory
+	 *                            to m_files and m_pending_dirs
+	 */
+	void ListDirectory(std::string const& dir);
+	DirectoryWalker(DirectoryWalker const&);			///< private copy constructor (not implemented!)
+	DirectoryWalker& operator=(DirectoryWalker const&);	///< private copy assignment (not implemented!)
+};
+
+//EXTENSIVE DOCUMENTATION:
+/**
+ * @class DirectoryWalker
+ * The tree is walked depth first; the entries of each directory are sorted by name, so
+ * the order of the returned files is the same on every run. Symbolic links to files are
+ * returned like regular files, symbolic links to directories are not followed.
+ * @code
+ * DirectoryWalker walker("saves");
+ * std::string path;
+ * while(walker.Next(&path)) {
+ *     //...
+ * }
+ * @endcode
+ */
+#endif
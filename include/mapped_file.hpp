@@ -0,0 +1,96 @@
+/**
+ * @file include/mapped_file.hpp
+ *
+ * @brief Read-only memory mapped files and bounds-checked memory spansbuild_header/
+ */
+#ifndef __MAPPED_FILE_HPP_INCLUDE_GUARD__
+#define __MAPPED_FILE_HPP_INCLUDE_GUARD__
+
+#include <cstddef>
+#include "../gbLib/include/gbException.hpp"
+
+/** A read-only, non-owning view on a contiguous field of T
+ * @note The span does not own its memory; it becomes invalid as soon as
+ *       the object providing the memory (e.g. a MappedFile) is destroyed.
+ */
+template<typename T>
+class MemorySpan {
+private:
+	T const* m_data;							///< first element of the span
+	size_t   m_size;							///< number of elements in the span
+public:
+	/** Constructor
+	 * @note Constructs an empty span
+	 */
+	MemorySpan(): m_data(NULL), m_size(0) {}
+	/** Constructor
+	 * @param[in] data Pointer to the first element
+	 * @param[in] size Number of elements
+	 */
+	MemorySpan(T const* data, size_t size): m_data(data), m_size(size) {}
+	/** Get the number of elements in the span
+	 * @return The number of elements
+	 */
+	size_t GetSize() const { return m_size; }
+	/** Get a pointer to the first element
+	 * @return Pointer to the first element; NULL for empty spans
+	 */
+	T const* GetData() const { return m_data; }
+	/** Bounds-checked element access
+	 * @param[in] index Element index [0..(GetSize()-1)]
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER;
+	 */
+	T const& operator[](size_t index) const {
+		if(index >= m_size) { throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER ) ); }
+		return m_data[index];
+	}
+	/** Get a part of the span
+	 * @param[in] offset Index of the first element of the new span
+	 * @param[in] count Number of elements of the new span
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER;
+	 */
+	MemorySpan<T> GetSubSpan(size_t offset, size_t count) const {
+		if((offset > m_size) || (count > m_size - offset)) {
+			throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER ) );
+		}
+		return MemorySpan<T>(m_data + offset, count);
+	}
+};
+
+/** A read-only memory mapping of a complete file
+ */
+class MappedFile {
+private:
+	unsigned char const* m_data;				///< start of the mapping
+	size_t m_size;								///< size of the mapping in bytes
+#ifdef _WIN32
+	void* m_file;								///< file handle
+	void* m_mapping;							///< file mapping handle
+#endif
+public:
+	/** Constructor
+	 * @param[in] fname Full path to the file that shall be mapped
+	 * @throw Ghulbus::gbException GB_FAILED indicates a file access error;
+	 */
+	MappedFile(char const* fname);
+	/** Destructor
+	 */
+	~MappedFile();
+	/** Get the mapped file contents
+	 * @return Pointer to the start of the mapping; NULL for empty files
+	 */
+	unsigned char const* GetData() const;
+	/** Get the size of the mapping
+	 * @return The file size in bytes
+	 */
+	size_t GetSize() const;
+	/** Get the mapped file contents as span
+	 * @return A span covering the complete file
+	 */
+	MemorySpan<unsigned char> GetSpan() const;
+private:
+	MappedFile(MappedFile const&);				///< private copy constructor (not implemented!)
+	MappedFile& operator=(MappedFile const&);	///< private copy assignment (not implemented!)
+};
+
+#endif
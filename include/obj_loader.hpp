@@ -8,12 +8,14 @@
 
 #include <iostream>
 #include <fstream>
+#include <string>
 #include <vector>
 #include "../gbLib/include/gbException.hpp"
+#include "content_hash.hpp"
+#include <climits>
 #include <cstring>
 
 /** The mesh files generated by OBJ_FileLoader
- * @todo sophisticated parsing of face entries (e.g. vert//normal)
  * @note Note that the datasets for geometry, normals and texture coordinates
  *       are expected to have a size divisible by 3! Keep this in mind and
  *       ensure that you're only writing triples when using the respective
@@ -215,12 +217,22 @@ public:
 	 */
 	Face const* GetFace(int index) const;
 private:
+	friend class OBJ_FileLoader;					///< the loader moves parsed data in without copying
 	OBJ_Mesh& operator=(OBJ_Mesh const&);			///< private copy assignment operator (not implemented)
 };
 
 #include "../src/obj_loader.impl.hpp"
 
 /** A loader for Wavefront .obj-files
+ * @note Faces may be given in any of the forms v, v/vt, v//vn and v/vt/vn, with positive or
+ *       negative (relative) indices; polygons are split into triangles. Faces without normals
+ *       get their face normal, faces without texture coordinates the coordinate (0, 0, 0).
+ * @note A new mesh is started by the first vertex following a named group (g) statement.
+ * @note Meshes can also be written to and read from binary mesh files, which hold the
+ *       parsed data as it is kept in memory: a header, a table with an entry per mesh, and
+ *       for each mesh its name and the fields of geometry, normal and texture data (doubles)
+ *       and of faces (10 ints each), every field aligned to 64 bytes. The format is little
+ *       endian; reading a binary mesh file maps it and copies the fields without parsing.
  */
 class OBJ_FileLoader {
 private:
@@ -231,9 +243,20 @@ public:
 	OBJ_FileLoader();
 	/** Constructor
 	 * @param[in] fname Full path to the file that shall be loaded
+	 * @throw Ghulbus::gbException GB_FAILED indicates a file access error or a malformed file;
 	 * @throw std::bad_alloc
 	 */
 	OBJ_FileLoader(const char* fname);
+	/** Constructor
+	 * @param[in] fname Full path to the file that shall be loaded
+	 * @param[in] n_threads Number of threads used for parsing; 0 uses one per processor
+	 * @throw Ghulbus::gbException GB_FAILED indicates a file access error or a malformed file;
+	 *                             a thread could not be created;
+	 * @throw std::bad_alloc
+	 * @note The result is the same for any number of threads. Files smaller than 2 MB
+	 *       are always parsed by the calling thread.
+	 */
+	OBJ_FileLoader(const char* fname, int n_threads);
 	/** Destructor
 	 */
 	~OBJ_FileLoader();
@@ -251,18 +274,260 @@ public:
 	 * @throw std::bad_alloc
 	 */
 	void AddMesh(OBJ_Mesh const& mesh);
+	/** Load a single mesh from a file, without keeping the others in memory
+	 * @param[in] fname Full path to the file
+	 * @param[in] index Number of the mesh, as for GetMesh() of a loader of the whole file
+	 * @param[out] n_meshes If the file has no mesh #index, receives the number of meshes
+	 *                      in the file; may be NULL
+	 * @return The mesh, which has to be deleted by the caller; NULL if the file has no mesh #index
+	 * @throw Ghulbus::gbException GB_FAILED indicates a file access error or a malformed file;
+	 * @throw std::bad_alloc
+	 * @note The file is read by an OBJ_StreamReader, which stops after the mesh.
+	 *       Meshes before it are not checked for errors.
+	 */
+	static OBJ_Mesh* LoadMesh(const char* fname, int index, int* n_meshes);
 	/** Write data back to a file
 	 * @param[in] fname Full path to the output file
 	 * @throw Ghulbus::gbException GB_FAILED indicates a file access error
 	 */
 	void WriteFile(char const* fname) const;
+	/** Write all meshes to a binary mesh file
+	 * @param[in] fname Full path to the output file
+	 * @throw Ghulbus::gbException GB_FAILED indicates a file access error
+	 */
+	void WriteBinaryFile(char const* fname) const;
+	/** Write all meshes to a binary mesh file that caches the contents of an obj file
+	 * @param[in] fname Full path to the output file
+	 * @param[in] source Full path to the obj file the meshes were loaded from; its size,
+	 *                   modification time and a hash are stored in the binary mesh file
+	 * @throw Ghulbus::gbException GB_FAILED indicates a file access error
+	 */
+	void WriteBinaryFile(char const* fname, char const* source) const;
+	/** Read meshes from a binary mesh file
+	 * @param[in] fname Full path to the binary mesh file
+	 * @throw Ghulbus::gbException GB_INVALIDCONTEXT indicates that the function was called while there
+	 *                             where already objects in the meshlist;
+	 * @throw Ghulbus::gbException GB_FAILED indicates a file access error or that the file is no
+	 *                             valid binary mesh file; the mesh list is left empty
+	 * @throw std::bad_alloc
+	 */
+	void ReadBinaryFile(char const* fname);
+	/** Read meshes from a binary mesh file, if it caches the current contents of an obj file
+	 * @param[in] fname Full path to the binary mesh file
+	 * @param[in] source Full path to the obj file
+	 * @return True if the meshes were read; false if fname does not exist, is no valid binary
+	 *         mesh file or does not match size, modification time and hash of source
+	 * @throw Ghulbus::gbException GB_INVALIDCONTEXT indicates that the function was called while there
+	 *                             where already objects in the meshlist;
+	 * @throw Ghulbus::gbException GB_FAILED indicates that source can not be accessed;
+	 * @throw std::bad_alloc
+	 * @note The hash covers the first and the last 64 KiB of source only.
+	 */
+	bool ReadBinaryFile(char const* fname, char const* source);
 private:
 	/** Private helper function that does the actual parsing
+	 * @param[in] data The contents of an obj file
+	 * @param[in] size Size of data in bytes
+	 * @param[in] n_threads Number of threads; 0 uses one per processor
 	 * @throw Ghulbus::gbException GB_INVALIDCONTEXT indicates that the function was called while there
-	 *                             where already objects in the meshlist
+	 *                             where already objects in the meshlist;
+	 * @throw Ghulbus::gbException GB_FAILED indicates a malformed vertex or face, or a face index
+	 *                             that is out of range; the mesh list is left empty
+	 * @throw std::bad_alloc
+	 */
+	void ReadFile(char const* data, size_t size, int n_threads);
+	/** Private helper function: moves the data parsed for a mesh into the mesh, filling in
+	 *                           missing normals and texture coordinates
+	 * @note Faces without normals get their face normal, faces without texture coordinates
+	 *       the coordinate (0, 0, 0); both are appended to the respective list.
+	 *       All vectors are left empty.
+	 * @throw Ghulbus::gbException GB_FAILED a face refers to an element that is not part of the mesh
+	 * @throw std::bad_alloc
+	 */
+	static void FinishMesh(OBJ_Mesh* mesh, std::vector<double>& geometry, std::vector<double>& normals,
+	                       std::vector<double>& texcoords, std::vector<OBJ_Mesh::Face>& faces);
+	/** Private helper function: writes a binary mesh file
+	 * @param[in] fname Full path to the output file
+	 * @param[in] source Full path to the cached obj file; NULL for none
+	 * @throw Ghulbus::gbException GB_FAILED indicates a file access error
+	 */
+	void WriteBinary(char const* fname, char const* source) const;
+	/** Private helper function: copies the meshes of a binary mesh file into the mesh list
+	 * @param[in] data The contents of a binary mesh file
+	 * @param[in] size Size of data in bytes
+	 * @throw Ghulbus::gbException GB_FAILED the data is no valid binary mesh file; the mesh list is left empty
+	 * @throw std::bad_alloc
+	 */
+	void ReadBinaryData(unsigned char const* data, size_t size);
+	friend class OBJ_MeshIndex;						///< the index loads single meshes with FinishMesh()
+};
+
+/** An index of the meshes of a Wavefront .obj-file, for listing the meshes and loading
+ *  single meshes without parsing the whole file
+ * @note Meshes are separated and numbered as by OBJ_FileLoader.
+ * @note The index can be kept in a sidecar file next to the obj file, named like the
+ *       obj file with ".idx" appended.
+ */
+class OBJ_MeshIndex {
+public:
+	/** Index entry of a mesh
+	 */
+	typedef struct Entry_t {
+		std::string name;							///< name of the mesh
+		unsigned long long offset;					///< byte offset of the first line of the mesh
+		unsigned long long size;					///< size of all lines of the mesh in bytes
+		int n_vertices;								///< number of geometry vertices of the mesh
+		int n_normals;								///< number of normals of the mesh
+		int n_texture;								///< number of texture coordinates of the mesh
+		int n_faces;								///< number of triangles of the mesh
+		int vert_base;								///< number of geometry vertices in the file before the mesh
+		int normal_base;							///< number of normals in the file before the mesh
+		int texture_base;							///< number of texture coordinates in the file before the mesh
+		int smoothing_group;						///< smoothing group at the start of the mesh
+	} Entry;
+private:
+	std::string m_fname;							///< path to the indexed file
+	unsigned long long m_file_size;					///< size of the indexed file in bytes
+	long long m_file_time;							///< modification time of the indexed file
+	ContentHash::Hash128 m_file_hash;				///< hash of the start and end of the indexed file
+	std::vector<Entry> m_entries;					///< entries of all meshes in file order
+public:
+	/** Constructor
+	 * @note Constructs an empty index; use Build() or ReadSidecar() to fill it
+	 */
+	OBJ_MeshIndex();
+	/** Index a file by scanning it
+	 * @param[in] fname Full path to the obj file
+	 * @throw Ghulbus::gbException GB_FAILED indicates a file access error;
+	 * @throw std::bad_alloc
+	 * @note Only the structure of the file is scanned; no numbers are parsed except those of
+	 *       smoothing groups, so malformed vertices and faces are not detected.
+	 */
+	void Build(char const* fname);
+	/** Take the index of a file from its sidecar file
+	 * @param[in] fname Full path to the obj file
+	 * @return True if the sidecar file exists and matches the size, modification time and
+	 *         hash of the obj file; false otherwise, in which case the index is not changed
+	 * @throw Ghulbus::gbException GB_FAILED indicates that the obj file can not be accessed;
+	 * @throw std::bad_alloc
+	 * @note The hash covers the first and the last 64 KiB of the obj file only.
+	 */
+	bool ReadSidecar(char const* fname);
+	/** Write the index to the sidecar file of the indexed file
+	 * @throw Ghulbus::gbException GB_INVALIDCONTEXT the index is empty;
+	 *                             GB_FAILED indicates a file access error;
+	 */
+	void WriteSidecar() const;
+	/** Get the path to the indexed file
+	 * @return The path as null-terminated C-string
+	 */
+	char const* GetFileName() const;
+	/** Get the number of meshes of the indexed file
+	 * @return The number of meshes, as OBJ_FileLoader::GetNMeshes() would return
+	 */
+	int GetNMeshes() const;
+	/** Get the index entry of a mesh
+	 * @param[in] index Number of the mesh from range [0..( GetNMeshes() - 1 )]
+	 * @return The index entry
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER;
+	 */
+	Entry const& GetEntry(int index) const;
+	/** Load a single mesh, reading only its lines from the indexed file
+	 * @param[in] index Number of the mesh from range [0..( GetNMeshes() - 1 )]
+	 * @return The mesh, which has to be deleted by the caller; it equals mesh #index
+	 *         of an OBJ_FileLoader of the file
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER;
+	 *                             GB_FAILED indicates a file access error, a malformed mesh or
+	 *                             that the file no longer matches the index;
 	 * @throw std::bad_alloc
 	 */
-	void ReadFile(std::ifstream& f);
+	OBJ_Mesh* LoadMesh(int index) const;
+};
+
+/** A reader for Wavefront .obj-files that passes the data to a visitor in batches,
+ *  instead of keeping the meshes in memory
+ * @note The file is read through a buffer of fixed size, so files of any size are read
+ *       with constant memory. Meshes are separated as by OBJ_FileLoader.
+ */
+class OBJ_StreamReader {
+public:
+	/** Texture and normal index of face corners that do not specify one
+	 */
+	static int const NO_INDEX = INT_MIN;
+	/** Interface for receiving the contents of a file
+	 * @note Data is passed in batches of limited size, in file order.
+	 *       All vertices a face refers to are passed before the face, unless the face
+	 *       refers to vertices that follow it in the file.
+	 */
+	class Visitor {
+	public:
+		/** Destructor
+		 */
+		virtual ~Visitor() {}
+		/** A new mesh starts
+		 * @param[in] index Number of the mesh, counting from 0
+		 * @return True to receive the data of the mesh; false to skip it
+		 */
+		virtual bool BeginMesh(int index) = 0;
+		/** Geometry data of the current mesh
+		 * @param[in] data Field of vertex coordinates (x, y, z)
+		 * @param[in] n_data Size of field data (3 times the number of vertices)
+		 */
+		virtual void Geometry(double const* data, int n_data) = 0;
+		/** Normal data of the current mesh
+		 * @param[in] data Field of normal coordinates (x, y, z)
+		 * @param[in] n_data Size of field data (3 times the number of normals)
+		 */
+		virtual void Normals(double const* data, int n_data) = 0;
+		/** Texture data of the current mesh
+		 * @param[in] data Field of texture coordinates (u, v, w)
+		 * @param[in] n_data Size of field data (3 times the number of texture coordinates)
+		 */
+		virtual void TextureData(double const* data, int n_data) = 0;
+		/** Faces of the current mesh
+		 * @param[in] faces Field of triangles; indices refer to the data of the current mesh,
+		 *                  texture and normal indices are NO_INDEX where the file gives none
+		 * @param[in] n_faces Size of field faces
+		 * @note Indices are not checked against the number of elements of the mesh.
+		 */
+		virtual void Faces(OBJ_Mesh::Face const* faces, int n_faces) = 0;
+		/** The current mesh ends
+		 * @param[in] index Number of the mesh
+		 * @param[in] name Name of the mesh
+		 * @param[in] has_faces True if the mesh has at least one face; also given for skipped meshes
+		 * @return True to continue reading; false to stop reading the file
+		 * @note The last mesh of a file is always ended, even if it has no faces
+		 *       (OBJ_FileLoader omits such a mesh).
+		 */
+		virtual bool EndMesh(int index, char const* name, bool has_faces) = 0;
+	};
+private:
+	std::vector<char> m_buffer;						///< buffer for reading the file
+public:
+	/** Constructor
+	 * @param[in] buffer_size Size of the read buffer in bytes; limits the length of a line
+	 * @throw std::bad_alloc
+	 */
+	OBJ_StreamReader(size_t buffer_size);
+	/** Read a file
+	 * @param[in] fname Full path to the file
+	 * @param[in] visitor Receives the contents of the file
+	 * @throw Ghulbus::gbException GB_FAILED indicates a file access error, a malformed vertex or face
+	 *                             of a mesh that is not skipped, or a line longer than the buffer;
+	 * @throw std::bad_alloc
+	 * @note Exceptions thrown by the visitor are passed on.
+	 */
+	void Read(char const* fname, Visitor* visitor);
+	/** Read from a stream
+	 * @param[in] is A stream opened in binary mode
+	 * @param[in] visitor Receives the contents of the stream
+	 * @throw Ghulbus::gbException GB_FAILED as for Read(char const*, Visitor*)
+	 * @throw std::bad_alloc
+	 */
+	void Read(std::istream& is, Visitor* visitor);
+private:
+	OBJ_StreamReader(OBJ_StreamReader const&);				///< private copy constructor (not implemented!)
+	OBJ_StreamReader& operator=(OBJ_StreamReader const&);	///< private copy assignment (not implemented!)
 };
 
 #endif
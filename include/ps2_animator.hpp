@@ -0,0 +1,114 @@
+/**
+ * @file include/ps2_animator.hpp
+ *
+ * @brief Evaluation of PS2 icon shape animationsbuild_header/
+ */
+#ifndef __PS2_ANIMATOR_HPP_INCLUDE_GUARD__
+#define __PS2_ANIMATOR_HPP_INCLUDE_GUARD__
+
+#include <vector>
+#include "../gbLib/include/gbException.hpp"
+#include "ps2_ps2icon.hpp"
+
+/** Samples the morphed geometry of an animated icon
+ * @note All Evaluate functions are const and keep no state, and the constructor reads
+ *       all lazily loaded segments they need, so a single animator can be used by several
+ *       threads at once as long as the icon is not modified in the meantime.
+ */
+class IconAnimator {
+public:
+	static int const MAX_LOOP_LENGTH    = 65536;	///< maximum number of ticks in the animation loop
+	static int const MAX_DISPLAY_FRAMES = 4096;	///< maximum number of displayed frames until the animation repeats
+private:
+	PS2Icon const* m_icon;							///< the animated icon
+	int m_n_vertices;								///< number of vertices of the icon
+	int m_n_shapes;									///< number of shapes of the icon
+	int m_n_frames;									///< number of Frame_Data entries of the icon
+	int m_loop_length;								///< number of ticks in the animation loop
+	float m_anim_speed;								///< ticks per displayed frame
+	int m_play_offset;								///< tick at which playback starts
+	std::vector<int> m_frame_shapes;				///< shape used by each frame
+	std::vector<int> m_key_begin;					///< index of the first key of each frame in m_keys
+	std::vector<PS2Icon::Frame_Key> m_keys;			///< keys of all frames, sorted by time per frame
+	std::vector<float> m_weight_table;				///< shape weights for each integral tick ((m_loop_length) rows of m_n_shapes)
+public:
+	/** Constructor
+	 * @param[in] icon The icon to animate; the animator keeps a reference to it, so it must
+	 *                 outlive the animator and its geometry must not change in the meantime
+	 * @throw Ghulbus::gbException GB_FAILED the animation references a shape that does not exist,
+	 *                             its speed is not finite or it is longer than MAX_LOOP_LENGTH ticks
+	 *                             or MAX_DISPLAY_FRAMES displayed frames;
+	 *                             the geometry of an icon opened with PS2Icon::LOAD_LAZY could not be read;
+	 * @throw std::bad_alloc
+	 */
+	IconAnimator(PS2Icon const& icon);
+	/** Destructor
+	 */
+	~IconAnimator();
+	/** Get the number of ticks in the animation loop
+	 * @return The loop length in ticks (at least 1)
+	 */
+	int GetLoopLength() const;
+	/** Get the number of displayed frames until the animation repeats
+	 * @return The number of frames at the icon's animation speed [1..MAX_DISPLAY_FRAMES]
+	 */
+	int GetNDisplayFrames() const;
+	/** Get the animation time of a displayed frame
+	 * @param[in] frame The displayed frame, counted from the start of playback
+	 * @return The time in ticks [0..GetLoopLength()), i.e. (play_offset + frame * anim_speed) wrapped to the loop
+	 */
+	float GetFrameTime(int frame) const;
+	/** Get the weight of each shape at a specific time
+	 * @param[in] t Time in ticks; wrapped to the animation loop
+	 * @param[out] weights A field of at least size n_shapes
+	 */
+	void GetShapeWeights(float t, float* weights) const;
+	/** Sample the vertex positions at a specific time
+	 * @param[in] t Time in ticks; wrapped to the animation loop
+	 * @param[out] x A field of at least size n_vertices receiving the x coordinates
+	 * @param[out] y A field of at least size n_vertices receiving the y coordinates
+	 * @param[out] z A field of at least size n_vertices receiving the z coordinates
+	 * @throw std::bad_alloc
+	 */
+	void EvaluatePlanes(float t, float* x, float* y, float* z) const;
+	/** Sample the vertex positions at a specific time
+	 * @param[in] t Time in ticks; wrapped to the animation loop
+	 * @param[out] data A field of at least size (n_vertices * 3) receiving x,y,z triples
+	 *                  (same layout as PS2Icon::GetVertexData())
+	 * @throw std::bad_alloc
+	 */
+	void Evaluate(float t, float* data) const;
+	/** Sample the vertex positions of a displayed frame
+	 * @param[in] frame The displayed frame, counted from the start of playback
+	 * @param[out] data A field of at least size (n_vertices * 3) receiving x,y,z triples
+	 * @throw std::bad_alloc
+	 */
+	void EvaluateFrame(int frame, float* data) const;
+private:
+	/** Internal helper function: evaluates the key tables without the lookup table
+	 */
+	void ComputeShapeWeights(float t, float* weights) const;
+	/** Internal helper function: wraps a time to the animation loop
+	 */
+	float WrapTime(float t) const;
+	IconAnimator(IconAnimator const&);				///< private copy constructor (not implemented!)
+	IconAnimator& operator=(IconAnimator const&);	///< private copy assignment (not implemented!)
+};
+
+//EXTENSIVE DOCUMENTATION:
+/**
+ * @class IconAnimator
+ * The animation of an icon is made up of n_frames @ref PS2Icon::Frame_Data_t "Frame_Data"
+ * entries, each naming a shape and a list of (time, value) keys. The keys of a frame
+ * describe the weight of its shape over time: between two keys the weight is interpolated
+ * linearly, before the first and after the last key it stays at the value of that key.
+ * The position of a vertex at time t is the weighted sum of its positions in all shapes.
+ * An icon without any frames shows its first shape.
+ *
+ * Time is measured in ticks; the animation repeats after frame_length ticks and each
+ * displayed frame advances anim_speed ticks, starting at play_offset.
+ *
+ * The weights of all integral ticks of the loop are computed on construction. Shapes
+ * are blended on the coordinate planes returned by PS2Icon::GetShapePlane() with SSE2.
+ */
+#endif
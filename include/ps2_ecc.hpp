@@ -0,0 +1,106 @@
+/**
+ * @file include/ps2_ecc.hpp
+ *
+ * @brief Hamming codes of PS2 memory card pagesbuild_header/
+ */
+#ifndef __PS2_ECC_HPP_INCLUDE_GUARD__
+#define __PS2_ECC_HPP_INCLUDE_GUARD__
+
+#include <cstddef>
+
+/** Error correcting codes stored in the spare area of memory card pages
+ * @note Each 128 byte chunk of a page is protected by a 3 byte Hamming code that
+ *       corrects single bit errors: the column parity followed by two line parities.
+ * @note There are two implementations of the code computation: a table-driven one working
+ *       byte by byte, and a vector one working on whole 16 byte blocks (SSE2 if the target
+ *       supports it, 32 bit words otherwise). Both yield identical results; all functions
+ *       without an explicit implementation in their name use the vector one.
+ */
+namespace PS2ECC {
+	int const CHUNK_SIZE = 128;						///< data bytes protected by one code
+	int const CODE_SIZE  = 3;						///< bytes per code
+
+	/** Outcome of checking a chunk against its code
+	 */
+	typedef enum {
+		CHECK_OK=0,									///< data and code match
+		CHECK_CORRECTED,							///< a single bit error in the data or in the code was corrected
+		CHECK_FAILED								///< the data has more errors than the code can correct
+	} CheckResult;
+
+	/** Compute the code of a chunk, using lookup tables
+	 * @param[in] chunk A field of CHUNK_SIZE bytes
+	 * @param[out] code A field of CODE_SIZE bytes receiving the code
+	 */
+	void CalculateTable(void const* chunk, unsigned char* code);
+	/** Compute the code of a chunk, using vector operations
+	 * @param[in] chunk A field of CHUNK_SIZE bytes; no alignment required
+	 * @param[out] code A field of CODE_SIZE bytes receiving the code
+	 */
+	void CalculateVector(void const* chunk, unsigned char* code);
+	/** Check whether the vector implementation uses SSE2
+	 * @return True if CalculateVector() was compiled with SSE2 intrinsics
+	 */
+	bool HasSSE2();
+	/** Compute the code of a chunk
+	 * @param[in] chunk A field of CHUNK_SIZE bytes
+	 * @param[out] code A field of CODE_SIZE bytes receiving the code
+	 */
+	void Calculate(void const* chunk, unsigned char* code);
+	/** Check a chunk against its code
+	 * @param[in] chunk A field of CHUNK_SIZE bytes
+	 * @param[in] code A field of CODE_SIZE bytes
+	 * @return True if the code matches the data
+	 */
+	bool Verify(void const* chunk, unsigned char const* code);
+	/** Check a chunk against its code and correct single bit errors
+	 * @param[in,out] chunk A field of CHUNK_SIZE bytes; a single flipped bit is restored
+	 * @param[in,out] code A field of CODE_SIZE bytes; replaced by the correct code
+	 *                     if the error was in the code itself
+	 * @return The outcome of the check; nothing is modified on CHECK_FAILED
+	 */
+	CheckResult Correct(unsigned char* chunk, unsigned char* code);
+
+	/** Compute the spare area of a page
+	 * @param[in] page A field of page_len bytes
+	 * @param[in] page_len Data bytes per page; a multiple of CHUNK_SIZE
+	 * @param[out] spare A field of (page_len / 32) bytes receiving the codes of all chunks
+	 *                   in order; the remaining bytes are set to 0
+	 */
+	void CalculatePage(void const* page, size_t page_len, unsigned char* spare);
+	/** Check a page against its spare area
+	 * @param[in] page A field of page_len bytes
+	 * @param[in] page_len Data bytes per page; a multiple of CHUNK_SIZE
+	 * @param[in] spare The spare area of the page; only the codes are checked
+	 * @return True if the codes of all chunks match
+	 */
+	bool VerifyPage(void const* page, size_t page_len, unsigned char const* spare);
+	/** Check a page against its spare area and correct single bit errors in each chunk
+	 * @param[in,out] page A field of page_len bytes
+	 * @param[in] page_len Data bytes per page; a multiple of CHUNK_SIZE
+	 * @param[in,out] spare The spare area of the page
+	 * @return The worst outcome of all chunks
+	 */
+	CheckResult CorrectPage(unsigned char* page, size_t page_len, unsigned char* spare);
+}
+
+//EXTENSIVE DOCUMENTATION:
+/**
+ * @namespace PS2ECC
+ * Bit j (0..2) of the column parity is the parity of all data bits whose bit position has
+ * bit j clear, bit (j+4) the parity of those whose position has bit j set. The first line
+ * parity is the XOR of the complemented indices of all bytes with odd parity, the second
+ * one the XOR of their indices. All three start from all ones.
+ *
+ * Both parities are linear in the data: the column parity only depends on the XOR of all
+ * bytes of the chunk, and bit k of the line parity is the parity of the XOR of all bytes
+ * whose index has bit k set. The vector implementation exploits this by folding the chunk
+ * to a handful of XOR sums instead of looking up every byte, which makes it several times
+ * faster than the table-driven version; the "make ecc_bench" target measures both.
+ *
+ * A single flipped data bit shows up as a difference in which the two line parities and
+ * the two halves of the column parity complement each other; the differences then give
+ * the index of the byte and the bit. A difference in a single code bit means that the
+ * code itself was damaged.
+ */
+#endif
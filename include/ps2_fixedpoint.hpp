@@ -0,0 +1,91 @@
+/**
+ * @file include/ps2_fixedpoint.hpp
+ *
+ * @brief Bulk conversion between the 4.12 fixed point format of icon files and floatbuild_header/
+ */
+#ifndef __PS2_FIXEDPOINT_HPP_INCLUDE_GUARD__
+#define __PS2_FIXEDPOINT_HPP_INCLUDE_GUARD__
+
+#include <cstddef>
+
+/** Conversion kernels for the 4.12 fixed point values stored in icon files
+ * @note All kernels are available as scalar, SSE2 and AVX2 implementation;
+ *       the fastest implementation supported by the executing CPU is selected
+ *       at runtime, on first use or when the program starts, whichever comes first.
+ * @note The float to fixed point direction rounds to nearest (ties to even) and
+ *       saturates to [-32768..32767]; NaN saturates to -32768.
+ */
+namespace PS2FixedPoint {
+	/** Available kernel implementations
+	 */
+	typedef enum {
+		KERNEL_SCALAR=0,				///< portable C++ implementation
+		KERNEL_SSE2,					///< x86 SSE2 implementation
+		KERNEL_AVX2						///< x86 AVX2 implementation
+	} KernelType;
+
+	/** Convert a field of fixed point values to float
+	 * @param[in] src A field of at least size n
+	 * @param[out] dst A field of at least size n
+	 * @param[in] n Number of values
+	 */
+	void ToFloat(short const* src, float* dst, size_t n);
+	/** Convert a field of floats to fixed point
+	 * @param[in] src A field of at least size n
+	 * @param[out] dst A field of at least size n
+	 * @param[in] n Number of values
+	 */
+	void FromFloat(float const* src, short* dst, size_t n);
+	/** Convert the x, y and z fields of a strided field of Vertex_Coord structs to float
+	 * @param[in] src The first Vertex_Coord
+	 * @param[in] src_stride Distance between two Vertex_Coords in bytes (must be a multiple of 2)
+	 * @param[out] dst A field of at least size (n*3) receiving tightly packed x,y,z triples
+	 * @param[in] n Number of Vertex_Coords
+	 */
+	void CoordsToFloat(void const* src, size_t src_stride, float* dst, size_t n);
+	/** Convert the x, y and z fields of a strided field of Vertex_Coord structs to three separate planes
+	 * @param[in] src The first Vertex_Coord
+	 * @param[in] src_stride Distance between two Vertex_Coords in bytes (must be a multiple of 2)
+	 * @param[out] x A field of at least size n receiving the x coordinates
+	 * @param[out] y A field of at least size n receiving the y coordinates
+	 * @param[out] z A field of at least size n receiving the z coordinates
+	 * @param[in] n Number of Vertex_Coords
+	 */
+	void CoordsToPlanes(void const* src, size_t src_stride, float* x, float* y, float* z, size_t n);
+	/** Convert tightly packed x,y,z float triples to a strided field of Vertex_Coord structs
+	 * @param[in] src A field of at least size (n*3)
+	 * @param[out] dst The first Vertex_Coord
+	 * @param[in] dst_stride Distance between two Vertex_Coords in bytes (must be a multiple of 2)
+	 * @param[in] n Number of Vertex_Coords
+	 * @note The f16_unknown field of each Vertex_Coord is set to 0.
+	 */
+	void FloatToCoords(float const* src, void* dst, size_t dst_stride, size_t n);
+	/** Convert the u and v fields of a strided field of Texture_Data structs to float
+	 * @param[in] src The first Texture_Data
+	 * @param[in] src_stride Distance between two Texture_Datas in bytes (must be a multiple of 2)
+	 * @param[out] dst A field of at least size (n*2) receiving tightly packed u,v pairs
+	 * @param[in] n Number of Texture_Datas
+	 */
+	void TexCoordsToFloat(void const* src, size_t src_stride, float* dst, size_t n);
+	/** Convert tightly packed u,v float pairs to a strided field of Texture_Data structs
+	 * @param[in] src A field of at least size (n*2)
+	 * @param[out] dst The first Texture_Data
+	 * @param[in] dst_stride Distance between two Texture_Datas in bytes (must be a multiple of 2)
+	 * @param[in] n Number of Texture_Datas
+	 * @note The color field of each Texture_Data is left untouched.
+	 */
+	void FloatToTexCoords(float const* src, void* dst, size_t dst_stride, size_t n);
+	/** Get the kernel implementation currently in use
+	 * @return The active kernel type
+	 */
+	KernelType GetKernelType();
+	/** Force a specific kernel implementation (e.g. for benchmarking)
+	 * @param[in] type The kernel to use; if the CPU does not support it, the
+	 *                 best supported kernel is selected instead
+	 * @return The kernel type that is active after the call
+	 * @remark Switching kernels is *not* thread-safe
+	 */
+	KernelType SetKernelType(KernelType type);
+};
+
+#endif
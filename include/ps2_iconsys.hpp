@@ -7,7 +7,10 @@
 #define __PS2_ICON_SYS_HPP_INCLUDE_GUARD__
 
 #include <fstream>
+#include <vector>
 #include "../gbLib/include/gbException.hpp"
+#include "mapped_file.hpp"
+#include "content_hash.hpp"
 
 /** A loader for the PS2 icon.sys files
  */
@@ -150,6 +153,11 @@ public:
 	 * @throw Ghulbus::gbException GB_FAILED indicates either a file read error or corrupt file;
 	 */
 	IconSys(const char* fname);
+	/** Constructor
+	 * @param[in] data Contents of a valid icon.sys file, e.g. read from a memory card image
+	 * @throw Ghulbus::gbException GB_FAILED indicates a truncated file;
+	 */
+	IconSys(MemorySpan<unsigned char> const& data);
 	/** Destructor
 	 */
 	~IconSys();
@@ -293,6 +301,30 @@ public:
 	 * @throw Ghulbus::gbException GB_FAILED indicates a file access error;
 	 */
 	void WriteFile(char const * fname);
+	/** Serialize the current data to memory, in the same format as WriteFile()
+	 * @param[out] data Receives the contents of the icon.sys file
+	 * @throw std::bad_alloc
+	 */
+	void WriteData(std::vector<unsigned char>* data) const;
+	/** Check the contents of an icon.sys file without decoding it
+	 * @param[in] data Contents of the file
+	 * @return True if the data is large enough and the PS2D string and the reserved fields
+	 *         are consistent
+	 */
+	static bool CheckValidity(MemorySpan<unsigned char> const& data);
+	/** Content hashes of an icon.sys, see GetFingerprint()
+	 */
+	typedef struct Fingerprint_t {
+		ContentHash::Hash128 display;				///< background colors, opacity and lights
+		ContentHash::Hash128 names;					///< title and icon file names
+		ContentHash::Hash128 file;					///< all of the above
+	} Fingerprint;
+	/** Compute the content hashes of the icon.sys
+	 * @return Hashes of the display settings, of the strings and of the complete file
+	 * @note The reserved fields and any bytes following the terminating null of a string
+	 *       are ignored, so that files which display identically get identical fingerprints.
+	 */
+	Fingerprint GetFingerprint() const;
 private:
 	/** Internal helper function
 	 * Checks the PS2D string and the reserved fields for consistency
@@ -309,6 +341,10 @@ private:
 	/** Augments the ASCII title string with a proper line break
 	 */
 	static void GetTitleString(char const * str_in, unsigned int pos_linebreak, char * str_out);
+	/** Internal helper function
+	 * Builds the decoded title strings from the File structure
+	 */
+	void DecodeStrings();
 	IconSys(IconSys const&);						///< private copy constructor (not implemented!)
 	IconSys& operator=(IconSys const&);				///< private copy assignment (not implemented!)
 };
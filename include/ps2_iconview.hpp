@@ -0,0 +1,140 @@
+/**
+ * @file include/ps2_iconview.hpp
+ *
+ * @brief A read-only, zero-copy view on PS2 icon filesbuild_header/
+ */
+#ifndef __PS2_ICON_VIEW_HPP_INCLUDE_GUARD__
+#define __PS2_ICON_VIEW_HPP_INCLUDE_GUARD__
+
+#include <vector>
+#include "../gbLib/include/gbException.hpp"
+#include "ps2_ps2icon.hpp"
+#include "mapped_file.hpp"
+
+/** A read-only view on a memory mapped PS2 icon file
+ * @note All accessors return references or spans into the mapping; they are
+ *       only valid as long as the view object is alive.
+ */
+class PS2IconView {
+private:
+	MappedFile* m_file;								///< the mapped icon file; NULL for views on memory
+	unsigned char const* m_data;					///< start of the icon data
+	size_t m_size;									///< size of the icon data in bytes
+	size_t m_record_size;							///< size of a single vertex record in bytes
+	size_t m_anim_offset;							///< offset of the animation header
+	size_t m_texture_offset;						///< offset of the texture segment
+	std::vector<size_t> m_frame_offsets;			///< offset of each Frame_Data entry
+public:
+	/** Constructor
+	 * @param[in] fname Complete path to a valid icon file
+	 * @throw Ghulbus::gbException GB_FAILED indicates a file access error or a corrupted file;
+	 * @throw std::bad_alloc
+	 */
+	PS2IconView(char const* fname);
+	/** Constructor
+	 * @param[in] data Contents of an icon file, e.g. read from a memory card image; the view
+	 *                 does not copy the data, so it must stay valid for the lifetime of the view
+	 * @throw Ghulbus::gbException GB_FAILED indicates a corrupted file;
+	 * @throw std::bad_alloc
+	 */
+	PS2IconView(MemorySpan<unsigned char> const& data);
+	/** Destructor
+	 */
+	~PS2IconView();
+	/** Get the file header
+	 * @return The icon file header
+	 */
+	PS2Icon::Icon_Header const& GetHeader() const;
+	/** Get the number of vertices of the icon
+	 * @return The number of vertices of the icon
+	 */
+	int GetNVertices() const;
+	/** Get the number of shapes per vertex
+	 * @return The number of shapes of the icon
+	 */
+	int GetNShapes() const;
+	/** Get the size of a single interleaved vertex record
+	 * @return The record size in bytes ((animation_shapes + 2) * 8)
+	 */
+	size_t GetVertexRecordSize() const;
+	/** Get the complete vertex segment
+	 * @return A span of (n_vertices * GetVertexRecordSize()) bytes
+	 */
+	MemorySpan<unsigned char> GetVertexSegment() const;
+	/** Get the coordinates of all shapes of a vertex
+	 * @param[in] vertex Vertex index [0..(n_vertices-1)]
+	 * @return A span of (animation_shapes) vertex coordinates
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER;
+	 */
+	MemorySpan<PS2Icon::Vertex_Coord> GetVertexShapes(int vertex) const;
+	/** Get the normal of a vertex
+	 * @param[in] vertex Vertex index [0..(n_vertices-1)]
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER;
+	 */
+	PS2Icon::Vertex_Coord const& GetVertexNormal(int vertex) const;
+	/** Get the texture coordinates and color of a vertex
+	 * @param[in] vertex Vertex index [0..(n_vertices-1)]
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER;
+	 */
+	PS2Icon::Texture_Data const& GetVertexTexture(int vertex) const;
+	/** Get the animation header
+	 * @return The animation header
+	 */
+	PS2Icon::Animation_Header const& GetAnimationHeader() const;
+	/** Get the number of frames in the animation
+	 * @return The number of frames of the icon
+	 */
+	int GetNFrames() const;
+	/** Get the complete animation data segment (excluding the animation header)
+	 * @return A span holding all Frame_Data and Frame_Key entries
+	 */
+	MemorySpan<unsigned char> GetAnimationSegment() const;
+	/** Get the frame data for a specific frame
+	 * @param[in] frame Number of the frame [0..(n_frames-1)]
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER;
+	 */
+	PS2Icon::Frame_Data const& GetFrameData(int frame) const;
+	/** Get the keys for a specific frame
+	 * @param[in] frame Number of the frame [0..(n_frames-1)]
+	 * @return A span of (n_keys) frame keys
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER;
+	 */
+	MemorySpan<PS2Icon::Frame_Key> GetFrameKeys(int frame) const;
+	/** Check whether the texture segment is rle encoded
+	 * @return True if the texture segment is compressed
+	 */
+	bool IsTextureCompressed() const;
+	/** Get the complete texture segment
+	 * @return A span of 32768 bytes (uncompressed) resp. the 32 bit size field
+	 *         followed by the rle encoded data (compressed)
+	 */
+	MemorySpan<unsigned char> GetTextureSegment() const;
+	/** Compute the content hashes of the icon
+	 * @return The same fingerprint as PS2Icon::GetFingerprint() for this file; only the
+	 *         texture is decoded, and only if it is rle encoded
+	 * @throw std::bad_alloc
+	 */
+	PS2Icon::Fingerprint GetFingerprint() const;
+private:
+	/** Internal helper function: validates the file layout and calculates segment offsets
+	 * @throw Ghulbus::gbException GB_FAILED indicates a corrupted file;
+	 * @throw std::bad_alloc
+	 */
+	void ParseLayout();
+	PS2IconView(PS2IconView const&);				///< private copy constructor (not implemented!)
+	PS2IconView& operator=(PS2IconView const&);		///< private copy assignment (not implemented!)
+};
+
+//EXTENSIVE DOCUMENTATION:
+/**
+ * @class PS2IconView
+ * This class provides read-only access to an icon file without decoding or copying
+ * any of its data. The file is mapped into memory once and all segments described in
+ * @ref ps2icon_file "the PS2Icon file format" are exposed as bounds-checked spans
+ * over that mapping. The layout of the file is validated on construction, so that
+ * none of the accessors may ever read past the end of the mapping.
+ *
+ * Use this class for bulk scanning of icon files. If a mutable copy of the data is
+ * required, construct a PS2Icon from the view.
+ */
+#endif
@@ -0,0 +1,243 @@
+/**
+ * @file include/ps2_memcard.hpp
+ *
+ * @brief A reader for PS2 memory card imagesbuild_header/
+ */
+#ifndef __PS2_MEMCARD_HPP_INCLUDE_GUARD__
+#define __PS2_MEMCARD_HPP_INCLUDE_GUARD__
+
+#include <string>
+#include <vector>
+#include "../gbLib/include/gbException.hpp"
+#include "mapped_file.hpp"
+
+/** Read-only access to the save directories of a PS2 memory card image
+ */
+class PS2MemoryCard {
+public:
+	/** Card superblock, stored at the start of the first page
+	 */
+	typedef struct Superblock_t {
+		char magic[28];								///< "Sony PS2 Memory Card Format "
+		char version[12];							///< format version, e.g. "1.2.0.0"
+		unsigned short page_len;					///< data bytes per page (512)
+		unsigned short pages_per_cluster;			///< pages per cluster (2)
+		unsigned short pages_per_erase_block;		///< pages per erase block (16)
+		unsigned short unknown;						///< should be: 0xFF00
+		unsigned int clusters_per_card;				///< total number of clusters
+		unsigned int alloc_offset;					///< first cluster of the allocatable area
+		unsigned int alloc_end;						///< number of allocatable clusters
+		unsigned int rootdir_cluster;				///< first cluster of the root directory (relative to alloc_offset)
+		unsigned int backup_block1;					///< erase block used for backup
+		unsigned int backup_block2;					///< erase block used for backup
+		unsigned int reserve1[2];					///< unused
+		unsigned int ifc_list[32];					///< clusters of the indirect FAT
+		unsigned int bad_block_list[32];			///< bad erase blocks
+		unsigned char card_type;					///< card type (2 = PS2)
+		unsigned char card_flags;					///< card flags
+		unsigned char reserve2[2];					///< unused
+	} Superblock;
+	/** Time stamp of a directory entry
+	 */
+	typedef struct Time_Stamp_t {
+		unsigned char reserve;						///< unused
+		unsigned char second;						///< second (0..59)
+		unsigned char minute;						///< minute (0..59)
+		unsigned char hour;							///< hour (0..23)
+		unsigned char day;							///< day of the month (1..31)
+		unsigned char month;						///< month (1..12)
+		unsigned short year;						///< year
+	} Time_Stamp;
+	/** Directory entry; every directory is a file of (length) consecutive entries
+	 */
+	typedef struct Dir_Entry_t {
+		unsigned short mode;						///< combination of Dir_Entry_Mode flags
+		unsigned short reserve1;					///< unused
+		unsigned int length;						///< file size in bytes resp. number of entries of a directory
+		Time_Stamp created;							///< creation time
+		unsigned int cluster;						///< first cluster (relative to alloc_offset)
+		unsigned int dir_entry;						///< index of the entry in the parent directory ("." entries only)
+		Time_Stamp modified;						///< modification time
+		unsigned int attributes;					///< user attributes
+		unsigned char reserve2[28];					///< unused
+		char name[32];								///< entry name (null terminated ASCII)
+		unsigned char reserve3[416];				///< unused
+	} Dir_Entry;
+	/** Flags of Dir_Entry::mode
+	 */
+	typedef enum Dir_Entry_Mode_t {
+		DF_READ      = 0x0001,
+		DF_WRITE     = 0x0002,
+		DF_EXECUTE   = 0x0004,
+		DF_PROTECTED = 0x0008,
+		DF_FILE      = 0x0010,
+		DF_DIRECTORY = 0x0020,
+		DF_0080      = 0x0080,
+		DF_0400      = 0x0400,
+		DF_HIDDEN    = 0x2000,
+		DF_EXISTS    = 0x8000
+	} Dir_Entry_Mode;
+	static unsigned int const FAT_ALLOCATED   = 0x80000000;	///< FAT entry bit marking a used cluster
+	static unsigned int const FAT_CHAIN_END   = 0x7FFFFFFF;	///< FAT entry value (without FAT_ALLOCATED) ending a chain
+private:
+	/** A file of a save directory
+	 */
+	typedef struct Save_File_t {
+		std::string name;							///< file name
+		unsigned int length;						///< file size in bytes
+		unsigned int cluster;						///< first cluster (relative to alloc_offset)
+	} Save_File;
+	/** A save directory in the root directory
+	 */
+	typedef struct Save_Dir_t {
+		std::string name;							///< directory name
+		std::vector<Save_File> files;				///< files of the directory
+	} Save_Dir;
+	MappedFile* m_file;								///< the mapped card image; NULL for cards in memory
+	unsigned char const* m_data;					///< start of the card image
+	size_t m_size;									///< size of the card image in bytes
+	Superblock m_superblock;						///< copy of the superblock
+	size_t m_raw_page_size;							///< bytes per page in the image, including the spare area if present
+	size_t m_cluster_size;							///< data bytes per cluster
+	unsigned int m_n_pages;							///< number of pages of the card
+	std::vector<Save_Dir> m_saves;					///< save directories of the card
+public:
+	/** Constructor
+	 * @param[in] fname Complete path to a memory card image (with or without ECC spare areas);
+	 *                  the image is mapped once and never copied
+	 * @throw Ghulbus::gbException GB_FAILED indicates a file access error or a corrupted image;
+	 * @throw std::bad_alloc
+	 */
+	PS2MemoryCard(char const* fname);
+	/** Constructor
+	 * @param[in] data A memory card image; it is not copied, so it must stay valid for the
+	 *                 lifetime of the object
+	 * @throw Ghulbus::gbException GB_FAILED indicates a corrupted image;
+	 * @throw std::bad_alloc
+	 */
+	PS2MemoryCard(MemorySpan<unsigned char> const& data);
+	/** Destructor
+	 */
+	~PS2MemoryCard();
+	/** Get the card superblock
+	 * @return The superblock
+	 */
+	Superblock const& GetSuperblock() const;
+	/** Check whether the image stores the ECC spare area of each page
+	 * @return True if each page is followed by (page_len / 32) spare bytes
+	 */
+	bool HasECC() const;
+	/** Check the ECC spare area of every page
+	 * @return The number of pages whose data does not match the codes of their spare area;
+	 *         pages with an erased spare area (never written) are not counted.
+	 *         Always 0 if the image does not store spare areas.
+	 */
+	unsigned int VerifyECC() const;
+	/** Get the number of save directories
+	 * @return The number of existing directories in the root directory
+	 */
+	int GetNSaves() const;
+	/** Get the name of a save directory
+	 * @param[in] save Index of the save directory [0..(GetNSaves()-1)]
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER;
+	 */
+	char const* GetSaveName(int save) const;
+	/** Find a save directory by name
+	 * @param[in] name Name of the directory
+	 * @return Index of the save directory; -1 if it does not exist
+	 */
+	int FindSave(char const* name) const;
+	/** Get the number of files in a save directory
+	 * @param[in] save Index of the save directory [0..(GetNSaves()-1)]
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER;
+	 */
+	int GetNFiles(int save) const;
+	/** Get the name of a file
+	 * @param[in] save Index of the save directory [0..(GetNSaves()-1)]
+	 * @param[in] file Index of the file [0..(GetNFiles(save)-1)]
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER;
+	 */
+	char const* GetFileName(int save, int file) const;
+	/** Get the size of a file
+	 * @param[in] save Index of the save directory [0..(GetNSaves()-1)]
+	 * @param[in] file Index of the file [0..(GetNFiles(save)-1)]
+	 * @return The file size in bytes
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER;
+	 */
+	size_t GetFileSize(int save, int file) const;
+	/** Find a file by name
+	 * @param[in] save Index of the save directory [0..(GetNSaves()-1)]
+	 * @param[in] name Name of the file; compared case-insensitively, as icon.sys files
+	 *                 do not always match the case of the icon file names
+	 * @return Index of the file; -1 if it does not exist
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER;
+	 */
+	int FindFile(int save, char const* name) const;
+	/** Read a file to memory
+	 * @param[in] save Index of the save directory [0..(GetNSaves()-1)]
+	 * @param[in] file Index of the file [0..(GetNFiles(save)-1)]
+	 * @param[out] data Receives the file contents; suitable for the IconSys and PS2IconView
+	 *                  constructors taking a MemorySpan
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER;
+	 *                             GB_FAILED indicates a corrupted FAT;
+	 * @throw std::bad_alloc
+	 */
+	void ReadFile(int save, int file, std::vector<unsigned char>* data) const;
+	/** Read a file to memory
+	 * @param[in] path Path of the file in the form "directory/file"
+	 * @param[out] data Receives the file contents
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER the file does not exist;
+	 *                             GB_FAILED indicates a corrupted FAT;
+	 * @throw std::bad_alloc
+	 */
+	void ReadFile(char const* path, std::vector<unsigned char>* data) const;
+private:
+	/** Internal helper function: validates the superblock and the image size and reads the directory tree
+	 */
+	void ParseCard();
+	/** Internal helper function: get the data of a page
+	 */
+	unsigned char const* GetPage(unsigned int page) const;
+	/** Internal helper function: read a 32 bit word of a cluster (absolute cluster number)
+	 */
+	unsigned int ReadClusterWord(unsigned int cluster, unsigned int index) const;
+	/** Internal helper function: look up the FAT entry of a cluster (relative to alloc_offset)
+	 */
+	unsigned int GetFATEntry(unsigned int cluster) const;
+	/** Internal helper function: reads (length) bytes of a cluster chain (relative to alloc_offset)
+	 */
+	void ReadChain(unsigned int cluster, size_t length, std::vector<unsigned char>* data) const;
+	/** Internal helper function: reads all entries of a directory
+	 */
+	void ReadDirectory(unsigned int cluster, std::vector<Dir_Entry>* entries) const;
+	PS2MemoryCard(PS2MemoryCard const&);			///< private copy constructor (not implemented!)
+	PS2MemoryCard& operator=(PS2MemoryCard const&);	///< private copy assignment (not implemented!)
+};
+
+//EXTENSIVE DOCUMENTATION:
+/**
+ * @class PS2MemoryCard
+ * A card is made up of pages of page_len data bytes (512), which may each be followed by
+ * a spare area of page_len/32 bytes holding the page ECC; both kinds of images (8 MB raw
+ * dumps and 8.25 MB dumps with ECC) are recognized by their size. Pages are grouped to
+ * clusters, the unit of allocation.
+ *
+ * The FAT holds one 32 bit entry per allocatable cluster: the entry of a used cluster has
+ * the FAT_ALLOCATED bit set and names the next cluster of the file, or FAT_CHAIN_END for
+ * the last cluster. The FAT itself is stored in clusters listed by the indirect FAT
+ * clusters of Superblock::ifc_list. All cluster numbers in the FAT and in directory entries
+ * are relative to Superblock::alloc_offset.
+ *
+ * A directory is a file of 512 byte Dir_Entry records, starting with "." and "..". The
+ * length of the "." entry is the number of entries of the directory. The root directory
+ * holds one subdirectory per save, which in turn holds the icon.sys and the icon files.
+ *
+ * The image is mapped once; ReadFile() gathers the clusters of a file to a contiguous
+ * buffer that can be handed to IconSys or PS2IconView without any temporary files:
+ * @code
+ * std::vector<unsigned char> data;
+ * card.ReadFile(save, card.FindFile(save, "icon.sys"), &data);
+ * IconSys icon_sys( MemorySpan<unsigned char>(&data[0], data.size()) );
+ * @endcode
+ */
+#endif
@@ -0,0 +1,147 @@
+/**
+ * @file include/ps2_memcard_writer.hpp
+ *
+ * @brief A writer for PS2 memory card imagesbuild_header/
+ */
+#ifndef __PS2_MEMCARD_WRITER_HPP_INCLUDE_GUARD__
+#define __PS2_MEMCARD_WRITER_HPP_INCLUDE_GUARD__
+
+#include <string>
+#include <vector>
+#include "../gbLib/include/gbException.hpp"
+#include "mapped_file.hpp"
+#include "ps2_iconsys.hpp"
+#include "ps2_ps2icon.hpp"
+#include "ps2_memcard.hpp"
+
+/** Packs save directories into a freshly formatted 8 MB memory card image
+ */
+class PS2MemoryCardWriter {
+public:
+	static unsigned int const PAGE_LEN          = 512;		///< data bytes per page
+	static unsigned int const PAGES_PER_CLUSTER = 2;		///< pages per cluster
+	static unsigned int const CLUSTERS_PER_CARD = 8192;		///< total number of clusters
+	static unsigned int const MAX_NAME_LEN      = 31;		///< maximum length of a directory or file name
+private:
+	/** A file of a save directory
+	 */
+	typedef struct Save_File_t {
+		std::string name;							///< file name
+		std::vector<unsigned char> data;			///< file contents
+	} Save_File;
+	/** A save directory in the root directory
+	 */
+	typedef struct Save_Dir_t {
+		std::string name;							///< directory name
+		std::vector<Save_File> files;				///< files of the directory
+	} Save_Dir;
+	/** A contiguous run of clusters holding one file or directory
+	 */
+	typedef struct Extent_t {
+		unsigned int cluster;						///< first cluster (relative to alloc_offset)
+		unsigned int n_clusters;					///< number of clusters
+		std::vector<unsigned char> const* data;		///< contents; padded with 0xFF up to the end of the extent
+	} Extent;
+	std::vector<Save_Dir> m_saves;					///< save directories of the card
+	PS2MemoryCard::Superblock m_superblock;			///< superblock of the formatted card
+	unsigned int m_n_used;							///< number of allocated clusters
+public:
+	/** Constructor
+	 */
+	PS2MemoryCardWriter();
+	/** Add an empty save directory
+	 * @param[in] name Name of the directory (at most MAX_NAME_LEN characters)
+	 * @return Index of the new save directory
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER the name is invalid or already taken;
+	 *                             GB_FAILED the card is full;
+	 * @throw std::bad_alloc
+	 */
+	int AddSave(char const* name);
+	/** Get the number of save directories
+	 */
+	int GetNSaves() const;
+	/** Add a file to a save directory
+	 * @param[in] save Index of the save directory [0..(GetNSaves()-1)]
+	 * @param[in] name Name of the file (at most MAX_NAME_LEN characters)
+	 * @param[in] data Contents of the file; copied
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER the name is invalid or already taken;
+	 *                             GB_FAILED the card is full;
+	 * @throw std::bad_alloc
+	 */
+	void AddFile(int save, char const* name, MemorySpan<unsigned char> const& data);
+	/** Add an icon.sys file to a save directory
+	 * @param[in] save Index of the save directory [0..(GetNSaves()-1)]
+	 * @param[in] icon_sys The icon.sys to store as "icon.sys"
+	 * @throw Ghulbus::gbException see AddFile()
+	 * @throw std::bad_alloc
+	 */
+	void AddIconSys(int save, IconSys const& icon_sys);
+	/** Add an icon file to a save directory
+	 * @param[in] save Index of the save directory [0..(GetNSaves()-1)]
+	 * @param[in] name Name of the file; should match one of the icon names of the icon.sys
+	 * @param[in] icon The icon to store
+	 * @param[in] encoding Encoding of the texture segment (see PS2Icon::WriteFile())
+	 * @throw Ghulbus::gbException see AddFile()
+	 * @throw std::bad_alloc
+	 */
+	void AddIcon(int save, char const* name, PS2Icon const& icon, PS2Icon::TextureEncoding encoding);
+	/** Get the number of allocated clusters
+	 * @return Clusters used by all directories and files added so far
+	 */
+	unsigned int GetNUsedClusters() const;
+	/** Get the number of allocatable clusters
+	 */
+	unsigned int GetNClusters() const;
+	/** Write the card image
+	 * @param[in] fname Complete path to the output image
+	 * @param[in] with_ecc If true, each page is followed by its 16 byte ECC spare area
+	 *                     (8.25 MB image); otherwise a raw 8 MB image is written
+	 * @throw Ghulbus::gbException GB_FAILED indicates a file access error;
+	 * @throw std::bad_alloc
+	 */
+	void Write(char const* fname, bool with_ecc) const;
+private:
+	/** Internal helper function: checks a new entry name for validity and uniqueness
+	 */
+	static void CheckName(char const* name, std::vector<std::string> const& taken);
+	/** Internal helper function: number of clusters of a file of (size) bytes
+	 */
+	static unsigned int ClustersFor(size_t size);
+	/** Internal helper function: number of clusters of a directory of (n_entries) entries
+	 */
+	static unsigned int DirClustersFor(size_t n_entries);
+	/** Internal helper function: reserves clusters, throws if the card is full
+	 */
+	void Allocate(unsigned int n_clusters);
+	/** Internal helper function: fills a directory entry
+	 */
+	static void MakeEntry(PS2MemoryCard::Dir_Entry* entry, char const* name, unsigned short mode,
+	                      unsigned int length, unsigned int cluster, unsigned int dir_entry,
+	                      PS2MemoryCard::Time_Stamp const& time);
+	PS2MemoryCardWriter(PS2MemoryCardWriter const&);			///< private copy constructor (not implemented!)
+	PS2MemoryCardWriter& operator=(PS2MemoryCardWriter const&);	///< private copy assignment (not implemented!)
+};
+
+//EXTENSIVE DOCUMENTATION:
+/**
+ * @class PS2MemoryCardWriter
+ * The writer collects save directories in memory and lays them out on a card formatted
+ * the same way as by the PS2 browser: the superblock in the first page, the indirect FAT
+ * in cluster 8, the FAT in clusters 9..40 and the allocatable area starting at cluster 41,
+ * with the two backup erase blocks at the end of the card left erased.
+ *
+ * Every directory and file occupies a contiguous run of clusters, allocated in the order
+ * the entries are added; the root directory comes first. Since the whole layout is known
+ * in advance, Write() emits the image front to back in a single pass, generating the
+ * superblock, FAT, directory entries and the ECC spare area of every page on the fly
+ * without ever holding the card image in memory. The result can be read back with
+ * PS2MemoryCard:
+ * @code
+ * PS2MemoryCardWriter writer;
+ * int save = writer.AddSave("BASLUS-12345");
+ * writer.AddIconSys(save, icon_sys);
+ * writer.AddIcon(save, "icon.icn", icon, PS2Icon::TEXTURE_AUTO);
+ * writer.Write("card.ps2", true);
+ * @endcode
+ */
+#endif
@@ -0,0 +1,111 @@
+/**
+ * @file include/ps2_preview.hpp
+ *
+ * @brief Parallel rendering of animated icon previewsbuild_header/
+ */
+#ifndef __PS2_PREVIEW_HPP_INCLUDE_GUARD__
+#define __PS2_PREVIEW_HPP_INCLUDE_GUARD__
+
+#include <vector>
+#include "../gbLib/include/gbException.hpp"
+#include "ps2_ps2icon.hpp"
+#include "ps2_iconsys.hpp"
+#include "ps2_animator.hpp"
+#include "ps2_rasterizer.hpp"
+#include "thread_pool.hpp"
+
+/** Renders every displayed frame of an icon's animation loop
+ */
+class IconPreviewRenderer {
+private:
+	PS2Icon const* m_icon;							///< the rendered icon
+	int m_width;									///< frame width in pixels
+	int m_height;									///< frame height in pixels
+	int m_n_frames;									///< number of displayed frames in the loop
+	IconAnimator m_animator;						///< samples the geometry of each frame
+	ThreadPool m_pool;								///< threads the frames are distributed to
+	std::vector<IconRasterizer*> m_rasterizers;		///< one rasterizer per thread of m_pool
+	std::vector<float> m_geometry;					///< x,y,z triples of all frames (m_n_frames * n_vertices * 3)
+	std::vector<unsigned int> m_frames;				///< rendered ARGB images of all frames (m_n_frames * m_width * m_height)
+public:
+	/** Constructor
+	 * @param[in] icon The icon to render; it must outlive the renderer. All lazily loaded
+	 *                 segments of the icon are read here, so the worker threads only read it.
+	 * @param[in] width Frame width in pixels [1..IconRasterizer::MAX_SIZE]
+	 * @param[in] height Frame height in pixels [1..IconRasterizer::MAX_SIZE]
+	 * @param[in] n_threads Number of rendering threads; 0 uses one per processor
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER;
+	 *                             GB_FAILED the animation is rejected by IconAnimator
+	 *                             or a thread could not be created;
+	 * @throw std::bad_alloc
+	 */
+	IconPreviewRenderer(PS2Icon const& icon, int width, int height, int n_threads);
+	/** Destructor
+	 */
+	~IconPreviewRenderer();
+	/** Get the frame width
+	 * @return The frame width in pixels
+	 */
+	int GetWidth() const;
+	/** Get the frame height
+	 * @return The frame height in pixels
+	 */
+	int GetHeight() const;
+	/** Get the number of frames
+	 * @return The number of displayed frames until the animation repeats (see IconAnimator::GetNDisplayFrames())
+	 */
+	int GetNFrames() const;
+	/** Get the number of rendering threads
+	 * @return The number of threads used by RenderFrames()
+	 */
+	int GetNThreads() const;
+	/** Take lights and background colors from an icon.sys
+	 * @param[in] icon_sys The icon.sys describing the scene
+	 * @note Only affects subsequent calls to RenderFrames().
+	 */
+	void SetLighting(IconSys const& icon_sys);
+	/** Render all frames
+	 * @throw Ghulbus::gbException Errors of the worker threads;
+	 * @throw std::bad_alloc
+	 */
+	void RenderFrames();
+	/** Get a rendered frame
+	 * @param[in] frame Index of the frame [0..(GetNFrames()-1)]
+	 * @param[out] data A field of at least size (width * height) receiving the image in ARGB format
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER
+	 */
+	void GetFrame(int frame, unsigned int* data) const;
+	/** Write all frames to a single TGA file, row by row from the top left
+	 * @param[in] fname The full path of the destination file
+	 * @param[in] columns Number of frames per row; 0 chooses a square-ish layout
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER the sheet exceeds the size supported by TGA;
+	 *                             GB_FAILED file access error;
+	 * @throw std::bad_alloc
+	 */
+	void WriteSpriteSheet(char const* fname, int columns) const;
+	/** Write each frame to its own TGA file
+	 * @param[in] prefix Path prefix of the destination files; frame i is written to
+	 *                   prefix_iiii.tga, with the index padded to four digits
+	 * @throw Ghulbus::gbException GB_FAILED file access error;
+	 * @throw std::bad_alloc
+	 */
+	void WriteFrameSequence(char const* prefix) const;
+private:
+	IconPreviewRenderer(IconPreviewRenderer const&);				///< private copy constructor (not implemented!)
+	IconPreviewRenderer& operator=(IconPreviewRenderer const&);	///< private copy assignment (not implemented!)
+};
+
+//EXTENSIVE DOCUMENTATION:
+/**
+ * @class IconPreviewRenderer
+ * The frames are the displayed frames of one animation loop as defined by IconAnimator:
+ * frame i shows the icon at tick (play_offset + i * anim_speed). The geometry of all frames
+ * is sampled on construction and a common view is fitted to the union of all frames, so
+ * the icon does not jump or scale between frames.
+ *
+ * RenderFrames() hands out whole frames to the threads of a ThreadPool; each thread draws
+ * with its own IconRasterizer and copies the result to the frame's slot in a shared buffer.
+ * Frames do not depend on each other, so rendering scales with the number of processors
+ * as long as there are at least as many frames as threads.
+ */
+#endif
@@ -7,8 +7,13 @@
 #define __PS2_ICON_LOADER_HPP_INCLUDE_GUARD__
 
 #include <fstream>
+#include <string>
+#include <vector>
 #include "../gbLib/include/gbException.hpp"
 #include "obj_loader.hpp"
+#include "content_hash.hpp"
+
+class PS2IconView;
 
 /** A loader for PS2 icon files
  * @note Currently all structs defined in this class are assumed to be unpadded!
@@ -63,17 +68,47 @@ public:
 		float time;									///< ???
 		float value;								///< ???
 	} Frame_Key;
+	/** Loading strategy for icon files
+	 */
+	typedef enum {
+		LOAD_EAGER=0,								///< decode the complete file on construction
+		LOAD_LAZY									///< decode geometry, animation keys and texture on first access, reopening the file by path
+	} LoadMode;
+	/** Texture segment encoding used by WriteFile()
+	 */
+	typedef enum {
+		TEXTURE_KEEP=0,								///< encoding indicated by the current texture_type
+		TEXTURE_RAW,								///< uncompressed texture
+		TEXTURE_RLE,								///< rle encoded texture
+		TEXTURE_AUTO								///< whichever of TEXTURE_RAW and TEXTURE_RLE is smaller
+	} TextureEncoding;
+	/** Content hashes of the segments of an icon, see GetFingerprint()
+	 */
+	typedef struct Fingerprint_t {
+		ContentHash::Hash128 geometry;				///< vertex count, shape count and all vertex records
+		ContentHash::Hash128 animation;				///< animation header, frame data and keys
+		ContentHash::Hash128 texture;				///< texture plane
+		ContentHash::Hash128 icon;					///< all of the above
+	} Fingerprint;
 private:
 	Icon_Header header;								///< icon file header
+	unsigned char* arena;							///< single allocation holding all of the fields below
 	Vertex_Coord* vertices;							///< icon vertex data
 	Vertex_Coord* normals;							///< icon normal data
 	Texture_Data* vert_texture;						///< per-vertex texture data
-	float* fvertices;								///< converted vertex data
+	float* fvertices;								///< converted vertex data; x, y and z plane of each shape, see GetShapePlane()
 	float* fnormals;								///< converted normal data
 	Animation_Header anim_header;					///< animation segment header
 	Frame_Data* animation;							///< animation data
 	Frame_Key** anim_keys;							///< frame key data
-	unsigned int texture[16384];					///< texture image data (128*128 pixels) in ARGB format (8 bits per channel)
+	unsigned int* texture;							///< texture image data (128*128 pixels) in ARGB format (8 bits per channel)
+	std::string source_file;						///< icon file the deferred segments are read from (lazy mode only)
+	std::streamoff anim_data_offset;				///< file offset of the first Frame_Data entry
+	std::streamoff texture_offset;					///< file offset of the texture segment
+	//deferred segments are read into the arena by const getters; only these flags change:
+	mutable bool geometry_loaded;					///< false if the vertex segment has not been decoded yet
+	mutable bool keys_loaded;						///< false if the animation keys have not been read yet
+	mutable bool texture_loaded;					///< false if the texture segment has not been decoded yet
 public:
 	/** Constructor
 	 * @note This just fills the fields with default values. 
@@ -86,6 +121,24 @@ public:
 	 * @throw std::bad_alloc
 	 */
 	PS2Icon(char const * fname);
+	/** Constructor
+	 * @param[in] fname Complete path to a valid icon file
+	 * @param[in] mode LOAD_EAGER decodes the complete file; LOAD_LAZY only reads the header
+	 *                 and frame data and defers all other segments to their first access
+	 * @throw Ghulbus::gbException GB_FAILED indicates a file access error; 
+	 * @throw std::bad_alloc
+	 * @note In lazy mode the file is reopened by its path fname on the first access to each
+	 *       deferred segment, so the file must still exist under that path and must be unchanged
+	 *       for the lifetime of the object. A replaced file is not detected; its contents are
+	 *       decoded as if they were the original ones. Errors while reading a deferred segment
+	 *       are thrown from the getter that caused the access.
+	 */
+	PS2Icon(char const * fname, LoadMode mode);
+	/** Constructor
+	 * @param[in] view A view on a mapped icon file; the icon data is copied and decoded
+	 * @throw std::bad_alloc
+	 */
+	PS2Icon(PS2IconView const& view);
 	/** Destructor
 	 */
 	~PS2Icon();
@@ -104,6 +157,20 @@ public:
 	 * @throw Ghulbus::gbException GB_FAILED uint overflow;
 	 */
 	int GetNFrames() const;
+	/** Get the length of the animation loop
+	 * @return The number of ticks after which the animation repeats (frame_length)
+	 * @throw Ghulbus::gbException GB_FAILED uint overflow;
+	 */
+	int GetFrameLength() const;
+	/** Get the playback speed of the animation
+	 * @return The number of ticks the animation advances per displayed frame (anim_speed)
+	 */
+	float GetAnimationSpeed() const;
+	/** Get the tick at which playback of the animation starts
+	 * @return The play offset in ticks (play_offset)
+	 * @throw Ghulbus::gbException GB_FAILED uint overflow;
+	 */
+	int GetPlayOffset() const;
 	/** Get the number of the shape used in a specific frame
 	 * @param[in] frame Number of the frame [0..(n_frames-1)]
 	 * @return The number of the shape used in frame [0..(animation_shapes-1)]
@@ -143,6 +210,14 @@ public:
 	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER;
 	 */
 	void GetVertexData(float* data, int shape) const;
+	/** Get the vertex coordinates of a shape as a plane of a single component
+	 * @param[in] shape The shape [0..(n_shapes-1)]
+	 * @param[in] component The coordinate component (0: x, 1: y, 2: z)
+	 * @return A field of n_vertices floats that stays valid until the geometry is changed
+	 *         or the icon is destroyed; it is aligned to 64 bytes
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER;
+	 */
+	float const* GetShapePlane(int shape, int component) const;
 	/** Get the per-vertex color data
 	 * @param[out] data A field of at least size (n_vertices)
 	 */
@@ -172,11 +247,30 @@ public:
 	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER;
 	 */
 	unsigned int GetTextureData(int x, int y) const;
+	/** Get the ratio between the size of the rle encoded and the uncompressed texture segment
+	 * @return The size of the rle encoded segment (including its size field) divided by 32768
+	 * @throw std::bad_alloc
+	 */
+	float GetTextureCompressionRatio() const;
 	/** Save the current data to a new icon file
 	 * @param[in] fname The full path of the destination file
 	 * @throw Ghulbus::gbException GB_FAILED file access error;
 	 */
 	void WriteFile(char const * fname) const;
+	/** Save the current data to a new icon file
+	 * @param[in] fname The full path of the destination file
+	 * @param[in] encoding Encoding of the texture segment; the texture_type written to
+	 *                     the file is adjusted to match, the icon itself is not modified
+	 * @throw Ghulbus::gbException GB_FAILED file access error;
+	 * @throw std::bad_alloc
+	 */
+	void WriteFile(char const * fname, TextureEncoding encoding) const;
+	/** Serialize the current data to memory, in the same format as WriteFile()
+	 * @param[out] data Receives the contents of the icon file
+	 * @param[in] encoding Encoding of the texture segment (see WriteFile())
+	 * @throw std::bad_alloc
+	 */
+	void WriteData(std::vector<unsigned char>* data, TextureEncoding encoding) const;
 	/** Set the geometry data of the icon
 	 * @param[in] mesh A valid OBJ_Mesh object holding new geometry data
 	 * @throw std::bad_alloc
@@ -203,19 +297,114 @@ public:
 	 * @param[in,out] mesh A mesh object that will be filled with the icon geometry
 	 */
 	void BuildMesh(OBJ_Mesh* mesh);
+	/** Check the validity of a file header
+	 * @param[in] header An icon file header
+	 * @return True if the header describes a plausible icon
+	 * @note This is the check performed by all loaders before reading any further
+	 */
+	static bool CheckValidity(Icon_Header const& header);
+	/** Compute the content hashes of the icon
+	 * @return Hashes of the geometry, animation and texture segments and of the complete icon
+	 * @note The segments are hashed in a canonical form, so icons that only differ in the
+	 *       encoding of the texture or in the reserved header fields get identical fingerprints.
+	 *       PS2IconView::GetFingerprint() yields the same result without decoding the file.
+	 * @throw Ghulbus::gbException GB_FAILED file access error (lazily loaded icons only);
+	 * @throw std::bad_alloc
+	 */
+	Fingerprint GetFingerprint() const;
 private:
-	/** Internal helper function: resets and allocates memory for geometry
+	/** Internal helper function: replaces the arena with one sized from the current headers
+	 * @param[in] frames A field of (anim_header.n_frames) frame data entries that is copied 
+	 *                   to the new arena; determines the number of keys per frame
+	 * @note The texture is preserved; all other fields are left uninitialized.
+	 * @throw std::bad_alloc
+	 */
+	void AllocateArena(Frame_Data const* frames);
+	/** Internal helper function: sets up the headers and the arena for a new, unanimated geometry
+	 * @param[in] n_vertices Number of vertices of the new geometry
 	 * @throw std::bad_alloc
 	 */
-	void AllocateVertexMemory();
+	void ResetGeometry(unsigned int n_vertices);
+	/** Internal helper function: distance between two coordinate planes in fvertices
+	 * @return The number of floats per plane (n_vertices rounded up to a multiple of 16)
+	 */
+	size_t GetPlaneStride() const;
+	/** Internal helper function: stores x,y,z triples to the coordinate planes of a shape
+	 * @param[in] shape The shape [0..(n_shapes-1)]
+	 * @param[in] data A field of at least size (n_vertices * 3)
+	 */
+	void SetShapePlanes(int shape, float const* data);
+	/** Internal helper function: decodes a complete vertex segment
+	 * @param[in] data The raw vertex segment of (n_vertices) interleaved records as stored in the file
+	 * @note The fields must have been allocated with AllocateArena() before
+	 */
+	void DecodeVertexSegment(unsigned char const* data) const;
+	/** Internal helper function: opens an icon file and reads its contents
+	 * @throw Ghulbus::gbException GB_FAILED indicates either file access error or uint overflow;
+	 * @throw std::bad_alloc
+	 */
+	void OpenFile(char const* fname, LoadMode mode);
 	/** Internal helper function: reads icon data from a (binary) filestream
+	 * @param[in] fin The stream positioned at the start of the file
+	 * @param[in] lazy If true, only the header and frame data are read; the other segments are skipped
 	 * @throw Ghulbus::gbException GB_FAILED indicates either file access error or uint overflow;
 	 * @throw std::bad_alloc
 	 */
-	void ReadFile(std::ifstream & fin);
-	/** Internal helper function: checks the validity of a file header
+	void ReadFile(std::ifstream & fin, bool lazy);
+	/** Internal helper function: reads and decodes the vertex segment at the current stream position
+	 * @throw Ghulbus::gbException GB_FAILED file access error;
+	 * @throw std::bad_alloc
+	 */
+	void ReadVertexSegment(std::ifstream & fin) const;
+	/** Internal helper function: reads the animation keys of all frames at the current stream position
+	 * @throw Ghulbus::gbException GB_FAILED file access error;
+	 * @throw std::bad_alloc
+	 */
+	void ReadAnimationKeys(std::ifstream & fin) const;
+	/** Internal helper function: reads and decodes the texture segment at the current stream position
+	 * @param[in] fin The stream positioned at the start of the texture segment
+	 * @param[in] file_end Size of the file, used for validating the rle data size
+	 * @throw Ghulbus::gbException GB_FAILED file access error or corrupted file;
+	 * @throw std::bad_alloc
+	 */
+	void ReadTextureSegment(std::ifstream & fin, std::streamoff file_end) const;
+	/** Internal helper function: reopens the source file of a lazily loaded icon
+	 * @param[out] fin The stream to open
+	 * @param[in] offset The file offset to seek to
+	 * @param[out] file_end Receives the size of the file
+	 * @throw Ghulbus::gbException GB_FAILED file access error;
+	 */
+	void OpenSourceFile(std::ifstream & fin, std::streamoff offset, std::streamoff* file_end) const;
+	/** Internal helper function: decodes the vertex segment if it was deferred
+	 * @throw Ghulbus::gbException GB_FAILED file access error;
+	 * @throw std::bad_alloc
+	 */
+	void EnsureGeometry() const;
+	/** Internal helper function: reads the animation keys if they were deferred
+	 * @throw Ghulbus::gbException GB_FAILED file access error;
+	 * @throw std::bad_alloc
 	 */
-	static bool CheckValidity(Icon_Header const&);
+	void EnsureAnimationKeys() const;
+	/** Internal helper function: decodes the texture segment if it was deferred
+	 * @throw Ghulbus::gbException GB_FAILED file access error or corrupted file;
+	 * @throw std::bad_alloc
+	 */
+	void EnsureTexture() const;
+	/** Internal helper function: hashes the vertex segment in file layout
+	 */
+	static ContentHash::Hash128 HashGeometry(Icon_Header const& header, unsigned char const* segment);
+	/** Internal helper function: hashes the animation header and the animation segment in file layout
+	 */
+	static ContentHash::Hash128 HashAnimation(Animation_Header const& anim_header, unsigned char const* segment, size_t size);
+	/** Internal helper function: hashes a texture plane as written by WriteFile() (bit 15 clear)
+	 */
+	static ContentHash::Hash128 HashTexture(unsigned short const* plane);
+	/** Internal helper function: sets the icon hash from the segment hashes
+	 */
+	static void CombineFingerprint(Fingerprint* fingerprint);
+	friend class PS2IconView;
+	PS2Icon(PS2Icon const&);						///< private copy constructor (not implemented!)
+	PS2Icon& operator=(PS2Icon const&);				///< private copy assignment (not implemented!)
 };
 typedef PS2Icon *LPPS2ICON;
 
@@ -226,8 +415,19 @@ typedef PS2Icon *LPPS2ICON;
  * @note This class keeps two representations of most of its data. Aside from the
  *       representation also used in the file, there is also a representation 
  *       that fits the standards of modern graphic APIs for visualization.
+ * @note All of this data, including the texture, lives in a single cache line aligned
+ *       arena that is sized from the file headers; an icon object is one heap allocation.
  * @todo SetAnimation
  *
+ * @section ps2icon_lazy Lazy loading
+ * An icon opened with LOAD_LAZY only reads the file header, the animation header and
+ * the frame data on construction; the vertex, key and texture data are skipped with
+ * seeks. Each of these segments is read and decoded on the first call to a getter that
+ * needs it and cached afterwards. Metadata queries like GetNVertices(), GetNFrames() or
+ * GetFrameShape() never touch the deferred segments.
+ * @note Lazily loaded icons must not be accessed from multiple threads concurrently,
+ *       not even through const member functions.
+ *
  * @section ps2icon_file The file format
  * The file is made up of the following segments:
  * @li @ref ps2icon_file_header "A file header"
@@ -0,0 +1,143 @@
+/**
+ * @file include/ps2_rasterizer.hpp
+ *
+ * @brief A software rasterizer for PS2 icon thumbnailsbuild_header/
+ */
+#ifndef __PS2_RASTERIZER_HPP_INCLUDE_GUARD__
+#define __PS2_RASTERIZER_HPP_INCLUDE_GUARD__
+
+#include <utility>
+#include <vector>
+#include "../gbLib/include/gbException.hpp"
+#include "ps2_ps2icon.hpp"
+#include "ps2_iconsys.hpp"
+
+/** Renders icons to an ARGB image, lit the way the icon.sys describes it
+ * @note A rasterizer keeps its image and scratch buffers between calls to Render();
+ *       use one object per thread.
+ */
+class IconRasterizer {
+public:
+	static int const MAX_SIZE  = 4096;				///< maximum width and height of the image
+	static int const TILE_SIZE = 32;				///< edge length of the square screen tiles triangles are binned to
+private:
+	/** Per-triangle setup data
+	 * @note Edge functions and interpolated attributes are stored as planes a*x + b*y + c
+	 *       in pixel coordinates; the edge functions are positive inside the triangle.
+	 */
+	typedef struct Triangle_t {
+		float edge[3][3];							///< a, b, c of the three edge functions
+		bool owner[3];								///< edge owns pixels that lie exactly on it (fill rule)
+		float attrib[6][3];							///< a, b, c of the planes for z, u, v, r, g, b
+		int min_x, min_y, max_x, max_y;				///< bounding box in pixels (inclusive), clipped to the image
+	} Triangle;
+	int m_width;									///< image width in pixels
+	int m_height;									///< image height in pixels
+	int m_stride;									///< row length of the internal buffers in pixels (multiple of 4)
+	int m_tiles_x;									///< number of tile columns
+	int m_tiles_y;									///< number of tile rows
+	float m_center_x;								///< icon x coordinate that maps to the image center
+	float m_center_y;								///< icon y coordinate that maps to the image center
+	float m_scale;									///< pixels per icon unit
+	float m_light_dir[3][3];						///< normalized light directions (pointing towards the light)
+	float m_light_color[3][3];						///< light colors (0..1)
+	float m_ambient[3];								///< ambient light color (0..1)
+	std::vector<unsigned int> m_background;			///< background gradient (m_stride * m_height)
+	std::vector<unsigned int> m_color;				///< color buffer (m_stride * m_height)
+	std::vector<float> m_depth;						///< depth buffer (m_stride * m_height)
+	std::vector<unsigned int> m_texture;			///< texture of the icon currently rendered
+	std::vector<Triangle> m_triangles;				///< setup data of the icon currently rendered
+	std::vector< std::pair<float, int> > m_order;	///< nearest depth and index of each triangle, sorted front to back
+	std::vector< std::vector<int> > m_bins;			///< triangles overlapping each tile
+public:
+	/** Constructor
+	 * @param[in] width Image width in pixels [1..MAX_SIZE]
+	 * @param[in] height Image height in pixels [1..MAX_SIZE]
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER
+	 * @throw std::bad_alloc
+	 * @note Lighting and background are initialized to those of a default IconSys.
+	 */
+	IconRasterizer(int width, int height);
+	/** Destructor
+	 */
+	~IconRasterizer();
+	/** Get the image width
+	 * @return The image width in pixels
+	 */
+	int GetWidth() const;
+	/** Get the image height
+	 * @return The image height in pixels
+	 */
+	int GetHeight() const;
+	/** Take lights and background colors from an icon.sys
+	 * @param[in] icon_sys The icon.sys describing the scene
+	 */
+	void SetLighting(IconSys const& icon_sys);
+	/** Set the orthographic projection
+	 * @param[in] center_x Icon x coordinate that maps to the image center
+	 * @param[in] center_y Icon y coordinate that maps to the image center
+	 * @param[in] scale Pixels per icon unit
+	 */
+	void SetView(float center_x, float center_y, float scale);
+	/** Set the orthographic projection so that a set of vertices fills the image
+	 * @param[in] data A field of at least size (n_vertices * 3) holding x,y,z triples
+	 * @param[in] n_vertices Number of vertices
+	 */
+	void FitView(float const* data, int n_vertices);
+	/** Render the first shape of an icon; the view is fitted to the shape
+	 * @param[in] icon The icon to render; an icon without shapes leaves only the background
+	 * @throw std::bad_alloc
+	 */
+	void Render(PS2Icon const& icon);
+	/** Render an icon with replaced vertex positions, using the current view
+	 * @param[in] icon The icon to render; its normals, colors, texture coordinates and texture are used
+	 * @param[in] data A field of at least size (n_vertices * 3) holding x,y,z triples, e.g.
+	 *                 obtained from PS2Icon::GetVertexData() or IconAnimator::Evaluate()
+	 * @throw std::bad_alloc
+	 */
+	void Render(PS2Icon const& icon, float const* data);
+	/** Get the rendered image
+	 * @param[out] data A field of at least size (width * height) receiving the image in ARGB format
+	 */
+	void GetImage(unsigned int* data) const;
+	/** Write the rendered image to a TGA file
+	 * @param[in] fname The full path of the destination file
+	 * @throw Ghulbus::gbException GB_FAILED file access error;
+	 * @throw std::bad_alloc
+	 */
+	void WriteImage(char const* fname) const;
+private:
+	/** Internal helper function: builds the background gradient from the corner colors
+	 */
+	void BuildBackground(IconSys const& icon_sys);
+	/** Internal helper function: sets up triangles and bins them to tiles
+	 */
+	void SetupTriangles(PS2Icon const& icon, float const* data);
+	/** Internal helper function: draws all triangles binned to a tile
+	 */
+	void RasterizeTile(int tile_x, int tile_y);
+	IconRasterizer(IconRasterizer const&);				///< private copy constructor (not implemented!)
+	IconRasterizer& operator=(IconRasterizer const&);	///< private copy assignment (not implemented!)
+};
+
+//EXTENSIVE DOCUMENTATION:
+/**
+ * @class IconRasterizer
+ * The icon is drawn with an orthographic projection looking down the positive z axis;
+ * icon x maps to image x and icon y to image y (both pointing right resp. down), smaller z
+ * is closer to the viewer. No faces are culled, visibility is resolved by a z-buffer.
+ *
+ * Each vertex is lit as ambient + sum(max(0, dot(normal, light_dir)) * light_color) over the
+ * three lights of the icon.sys and multiplied with the vertex color (RGBA, red in the lowest
+ * byte); the result is interpolated across the triangle and modulates the nearest texel of the
+ * icon texture (v = 0 is the first texture row). The background is the bilinear gradient
+ * between the four corner colors; the image is fully opaque.
+ *
+ * Rendering runs in two passes: triangles are set up, sorted front to back by their nearest
+ * vertex and binned to TILE_SIZE x TILE_SIZE tiles, then each tile is rasterized in turn so
+ * that its color and depth rows stay in the cache. Drawing front to back lets most hidden
+ * pixels fail the depth test before they are textured and lit. Within a tile the edge
+ * functions, depth test and attribute interpolation are evaluated for four pixels at once
+ * with SSE2. Pixels exactly on an edge shared by two triangles are drawn by exactly one of them.
+ */
+#endif
@@ -0,0 +1,93 @@
+/**
+ * @file include/ps2_texture.hpp
+ *
+ * @brief Conversion between the RGB555 texel format of icon files and ARGB8888build_header/
+ */
+#ifndef __PS2_TEXTURE_HPP_INCLUDE_GUARD__
+#define __PS2_TEXTURE_HPP_INCLUDE_GUARD__
+
+#include <cstddef>
+
+/** Codec for the 128x128 texture plane of icon files
+ * @note Texels are stored as ABBBBBGGGGGRRRRR in the file; the ARGB8888 side
+ *       uses the same layout as PS2Icon::GetTextureData() (0xAARRGGBB).
+ * @note Whole planes are converted with SSE2 if the target supports it.
+ */
+namespace PS2Texture {
+	int const WIDTH  = 128;							///< texture width in texels
+	int const HEIGHT = 128;							///< texture height in texels
+	int const N_TEXELS = WIDTH * HEIGHT;			///< number of texels in a texture plane
+	int const RLE_MAX_SIZE = N_TEXELS * 2 + (N_TEXELS / 256) * 2;	///< worst case size of a rle encoded plane in bytes (all literals)
+
+	/** Treatment of bit 15 of a RGB555 texel
+	 */
+	typedef enum {
+		ALPHA_OPAQUE=0,								///< bit 15 is ignored on read and cleared on write; alpha is always 0xff
+		ALPHA_BIT15									///< bit 15 maps to alpha 0xff (set) resp. 0x00 (clear); alpha >= 0x80 sets bit 15
+	} AlphaMode;
+
+	/** Convert a single RGB555 texel to ARGB8888
+	 * @param[in] c The texel as stored in the file
+	 * @param[in] mode Treatment of bit 15
+	 * @return The texel in ARGB format; the lower 3 bits of each color channel are 0
+	 */
+	inline unsigned int ToARGB(unsigned short c, AlphaMode mode) {
+		unsigned int const r = ( c        & 0x1f) << 3;
+		unsigned int const g = ((c >> 5)  & 0x1f) << 3;
+		unsigned int const b = ((c >> 10) & 0x1f) << 3;
+		unsigned int const a = ((mode == ALPHA_OPAQUE) || (c & 0x8000)) ? 0xff : 0x00;
+		return ( (a << 24) | (r << 16) | (g << 8) | b );
+	}
+	/** Convert a single ARGB8888 texel to RGB555
+	 * @param[in] c The texel in ARGB format
+	 * @param[in] mode Treatment of bit 15
+	 * @return The texel as stored in the file; the lower 3 bits of each color channel are dropped
+	 */
+	inline unsigned short ToRGB555(unsigned int c, AlphaMode mode) {
+		unsigned int ret = ((c >> 19) & 0x001f) | ((c >> 6) & 0x03e0) | ((c << 7) & 0x7c00);
+		if(mode == ALPHA_BIT15) { ret |= (c >> 16) & 0x8000; }
+		return static_cast<unsigned short>(ret);
+	}
+
+	/** Convert a field of RGB555 texels to ARGB8888
+	 * @param[in] src A field of at least (n*2) bytes of texels as stored in the file; no alignment required
+	 * @param[out] dst A field of at least size n
+	 * @param[in] n Number of texels
+	 * @param[in] mode Treatment of bit 15
+	 */
+	void Unpack(void const* src, unsigned int* dst, size_t n, AlphaMode mode);
+	/** Convert a field of ARGB8888 texels to RGB555
+	 * @param[in] src A field of at least size n
+	 * @param[out] dst A field of at least (n*2) bytes receiving texels as stored in the file; no alignment required
+	 * @param[in] n Number of texels
+	 * @param[in] mode Treatment of bit 15
+	 */
+	void Pack(unsigned int const* src, void* dst, size_t n, AlphaMode mode);
+	/** Decode a rle encoded texture segment to ARGB8888
+	 * @param[in] src The rle encoded texels (excluding the leading 32 bit size field); no alignment required
+	 * @param[in] size Size of src in bytes
+	 * @param[out] dst A field of at least size N_TEXELS
+	 * @param[in] mode Treatment of bit 15
+	 * @return The number of texels decoded; texels beyond that are set to 0
+	 * @note Decoding stops at the end of src or at the end of the texture plane,
+	 *       whichever comes first; data that would exceed the plane is ignored.
+	 */
+	int DecodeRLE(void const* src, size_t size, unsigned int* dst, AlphaMode mode);
+	/** Rle encode a texture plane
+	 * @param[in] plane A field of N_TEXELS texels as stored in the file
+	 * @param[out] dst A field of at least RLE_MAX_SIZE bytes receiving the rle encoded texels
+	 *                 (excluding the leading 32 bit size field); no alignment required
+	 * @return The size of the encoded data in bytes
+	 * @note The encoding is size-optimal: repeat (4 bytes) and literal (2 + 2*n bytes, n <= 256)
+	 *       segments are chosen by dynamic programming over the complete plane.
+	 */
+	int EncodeRLE(unsigned short const* plane, void* dst);
+	/** Mirror an ARGB8888 image along its horizontal axis in place
+	 * @param[in,out] data A field of at least size (width * height)
+	 * @param[in] width Width of the image in texels
+	 * @param[in] height Height of the image in texels
+	 */
+	void FlipRows(unsigned int* data, int width, int height);
+};
+
+#endif
@@ -0,0 +1,85 @@
+/**
+ * @file include/thread_pool.hpp
+ *
+ * @brief A fixed-size pool of worker threads for data parallel jobsbuild_header/
+ */
+#ifndef __THREAD_POOL_HPP_INCLUDE_GUARD__
+#define __THREAD_POOL_HPP_INCLUDE_GUARD__
+
+#include "../gbLib/include/gbException.hpp"
+
+/** A fixed number of threads that process the items of a job in parallel
+ * @note The calling thread of Run() takes part in the work, so a pool of n threads
+ *       starts (n-1) worker threads.
+ */
+class ThreadPool {
+public:
+	/** Interface for work that is split in independent items
+	 */
+	class Job {
+	public:
+		virtual ~Job() {}
+		/** Process a single item
+		 * @param[in] item Index of the item [0..(n_items-1)]
+		 * @param[in] thread Index of the executing thread [0..(GetNThreads()-1)]; no two items
+		 *                   are processed by the same thread at once, so per-thread scratch data
+		 *                   may be indexed by it
+		 */
+		virtual void Run(int item, int thread) = 0;
+	};
+private:
+	struct Shared;									///< platform specific synchronization state
+	int m_n_threads;								///< number of threads including the caller of Run()
+	Shared* m_shared;								///< state shared with the worker threads
+public:
+	/** Constructor
+	 * @param[in] n_threads Number of threads, including the calling thread;
+	 *                      0 uses GetHardwareConcurrency()
+	 * @throw Ghulbus::gbException GB_ILLEGALPARAMETER;
+	 *                             GB_FAILED a thread or its wakeup event could not be created;
+	 * @throw std::bad_alloc
+	 */
+	ThreadPool(int n_threads);
+	/** Destructor
+	 * @note Waits for all worker threads to exit
+	 */
+	~ThreadPool();
+	/** Get the number of threads
+	 * @return The number of threads including the calling thread
+	 */
+	int GetNThreads() const;
+	/** Process all items of a job and wait for completion
+	 * @param[in] job The job to process
+	 * @param[in] n_items Number of items; items are handed out to threads one at a time
+	 * @throw Ghulbus::gbException The first exception thrown by job.Run(); the remaining items are
+	 *                             skipped in this case. std::bad_alloc is reported as GB_OUTOFMEMORY,
+	 *                             other exceptions as GB_FAILED.
+	 * @note Run() must not be called from more than one thread at a time or from inside a job.
+	 */
+	void Run(Job& job, int n_items);
+	/** Get the number of hardware threads of the system
+	 * @return The number of logical processors (at least 1)
+	 */
+	static int GetHardwareConcurrency();
+private:
+	/** Internal helper function: takes items of the current job until none are left
+	 */
+	void ProcessItems(int thread);
+	/** Internal helper function: main loop of the worker threads
+	 */
+	void WorkerLoop(int thread);
+	/** Internal helper function: signals shutdown and joins all started worker threads
+	 */
+	void StopWorkers();
+	/** Internal helper function: entry point of the worker threads
+	 */
+#ifdef _WIN32
+	static unsigned long __stdcall WorkerEntry(void* param);
+#else
+	static void* WorkerEntry(void* param);
+#endif
+	ThreadPool(ThreadPool const&);					///< private copy constructor (not implemented!)
+	ThreadPool& operator=(ThreadPool const&);		///< private copy assignment (not implemented!)
+};
+
+#endif
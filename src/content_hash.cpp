@@ -0,0 +1,94 @@
+/**
+ * @file src/content_hash.cpp
+ *
+ * @brief Implementation of the 128 bit content hashesbuild_header/
+ */
+#include "../include/content_hash.hpp"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace ContentHash {
+	unsigned long long const C1 = 0x87c37b91114253d5ULL;
+	unsigned long long const C2 = 0x4cf5ad432745937fULL;
+
+	inline unsigned long long rotl64(unsigned long long x, int r) {
+		return (x << r) | (x >> (64 - r));
+	}
+
+	inline unsigned long long fmix64(unsigned long long k) {
+		k ^= k >> 33;
+		k *= 0xff51afd7ed558ccdULL;
+		k ^= k >> 33;
+		k *= 0xc4ceb9fe1a85ec53ULL;
+		k ^= k >> 33;
+		return k;
+	}
+
+	Hash128 Compute(void const* data, size_t size, unsigned int seed) {
+		unsigned char const* p = static_cast<unsigned char const*>(data);
+		size_t const n_blocks = size / 16;
+		unsigned long long h1 = seed;
+		unsigned long long h2 = seed;
+
+		//body:
+		for(size_t i=0; i<n_blocks; i++) {
+			unsigned long long k1, k2;
+			memcpy(&k1, p + i*16, 8);
+			memcpy(&k2, p + i*16 + 8, 8);
+			k1 *= C1;  k1 = rotl64(k1, 31);  k1 *= C2;  h1 ^= k1;
+			h1 = rotl64(h1, 27);  h1 += h2;  h1 = h1*5 + 0x52dce729;
+			k2 *= C2;  k2 = rotl64(k2, 33);  k2 *= C1;  h2 ^= k2;
+			h2 = rotl64(h2, 31);  h2 += h1;  h2 = h2*5 + 0x38495ab5;
+		}
+
+		//tail:
+		unsigned char const* tail = p + n_blocks*16;
+		size_t const n_tail = size & 15;
+		unsigned long long k1 = 0;
+		unsigned long long k2 = 0;
+		for(size_t i=n_tail; i>8; i--) {
+			k2 ^= static_cast<unsigned long long>(tail[i-1]) << ((i-9) * 8);
+		}
+		if(n_tail > 8) {
+			k2 *= C2;  k2 = rotl64(k2, 33);  k2 *= C1;  h2 ^= k2;
+		}
+		for(size_t i=(n_tail > 8 ? 8 : n_tail); i>0; i--) {
+			k1 ^= static_cast<unsigned long long>(tail[i-1]) << ((i-1) * 8);
+		}
+		if(n_tail > 0) {
+			k1 *= C1;  k1 = rotl64(k1, 31);  k1 *= C2;  h1 ^= k1;
+		}
+
+		//finalization:
+		h1 ^= static_cast<unsigned long long>(size);
+		h2 ^= static_cast<unsigned long long>(size);
+		h1 += h2;
+		h2 += h1;
+		h1 = fmix64(h1);
+		h2 = fmix64(h2);
+		h1 += h2;
+		h2 += h1;
+
+		Hash128 ret;
+		ret.low  = h1;
+		ret.high = h2;
+		return ret;
+	}
+
+	Hash128 Combine(Hash128 const* hashes, size_t n, unsigned int seed) {
+		std::vector<unsigned char> buffer(n * 16 + 1);
+		for(size_t i=0; i<n; i++) {
+			memcpy(&buffer[i*16], &hashes[i].low, 8);
+			memcpy(&buffer[i*16 + 8], &hashes[i].high, 8);
+		}
+		return Compute(&buffer[0], n * 16, seed);
+	}
+
+	std::string ToString(Hash128 const& h) {
+		char buffer[33];
+		sprintf(buffer, "%08x%08x%08x%08x", static_cast<unsigned int>(h.high >> 32), static_cast<unsigned int>(h.high),
+		        static_cast<unsigned int>(h.low >> 32), static_cast<unsigned int>(h.low));
+		return std::string(buffer, 32);
+	}
+}
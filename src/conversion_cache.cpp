@@ -0,0 +1,323 @@
+/**
+ * @file src/conversion_cache.cpp
+ *
+ * @brief Implementation of the ConversionCache classbuild_header/
+ */
+#include "../include/conversion_cache.hpp"
+#include "../include/mapped_file.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#ifdef _WIN32
+#	include <windows.h>
+#else
+#	include <sys/types.h>
+#	include <sys/stat.h>
+#	include <dirent.h>
+#	include <unistd.h>
+#	include <utime.h>
+#endif
+
+/** A file of the cache directory, as found by Evict()
+ */
+typedef struct CacheFile_t {
+	std::string name;							///< file name
+	unsigned long long size;					///< file size in bytes
+	unsigned long long time;					///< modification time (platform units)
+} CacheFile;
+
+/** All files of a cache entry, as found by Evict()
+ */
+typedef struct CacheEntry_t {
+	std::string key;							///< key of the entry in hex
+	std::vector<std::string> names;				///< file names of the outputs
+	unsigned long long size;					///< total size of the outputs in bytes
+	unsigned long long time;					///< latest modification time of the outputs
+} CacheEntry;
+
+/** Helper function: orders cache files by name
+ */
+static bool cache_file_less(CacheFile const& a, CacheFile const& b) {
+	return a.name < b.name;
+}
+
+/** Helper function: orders cache entries by time of last use
+ */
+static bool cache_entry_less(CacheEntry const& a, CacheEntry const& b) {
+	return (a.time < b.time) || ((a.time == b.time) && (a.key < b.key));
+}
+
+/** Helper function: checks whether a file name is that of an output stored in the cache
+ * @return The length of the key prefix; 0 for all other files (e.g. temporary files)
+ */
+static size_t entry_key_length(char const* name) {
+	size_t const key_length = 32;
+	size_t const len = strlen(name);
+	if((len < key_length + 2) || (name[key_length] != '.')) { return 0; }
+	for(size_t i=0; i<key_length; i++) {
+		if(!(((name[i] >= '0') && (name[i] <= '9')) || ((name[i] >= 'a') && (name[i] <= 'f')))) { return 0; }
+	}
+	for(size_t i=key_length+1; i<len; i++) {
+		if((name[i] < '0') || (name[i] > '9')) { return 0; }
+	}
+	return key_length;
+}
+
+/** Helper function: copies a file, replacing the destination
+ * @throw Ghulbus::gbException GB_FAILED
+ */
+static void copy_file(char const* src, char const* dst) {
+	MappedFile source(src);
+	std::ofstream fout(dst, std::ios_base::out | std::ios_base::binary);
+	if(fout.fail()) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not open file for writing" ) );
+	}
+	fout.write(reinterpret_cast<char const*>(source.GetData()), source.GetSize());
+	fout.close();
+	if(fout.fail()) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not write file" ) );
+	}
+}
+
+#ifdef _WIN32
+static bool file_exists(char const* path) {
+	DWORD const attributes = GetFileAttributesA(path);
+	return (attributes != INVALID_FILE_ATTRIBUTES) && ((attributes & FILE_ATTRIBUTE_DIRECTORY) == 0);
+}
+
+static bool make_directory(char const* path) {
+	if(CreateDirectoryA(path, NULL)) { return true; }
+	DWORD const attributes = GetFileAttributesA(path);
+	return (attributes != INVALID_FILE_ATTRIBUTES) && ((attributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
+}
+
+static bool make_hard_link(char const* existing, char const* path) {
+	return CreateHardLinkA(path, existing, NULL) != 0;
+}
+
+static bool replace_file(char const* src, char const* dst) {
+	return MoveFileExA(src, dst, MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+static void touch_file(char const* path) {
+	HANDLE file = CreateFileA(path, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+	                          NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE) { return; }
+	FILETIME now;
+	GetSystemTimeAsFileTime(&now);
+	SetFileTime(file, NULL, NULL, &now);
+	CloseHandle(file);
+}
+
+static std::string temporary_suffix() {
+	char buffer[32];
+	sprintf(buffer, ".tmp%lu", static_cast<unsigned long>(GetCurrentProcessId()));
+	return buffer;
+}
+
+static void list_cache_files(std::string const& dir, std::vector<CacheFile>* files) {
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA((dir + "\\*").c_str(), &data);
+	if(find == INVALID_HANDLE_VALUE) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not list directory" ) );
+	}
+	try {
+		do {
+			if((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || (entry_key_length(data.cFileName) == 0)) { continue; }
+			CacheFile file;
+			file.name = data.cFileName;
+			file.size = (static_cast<unsigned long long>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+			file.time = (static_cast<unsigned long long>(data.ftLastWriteTime.dwHighDateTime) << 32) |
+			            data.ftLastWriteTime.dwLowDateTime;
+			files->push_back(file);
+		} while(FindNextFileA(find, &data));
+	} catch(...) {
+		FindClose(find);
+		throw;
+	}
+	FindClose(find);
+}
+#else
+static bool file_exists(char const* path) {
+	struct stat st;
+	return (stat(path, &st) == 0) && S_ISREG(st.st_mode);
+}
+
+static bool make_directory(char const* path) {
+	if(mkdir(path, 0777) == 0) { return true; }
+	struct stat st;
+	return (stat(path, &st) == 0) && S_ISDIR(st.st_mode);
+}
+
+static bool make_hard_link(char const* existing, char const* path) {
+	return link(existing, path) == 0;
+}
+
+static bool replace_file(char const* src, char const* dst) {
+	return rename(src, dst) == 0;
+}
+
+static void touch_file(char const* path) {
+	utime(path, NULL);
+}
+
+static std::string temporary_suffix() {
+	char buffer[32];
+	sprintf(buffer, ".tmp%lu", static_cast<unsigned long>(getpid()));
+	return buffer;
+}
+
+static void list_cache_files(std::string const& dir, std::vector<CacheFile>* files) {
+	DIR* d = opendir(dir.c_str());
+	if(!d) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not list directory" ) );
+	}
+	try {
+		struct dirent* entry;
+		while((entry = readdir(d)) != NULL) {
+			if(entry_key_length(entry->d_name) == 0) { continue; }
+			struct stat st;
+			if((stat((dir + '/' + entry->d_name).c_str(), &st) != 0) || !S_ISREG(st.st_mode)) { continue; }
+			CacheFile file;
+			file.name = entry->d_name;
+			file.size = static_cast<unsigned long long>(st.st_size);
+			file.time = static_cast<unsigned long long>(st.st_mtime);
+			files->push_back(file);
+		}
+	} catch(...) {
+		closedir(d);
+		throw;
+	}
+	closedir(d);
+}
+#endif
+
+ConversionCache::Key::Key(char const* conversion)
+{
+	AddString(conversion);
+}
+
+void ConversionCache::Key::AddBytes(void const* data, size_t size) {
+	m_parts.push_back( ContentHash::Compute(data, size, 8) );
+}
+
+void ConversionCache::Key::AddFile(char const* fname) {
+	MappedFile file(fname);
+	AddBytes(file.GetData(), file.GetSize());
+}
+
+void ConversionCache::Key::AddString(char const* str) {
+	AddBytes(str, strlen(str));
+}
+
+void ConversionCache::Key::AddInt(int value) {
+	AddBytes(&value, sizeof(value));
+}
+
+void ConversionCache::Key::AddFloat(float value) {
+	AddBytes(&value, sizeof(value));
+}
+
+ContentHash::Hash128 ConversionCache::Key::GetHash() const {
+	return ContentHash::Combine(&m_parts[0], m_parts.size(), 9);
+}
+
+ConversionCache::ConversionCache(char const* directory, unsigned long long max_size)
+	:m_directory(directory), m_max_size(max_size), m_hard_links(false)
+{
+	if(!make_directory(directory)) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not create cache directory" ) );
+	}
+}
+
+void ConversionCache::SetHardLinks(bool hard_links) {
+	m_hard_links = hard_links;
+}
+
+char const* ConversionCache::GetDirectory() const {
+	return m_directory.c_str();
+}
+
+unsigned long long ConversionCache::GetMaxSize() const {
+	return m_max_size;
+}
+
+std::string ConversionCache::GetEntryPath(ContentHash::Hash128 const& key, int index) const {
+	char buffer[16];
+	sprintf(buffer, ".%d", index);
+	return m_directory + '/' + ContentHash::ToString(key) + buffer;
+}
+
+bool ConversionCache::Retrieve(Key const& key, char const* const* outputs, int n_outputs) {
+	ContentHash::Hash128 const hash = key.GetHash();
+	std::vector<std::string> entries(n_outputs);
+	for(int i=0; i<n_outputs; i++) {
+		entries[i] = GetEntryPath(hash, i);
+		if(!file_exists(entries[i].c_str())) { return false; }
+	}
+	for(int i=0; i<n_outputs; i++) {
+		//an existing output may itself be a link to a cached file, so it is never written through:
+		remove(outputs[i]);
+		if(!(m_hard_links && make_hard_link(entries[i].c_str(), outputs[i]))) {
+			copy_file(entries[i].c_str(), outputs[i]);
+		}
+		touch_file(entries[i].c_str());
+	}
+	return true;
+}
+
+void ConversionCache::Store(Key const& key, char const* const* outputs, int n_outputs) {
+	ContentHash::Hash128 const hash = key.GetHash();
+	std::string const suffix = temporary_suffix();
+	for(int i=0; i<n_outputs; i++) {
+		std::string const entry = GetEntryPath(hash, i);
+		std::string const tmp = entry + suffix;
+		try {
+			copy_file(outputs[i], tmp.c_str());
+		} catch( Ghulbus::gbException& ) {
+			remove(tmp.c_str());
+			throw;
+		}
+		if(!replace_file(tmp.c_str(), entry.c_str())) {
+			remove(tmp.c_str());
+			throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not write cache entry" ) );
+		}
+	}
+	Evict();
+}
+
+unsigned long long ConversionCache::Evict() {
+	std::vector<CacheFile> files;
+	list_cache_files(m_directory, &files);
+	std::sort(files.begin(), files.end(), cache_file_less);
+
+	//the outputs of an entry are adjacent after sorting by name:
+	std::vector<CacheEntry> entries;
+	unsigned long long total_size = 0;
+	for(size_t i=0; i<files.size(); i++) {
+		std::string const key = files[i].name.substr(0, entry_key_length(files[i].name.c_str()));
+		if(entries.empty() || (entries.back().key != key)) {
+			CacheEntry entry;
+			entry.key  = key;
+			entry.size = 0;
+			entry.time = 0;
+			entries.push_back(entry);
+		}
+		CacheEntry& entry = entries.back();
+		entry.names.push_back(files[i].name);
+		entry.size += files[i].size;
+		entry.time = std::max(entry.time, files[i].time);
+		total_size += files[i].size;
+	}
+	if(total_size <= m_max_size) { return total_size; }
+
+	std::sort(entries.begin(), entries.end(), cache_entry_less);
+	for(size_t i=0; (i<entries.size()) && (total_size > m_max_size); i++) {
+		for(size_t j=0; j<entries[i].names.size(); j++) {
+			remove((m_directory + '/' + entries[i].names[j]).c_str());
+		}
+		total_size -= entries[i].size;
+	}
+	return total_size;
+}
@@ -0,0 +1,130 @@
+/**
+ * @file src/directory_walker.cpp
+ *
+ * @brief Implementation of the DirectoryWalker classbuild_header/
+ */
+#include "../include/directory_walker.hpp"
+#include <algorithm>
+#include <cstring>
+#ifdef _WIN32
+#	include <windows.h>
+#else
+#	include <sys/types.h>
+#	include <sys/stat.h>
+#	include <dirent.h>
+#endif
+
+/** Helper function: appends a name to a directory path
+ */
+static std::string join_path(std::string const& dir, char const* name) {
+	if(dir.empty()) { return name; }
+	char const last = dir[dir.size() - 1];
+	if((last == '/') || (last == '\\')) { return dir + name; }
+	return dir + '/' + name;
+}
+
+DirectoryWalker::DirectoryWalker(char const* root)
+{
+	if(IsDirectory(root)) {
+		m_pending_dirs.push_back(root);
+	} else {
+#ifdef _WIN32
+		DWORD const attributes = GetFileAttributesA(root);
+		bool const exists = (attributes != INVALID_FILE_ATTRIBUTES);
+#else
+		struct stat st;
+		bool const exists = (stat(root, &st) == 0);
+#endif
+		if(!exists) {
+			throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Path does not exist" ) );
+		}
+		m_files.push_back(root);
+	}
+}
+
+bool DirectoryWalker::Next(std::string* path) {
+	while(m_files.empty()) {
+		if(m_pending_dirs.empty()) { return false; }
+		std::string const dir = m_pending_dirs.back();
+		m_pending_dirs.pop_back();
+		ListDirectory(dir);
+	}
+	path->swap(m_files.back());
+	m_files.pop_back();
+	return true;
+}
+
+#ifdef _WIN32
+bool DirectoryWalker::IsDirectory(char const* path) {
+	DWORD const attributes = GetFileAttributesA(path);
+	return (attributes != INVALID_FILE_ATTRIBUTES) && ((attributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
+}
+
+void DirectoryWalker::ListDirectory(std::string const& dir) {
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA(join_path(dir, "*").c_str(), &data);
+	if(find == INVALID_HANDLE_VALUE) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not list directory" ) );
+	}
+	std::vector<std::string> files;
+	std::vector<std::string> dirs;
+	try {
+		do {
+			if((strcmp(data.cFileName, ".") == 0) || (strcmp(data.cFileName, "..") == 0)) { continue; }
+			if(data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) {
+				//links to directories are not followed:
+				if(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) { continue; }
+			}
+			if(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+				dirs.push_back(join_path(dir, data.cFileName));
+			} else {
+				files.push_back(join_path(dir, data.cFileName));
+			}
+		} while(FindNextFileA(find, &data));
+	} catch(...) {
+		FindClose(find);
+		throw;
+	}
+	FindClose(find);
+#else
+bool DirectoryWalker::IsDirectory(char const* path) {
+	struct stat st;
+	return (stat(path, &st) == 0) && S_ISDIR(st.st_mode);
+}
+
+void DirectoryWalker::ListDirectory(std::string const& dir) {
+	DIR* d = opendir(dir.c_str());
+	if(!d) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not list directory" ) );
+	}
+	std::vector<std::string> files;
+	std::vector<std::string> dirs;
+	try {
+		struct dirent* entry;
+		while((entry = readdir(d)) != NULL) {
+			if((strcmp(entry->d_name, ".") == 0) || (strcmp(entry->d_name, "..") == 0)) { continue; }
+			std::string const path = join_path(dir, entry->d_name);
+			struct stat st;
+			if(lstat(path.c_str(), &st) != 0) { continue; }
+			if(S_ISLNK(st.st_mode)) {
+				//links to files are returned, links to directories are not followed:
+				if((stat(path.c_str(), &st) != 0) || !S_ISREG(st.st_mode)) { continue; }
+			}
+			if(S_ISDIR(st.st_mode)) {
+				dirs.push_back(path);
+			} else if(S_ISREG(st.st_mode)) {
+				files.push_back(path);
+			}
+		}
+	} catch(...) {
+		closedir(d);
+		throw;
+	}
+	closedir(d);
+#endif
+	//both vectors are consumed from the back:
+	std::sort(files.begin(), files.end());
+	std::sort(dirs.begin(), dirs.end());
+	m_files.assign(files.rbegin(), files.rend());
+	m_pending_dirs.insert(m_pending_dirs.end(), dirs.rbegin(), dirs.rend());
+}
@@ -0,0 +1,97 @@
+/**
+ * @file src/mapped_file.cpp
+ *
+ * @brief Implementation of the MappedFile classbuild_header/
+ */
+#include "../include/mapped_file.hpp"
+#ifdef _WIN32
+#	include <windows.h>
+#else
+#	include <sys/types.h>
+#	include <sys/stat.h>
+#	include <sys/mman.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(char const* fname): m_data(NULL), m_size(0), m_file(NULL), m_mapping(NULL)
+{
+	HANDLE file = CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                          FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(file == INVALID_HANDLE_VALUE) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not open file for mapping" ) );
+	}
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(file, &size)) {
+		CloseHandle(file);
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not determine file size" ) );
+	}
+	m_file = file;
+	m_size = static_cast<size_t>(size.QuadPart);
+	if(m_size == 0) {
+		//empty files can not be mapped; GetData() returns NULL in this case
+		return;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(mapping == NULL) {
+		CloseHandle(file);
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not map file" ) );
+	}
+	m_mapping = mapping;
+	m_data = static_cast<unsigned char const*>( MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) );
+	if(m_data == NULL) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not map file" ) );
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if(m_data)    { UnmapViewOfFile(m_data);                    m_data = NULL; }
+	if(m_mapping) { CloseHandle(static_cast<HANDLE>(m_mapping)); m_mapping = NULL; }
+	if(m_file)    { CloseHandle(static_cast<HANDLE>(m_file));    m_file = NULL; }
+}
+#else
+MappedFile::MappedFile(char const* fname): m_data(NULL), m_size(0)
+{
+	int fd = open(fname, O_RDONLY);
+	if(fd < 0) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not open file for mapping" ) );
+	}
+	struct stat st;
+	if(fstat(fd, &st) != 0) {
+		close(fd);
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not determine file size" ) );
+	}
+	m_size = static_cast<size_t>(st.st_size);
+	if(m_size == 0) {
+		//empty files can not be mapped; GetData() returns NULL in this case
+		close(fd);
+		return;
+	}
+	void* p = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	//the mapping stays valid after the descriptor is closed:
+	close(fd);
+	if(p == MAP_FAILED) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not map file" ) );
+	}
+	m_data = static_cast<unsigned char const*>(p);
+}
+
+MappedFile::~MappedFile()
+{
+	if(m_data) { munmap(const_cast<unsigned char*>(m_data), m_size);  m_data = NULL; }
+}
+#endif
+
+unsigned char const* MappedFile::GetData() const {
+	return m_data;
+}
+size_t MappedFile::GetSize() const {
+	return m_size;
+}
+MemorySpan<unsigned char> MappedFile::GetSpan() const {
+	return MemorySpan<unsigned char>(m_data, m_size);
+}
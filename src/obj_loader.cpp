@@ -4,9 +4,26 @@
  * @brief Implementation of OBJ_FileLoader and OBJ_Meshbuild_header/
  */
 #include "../include/obj_loader.hpp"
+#include "../include/mapped_file.hpp"
+#include "../include/thread_pool.hpp"
+#include <algorithm>
+#include <climits>
+#include <cmath>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <string>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/** Size of the buffer OBJ_FileLoader::WriteFile() formats the text into
+ */
+static size_t const WRITER_BUFFER_SIZE = 1 << 18;
+/** Maximum number of characters of a line formatted directly into the buffer of OBJ_FileLoader::WriteFile();
+ *  enough for three numbers of up to 320 characters each
+ */
+static size_t const WRITER_RESERVE = 1024;
 
 OBJ_FileLoader::OBJ_FileLoader()
 {
@@ -15,10 +32,14 @@ OBJ_FileLoader::OBJ_FileLoader()
 
 OBJ_FileLoader::OBJ_FileLoader(const char* fname)
 {
-	std::ifstream fin(fname, std::ios_base::in);
-	if(fin.fail()) { throw( Ghulbus::gbException(Ghulbus::gbException::GB_FAILED,
-	                                             "Could not open obj file for read") ); }
-	ReadFile(fin);
+	MappedFile file(fname);
+	ReadFile(reinterpret_cast<char const*>(file.GetData()), file.GetSize(), 1);
+}
+
+OBJ_FileLoader::OBJ_FileLoader(const char* fname, int n_threads)
+{
+	MappedFile file(fname);
+	ReadFile(reinterpret_cast<char const*>(file.GetData()), file.GetSize(), n_threads);
 }
 OBJ_FileLoader::~OBJ_FileLoader()
 {
@@ -40,6 +61,144 @@ void OBJ_FileLoader::AddMesh(OBJ_Mesh const& mesh) {
 	m_MeshList.push_back(newmesh);
 }
 
+/** Helper function: formats an integer in decimal
+ * @param[out] p Receives the digits; room for 11 characters is needed
+ * @return Pointer past the last character written
+ */
+static char* format_int(char* p, int value) {
+	unsigned int u = static_cast<unsigned int>(value);
+	if(value < 0) {
+		*p++ = '-';
+		u = 0u - u;
+	}
+	char digits[10];
+	int n = 0;
+	do {
+		digits[n++] = static_cast<char>('0' + u % 10);
+		u /= 10;
+	} while(u != 0);
+	while(n > 0) { *p++ = digits[--n]; }
+	return p;
+}
+
+/** Helper function: formats a floating point number with six decimals, exactly as
+ *                   printf("%.6f") and std::ostream with std::fixed and precision 6 do
+ * @param[out] p Receives the number; room for 320 characters is needed
+ * @return Pointer past the last character written
+ * @note Numbers below 1e9 are converted exactly by integer arithmetic; all others, as well as
+ *       numbers exactly halfway between two results, whose rounding is up to the C library,
+ *       are handed to sprintf().
+ */
+static char* format_fixed(char* p, double value) {
+	unsigned long long bits;
+	memcpy(&bits, &value, sizeof(bits));
+	bool const negative = (bits >> 63) != 0;
+	int const exponent = static_cast<int>((bits >> 52) & 0x7ff);
+	unsigned long long const mantissa = (exponent == 0) ? (bits & 0xfffffffffffffULL) : ((bits & 0xfffffffffffffULL) | (1ULL << 52));
+	if(!(fabs(value) < 1e9)) {
+		return p + sprintf(p, "%.6f", value);
+	}
+	//value = mantissa * 2^-shift; the result is value * 10^6 rounded to an integer:
+	int const shift = 1075 - ((exponent == 0) ? 1 : exponent);
+	unsigned long long result = 0;
+	if(shift < 76) {
+		//mantissa * 10^6 has at most 73 bits, held in (high, low):
+		unsigned long long const a = (mantissa & 0xffffffffULL) * 1000000ULL;
+		unsigned long long const b = (mantissa >> 32) * 1000000ULL;
+		unsigned long long const low = (b << 32) + a;
+		unsigned long long const high = (b >> 32) + ((low < a) ? 1 : 0);
+		unsigned long long rest_high, rest_low, half_high, half_low;
+		if(shift < 64) {
+			result = (low >> shift) | ((shift > 0) ? (high << (64 - shift)) : 0);
+			rest_high = 0;
+			rest_low = low & ((1ULL << shift) - 1);
+			half_high = 0;
+			half_low = 1ULL << (shift - 1);
+		} else {
+			result = high >> (shift - 64);
+			rest_high = high & ((1ULL << (shift - 64)) - 1);
+			rest_low = low;
+			half_high = (shift > 64) ? (1ULL << (shift - 65)) : 0;
+			half_low = (shift > 64) ? 0 : (1ULL << 63);
+		}
+		if((rest_high == half_high) && (rest_low == half_low)) {
+			return p + sprintf(p, "%.6f", value);
+		}
+		if((rest_high > half_high) || ((rest_high == half_high) && (rest_low > half_low))) {
+			++result;
+		}
+	}
+	if(negative) { *p++ = '-'; }
+	p = format_int(p, static_cast<int>(result / 1000000));
+	*p++ = '.';
+	unsigned int fraction = static_cast<unsigned int>(result % 1000000);
+	for(int i=5; i>=0; i--) {
+		p[i] = static_cast<char>('0' + fraction % 10);
+		fraction /= 10;
+	}
+	return p + 6;
+}
+
+/** Collects the text of an obj file in a buffer and writes it in large blocks
+ */
+class OBJ_TextWriter {
+private:
+	std::ofstream& m_out;							///< the output file
+	std::vector<char> m_buffer;						///< text not yet written
+	size_t m_used;									///< number of characters in m_buffer
+public:
+	OBJ_TextWriter(std::ofstream& out)
+		:m_out(out), m_buffer(WRITER_BUFFER_SIZE), m_used(0)
+	{
+	}
+	/** Get room for up to WRITER_RESERVE characters
+	 * @return Pointer to the room; pass the end of the written characters to Commit()
+	 */
+	char* Reserve() {
+		if(m_used + WRITER_RESERVE > m_buffer.size()) { Flush(); }
+		return &m_buffer[m_used];
+	}
+	void Commit(char* end) {
+		m_used = end - &m_buffer[0];
+	}
+	void Put(char const* str) {
+		size_t const len = strlen(str);
+		if(len > WRITER_RESERVE) {
+			Flush();
+			m_out.write(str, static_cast<std::streamsize>(len));
+		} else {
+			char* p = Reserve();
+			memcpy(p, str, len);
+			Commit(p + len);
+		}
+	}
+	void PutInt(int value) {
+		Commit(format_int(Reserve(), value));
+	}
+	void Flush() {
+		m_out.write(&m_buffer[0], static_cast<std::streamsize>(m_used));
+		m_used = 0;
+	}
+private:
+	OBJ_TextWriter& operator=(OBJ_TextWriter const&);		///< private copy assignment (not implemented!)
+};
+
+/** Helper function: writes a line of three coordinates
+ * @param[in] prefix Start of the line, e.g. "v  "
+ * @param[in] coords The coordinates
+ */
+inline void write_coordinates(OBJ_TextWriter* writer, char const* prefix, double const* coords) {
+	char* p = writer->Reserve();
+	while(*prefix) { *p++ = *prefix++; }
+	p = format_fixed(p, coords[0]);
+	*p++ = ' ';
+	p = format_fixed(p, coords[1]);
+	*p++ = ' ';
+	p = format_fixed(p, coords[2]);
+	*p++ = '\n';
+	writer->Commit(p);
+}
+
 void OBJ_FileLoader::WriteFile(char const* fname) const {
 	std::ofstream fout(fname, std::ios_base::out);
 	if( fout.fail() ) {
@@ -47,185 +206,1459 @@ void OBJ_FileLoader::WriteFile(char const* fname) const {
 			                         "Output OBJ file could not be opened" ) );
 	}
 	//again we need counters since obj doesn't reset indices between meshes:
-	int vert_counter=0, normal_counter=0, texture_counter=0;
 	int vert_base=0, normal_base=0, texture_base=0;
 	int current_smooth_group = 0;
-	
-	fout.precision(6);
-	fout << std::fixed;
+
+	//the text is formatted into a buffer that is written in large blocks:
+	OBJ_TextWriter writer(fout);
 	//file header:
-	fout << "# OBJ File created by PS2IconSys Viewer" << std::endl
-		 << "#  http://www.ghulbus-inc.de/" << std::endl
-		 << "#" << std::endl;
+	writer.Put("# OBJ File created by PS2IconSys Viewer\n"
+	           "#  http://www.ghulbus-inc.de/\n"
+	           "#\n");
 
 	for(int i=0; i<GetNMeshes(); i++) {
 		OBJ_Mesh const* mesh = GetMesh(i);
 		//object header:
-		fout << "# object " << mesh->GetName() << " to come" << std::endl
-			 << "#" << std::endl;
+		writer.Put("# object ");
+		writer.Put(mesh->GetName());
+		writer.Put(" to come\n#\n");
 		
 		//vertex data:
-		for(int j=0; j<mesh->GetNVertices(); j++) {
-			vert_counter++;
-			fout << "v  " << *(mesh->GetVertexX(j)) << " " << *(mesh->GetVertexY(j)) << " "
-				<< *(mesh->GetVertexZ(j)) << std::endl;
+		for(size_t j=0; j+2<mesh->m_geometry.size(); j+=3) {
+			write_coordinates(&writer, "v  ", &mesh->m_geometry[j]);
 		}
-		fout << "# " << mesh->GetNVertices() << " vertices" << std::endl << std::endl;
+		writer.Put("# ");
+		writer.PutInt(mesh->GetNVertices());
+		writer.Put(" vertices\n\n");
 		//texture vertex data:
-		for(int j=0; j<mesh->GetNTexture(); j++) {
-			texture_counter++;
-			fout << "vt  " << *(mesh->GetTextureX(j)) << " " << *(mesh->GetTextureY(j)) << " "
-				<< *(mesh->GetTextureZ(j)) << std::endl;
+		for(size_t j=0; j+2<mesh->m_texcoords.size(); j+=3) {
+			write_coordinates(&writer, "vt  ", &mesh->m_texcoords[j]);
 		}
-		fout << "# " << mesh->GetNTexture() << " texture vertices" << std::endl << std::endl;
+		writer.Put("# ");
+		writer.PutInt(mesh->GetNTexture());
+		writer.Put(" texture vertices\n\n");
 		//vertex normal data:
-		for(int j=0; j<mesh->GetNNormals(); j++) {
-			normal_counter++;
-			fout << "vn  " << *(mesh->GetNormalX(j)) << " " << *(mesh->GetNormalY(j)) << " "
-				<< *(mesh->GetNormalZ(j)) << std::endl;
+		for(size_t j=0; j+2<mesh->m_normals.size(); j+=3) {
+			write_coordinates(&writer, "vn  ", &mesh->m_normals[j]);
 		}
-		fout << "# " << mesh->GetNNormals() << " vertex normals" << std::endl << std::endl;
+		writer.Put("# ");
+		writer.PutInt(mesh->GetNNormals());
+		writer.Put(" vertex normals\n\n");
 
 		//face list:
-		fout << "g " << mesh->GetName() << std::endl;
-		current_smooth_group = mesh->GetFace(0)->smoothing_group;
-		fout << "s " << current_smooth_group << std::endl;
-		for(int j=0; j<mesh->GetNFaces(); j++) {
-			OBJ_Mesh::Face const* current_face = mesh->GetFace(j);
-			if(current_face->smoothing_group != current_smooth_group) {
-				current_smooth_group = current_face->smoothing_group;
-				fout << "s " << current_smooth_group << std::endl;
+		writer.Put("g ");
+		writer.Put(mesh->GetName());
+		writer.Put("\n");
+		if(mesh->m_faces.empty()) {
+			//as GetFace(0) would:
+			writer.Flush();
+			throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER ) );
+		}
+		current_smooth_group = mesh->m_faces[0].smoothing_group;
+		writer.Put("s ");
+		writer.PutInt(current_smooth_group);
+		writer.Put("\n");
+		for(std::vector<OBJ_Mesh::Face>::const_iterator it = mesh->m_faces.begin(); it != mesh->m_faces.end(); ++it) {
+			if(it->smoothing_group != current_smooth_group) {
+				current_smooth_group = it->smoothing_group;
+				writer.Put("s ");
+				writer.PutInt(current_smooth_group);
+				writer.Put("\n");
 			}
-			fout << "f " << (current_face->vert1 + vert_base + 1) << "/" 
-				<< (current_face->texture1 + texture_base + 1) << "/" 
-				<< (current_face->normal1 + normal_base + 1)   << " " 
-				<< (current_face->vert2 + vert_base + 1)       << "/" 
-				<< (current_face->texture2 + texture_base + 1) << "/" 
-				<< (current_face->normal2 + normal_base + 1)   << " " 
-				<< (current_face->vert3 + vert_base + 1)       << "/" 
-				<< (current_face->texture3 + texture_base + 1) << "/" 
-				<< (current_face->normal3 + normal_base + 1)   << std::endl;
-		}
-		fout << "# " << mesh->GetNFaces() << " faces" << std::endl << std::endl;
+			int const corners[9] = { it->vert1, it->texture1, it->normal1,
+			                         it->vert2, it->texture2, it->normal2,
+			                         it->vert3, it->texture3, it->normal3 };
+			int const bases[3] = { vert_base, texture_base, normal_base };
+			char* p = writer.Reserve();
+			*p++ = 'f';
+			for(int j=0; j<9; j++) {
+				*p++ = (j % 3 == 0) ? ' ' : '/';
+				p = format_int(p, corners[j] + bases[j % 3] + 1);
+			}
+			*p++ = '\n';
+			writer.Commit(p);
+		}
+		writer.Put("# ");
+		writer.PutInt(mesh->GetNFaces());
+		writer.Put(" faces\n\n");
 
 		//adjust base counters:
-		vert_base = vert_counter;
-		normal_base = normal_counter;
-		texture_base = texture_counter;
-		fout << "g" << std::endl;
+		vert_base += mesh->GetNVertices();
+		normal_base += mesh->GetNNormals();
+		texture_base += mesh->GetNTexture();
+		writer.Put("g\n");
+	}
+	writer.Flush();
+	fout.close();
+	if(fout.fail()) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not write file" ) );
 	}
 }
 
-void OBJ_FileLoader::ReadFile(std::ifstream& f) 
+/** Index of face elements without texture coordinate or normal while parsing
+ */
+static int const MISSING_INDEX = OBJ_StreamReader::NO_INDEX;
+/** Minimum size of the chunks an obj file is split into for parsing in parallel
+ */
+static size_t const MIN_CHUNK_SIZE = 1 << 20;
+/** Number of chunks per thread an obj file is split into, for balancing the load
+ */
+static size_t const CHUNKS_PER_THREAD = 4;
+/** Number of elements passed to an OBJ_StreamReader::Visitor at once
+ */
+static size_t const STREAM_BATCH_SIZE = 4096;
+/** Size of the read buffer of the OBJ_StreamReader used by OBJ_FileLoader::LoadMesh()
+ */
+static size_t const STREAM_BUFFER_SIZE = 1 << 20;
+/** Number of bytes at the start and at the end of an obj file covered by the hash of OBJ_MeshIndex
+ */
+static size_t const INDEX_HASH_SIZE = 1 << 16;
+/** Suffix of the sidecar file of OBJ_MeshIndex, appended to the name of the obj file
+ */
+static char const INDEX_SIDECAR_SUFFIX[] = ".idx";
+/** First word of a sidecar file of OBJ_MeshIndex
+ */
+static char const INDEX_SIDECAR_MAGIC[] = "OBJ_MESH_INDEX";
+/** Format version of the sidecar files of OBJ_MeshIndex
+ */
+static int const INDEX_SIDECAR_VERSION = 1;
+/** First bytes of a binary mesh file
+ */
+static char const BINARY_MAGIC[8] = { 'O', 'B', 'J', 'M', 'E', 'S', 'H', '\0' };
+/** Value stored to detect the byte order of a binary mesh file
+ */
+static unsigned int const BINARY_BYTE_ORDER = 0x01020304;
+/** Format version of binary mesh files
+ */
+static unsigned int const BINARY_VERSION = 1;
+/** Alignment of the fields of a binary mesh file in bytes
+ */
+static size_t const BINARY_ALIGNMENT = 64;
+
+/** Helper function: skips blanks (but not line breaks)
+ */
+inline char const* skip_blanks(char const* p, char const* end) {
+	while((p != end) && ((*p == ' ') || (*p == '\t') || (*p == '\r'))) { ++p; }
+	return p;
+}
+
+/** Helper function: reads a floating point number
+ * @return Pointer to the first character following the number; NULL if there is no number at p
+ * @note Numbers of up to 19 significant digits and a decimal exponent of at most 22 are
+ *       converted exactly (and thus correctly rounded); all others are handed to strtod()
+ *       with the decimal point removed. Unlike sscanf(), neither path depends on the
+ *       current locale's decimal point.
+ */
+static char const* parse_double(char const* p, char const* end, double* value) {
+	static double const powers_of_ten[] = { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	                                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	char const* const start = p;
+	bool negative = false;
+	if((p != end) && ((*p == '-') || (*p == '+'))) { negative = (*p == '-'); ++p; }
+	//the mantissa is only exact for up to 19 digits; longer numbers are handled by strtod() below:
+	unsigned long long mantissa = 0;
+	char const* const int_begin = p;
+	for(; (p != end) && (*p >= '0') && (*p <= '9'); ++p) { mantissa = mantissa*10 + (*p - '0'); }
+	int n_digits = static_cast<int>(p - int_begin);
+	int exponent = 0;
+	if((p != end) && (*p == '.')) {
+		char const* const frac_begin = ++p;
+		for(; (p != end) && (*p >= '0') && (*p <= '9'); ++p) { mantissa = mantissa*10 + (*p - '0'); }
+		exponent = -static_cast<int>(p - frac_begin);
+		n_digits -= exponent;
+	}
+	char const* const digits_end = p;
+	if(n_digits == 0) {
+		//inf, nan or garbage; strtod() reads inf and nan the same in every locale:
+		if((p == end) || ((*p != 'i') && (*p != 'I') && (*p != 'n') && (*p != 'N'))) { return NULL; }
+		char const* q = start;
+		while((q != end) && (*q != ' ') && (*q != '\t') && (*q != '\r') && (*q != '\n')) { ++q; }
+		if(q == start) { return NULL; }
+		std::string const token(start, q);
+		char* token_end;
+		*value = strtod(token.c_str(), &token_end);
+		return (token_end == token.c_str()) ? NULL : (start + (token_end - token.c_str()));
+	}
+	if((p != end) && ((*p == 'e') || (*p == 'E'))) {
+		char const* q = p + 1;
+		bool negative_exponent = false;
+		if((q != end) && ((*q == '-') || (*q == '+'))) { negative_exponent = (*q == '-'); ++q; }
+		if((q != end) && (*q >= '0') && (*q <= '9')) {
+			int e = 0;
+			for(; (q != end) && (*q >= '0') && (*q <= '9'); ++q) {
+				if(e < 100000) { e = e*10 + (*q - '0'); }
+			}
+			exponent += negative_exponent ? -e : e;
+			p = q;
+		}
+	}
+	if((n_digits <= 19) && (mantissa <= (1ULL << 53)) && (exponent >= -22) && (exponent <= 22)) {
+		double d = static_cast<double>(mantissa);
+		d = (exponent < 0) ? (d / powers_of_ten[-exponent]) : (d * powers_of_ten[exponent]);
+		*value = negative ? -d : d;
+		return p;
+	}
+	//the token is rebuilt without the decimal point, which strtod() takes from the locale:
+	std::string token(negative ? "-" : "");
+	for(char const* q=int_begin; q!=digits_end; ++q) {
+		if(*q != '.') { token += *q; }
+	}
+	char exponent_str[16];
+	sprintf(exponent_str, "e%d", exponent);
+	token += exponent_str;
+	*value = strtod(token.c_str(), NULL);
+	return p;
+}
+
+/** Helper function: reads a decimal integer
+ * @return Pointer to the first character following the number; NULL if there is no number at p
+ */
+static char const* parse_int(char const* p, char const* end, int* value) {
+	bool negative = false;
+	if((p != end) && ((*p == '-') || (*p == '+'))) { negative = (*p == '-'); ++p; }
+	if((p == end) || (*p < '0') || (*p > '9')) { return NULL; }
+	long long v = 0;
+	for(; (p != end) && (*p >= '0') && (*p <= '9'); ++p) {
+		v = v*10 + (*p - '0');
+		if(v > INT_MAX) { return NULL; }
+	}
+	*value = static_cast<int>(negative ? -v : v);
+	return p;
+}
+
+/** Helper function: reads up to n coordinates of a v, vt or vn line, missing ones are set to 0
+ * @return The number of coordinates read
+ */
+static int parse_coordinates(char const* p, char const* end, double* coords, int n) {
+	int i = 0;
+	for(; i<n; i++) {
+		p = skip_blanks(p, end);
+		char const* q = parse_double(p, end, &coords[i]);
+		if(!q) { break; }
+		p = q;
+	}
+	for(int j=i; j<n; j++) { coords[j] = 0.0; }
+	return i;
+}
+
+/** Helper function: translates an OBJ index to a 0-based index into the current mesh
+ * @param[in] index 1-based index as read from the file, or negative for counting back from the last element read
+ * @param[in] counter Number of elements read from the file so far
+ * @param[in] base Number of elements read before the current mesh
+ */
+inline int resolve_index(int index, int counter, int base) {
+	return ((index < 0) ? (counter + index) : (index - 1)) - base;
+}
+
+/** Helper function: reads one vertex of a face in any of the forms v, v/vt, v//vn and v/vt/vn
+ * @param[out] indices Receives the indices of vertex, texture and normal (0 if absent)
+ * @return Pointer to the first character following the vertex; NULL if there is none at p
+ */
+static char const* parse_face_vertex(char const* p, char const* end, int* indices) {
+	indices[0] = indices[1] = indices[2] = 0;
+	p = parse_int(p, end, &indices[0]);
+	if(!p) { return NULL; }
+	if((p != end) && (*p == '/')) {
+		++p;
+		if((p != end) && (*p != '/')) {
+			p = parse_int(p, end, &indices[1]);
+			if(!p) { return NULL; }
+		}
+		if((p != end) && (*p == '/')) {
+			p = parse_int(p + 1, end, &indices[2]);
+			if(!p) { return NULL; }
+		}
+	}
+	return p;
+}
+
+void OBJ_FileLoader::FinishMesh(OBJ_Mesh* mesh, std::vector<double>& geometry, std::vector<double>& normals,
+                                std::vector<double>& texcoords, std::vector<OBJ_Mesh::Face>& faces)
 {
-	///@todo: only triangular polys supported; all vertices are assumed to have vertex, texture and normal data present;
-	std::string buffer;
-	if(m_MeshList.size() > 0) { 
-		throw( Ghulbus::gbException( Ghulbus::gbException::GB_INVALIDCONTEXT,
-			                         "The mesh list is not empty" ) );
+	int const n_vertices = static_cast<int>(geometry.size() / 3);
+	int const n_normals  = static_cast<int>(normals.size() / 3);
+	int const n_texture  = static_cast<int>(texcoords.size() / 3);
+	int default_texture  = -1;
+	for(size_t i=0; i<faces.size(); i++) {
+		OBJ_Mesh::Face& face = faces[i];
+		int* const verts[3]   = { &face.vert1, &face.vert2, &face.vert3 };
+		int* const normal[3]  = { &face.normal1, &face.normal2, &face.normal3 };
+		int* const texture[3] = { &face.texture1, &face.texture2, &face.texture3 };
+		for(int j=0; j<3; j++) {
+			if((*verts[j] < 0) || (*verts[j] >= n_vertices) ||
+			   ((*normal[j] != MISSING_INDEX) && ((*normal[j] < 0) || (*normal[j] >= n_normals))) ||
+			   ((*texture[j] != MISSING_INDEX) && ((*texture[j] < 0) || (*texture[j] >= n_texture))))
+			{
+				throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Face index out of range" ) );
+			}
+		}
+		if((*normal[0] == MISSING_INDEX) || (*normal[1] == MISSING_INDEX) || (*normal[2] == MISSING_INDEX)) {
+			double const* a = &geometry[face.vert1 * 3];
+			double const* b = &geometry[face.vert2 * 3];
+			double const* c = &geometry[face.vert3 * 3];
+			double const u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			double const v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+			double n[3] = { u[1]*v[2] - u[2]*v[1], u[2]*v[0] - u[0]*v[2], u[0]*v[1] - u[1]*v[0] };
+			double const len = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+			if(len > 0.0) { n[0] /= len;  n[1] /= len;  n[2] /= len; }
+			int const index = static_cast<int>(normals.size() / 3);
+			normals.insert(normals.end(), n, n + 3);
+			for(int j=0; j<3; j++) {
+				if(*normal[j] == MISSING_INDEX) { *normal[j] = index; }
+			}
+		}
+		if((*texture[0] == MISSING_INDEX) || (*texture[1] == MISSING_INDEX) || (*texture[2] == MISSING_INDEX)) {
+			if(default_texture < 0) {
+				default_texture = static_cast<int>(texcoords.size() / 3);
+				texcoords.insert(texcoords.end(), 3, 0.0);
+			}
+			for(int j=0; j<3; j++) {
+				if(*texture[j] == MISSING_INDEX) { *texture[j] = default_texture; }
+			}
+		}
 	}
-	char group_name[256];								///< buffer holding the current group name
-	bool new_group_was_opened = false;					///< flag for mesh object maintenance
-	OBJ_Mesh* mesh = new OBJ_Mesh("");					///< buffer mesh object
-	double tmp[3];
+	mesh->m_geometry.swap(geometry);
+	mesh->m_normals.swap(normals);
+	mesh->m_texcoords.swap(texcoords);
+	mesh->m_faces.swap(faces);
+	geometry.clear();
+	normals.clear();
+	texcoords.clear();
+	faces.clear();
+}
+
+/** State of the parser between two lines of an obj file
+ */
+typedef struct OBJ_ParseState_t {
+	int vert_counter, normal_counter, texture_counter;	///< number of elements read so far
+	int vert_base, normal_base, texture_base;			///< number of elements read before the current mesh
+	std::string group_name;								///< the current group name
+	bool new_group_was_opened;							///< flag for mesh object maintenance
+	int smoothing_group;								///< the current smoothing group
+} OBJ_ParseState;
+
+/** The data of a mesh found in one chunk of an obj file
+ * @note A mesh spanning several chunks consists of one piece per chunk.
+ */
+typedef struct OBJ_MeshPiece_t {
+	std::vector<double> geometry, normals, texcoords;	///< data of the mesh
+	std::vector<OBJ_Mesh::Face> faces;					///< faces of the mesh (mesh local indices)
+	bool ends_mesh;										///< true if the mesh ends with this piece
+	std::string name;									///< name of the mesh (only if ends_mesh)
+} OBJ_MeshPiece;
+
+/** What a chunk of an obj file changes about the parser state
+ */
+typedef struct OBJ_ChunkSummary_t {
+	int n_vertices, n_normals, n_texture;				///< number of elements in the chunk
+	bool has_vertex_line;								///< true if the chunk contains a v* line
+	bool has_group;										///< true if the chunk contains a named group
+	std::string group_name;								///< name of the last group of the chunk
+	bool has_split;										///< true if a v* line follows a group in the chunk
+	int split_vertices, split_normals, split_texture;	///< elements in the chunk before its last such v* line
+	bool group_open_at_end;								///< true if no v* line follows the last group of the chunk
+	bool has_smoothing_group;							///< true if the chunk sets the smoothing group
+	int smoothing_group;								///< the last smoothing group set in the chunk
+} OBJ_ChunkSummary;
+
+/** Helper function: sets the parser state for the start of a file
+ */
+static void init_state(OBJ_ParseState* state) {
+	state->vert_counter = state->normal_counter = state->texture_counter = 0;
+	state->vert_base = state->normal_base = state->texture_base = 0;
+	state->group_name.clear();
+	state->new_group_was_opened = false;
+	state->smoothing_group = -1;
+}
+
+/** Helper function: reads the name of a group statement
+ * @param[in] p First character following the 'g'
+ * @return True if the name is not empty
+ */
+static bool parse_group_name(char const* p, char const* line_end, std::string* name) {
+	p = skip_blanks(p, line_end);
+	char const* name_end = p;
+	while((name_end != line_end) && (*name_end != ' ') && (*name_end != '\t') && (*name_end != '\r')) { ++name_end; }
+	if(name_end == p) { return false; }
+	name->assign(p, name_end);
+	return true;
+}
+
+/** Helper function: reads the argument of a smoothing group statement
+ * @param[in] p First character following the 's'
+ * @return False if the argument is neither a number nor "off"
+ */
+static bool parse_smoothing_group(char const* p, char const* line_end, int* smoothing_group) {
+	p = skip_blanks(p, line_end);
+	if(parse_int(p, line_end, smoothing_group)) { return true; }
+	if((line_end - p >= 3) && (strncmp(p, "off", 3) == 0)) { *smoothing_group = 0;  return true; }
+	return false;
+}
+
+/** Helper function: parses a part of an obj file that starts and ends at a line boundary
+ * @param[in] begin First character of the part
+ * @param[in] end One past the last character of the part
+ * @param[in,out] state Parser state at begin; receives the state at end
+ * @param[in] sink Receives the data; must provide
+ *                 - bool IsActive() const: false if the data of the current mesh is not needed
+ *                 - bool SplitMesh(std::string const& name): ends the current mesh and starts
+ *                   a new one; false to stop parsing
+ *                 - void AddGeometry(double const*), AddNormal(double const*), AddTexture(double const*):
+ *                   receive a triple of coordinates
+ *                 - void AddFace(OBJ_Mesh::Face const&): receives a triangle with mesh local indices;
+ *                   missing texture and normal indices are MISSING_INDEX
+ *                 - void SkipFace(): called instead of AddFace() for each face line if not active
+ * @return False if the sink stopped parsing; state is not updated then
+ * @throw Ghulbus::gbException GB_FAILED indicates a malformed vertex or face;
+ * @throw std::bad_alloc
+ */
+template<class Sink>
+static bool parse_lines(char const* begin, char const* end, OBJ_ParseState* state, Sink* sink)
+{
+	std::vector<int> polygon;							///< vertex, texture and normal index of each corner of the current face
 	OBJ_Mesh::Face tmp_face;
-	tmp_face.smoothing_group = -1;
-	int vert_counter=0, normal_counter=0, texture_counter=0;
-	int vert_base=0, normal_base=0, texture_base=0;
-	
-	while( std::getline(f, buffer) ) {
-		//for each line of the file do:
+
+	char const* line = begin;
+	while(line != end) {
+		char const* line_end = static_cast<char const*>(memchr(line, '\n', end - line));
+		if(!line_end) { line_end = end; }
+		char const* p = skip_blanks(line, line_end);
 		//first character determines what kind of data to expect:
-		switch(buffer[0]) {
-			case '#':
-				//commentary
-				// do nothing
-				break;
-			case 'v':
-				//vertex data
-				if(new_group_was_opened) {
-					//if new group was opened since last vertex was read
-					//the following data belongs to a new mesh
-					OBJ_Mesh* newmesh = new OBJ_Mesh("");
-					mesh->SetName(group_name);
-					m_MeshList.push_back(mesh);
-					mesh = newmesh;
-					vert_base = vert_counter;			//save current indices
-					normal_base = normal_counter;
-					texture_base = texture_counter;
-					new_group_was_opened = false;
+		if((p != line_end) && (*p == 'v')) {
+			//vertex data
+			if(state->new_group_was_opened) {
+				//if new group was opened since last vertex was read
+				//the following data belongs to a new mesh
+				if(!sink->SplitMesh(state->group_name)) { return false; }
+				state->vert_base = state->vert_counter;			//save current indices
+				state->normal_base = state->normal_counter;
+				state->texture_base = state->texture_counter;
+				state->new_group_was_opened = false;
+			}
+			//read and store vertex data; only count it if not needed:
+			double tmp[3];
+			char const type = (p + 1 != line_end) ? p[1] : '\0';
+			if((type == ' ') || (type == '\t')) {
+				//geometry vertex
+				if(sink->IsActive()) {
+					if(parse_coordinates(p + 1, line_end, tmp, 3) != 3) {
+						throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Malformed vertex" ) );
+					}
+					sink->AddGeometry(tmp);
 				}
-				//read and store vertex data:
-				switch(buffer[1]) {
-					case ' ':
-						//geometry vertex
-						sscanf(buffer.c_str(), "v %lf %lf %lf", &(tmp[0]), &(tmp[1]), &(tmp[2]));
-						mesh->AddGeometry(tmp, 3);
-						vert_counter++;
-						break;
-					case 't':
-						//texture vertex
-						sscanf(buffer.c_str(), "vt %lf %lf %lf", &(tmp[0]), &(tmp[1]), &(tmp[2]));
-						mesh->AddTextureData(tmp, 3);
-						texture_counter++;
-						break;
-					case 'n':
-						//normal vertex
-						sscanf(buffer.c_str(), "vn %lf %lf %lf", &(tmp[0]), &(tmp[1]), &(tmp[2]));
-						mesh->AddNormals(tmp, 3);
-						normal_counter++;
-						break;
-					case 'p':
-						//parameter space vertex
-						/// @todo
-						break;
-					default:
-						break;
+				state->vert_counter++;
+			} else if(type == 't') {
+				//texture vertex
+				if(sink->IsActive()) {
+					if(parse_coordinates(p + 2, line_end, tmp, 3) < 1) {
+						throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Malformed texture vertex" ) );
+					}
+					sink->AddTexture(tmp);
 				}
-				break;
-			case 'f':
-				//face
-				//read and store face data:
-				sscanf(buffer.c_str(), "f %d/%d/%d %d/%d/%d %d/%d/%d",
-					    &(tmp_face.vert1), &(tmp_face.texture1), &(tmp_face.normal1),
-						&(tmp_face.vert2), &(tmp_face.texture2), &(tmp_face.normal2),
-						&(tmp_face.vert3), &(tmp_face.texture3), &(tmp_face.normal3) );
-				//since obj's index counters are not reset between groups, we need to adjust indices manually:
-				tmp_face.vert1 -= vert_base; tmp_face.vert2 -= vert_base; tmp_face.vert3 -= vert_base;
-				tmp_face.normal1 -= normal_base; tmp_face.normal2 -= normal_base; tmp_face.normal3 -= normal_base; 
-				tmp_face.texture1 -= texture_base; tmp_face.texture2 -= texture_base; tmp_face.texture3 -= texture_base;
-				//beware! object file indices are 1-based; readjust:
-				tmp_face.vert1--;    tmp_face.vert2--;    tmp_face.vert3--;
-				tmp_face.texture1--; tmp_face.texture2--; tmp_face.texture3--;
-				tmp_face.normal1--;  tmp_face.normal2--;  tmp_face.normal3--;
-				mesh->AddFaceData(&tmp_face, 1);
-				break;
-			case 'g':
-				//group
-				if(sscanf(buffer.c_str(), "g %s", group_name) > 0) {
-					//a new (named) group was opened;
-					//in 3dsmax obj files this should only happen before a new faces block
-					new_group_was_opened = true;
+				state->texture_counter++;
+			} else if(type == 'n') {
+				//normal vertex
+				if(sink->IsActive()) {
+					if(parse_coordinates(p + 2, line_end, tmp, 3) != 3) {
+						throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Malformed normal vertex" ) );
+					}
+					sink->AddNormal(tmp);
 				}
-				break;
-			case 's':
-				switch(buffer[1]) {
-					case ' ':
-						//smoothing group
-						sscanf(buffer.c_str(), "s %d", &(tmp_face.smoothing_group));
-						break;
-					default:
-						break;
+				state->normal_counter++;
+			}
+			//parameter space vertices (vp) are ignored
+		} else if((p != line_end) && (*p == 'f') && !sink->IsActive()) {
+			sink->SkipFace();
+		} else if((p != line_end) && (*p == 'f')) {
+			//face; polygons are split into a fan of triangles:
+			polygon.clear();
+			p = skip_blanks(p + 1, line_end);
+			while(p != line_end) {
+				int indices[3];
+				p = parse_face_vertex(p, line_end, indices);
+				if((!p) || (indices[0] == 0)) {
+					throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Malformed face" ) );
 				}
-			default:
-				break;
+				//since obj's index counters are not reset between groups, we need to adjust indices manually:
+				polygon.push_back( resolve_index(indices[0], state->vert_counter, state->vert_base) );
+				polygon.push_back( (indices[1] == 0) ? MISSING_INDEX :
+				                   resolve_index(indices[1], state->texture_counter, state->texture_base) );
+				polygon.push_back( (indices[2] == 0) ? MISSING_INDEX :
+				                   resolve_index(indices[2], state->normal_counter, state->normal_base) );
+				p = skip_blanks(p, line_end);
+			}
+			if(polygon.size() < 9) {
+				throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Malformed face" ) );
+			}
+			tmp_face.smoothing_group = state->smoothing_group;
+			for(size_t i=6; i<polygon.size(); i+=3) {
+				tmp_face.vert1 = polygon[0];    tmp_face.texture1 = polygon[1];    tmp_face.normal1 = polygon[2];
+				tmp_face.vert2 = polygon[i-3];  tmp_face.texture2 = polygon[i-2];  tmp_face.normal2 = polygon[i-1];
+				tmp_face.vert3 = polygon[i];    tmp_face.texture3 = polygon[i+1];  tmp_face.normal3 = polygon[i+2];
+				sink->AddFace(tmp_face);
+			}
+		} else if((p != line_end) && (*p == 'g')) {
+			//group
+			if(parse_group_name(p + 1, line_end, &state->group_name)) {
+				//a new (named) group was opened;
+				//in 3dsmax obj files this should only happen before a new faces block
+				state->new_group_was_opened = true;
+			}
+		} else if((p != line_end) && (*p == 's')) {
+			//smoothing group
+			parse_smoothing_group(p + 1, line_end, &state->smoothing_group);
 		}
+		//all other lines (comments, materials, ...) are ignored
+		line = (line_end == end) ? end : (line_end + 1);
+	}
+	return true;
+}
+
+/** Receives the data found by parse_lines() as mesh pieces for OBJ_FileLoader
+ */
+class OBJ_PieceSink {
+private:
+	std::deque<OBJ_MeshPiece>* m_pieces;			///< the pieces found so far
+	OBJ_MeshPiece* m_piece;							///< the current piece
+public:
+	OBJ_PieceSink(std::deque<OBJ_MeshPiece>* pieces)
+		:m_pieces(pieces)
+	{
+		StartPiece();
+	}
+	bool IsActive() const { return true; }
+	bool SplitMesh(std::string const& name) {
+		m_piece->ends_mesh = true;
+		m_piece->name = name;
+		StartPiece();
+		return true;
+	}
+	void AddGeometry(double const* v) { m_piece->geometry.insert(m_piece->geometry.end(), v, v + 3); }
+	void AddNormal(double const* v) { m_piece->normals.insert(m_piece->normals.end(), v, v + 3); }
+	void AddTexture(double const* v) { m_piece->texcoords.insert(m_piece->texcoords.end(), v, v + 3); }
+	void AddFace(OBJ_Mesh::Face const& face) { m_piece->faces.push_back(face); }
+	void SkipFace() {}
+private:
+	void StartPiece() {
+		m_pieces->push_back(OBJ_MeshPiece());
+		m_piece = &m_pieces->back();
+		m_piece->ends_mesh = false;
 	}
-	if(mesh->GetNFaces() > 0) {
-		mesh->SetName(group_name);
-		m_MeshList.push_back(mesh);
+};
+
+/** Helper function: parses a part of an obj file that starts and ends at a line boundary
+ * @param[in] begin First character of the part
+ * @param[in] end One past the last character of the part
+ * @param[in,out] state Parser state at begin; receives the state at end
+ * @param[out] pieces Receives the mesh data found; a new piece is started for every new mesh
+ * @throw Ghulbus::gbException GB_FAILED indicates a malformed vertex or face;
+ * @throw std::bad_alloc
+ */
+static void parse_chunk(char const* begin, char const* end, OBJ_ParseState* state, std::deque<OBJ_MeshPiece>* pieces)
+{
+	OBJ_PieceSink sink(pieces);
+	parse_lines(begin, end, state, &sink);
+}
+
+/** Helper function: determines how a part of an obj file changes the parser state, without
+ *                   parsing any numbers but those of smoothing groups
+ * @param[in] begin First character of the part
+ * @param[in] end One past the last character of the part
+ * @param[out] summary Receives the changes
+ * @note The lines are classified exactly as by parse_chunk().
+ */
+static void summarize_chunk(char const* begin, char const* end, OBJ_ChunkSummary* summary)
+{
+	summary->n_vertices = summary->n_normals = summary->n_texture = 0;
+	summary->has_vertex_line = summary->has_group = summary->has_split = summary->has_smoothing_group = false;
+	summary->group_open_at_end = false;
+	summary->split_vertices = summary->split_normals = summary->split_texture = 0;
+	summary->smoothing_group = -1;
+	bool group_was_opened = false;
+	char const* line = begin;
+	while(line != end) {
+		char const* line_end = static_cast<char const*>(memchr(line, '\n', end - line));
+		if(!line_end) { line_end = end; }
+		char const* p = skip_blanks(line, line_end);
+		if((p != line_end) && (*p == 'v')) {
+			summary->has_vertex_line = true;
+			if(group_was_opened) {
+				summary->has_split = true;
+				summary->split_vertices = summary->n_vertices;
+				summary->split_normals  = summary->n_normals;
+				summary->split_texture  = summary->n_texture;
+				group_was_opened = false;
+			}
+			char const type = (p + 1 != line_end) ? p[1] : '\0';
+			if((type == ' ') || (type == '\t')) {
+				summary->n_vertices++;
+			} else if(type == 't') {
+				summary->n_texture++;
+			} else if(type == 'n') {
+				summary->n_normals++;
+			}
+		} else if((p != line_end) && (*p == 'g')) {
+			if(parse_group_name(p + 1, line_end, &summary->group_name)) {
+				summary->has_group = true;
+				group_was_opened = true;
+			}
+		} else if((p != line_end) && (*p == 's')) {
+			if(parse_smoothing_group(p + 1, line_end, &summary->smoothing_group)) {
+				summary->has_smoothing_group = true;
+			}
+		}
+		line = (line_end == end) ? end : (line_end + 1);
+	}
+	summary->group_open_at_end = group_was_opened;
+}
+
+/** Helper function: applies the changes of a chunk to the parser state
+ * @param[in] state Parser state at the start of the chunk
+ * @param[in] summary Changes made by the chunk
+ * @param[out] next Receives the parser state at the end of the chunk
+ */
+static void advance_state(OBJ_ParseState const& state, OBJ_ChunkSummary const& summary, OBJ_ParseState* next)
+{
+	next->vert_counter    = state.vert_counter    + summary.n_vertices;
+	next->normal_counter  = state.normal_counter  + summary.n_normals;
+	next->texture_counter = state.texture_counter + summary.n_texture;
+	if(summary.has_split) {
+		//the last mesh of the chunk starts after a group within the chunk:
+		next->vert_base    = state.vert_counter    + summary.split_vertices;
+		next->normal_base  = state.normal_counter  + summary.split_normals;
+		next->texture_base = state.texture_counter + summary.split_texture;
+	} else if(state.new_group_was_opened && summary.has_vertex_line) {
+		//a group opened in an earlier chunk starts a new mesh with the first v* line of the chunk:
+		next->vert_base    = state.vert_counter;
+		next->normal_base  = state.normal_counter;
+		next->texture_base = state.texture_counter;
+	} else {
+		next->vert_base    = state.vert_base;
+		next->normal_base  = state.normal_base;
+		next->texture_base = state.texture_base;
+	}
+	if(summary.has_group) {
+		next->group_name = summary.group_name;
+		next->new_group_was_opened = summary.group_open_at_end;
+	} else {
+		next->group_name = state.group_name;
+		next->new_group_was_opened = state.new_group_was_opened && !summary.has_vertex_line;
+	}
+	next->smoothing_group = summary.has_smoothing_group ? summary.smoothing_group : state.smoothing_group;
+}
+
+/** Helper function: joins the pieces of a mesh
+ * @param[in] pieces The pieces in file order; they are left empty
+ * @param[out] joined Receives the data of all pieces
+ */
+static void join_pieces(std::vector<OBJ_MeshPiece*> const& pieces, OBJ_MeshPiece* joined)
+{
+	if(pieces.size() == 1) {
+		joined->geometry.swap(pieces[0]->geometry);
+		joined->normals.swap(pieces[0]->normals);
+		joined->texcoords.swap(pieces[0]->texcoords);
+		joined->faces.swap(pieces[0]->faces);
+		return;
+	}
+	size_t n_geometry = 0, n_normals = 0, n_texcoords = 0, n_faces = 0;
+	for(size_t i=0; i<pieces.size(); i++) {
+		n_geometry  += pieces[i]->geometry.size();
+		n_normals   += pieces[i]->normals.size();
+		n_texcoords += pieces[i]->texcoords.size();
+		n_faces     += pieces[i]->faces.size();
+	}
+	joined->geometry.reserve(n_geometry);
+	joined->normals.reserve(n_normals);
+	joined->texcoords.reserve(n_texcoords);
+	joined->faces.reserve(n_faces);
+	for(size_t i=0; i<pieces.size(); i++) {
+		OBJ_MeshPiece* piece = pieces[i];
+		joined->geometry.insert(joined->geometry.end(), piece->geometry.begin(), piece->geometry.end());
+		joined->normals.insert(joined->normals.end(), piece->normals.begin(), piece->normals.end());
+		joined->texcoords.insert(joined->texcoords.end(), piece->texcoords.begin(), piece->texcoords.end());
+		joined->faces.insert(joined->faces.end(), piece->faces.begin(), piece->faces.end());
+		std::vector<double>().swap(piece->geometry);
+		std::vector<double>().swap(piece->normals);
+		std::vector<double>().swap(piece->texcoords);
+		std::vector<OBJ_Mesh::Face>().swap(piece->faces);
+	}
+}
+
+/** Determines the parser state changes of one chunk of an obj file per item
+ */
+class OBJ_SummaryJob: public ThreadPool::Job {
+private:
+	std::vector<char const*> const& m_bounds;
+	std::vector<OBJ_ChunkSummary>& m_summaries;
+public:
+	OBJ_SummaryJob(std::vector<char const*> const& bounds, std::vector<OBJ_ChunkSummary>& summaries)
+		:m_bounds(bounds), m_summaries(summaries) {}
+	void Run(int item, int /* thread */) {
+		summarize_chunk(m_bounds[item], m_bounds[item+1], &m_summaries[item]);
+	}
+private:
+	OBJ_SummaryJob& operator=(OBJ_SummaryJob const&);		///< private copy assignment (not implemented!)
+};
+
+/** Parses one chunk of an obj file per item, starting from the parser state at its beginning
+ */
+class OBJ_ParseJob: public ThreadPool::Job {
+private:
+	std::vector<char const*> const& m_bounds;
+	std::vector<OBJ_ParseState> const& m_states;
+	std::vector< std::deque<OBJ_MeshPiece> >& m_pieces;
+public:
+	OBJ_ParseJob(std::vector<char const*> const& bounds, std::vector<OBJ_ParseState> const& states,
+	             std::vector< std::deque<OBJ_MeshPiece> >& pieces)
+		:m_bounds(bounds), m_states(states), m_pieces(pieces) {}
+	void Run(int item, int /* thread */) {
+		OBJ_ParseState state = m_states[item];
+		parse_chunk(m_bounds[item], m_bounds[item+1], &state, &m_pieces[item]);
+	}
+private:
+	OBJ_ParseJob& operator=(OBJ_ParseJob const&);			///< private copy assignment (not implemented!)
+};
+
+void OBJ_FileLoader::ReadFile(char const* data, size_t size, int n_threads)
+{
+	if(m_MeshList.size() > 0) { 
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_INVALIDCONTEXT,
+			                         "The mesh list is not empty" ) );
+	}
+	if(n_threads == 0) { n_threads = ThreadPool::GetHardwareConcurrency(); }
+
+	//split the file at line boundaries; small files and single threads use a single chunk:
+	char const* const end = data + size;
+	std::vector<char const*> bounds(1, data);
+	size_t const max_chunks = (n_threads > 1) ? std::min(static_cast<size_t>(n_threads) * CHUNKS_PER_THREAD,
+	                                                     size / MIN_CHUNK_SIZE) : 1;
+	for(size_t i=1; i<max_chunks; i++) {
+		char const* p = std::max(data + (size / max_chunks) * i, bounds.back());
+		char const* line_end = static_cast<char const*>(memchr(p, '\n', end - p));
+		if(!line_end) { break; }
+		if(line_end + 1 != bounds.back()) { bounds.push_back(line_end + 1); }
+	}
+	if((bounds.size() == 1) || (bounds.back() != end)) { bounds.push_back(end); }
+	int const n_chunks = static_cast<int>(bounds.size()) - 1;
+
+	//the state at the start of each chunk is the prefix sum of the changes of all previous chunks;
+	//starting from it, each chunk is parsed exactly as it would be by a single pass over the file:
+	std::vector<OBJ_ParseState> states(n_chunks + 1);
+	init_state(&states[0]);
+	std::vector< std::deque<OBJ_MeshPiece> > pieces(n_chunks);
+	if(n_chunks > 1) {
+		ThreadPool pool(std::min(n_threads, n_chunks));
+		std::vector<OBJ_ChunkSummary> summaries(n_chunks);
+		OBJ_SummaryJob summary_job(bounds, summaries);
+		pool.Run(summary_job, n_chunks);
+		for(int i=0; i<n_chunks; i++) {
+			advance_state(states[i], summaries[i], &states[i+1]);
+		}
+		OBJ_ParseJob parse_job(bounds, states, pieces);
+		pool.Run(parse_job, n_chunks);
 	} else {
+		states[1] = states[0];
+		parse_chunk(data, end, &states[1], &pieces[0]);
+	}
+
+	try {
+		std::vector<OBJ_MeshPiece*> mesh_pieces;
+		for(int i=0; i<n_chunks; i++) {
+			for(std::deque<OBJ_MeshPiece>::iterator it = pieces[i].begin(); it != pieces[i].end(); ++it) {
+				mesh_pieces.push_back(&(*it));
+				if(it->ends_mesh) {
+					OBJ_MeshPiece joined;
+					join_pieces(mesh_pieces, &joined);
+					mesh_pieces.clear();
+					OBJ_Mesh* mesh = new OBJ_Mesh(it->name.c_str());
+					m_MeshList.push_back(mesh);
+					FinishMesh(mesh, joined.geometry, joined.normals, joined.texcoords, joined.faces);
+				}
+			}
+		}
+		OBJ_MeshPiece joined;
+		join_pieces(mesh_pieces, &joined);
+		if(!joined.faces.empty()) {
+			OBJ_Mesh* mesh = new OBJ_Mesh(states[n_chunks].group_name.c_str());
+			m_MeshList.push_back(mesh);
+			FinishMesh(mesh, joined.geometry, joined.normals, joined.texcoords, joined.faces);
+		}
+	} catch(...) {
+		for(std::vector<OBJ_Mesh*>::iterator i = m_MeshList.begin(); i != m_MeshList.end(); ++i) {
+			delete *i;
+		}
+		m_MeshList.clear();
+		throw;
+	}
+}
+
+/** Receives the data found by parse_lines() and passes it on to an OBJ_StreamReader::Visitor in batches
+ */
+class OBJ_StreamSink {
+private:
+	OBJ_StreamReader::Visitor* m_visitor;			///< the receiver of the data
+	int m_mesh;										///< number of the current mesh
+	bool m_active;									///< true if the visitor wants the data of the current mesh
+	bool m_has_faces;								///< true if a face of the current mesh was found
+	std::vector<double> m_geometry;					///< geometry data not yet passed on
+	std::vector<double> m_normals;					///< normal data not yet passed on
+	std::vector<double> m_texcoords;				///< texture data not yet passed on
+	std::vector<OBJ_Mesh::Face> m_faces;			///< faces not yet passed on
+public:
+	OBJ_StreamSink(OBJ_StreamReader::Visitor* visitor)
+		:m_visitor(visitor), m_mesh(0), m_active(false), m_has_faces(false)
+	{
+		m_geometry.reserve(STREAM_BATCH_SIZE * 3);
+		m_normals.reserve(STREAM_BATCH_SIZE * 3);
+		m_texcoords.reserve(STREAM_BATCH_SIZE * 3);
+		m_faces.reserve(STREAM_BATCH_SIZE);
+	}
+	void BeginMesh() {
+		m_has_faces = false;
+		m_active = m_visitor->BeginMesh(m_mesh);
+	}
+	bool EndMesh(std::string const& name) {
+		FlushFaces();
+		return m_visitor->EndMesh(m_mesh, name.c_str(), m_has_faces);
+	}
+	bool IsActive() const { return m_active; }
+	bool SplitMesh(std::string const& name) {
+		if(!EndMesh(name)) { return false; }
+		++m_mesh;
+		BeginMesh();
+		return true;
+	}
+	void AddGeometry(double const* v) { AddVertex(v, &m_geometry); }
+	void AddNormal(double const* v) { AddVertex(v, &m_normals); }
+	void AddTexture(double const* v) { AddVertex(v, &m_texcoords); }
+	void AddFace(OBJ_Mesh::Face const& face) {
+		m_has_faces = true;
+		m_faces.push_back(face);
+		if(m_faces.size() == STREAM_BATCH_SIZE) { FlushFaces(); }
+	}
+	void SkipFace() { m_has_faces = true; }
+private:
+	void AddVertex(double const* v, std::vector<double>* batch) {
+		batch->insert(batch->end(), v, v + 3);
+		if(batch->size() == STREAM_BATCH_SIZE * 3) { FlushVertices(); }
+	}
+	void FlushVertices() {
+		if(!m_geometry.empty()) {
+			m_visitor->Geometry(&m_geometry[0], static_cast<int>(m_geometry.size()));
+			m_geometry.clear();
+		}
+		if(!m_normals.empty()) {
+			m_visitor->Normals(&m_normals[0], static_cast<int>(m_normals.size()));
+			m_normals.clear();
+		}
+		if(!m_texcoords.empty()) {
+			m_visitor->TextureData(&m_texcoords[0], static_cast<int>(m_texcoords.size()));
+			m_texcoords.clear();
+		}
+	}
+	void FlushFaces() {
+		//the vertices preceding the faces are passed first:
+		FlushVertices();
+		if(!m_faces.empty()) {
+			m_visitor->Faces(&m_faces[0], static_cast<int>(m_faces.size()));
+			m_faces.clear();
+		}
+	}
+};
+
+/** Collects a single mesh for OBJ_FileLoader::LoadMesh()
+ */
+class OBJ_MeshCollector: public OBJ_StreamReader::Visitor {
+public:
+	int index;										///< number of the wanted mesh
+	bool found;										///< true once the wanted mesh is known to be complete
+	int n_begun;									///< number of meshes started so far
+	bool last_has_faces;							///< true if the mesh ended last has faces
+	std::string name;								///< name of the wanted mesh
+	std::vector<double> geometry;					///< geometry data of the wanted mesh
+	std::vector<double> normals;					///< normal data of the wanted mesh
+	std::vector<double> texcoords;					///< texture data of the wanted mesh
+	std::vector<OBJ_Mesh::Face> faces;				///< faces of the wanted mesh
+public:
+	OBJ_MeshCollector(int mesh_index)
+		:index(mesh_index), found(false), n_begun(0), last_has_faces(false)
+	{
+	}
+	bool BeginMesh(int mesh_index) {
+		//OBJ_FileLoader omits only the last mesh of a file if it has no faces,
+		//so a mesh followed by another one is always kept:
+		n_begun = mesh_index + 1;
+		if(mesh_index == index + 1) { found = true; }
+		return mesh_index == index;
+	}
+	void Geometry(double const* data, int n_data) { geometry.insert(geometry.end(), data, data + n_data); }
+	void Normals(double const* data, int n_data) { normals.insert(normals.end(), data, data + n_data); }
+	void TextureData(double const* data, int n_data) { texcoords.insert(texcoords.end(), data, data + n_data); }
+	void Faces(OBJ_Mesh::Face const* data, int n_faces) { faces.insert(faces.end(), data, data + n_faces); }
+	bool EndMesh(int mesh_index, char const* mesh_name, bool has_faces) {
+		last_has_faces = has_faces;
+		if(mesh_index == index) {
+			name = mesh_name;
+			found = has_faces;
+		}
+		return !found;
+	}
+	/** Number of meshes of the file, as counted by OBJ_FileLoader; only valid if the whole file was read
+	 */
+	int GetNMeshes() const {
+		return last_has_faces ? n_begun : (n_begun - 1);
+	}
+};
+
+OBJ_Mesh* OBJ_FileLoader::LoadMesh(const char* fname, int index, int* n_meshes)
+{
+	OBJ_MeshCollector collector(index);
+	OBJ_StreamReader reader(STREAM_BUFFER_SIZE);
+	reader.Read(fname, &collector);
+	if(!collector.found) {
+		if(n_meshes) { *n_meshes = collector.GetNMeshes(); }
+		return NULL;
+	}
+	OBJ_Mesh* mesh = new OBJ_Mesh(collector.name.c_str());
+	try {
+		FinishMesh(mesh, collector.geometry, collector.normals, collector.texcoords, collector.faces);
+	} catch(...) {
+		delete mesh;
+		throw;
+	}
+	return mesh;
+}
+
+int const OBJ_StreamReader::NO_INDEX;
+
+OBJ_StreamReader::OBJ_StreamReader(size_t buffer_size)
+	:m_buffer(buffer_size)
+{
+	if(buffer_size == 0) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER, "Buffer size must not be 0" ) );
+	}
+}
+
+void OBJ_StreamReader::Read(char const* fname, Visitor* visitor)
+{
+	std::ifstream fin(fname, std::ios_base::in | std::ios_base::binary);
+	if(!fin) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not open file" ) );
+	}
+	Read(fin, visitor);
+}
+
+void OBJ_StreamReader::Read(std::istream& is, Visitor* visitor)
+{
+	OBJ_ParseState state;
+	init_state(&state);
+	OBJ_StreamSink sink(visitor);
+	sink.BeginMesh();
+	char* const buffer = &m_buffer[0];
+	size_t filled = 0;
+	bool at_end = false;
+	while(!at_end) {
+		is.read(buffer + filled, m_buffer.size() - filled);
+		filled += static_cast<size_t>(is.gcount());
+		if(is.bad()) {
+			throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not read file" ) );
+		}
+		at_end = is.eof();
+		//parse all complete lines; the rest is kept for the next read:
+		char const* parse_end = buffer + filled;
+		if(!at_end) {
+			while((parse_end != buffer) && (parse_end[-1] != '\n')) { --parse_end; }
+			if(parse_end == buffer) {
+				throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Line exceeds the read buffer" ) );
+			}
+		}
+		if(!parse_lines(buffer, parse_end, &state, &sink)) { return; }
+		filled -= parse_end - buffer;
+		memmove(buffer, parse_end, filled);
+	}
+	sink.EndMesh(state.group_name);
+}
+
+/** Helper function: gets size and modification time of a file
+ * @throw Ghulbus::gbException GB_FAILED the file can not be accessed;
+ */
+static void get_file_status(char const* fname, unsigned long long* size, long long* time) {
+#ifdef _WIN32
+	struct _stat64 st;
+	if(_stat64(fname, &st) != 0) {
+#else
+	struct stat st;
+	if(stat(fname, &st) != 0) {
+#endif
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not access file" ) );
+	}
+	*size = static_cast<unsigned long long>(st.st_size);
+	*time = static_cast<long long>(st.st_mtime);
+}
+
+/** Helper function: hashes the first and the last INDEX_HASH_SIZE bytes of a file
+ */
+static ContentHash::Hash128 hash_file_ends(unsigned char const* data, size_t size) {
+	size_t const n = std::min(size, INDEX_HASH_SIZE);
+	ContentHash::Hash128 parts[2];
+	parts[0] = ContentHash::Compute(data, n, 10);
+	parts[1] = ContentHash::Compute(data + size - n, n, 10);
+	return ContentHash::Combine(parts, 2, 10);
+}
+
+/** Helper function: starts the index entry of a mesh
+ */
+static void begin_entry(OBJ_MeshIndex::Entry* entry, unsigned long long offset, int vert_base, int normal_base,
+                        int texture_base, int smoothing_group)
+{
+	entry->offset = offset;
+	entry->n_vertices = entry->n_normals = entry->n_texture = entry->n_faces = 0;
+	entry->vert_base = vert_base;
+	entry->normal_base = normal_base;
+	entry->texture_base = texture_base;
+	entry->smoothing_group = smoothing_group;
+}
+
+/** Helper function: finds the meshes of an obj file, without parsing any numbers but those
+ *                   of smoothing groups
+ * @param[in] data The contents of an obj file
+ * @param[in] size Size of data in bytes
+ * @param[out] entries Receives an entry per mesh
+ * @note The lines are classified exactly as by parse_lines(); triangles are counted by the
+ *       corners of each face.
+ */
+static void index_meshes(char const* data, size_t size, std::vector<OBJ_MeshIndex::Entry>* entries)
+{
+	char const* const end = data + size;
+	int vert_counter = 0, normal_counter = 0, texture_counter = 0;
+	int smoothing_group = -1;
+	std::string group_name;
+	bool group_was_opened = false;
+	OBJ_MeshIndex::Entry entry;
+	begin_entry(&entry, 0, 0, 0, 0, -1);
+	char const* line = data;
+	while(line != end) {
+		char const* line_end = static_cast<char const*>(memchr(line, '\n', end - line));
+		if(!line_end) { line_end = end; }
+		char const* p = skip_blanks(line, line_end);
+		if((p != line_end) && (*p == 'v')) {
+			if(group_was_opened) {
+				entry.name = group_name;
+				entry.size = (line - data) - entry.offset;
+				entries->push_back(entry);
+				begin_entry(&entry, line - data, vert_counter, normal_counter, texture_counter, smoothing_group);
+				group_was_opened = false;
+			}
+			char const type = (p + 1 != line_end) ? p[1] : '\0';
+			if((type == ' ') || (type == '\t')) {
+				entry.n_vertices++;
+				vert_counter++;
+			} else if(type == 't') {
+				entry.n_texture++;
+				texture_counter++;
+			} else if(type == 'n') {
+				entry.n_normals++;
+				normal_counter++;
+			}
+		} else if((p != line_end) && (*p == 'f')) {
+			int n_corners = 0;
+			p = skip_blanks(p + 1, line_end);
+			while(p != line_end) {
+				++n_corners;
+				while((p != line_end) && (*p != ' ') && (*p != '\t') && (*p != '\r')) { ++p; }
+				p = skip_blanks(p, line_end);
+			}
+			if(n_corners >= 3) { entry.n_faces += n_corners - 2; }
+		} else if((p != line_end) && (*p == 'g')) {
+			if(parse_group_name(p + 1, line_end, &group_name)) {
+				group_was_opened = true;
+			}
+		} else if((p != line_end) && (*p == 's')) {
+			parse_smoothing_group(p + 1, line_end, &smoothing_group);
+		}
+		line = (line_end == end) ? end : (line_end + 1);
+	}
+	//as OBJ_FileLoader, omit the last mesh if it has no faces:
+	if(entry.n_faces > 0) {
+		entry.name = group_name;
+		entry.size = size - entry.offset;
+		entries->push_back(entry);
+	}
+}
+
+OBJ_MeshIndex::OBJ_MeshIndex()
+	:m_file_size(0), m_file_time(0)
+{
+	m_file_hash.low = m_file_hash.high = 0;
+}
+
+void OBJ_MeshIndex::Build(char const* fname)
+{
+	unsigned long long file_size;
+	long long file_time;
+	get_file_status(fname, &file_size, &file_time);
+	MappedFile file(fname);
+	std::vector<Entry> entries;
+	index_meshes(reinterpret_cast<char const*>(file.GetData()), file.GetSize(), &entries);
+	m_fname = fname;
+	m_file_size = file.GetSize();
+	m_file_time = file_time;
+	m_file_hash = hash_file_ends(file.GetData(), file.GetSize());
+	m_entries.swap(entries);
+}
+
+bool OBJ_MeshIndex::ReadSidecar(char const* fname)
+{
+	unsigned long long file_size;
+	long long file_time;
+	get_file_status(fname, &file_size, &file_time);
+	std::ifstream fin((std::string(fname) + INDEX_SIDECAR_SUFFIX).c_str(), std::ios_base::in | std::ios_base::binary);
+	if(!fin) { return false; }
+	std::string magic, hash;
+	int version = 0;
+	unsigned long long size = 0;
+	long long time = 0;
+	size_t n_entries = 0;
+	fin >> magic >> version >> size >> time >> hash >> n_entries;
+	if( fin.fail() || (magic != INDEX_SIDECAR_MAGIC) || (version != INDEX_SIDECAR_VERSION) ||
+		(size != file_size) || (time != file_time) || (n_entries > file_size) ) {
+		return false;
+	}
+	std::vector<Entry> entries(n_entries);
+	for(size_t i=0; i<n_entries; i++) {
+		Entry& e = entries[i];
+		fin >> e.offset >> e.size >> e.n_vertices >> e.n_normals >> e.n_texture >> e.n_faces
+		    >> e.vert_base >> e.normal_base >> e.texture_base >> e.smoothing_group;
+		fin.get();
+		std::getline(fin, e.name);
+		if(fin.fail() || (e.offset > file_size) || (e.size > file_size - e.offset)) { return false; }
+	}
+	//the hash is checked last, as it is the only check that reads the obj file:
+	MappedFile file(fname);
+	if( (file.GetSize() != file_size) ||
+		(ContentHash::ToString(hash_file_ends(file.GetData(), file.GetSize())) != hash) ) {
+		return false;
+	}
+	m_fname = fname;
+	m_file_size = file_size;
+	m_file_time = file_time;
+	m_file_hash = hash_file_ends(file.GetData(), file.GetSize());
+	m_entries.swap(entries);
+	return true;
+}
+
+void OBJ_MeshIndex::WriteSidecar() const
+{
+	if(m_fname.empty()) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_INVALIDCONTEXT, "No file was indexed" ) );
+	}
+	std::ofstream fout((m_fname + INDEX_SIDECAR_SUFFIX).c_str(), std::ios_base::out | std::ios_base::binary);
+	if(fout.fail()) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not open file for writing" ) );
+	}
+	fout << INDEX_SIDECAR_MAGIC << ' ' << INDEX_SIDECAR_VERSION << '\n'
+	     << m_file_size << ' ' << m_file_time << ' ' << ContentHash::ToString(m_file_hash) << '\n'
+	     << m_entries.size() << '\n';
+	for(std::vector<Entry>::const_iterator it = m_entries.begin(); it != m_entries.end(); ++it) {
+		fout << it->offset << ' ' << it->size << ' ' << it->n_vertices << ' ' << it->n_normals << ' '
+		     << it->n_texture << ' ' << it->n_faces << ' ' << it->vert_base << ' ' << it->normal_base << ' '
+		     << it->texture_base << ' ' << it->smoothing_group << ' ' << it->name << '\n';
+	}
+	fout.close();
+	if(fout.fail()) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not write file" ) );
+	}
+}
+
+char const* OBJ_MeshIndex::GetFileName() const {
+	return m_fname.c_str();
+}
+
+int OBJ_MeshIndex::GetNMeshes() const {
+	return static_cast<int>(m_entries.size());
+}
+
+OBJ_MeshIndex::Entry const& OBJ_MeshIndex::GetEntry(int index) const {
+	if((index < 0) || (index >= GetNMeshes())) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER ) );
+	}
+	return m_entries[index];
+}
+
+OBJ_Mesh* OBJ_MeshIndex::LoadMesh(int index) const
+{
+	Entry const& entry = GetEntry(index);
+	MappedFile file(m_fname.c_str());
+	if(file.GetSize() != m_file_size) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "The file does not match the index" ) );
+	}
+	//parse the lines of the mesh, starting from the parser state at the start of the mesh:
+	OBJ_ParseState state;
+	state.vert_counter = state.vert_base = entry.vert_base;
+	state.normal_counter = state.normal_base = entry.normal_base;
+	state.texture_counter = state.texture_base = entry.texture_base;
+	state.group_name = entry.name;
+	state.new_group_was_opened = false;
+	state.smoothing_group = entry.smoothing_group;
+	char const* begin = reinterpret_cast<char const*>(file.GetData()) + entry.offset;
+	std::deque<OBJ_MeshPiece> pieces;
+	parse_chunk(begin, begin + entry.size, &state, &pieces);
+	OBJ_MeshPiece& piece = pieces.front();
+	if( (pieces.size() != 1) || (state.vert_counter != entry.vert_base + entry.n_vertices) ||
+		(state.normal_counter != entry.normal_base + entry.n_normals) ||
+		(state.texture_counter != entry.texture_base + entry.n_texture) ||
+		(piece.faces.size() != static_cast<size_t>(entry.n_faces)) ) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "The file does not match the index" ) );
+	}
+	OBJ_Mesh* mesh = new OBJ_Mesh(entry.name.c_str());
+	try {
+		OBJ_FileLoader::FinishMesh(mesh, piece.geometry, piece.normals, piece.texcoords, piece.faces);
+	} catch(...) {
 		delete mesh;
+		throw;
+	}
+	return mesh;
+}
+
+/** Header of a binary mesh file
+ */
+typedef struct OBJ_BinaryHeader_t {
+	char magic[8];									///< BINARY_MAGIC
+	unsigned int byte_order;						///< BINARY_BYTE_ORDER, as stored by the writing host
+	unsigned int version;							///< BINARY_VERSION
+	unsigned int n_meshes;							///< number of entries in the mesh table following the header
+	unsigned int reserved;							///< always 0
+	unsigned long long file_size;					///< size of the binary mesh file in bytes
+	unsigned long long source_size;					///< size of the cached obj file in bytes (0 if none)
+	long long source_time;							///< modification time of the cached obj file (0 if none)
+	unsigned long long source_hash_low;				///< hash of the start and end of the cached obj file (0 if none)
+	unsigned long long source_hash_high;			///< (upper 64 bits)
+} OBJ_BinaryHeader;
+
+/** Entry of the mesh table of a binary mesh file
+ * @note Offsets are relative to the start of the file and multiples of BINARY_ALIGNMENT.
+ */
+typedef struct OBJ_BinaryMesh_t {
+	unsigned long long name_offset;					///< offset of the null-terminated name
+	unsigned long long geometry_offset;				///< offset of the geometry data
+	unsigned long long normals_offset;				///< offset of the normal data
+	unsigned long long texcoords_offset;			///< offset of the texture data
+	unsigned long long faces_offset;				///< offset of the face data
+	unsigned int name_length;						///< length of the name without the terminating 0
+	unsigned int n_geometry;						///< number of doubles of geometry data
+	unsigned int n_normals;							///< number of doubles of normal data
+	unsigned int n_texcoords;						///< number of doubles of texture data
+	unsigned int n_faces;							///< number of faces
+	unsigned int reserved;							///< always 0
+} OBJ_BinaryMesh;
+
+/** Helper function: rounds an offset in a binary mesh file up to the next multiple of BINARY_ALIGNMENT
+ */
+inline unsigned long long align_binary_offset(unsigned long long offset) {
+	return (offset + BINARY_ALIGNMENT - 1) & ~static_cast<unsigned long long>(BINARY_ALIGNMENT - 1);
+}
+
+/** Helper function: writes a field to a binary mesh file at the given offset, padding the gap with zeros
+ * @param[in,out] position Number of bytes written so far; receives the position after the field
+ */
+static void write_binary_field(std::ofstream& fout, unsigned long long* position, unsigned long long offset,
+                               void const* data, size_t size)
+{
+	static char const zeros[BINARY_ALIGNMENT] = { 0 };
+	fout.write(zeros, static_cast<std::streamsize>(offset - *position));
+	if(size > 0) {
+		fout.write(static_cast<char const*>(data), static_cast<std::streamsize>(size));
+	}
+	*position = offset + size;
+}
+
+/** Helper function: checks whether a field lies within a binary mesh file and is aligned
+ */
+static bool is_binary_field(unsigned long long offset, unsigned long long count, size_t element_size,
+                            unsigned long long file_size)
+{
+	return (offset % BINARY_ALIGNMENT == 0) && (offset <= file_size) && (count <= (file_size - offset) / element_size);
+}
+
+/** Helper function: checks whether all indices of the faces of a mesh are valid
+ */
+static bool has_valid_indices(OBJ_Mesh::Face const* faces, unsigned int n_faces, unsigned int n_geometry,
+                              unsigned int n_normals, unsigned int n_texcoords)
+{
+	for(unsigned int i=0; i<n_faces; i++) {
+		OBJ_Mesh::Face const& f = faces[i];
+		if( (static_cast<unsigned int>(f.vert1) >= n_geometry / 3) || (static_cast<unsigned int>(f.vert2) >= n_geometry / 3) ||
+			(static_cast<unsigned int>(f.vert3) >= n_geometry / 3) || (static_cast<unsigned int>(f.normal1) >= n_normals / 3) ||
+			(static_cast<unsigned int>(f.normal2) >= n_normals / 3) || (static_cast<unsigned int>(f.normal3) >= n_normals / 3) ||
+			(static_cast<unsigned int>(f.texture1) >= n_texcoords / 3) || (static_cast<unsigned int>(f.texture2) >= n_texcoords / 3) ||
+			(static_cast<unsigned int>(f.texture3) >= n_texcoords / 3) )
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void OBJ_FileLoader::WriteBinaryFile(char const* fname) const {
+	WriteBinary(fname, NULL);
+}
+
+void OBJ_FileLoader::WriteBinaryFile(char const* fname, char const* source) const {
+	WriteBinary(fname, source);
+}
+
+void OBJ_FileLoader::WriteBinary(char const* fname, char const* source) const
+{
+	OBJ_BinaryHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BINARY_MAGIC, sizeof(header.magic));
+	header.byte_order = BINARY_BYTE_ORDER;
+	header.version = BINARY_VERSION;
+	header.n_meshes = static_cast<unsigned int>(m_MeshList.size());
+	if(source) {
+		get_file_status(source, &header.source_size, &header.source_time);
+		MappedFile file(source);
+		ContentHash::Hash128 const hash = hash_file_ends(file.GetData(), file.GetSize());
+		header.source_size = file.GetSize();
+		header.source_hash_low = hash.low;
+		header.source_hash_high = hash.high;
+	}
+
+	//lay out the fields of all meshes behind the mesh table:
+	std::vector<OBJ_BinaryMesh> table(m_MeshList.size());
+	unsigned long long offset = sizeof(OBJ_BinaryHeader) + table.size() * sizeof(OBJ_BinaryMesh);
+	for(size_t i=0; i<m_MeshList.size(); i++) {
+		OBJ_Mesh const* mesh = m_MeshList[i];
+		OBJ_BinaryMesh& entry = table[i];
+		memset(&entry, 0, sizeof(entry));
+		entry.name_length = static_cast<unsigned int>(strlen(mesh->m_name));
+		entry.n_geometry  = static_cast<unsigned int>(mesh->m_geometry.size());
+		entry.n_normals   = static_cast<unsigned int>(mesh->m_normals.size());
+		entry.n_texcoords = static_cast<unsigned int>(mesh->m_texcoords.size());
+		entry.n_faces     = static_cast<unsigned int>(mesh->m_faces.size());
+		entry.name_offset = align_binary_offset(offset);
+		entry.geometry_offset  = align_binary_offset(entry.name_offset + entry.name_length + 1);
+		entry.normals_offset   = align_binary_offset(entry.geometry_offset + entry.n_geometry * sizeof(double));
+		entry.texcoords_offset = align_binary_offset(entry.normals_offset + entry.n_normals * sizeof(double));
+		entry.faces_offset     = align_binary_offset(entry.texcoords_offset + entry.n_texcoords * sizeof(double));
+		offset = entry.faces_offset + entry.n_faces * sizeof(OBJ_Mesh::Face);
+	}
+	header.file_size = offset;
+
+	std::ofstream fout(fname, std::ios_base::out | std::ios_base::binary);
+	if(fout.fail()) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not open file for writing" ) );
+	}
+	unsigned long long position = 0;
+	write_binary_field(fout, &position, 0, &header, sizeof(header));
+	if(!table.empty()) {
+		write_binary_field(fout, &position, position, &table[0], table.size() * sizeof(OBJ_BinaryMesh));
+	}
+	for(size_t i=0; i<m_MeshList.size(); i++) {
+		OBJ_Mesh const* mesh = m_MeshList[i];
+		OBJ_BinaryMesh const& entry = table[i];
+		write_binary_field(fout, &position, entry.name_offset, mesh->m_name, entry.name_length + 1);
+		write_binary_field(fout, &position, entry.geometry_offset, mesh->m_geometry.empty() ? NULL : &mesh->m_geometry[0],
+		                   entry.n_geometry * sizeof(double));
+		write_binary_field(fout, &position, entry.normals_offset, mesh->m_normals.empty() ? NULL : &mesh->m_normals[0],
+		                   entry.n_normals * sizeof(double));
+		write_binary_field(fout, &position, entry.texcoords_offset, mesh->m_texcoords.empty() ? NULL : &mesh->m_texcoords[0],
+		                   entry.n_texcoords * sizeof(double));
+		write_binary_field(fout, &position, entry.faces_offset, mesh->m_faces.empty() ? NULL : &mesh->m_faces[0],
+		                   entry.n_faces * sizeof(OBJ_Mesh::Face));
+	}
+	fout.close();
+	if(fout.fail()) {
+		remove(fname);
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not write file" ) );
+	}
+}
+
+void OBJ_FileLoader::ReadBinaryFile(char const* fname)
+{
+	if(m_MeshList.size() > 0) { 
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_INVALIDCONTEXT,
+			                         "The mesh list is not empty" ) );
+	}
+	MappedFile file(fname);
+	ReadBinaryData(file.GetData(), file.GetSize());
+}
+
+bool OBJ_FileLoader::ReadBinaryFile(char const* fname, char const* source)
+{
+	if(m_MeshList.size() > 0) { 
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_INVALIDCONTEXT,
+			                         "The mesh list is not empty" ) );
+	}
+	unsigned long long source_size;
+	long long source_time;
+	get_file_status(source, &source_size, &source_time);
+	try {
+		MappedFile file(fname);
+		OBJ_BinaryHeader header;
+		if(file.GetSize() < sizeof(header)) { return false; }
+		memcpy(&header, file.GetData(), sizeof(header));
+		if((header.source_size != source_size) || (header.source_time != source_time)) { return false; }
+		MappedFile source_file(source);
+		ContentHash::Hash128 const hash = hash_file_ends(source_file.GetData(), source_file.GetSize());
+		if( (source_file.GetSize() != source_size) || (header.source_hash_low != hash.low) ||
+			(header.source_hash_high != hash.high) ) {
+			return false;
+		}
+		ReadBinaryData(file.GetData(), file.GetSize());
+	} catch( Ghulbus::gbException& ) {
+		//a missing or invalid binary mesh file is simply out of date:
+		return false;
+	}
+	return true;
+}
+
+void OBJ_FileLoader::ReadBinaryData(unsigned char const* data, size_t size)
+{
+	OBJ_BinaryHeader header;
+	if(size < sizeof(header)) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "No valid binary mesh file" ) );
+	}
+	memcpy(&header, data, sizeof(header));
+	if( (memcmp(header.magic, BINARY_MAGIC, sizeof(header.magic)) != 0) || (header.byte_order != BINARY_BYTE_ORDER) ||
+		(header.version != BINARY_VERSION) || (header.file_size != size) ||
+		!is_binary_field(sizeof(header), header.n_meshes, sizeof(OBJ_BinaryMesh), size) )
+	{
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "No valid binary mesh file" ) );
+	}
+	OBJ_BinaryMesh const* table = reinterpret_cast<OBJ_BinaryMesh const*>(data + sizeof(header));
+	try {
+		for(unsigned int i=0; i<header.n_meshes; i++) {
+			OBJ_BinaryMesh const& entry = table[i];
+			if( !is_binary_field(entry.name_offset, entry.name_length + 1ULL, 1, size) ||
+				(data[entry.name_offset + entry.name_length] != '\0') ||
+				!is_binary_field(entry.geometry_offset, entry.n_geometry, sizeof(double), size) ||
+				!is_binary_field(entry.normals_offset, entry.n_normals, sizeof(double), size) ||
+				!is_binary_field(entry.texcoords_offset, entry.n_texcoords, sizeof(double), size) ||
+				!is_binary_field(entry.faces_offset, entry.n_faces, sizeof(OBJ_Mesh::Face), size) )
+			{
+				throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "No valid binary mesh file" ) );
+			}
+			double const* geometry  = reinterpret_cast<double const*>(data + entry.geometry_offset);
+			double const* normals   = reinterpret_cast<double const*>(data + entry.normals_offset);
+			double const* texcoords = reinterpret_cast<double const*>(data + entry.texcoords_offset);
+			OBJ_Mesh::Face const* faces = reinterpret_cast<OBJ_Mesh::Face const*>(data + entry.faces_offset);
+			if(!has_valid_indices(faces, entry.n_faces, entry.n_geometry, entry.n_normals, entry.n_texcoords)) {
+				throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Face index out of range" ) );
+			}
+			OBJ_Mesh* mesh = new OBJ_Mesh(reinterpret_cast<char const*>(data + entry.name_offset));
+			m_MeshList.push_back(mesh);
+			mesh->m_geometry.assign(geometry, geometry + entry.n_geometry);
+			mesh->m_normals.assign(normals, normals + entry.n_normals);
+			mesh->m_texcoords.assign(texcoords, texcoords + entry.n_texcoords);
+			mesh->m_faces.assign(faces, faces + entry.n_faces);
+		}
+	} catch(...) {
+		for(std::vector<OBJ_Mesh*>::iterator i = m_MeshList.begin(); i != m_MeshList.end(); ++i) {
+			delete *i;
+		}
+		m_MeshList.clear();
+		throw;
 	}
 }
 
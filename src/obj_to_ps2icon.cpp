@@ -4,8 +4,10 @@
  * @brief A tool for converting Wavefront OBJ to PS2 Iconsbuild_header/
  */
 #include <iostream>
+#include <string>
 #include "../include/ps2_ps2icon.hpp"
 #include "../include/obj_loader.hpp"
+#include "../include/conversion_cache.hpp"
 #include "../gbLib/include/gbException.hpp"
 #include "../gbLib/include/gbImageLoader.hpp"
 
@@ -16,6 +18,13 @@ char const* texture_input_file = NULL;		///< path to the texture file (tga or bm
 bool verbose_output            = false;		///< flag for verbose output
 bool list_obj_file             = false;		///< flag for obj content listing
 float obj_scale_factor         = 0.0f;		///< geometric scale factor for conversion
+PS2Icon::TextureEncoding texture_encoding = PS2Icon::TEXTURE_RAW;	///< encoding of the output texture
+char const* cache_directory    = NULL;		///< path to the conversion cache (NULL = no caching)
+int cache_size                 = 256;		///< size limit of the conversion cache in MB
+bool cache_hard_links          = false;		///< flag for hard linking outputs from the cache
+bool use_mesh_index            = false;		///< flag for using the mesh index sidecar file of the obj file
+bool use_binary_cache          = false;		///< flag for using the binary mesh file of the obj file
+int n_threads                  = 0;			///< number of threads for parsing the obj file for listing (0 = one per processor)
 
 /** Print a help text on screen
  * @param[in] self Name of the executable (e.g. obtained from argv[0])
@@ -36,8 +45,18 @@ void PrintHelp(char* self)
 			  << "  -t, --input-texture  Texture file used as input (must be BMP or TGA)" << "\n"
 			  << "  -m, --mesh-index     Index of the OBJ mesh to use (0-based)"          << "\n"
 			  << "  -s, --scale-factor   Scale factor that is applied to geometry"        << "\n"
+			  << "  -e, --texture-encoding  Texture encoding: raw (default), rle or auto" << "\n"
 			  << "  -v, --verbose        activate verbose output"                         << "\n"
 			  << "  -l, --list-obj-file  list the meshes contained in input"              << "\n"
+			  << "  -c, --cache-dir      Directory of the conversion cache"               << "\n"
+			  << "  -cs, --cache-size    Size limit of the conversion cache in MB (256)"  << "\n"
+			  << "  -cl, --cache-links   Hard link outputs from the cache instead of copying" << "\n"
+			  << "  -j,  --threads       Threads for parsing the OBJ file with -l (one per processor)" << "\n"
+			  << "  -i,  --index         Use the mesh index <input-file>.idx; it is created or"   << "\n"
+			  << "                       updated if it does not match the OBJ file"            << "\n"
+			  << "  -b,  --binary-cache  Load the meshes from the binary mesh file"            << "\n"
+			  << "                       <input-file>.mesh; it is created or updated if it"    << "\n"
+			  << "                       does not match the OBJ file"                          << "\n"
 			  << "\n"
 			  << " Examples:"                                                              << "\n"
 			  << "  " << self << " -f foo.obj"                                            << "\n"
@@ -49,8 +68,22 @@ void PrintHelp(char* self)
 			  << "using the image from bar.tga as a texture and scaling the geometry"     << "\n"
 			  << "to half the size before writing."                                       << "\n"
 			  << "\n"
+			  << "  " << self << " -f foo.obj -t bar.tga -e auto"                         << "\n"
+			  << "Converts the first mesh in file foo.obj to an icon file default.icn"    << "\n"
+			  << "using the image from bar.tga as a texture, which is rle encoded if"     << "\n"
+			  << "that results in a smaller file."                                        << "\n"
+			  << "\n"
 			  << "  " << self << " -f foo.obj -l"                                         << "\n"
 			  << "Prints a list of all meshes in foo.obj. No files are written."          << "\n"
+			  << "\n"
+			  << "  " << self << " -f foo.obj -l -i"                                      << "\n"
+			  << "Prints a list of all meshes in foo.obj from its mesh index foo.obj.idx,"  << "\n"
+			  << "which is created first if needed. Converting with -m and -i reads only"  << "\n"
+			  << "the lines of the chosen mesh."                                            << "\n"
+			  << "\n"
+			  << "  " << self << " -f foo.obj -t bar.tga -o out.icn -c cache"             << "\n"
+			  << "Converts as above, unless the same conversion of the same foo.obj and"  << "\n"
+			  << "bar.tga is found in the directory cache; then out.icn is copied from there." << "\n"
 			  << std::endl;
 }
 
@@ -69,6 +102,12 @@ void ParseCommandLine(int argc, char* argv[])
 			list_obj_file = true;
 		} else if( (strcmp( argv[i], "-v" ) == 0) || (strcmp( argv[i], "--verbose" ) == 0) ) {
 			verbose_output = true;
+		} else if( (strcmp( argv[i], "-cl" ) == 0) || (strcmp( argv[i], "--cache-links" ) == 0) ) {
+			cache_hard_links = true;
+		} else if( (strcmp( argv[i], "-i" ) == 0) || (strcmp( argv[i], "--index" ) == 0) ) {
+			use_mesh_index = true;
+		} else if( (strcmp( argv[i], "-b" ) == 0) || (strcmp( argv[i], "--binary-cache" ) == 0) ) {
+			use_binary_cache = true;
 		} else if(i < argc-1) {
 		//Parameters with 1 argument
 			if( (strcmp( argv[i], "-f" ) == 0) || (strcmp( argv[i], "--input-file" ) == 0) ) {
@@ -81,6 +120,35 @@ void ParseCommandLine(int argc, char* argv[])
 				obj_mesh_index = atoi(argv[++i]);
 			} else if( (strcmp( argv[i], "-s" ) == 0) || (strcmp( argv[i], "--scale-factor" ) == 0) ) {
 				obj_scale_factor = static_cast<float>(atof(argv[++i]));
+			} else if( (strcmp( argv[i], "-c" ) == 0) || (strcmp( argv[i], "--cache-dir" ) == 0) ) {
+				cache_directory = argv[++i];
+			} else if( (strcmp( argv[i], "-cs" ) == 0) || (strcmp( argv[i], "--cache-size" ) == 0) ) {
+				cache_size = atoi(argv[++i]);
+				if(cache_size <= 0) {
+					std::cout << "Invalid cache size." << std::endl << std::endl;
+					PrintHelp(argv[0]);
+					exit(1);
+				}
+			} else if( (strcmp( argv[i], "-j" ) == 0) || (strcmp( argv[i], "--threads" ) == 0) ) {
+				n_threads = atoi(argv[++i]);
+				if(n_threads < 0) {
+					std::cout << "Invalid number of threads." << std::endl << std::endl;
+					PrintHelp(argv[0]);
+					exit(1);
+				}
+			} else if( (strcmp( argv[i], "-e" ) == 0) || (strcmp( argv[i], "--texture-encoding" ) == 0) ) {
+				++i;
+				if(strcmp( argv[i], "raw" ) == 0) {
+					texture_encoding = PS2Icon::TEXTURE_RAW;
+				} else if(strcmp( argv[i], "rle" ) == 0) {
+					texture_encoding = PS2Icon::TEXTURE_RLE;
+				} else if(strcmp( argv[i], "auto" ) == 0) {
+					texture_encoding = PS2Icon::TEXTURE_AUTO;
+				} else {
+					std::cout << "Invalid texture encoding \"" << argv[i] << "\"." << std::endl << std::endl;
+					PrintHelp(argv[0]);
+					exit(1);
+				}
 			} else {
 				std::cout << "Invalid argument." << std::endl << std::endl;
 				PrintHelp(argv[0]);
@@ -99,22 +167,124 @@ void ParseCommandLine(int argc, char* argv[])
 OBJ_FileLoader* LoadOBJFile()
 {
 	OBJ_FileLoader* ret = NULL;
+	std::string const binary_file = std::string(obj_input_file) + ".mesh";
+	if(use_binary_cache) {
+		ret = new OBJ_FileLoader();
+		try {
+			if(ret->ReadBinaryFile(binary_file.c_str(), obj_input_file)) {
+				if(verbose_output)
+					std::cout << " * Meshes taken from binary mesh file \"" << binary_file << "\"." << std::endl;
+			} else {
+				delete ret;
+				ret = NULL;
+			}
+		} catch(Ghulbus::gbException const&) {
+			std::cout << "File read error: \"" << obj_input_file << "\"" << std::endl;
+			exit(1);
+		}
+	}
+	if(!ret) {
+		if(verbose_output)
+			std::cout << " * Reading OBJ file \"" << obj_input_file << "\"...";
+		try {
+			ret = new OBJ_FileLoader(obj_input_file, n_threads);
+		} catch(Ghulbus::gbException const&) {
+			std::cout << "\nFile read error: \"" << obj_input_file << "\"" << std::endl;
+			exit(1);
+		}
+		if(verbose_output)
+			std::cout << "done." << std::endl;
+		if(use_binary_cache) {
+			try {
+				ret->WriteBinaryFile(binary_file.c_str(), obj_input_file);
+			} catch(Ghulbus::gbException const&) {
+				std::cout << "Warning: could not write the binary mesh file \"" << binary_file << "\"" << std::endl;
+			}
+		}
+	}
+
+	if(obj_mesh_index >= ret->GetNMeshes()) {
+		std::cout << "Invalid mesh index. Index given: " << obj_mesh_index << "; Maximum allowed for \"" 
+			<< obj_input_file << "\": " << (ret->GetNMeshes() - 1) << std::endl;
+		exit(1);
+	}
+	return ret;
+}
+
+/** Load the requested mesh from the obj file, reading the file only up to that mesh
+ */
+OBJ_Mesh* LoadOBJMesh()
+{
+	OBJ_Mesh* ret = NULL;
+	int n_meshes = 0;
 	if(verbose_output)
-		std::cout << " * Reading OBJ file \"" << obj_input_file << "\"...";
+		std::cout << " * Reading mesh #" << obj_mesh_index << " from OBJ file \"" << obj_input_file << "\"...";
 	try {
-		ret = new OBJ_FileLoader(obj_input_file);
-	} catch(Ghulbus::gbException e) {
+		ret = OBJ_FileLoader::LoadMesh(obj_input_file, obj_mesh_index, &n_meshes);
+	} catch(Ghulbus::gbException const&) {
 		std::cout << "\nFile read error: \"" << obj_input_file << "\"" << std::endl;
 		exit(1);
 	}
 	if(verbose_output)
 		std::cout << "done." << std::endl;
 
-	if(obj_mesh_index >= ret->GetNMeshes()) {
+	if(!ret) {
 		std::cout << "Invalid mesh index. Index given: " << obj_mesh_index << "; Maximum allowed for \"" 
-			<< obj_input_file << "\": " << (ret->GetNMeshes() - 1) << std::endl;
+			<< obj_input_file << "\": " << (n_meshes - 1) << std::endl;
+		exit(1);
+	}
+	return ret;
+}
+
+/** Get the mesh index of the obj file, from its sidecar file if that is up to date
+ */
+OBJ_MeshIndex* LoadOBJIndex()
+{
+	OBJ_MeshIndex* ret = new OBJ_MeshIndex();
+	try {
+		if(ret->ReadSidecar(obj_input_file)) {
+			if(verbose_output)
+				std::cout << " * Mesh index of \"" << obj_input_file << "\" is up to date." << std::endl;
+			return ret;
+		}
+		if(verbose_output)
+			std::cout << " * Indexing OBJ file \"" << obj_input_file << "\"...";
+		ret->Build(obj_input_file);
+		if(verbose_output)
+			std::cout << "done." << std::endl;
+	} catch(Ghulbus::gbException const&) {
+		std::cout << "\nFile read error: \"" << obj_input_file << "\"" << std::endl;
 		exit(1);
 	}
+	try {
+		ret->WriteSidecar();
+	} catch(Ghulbus::gbException const&) {
+		std::cout << "Warning: could not write the mesh index of \"" << obj_input_file << "\"" << std::endl;
+	}
+	return ret;
+}
+
+/** Load the requested mesh using the mesh index, reading only the lines of that mesh
+ * @param[in] obj_index Index of the obj file
+ */
+OBJ_Mesh* LoadIndexedOBJMesh(OBJ_MeshIndex const* obj_index)
+{
+	if(obj_mesh_index >= obj_index->GetNMeshes()) {
+		std::cout << "Invalid mesh index. Index given: " << obj_mesh_index << "; Maximum allowed for \"" 
+			<< obj_input_file << "\": " << (obj_index->GetNMeshes() - 1) << std::endl;
+		exit(1);
+	}
+	OBJ_Mesh* ret = NULL;
+	if(verbose_output)
+		std::cout << " * Reading mesh #" << obj_mesh_index << " from OBJ file \"" << obj_input_file << "\"...";
+	try {
+		ret = obj_index->LoadMesh(obj_mesh_index);
+	} catch(Ghulbus::gbException const&) {
+		std::cout << "\nFile read error: \"" << obj_input_file << "\"" << std::endl;
+		exit(1);
+	}
+	if(verbose_output)
+		std::cout << "done." << std::endl;
 	return ret;
 }
 
@@ -133,6 +303,21 @@ void ListOBJFile(OBJ_FileLoader const* obj_file)
 	std::cout << " *  done." << std::endl;
 }
 
+/** Print a list of all meshes contained in an obj file from its mesh index
+ * @param[in] obj_index Index of the file to list
+ */
+void ListOBJIndex(OBJ_MeshIndex const* obj_index)
+{
+	std::cout << " * Listing OBJ file \"" << obj_input_file << "\" contents from its mesh index...\n";
+	std::cout << " **  Found " << obj_index->GetNMeshes() << " meshes: " << std::endl;
+	for(int i=0; i<obj_index->GetNMeshes(); ++i) {
+		OBJ_MeshIndex::Entry const& tmp = obj_index->GetEntry(i);
+		std::cout << " **   #" << i << ": " << tmp.name << " - " 
+			<< tmp.n_faces << " Triangles, " << tmp.n_vertices << " Vertices\n";
+	}
+	std::cout << " *  done." << std::endl;
+}
+
 /** Helper function: Is f a path to a BMP file?
  */
 bool IsBMP(char const* f)
@@ -179,7 +364,7 @@ GhulbusUtil::gbImageLoader* LoadTexture()
 
 /** Write a PS2Icon file
  */
-void WriteOutputFile(OBJ_FileLoader const* obj_file, GhulbusUtil::gbImageLoader* img_loader)
+void WriteOutputFile(OBJ_Mesh const* obj_mesh, GhulbusUtil::gbImageLoader* img_loader)
 {
 	PS2Icon ps2_icon;
 	if(img_loader) {
@@ -190,22 +375,23 @@ void WriteOutputFile(OBJ_FileLoader const* obj_file, GhulbusUtil::gbImageLoader*
 		img_loader->GetImageData32(tmp);
 		ps2_icon.SetTextureData(tmp);
 		delete[] tmp;
-		if(verbose_output)
+		if(verbose_output) {
 			std::cout << "done." << std::endl;
+			std::cout << "    Texture rle compression ratio is " << ps2_icon.GetTextureCompressionRatio() << std::endl;
+		}
 	}
-	OBJ_Mesh const* tmp = obj_file->GetMesh(obj_mesh_index);
 	if(verbose_output)
 		std::cout << " * Copying geometry data from \"" << obj_input_file << "\": Mesh #" << obj_mesh_index
-			<< " - " << tmp->GetName() << "...";
+			<< " - " << obj_mesh->GetName() << "...";
 	if(obj_scale_factor != 0.0f) {
 		if(verbose_output)
 			std::cout << "\n    Scale factor is " << obj_scale_factor << " ...";
 		if(obj_scale_factor < 0.0f) {
 			std::cout << "\n!WARNING! Scale factor is negative.\n    ";
 		}
-		ps2_icon.SetGeometry(*tmp, obj_scale_factor);
+		ps2_icon.SetGeometry(*obj_mesh, obj_scale_factor);
 	} else {
-		ps2_icon.SetGeometry(*tmp);
+		ps2_icon.SetGeometry(*obj_mesh);
 	}
 	if(verbose_output)
 		std::cout << "done." << std::endl;
@@ -213,7 +399,7 @@ void WriteOutputFile(OBJ_FileLoader const* obj_file, GhulbusUtil::gbImageLoader*
 	if(verbose_output)
 		std::cout << " * Writing output to \"" << ps2_output_file << "\"...";
 	try {
-		ps2_icon.WriteFile(ps2_output_file);
+		ps2_icon.WriteFile(ps2_output_file, texture_encoding);
 	} catch(Ghulbus::gbException e) {
 		std::cout << "\nError while writing to \"" << ps2_output_file << "\"" << std::endl;
 		exit(1);
@@ -222,6 +408,32 @@ void WriteOutputFile(OBJ_FileLoader const* obj_file, GhulbusUtil::gbImageLoader*
 		std::cout << "done." << std::endl;
 }
 
+/** Open the conversion cache and build the key of the requested conversion
+ * @param[out] key Receives the key
+ * @return The cache; NULL if it can not be used, in which case the conversion is done uncached
+ */
+ConversionCache* OpenCache(ConversionCache::Key* key)
+{
+	ConversionCache* ret = NULL;
+	try {
+		ret = new ConversionCache(cache_directory, static_cast<unsigned long long>(cache_size) << 20);
+		ret->SetHardLinks(cache_hard_links);
+		key->AddFile(obj_input_file);
+		key->AddInt(obj_mesh_index);
+		key->AddFloat(obj_scale_factor);
+		key->AddInt(texture_encoding);
+		key->AddInt(texture_input_file ? 1 : 0);
+		if(texture_input_file) { key->AddFile(texture_input_file); }
+	} catch( Ghulbus::gbException& ) {
+		//missing input files are reported by the conversion itself:
+		if(verbose_output)
+			std::cout << " * Conversion cache \"" << cache_directory << "\" not used." << std::endl;
+		delete ret;
+		return NULL;
+	}
+	return ret;
+}
+
 int main(int argc, char* argv[])
 {
 	ParseCommandLine(argc, argv);
@@ -234,10 +446,51 @@ int main(int argc, char* argv[])
 	std::cout << "OBJ to PS2Icon Converter  V-1.0\n by Ghulbus Inc.  (http://www.ghulbus-inc.de/)\n" << std::endl;
 	if((!list_obj_file) && (!ps2_output_file)) { ps2_output_file = "default.icn"; }
 
-	OBJ_FileLoader* obj_file = LoadOBJFile();
+	ConversionCache* cache = NULL;
+	ConversionCache::Key cache_key("obj_to_ps2icon/1");
+	if(cache_directory && ps2_output_file) {
+		cache = OpenCache(&cache_key);
+	}
+	if(cache && !list_obj_file) {
+		bool hit = false;
+		try {
+			hit = cache->Retrieve(cache_key, &ps2_output_file, 1);
+		} catch( Ghulbus::gbException& ) {
+			std::cout << "Error while writing to \"" << ps2_output_file << "\"" << std::endl;
+			exit(1);
+		}
+		if(hit) {
+			if(verbose_output)
+				std::cout << " * Output \"" << ps2_output_file << "\" taken from the conversion cache." << std::endl;
+			delete cache;
+			std::cout << "Success :)" << std::endl;
+			return 0;
+		}
+	}
 
-	if(list_obj_file) {
+	//listing needs all meshes; a conversion reads the file only up to the requested mesh,
+	//or with the mesh index only the lines of that mesh; the binary mesh file holds all meshes:
+	OBJ_FileLoader* obj_file = NULL;
+	OBJ_MeshIndex* obj_index = NULL;
+	OBJ_Mesh* obj_mesh = NULL;
+	if(use_binary_cache) {
+		obj_file = LoadOBJFile();
+		if(list_obj_file) {
+			ListOBJFile(obj_file);
+		}
+	} else if(use_mesh_index) {
+		obj_index = LoadOBJIndex();
+		if(list_obj_file) {
+			ListOBJIndex(obj_index);
+		}
+		if(ps2_output_file) {
+			obj_mesh = LoadIndexedOBJMesh(obj_index);
+		}
+	} else if(list_obj_file) {
+		obj_file = LoadOBJFile();
 		ListOBJFile(obj_file);
+	} else {
+		obj_mesh = LoadOBJMesh();
 	}
 
 	GhulbusUtil::gbImageLoader* img_loader = NULL;
@@ -246,11 +499,25 @@ int main(int argc, char* argv[])
 	}
 	
 	if(ps2_output_file) {
-		WriteOutputFile(obj_file, img_loader);
+		if(cache) {
+			//the old output may be hard linked to the cache and must not be written through:
+			remove(ps2_output_file);
+		}
+		WriteOutputFile(obj_file ? obj_file->GetMesh(obj_mesh_index) : obj_mesh, img_loader);
+		if(cache) {
+			try {
+				cache->Store(cache_key, &ps2_output_file, 1);
+			} catch( Ghulbus::gbException& ) {
+				std::cout << "Warning: could not add \"" << ps2_output_file << "\" to the conversion cache" << std::endl;
+			}
+		}
 	}
 
 	delete img_loader;
+	delete obj_mesh;
+	delete obj_index;
 	delete obj_file;
+	delete cache;
 
 	std::cout << "Success :)" << std::endl;
 
@@ -0,0 +1,190 @@
+/**
+ * @file src/ps2_animator.cpp
+ *
+ * @brief Implementation of the IconAnimator classbuild_header/
+ */
+#include "../include/ps2_animator.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#	define PS2_ANIMATOR_SSE2
+#	include <emmintrin.h>
+#endif
+
+/** Helper function: orders keys by time
+ */
+inline bool key_time_less(PS2Icon::Frame_Key const& a, PS2Icon::Frame_Key const& b) {
+	return (a.time < b.time);
+}
+
+/** Helper function: adds a weighted plane to an accumulator plane (dst += w * src)
+ */
+static void blend_plane(float const* src, float w, float* dst, size_t n) {
+	size_t i = 0;
+#ifdef PS2_ANIMATOR_SSE2
+	__m128 const vw = _mm_set1_ps(w);
+	for(; i+8 <= n; i+=8) {
+		__m128 d0 = _mm_add_ps( _mm_loadu_ps(dst + i),     _mm_mul_ps(vw, _mm_loadu_ps(src + i)) );
+		__m128 d1 = _mm_add_ps( _mm_loadu_ps(dst + i + 4), _mm_mul_ps(vw, _mm_loadu_ps(src + i + 4)) );
+		_mm_storeu_ps(dst + i,     d0);
+		_mm_storeu_ps(dst + i + 4, d1);
+	}
+#endif
+	for(; i<n; i++) {
+		dst[i] += w * src[i];
+	}
+}
+
+IconAnimator::IconAnimator(PS2Icon const& icon): m_icon(&icon), m_n_vertices(0), m_n_shapes(0), m_n_frames(0),
+m_loop_length(1), m_anim_speed(1.0f), m_play_offset(0)
+{
+	m_n_vertices  = icon.GetNVertices();
+	m_n_shapes    = icon.GetNShapes();
+	m_n_frames    = icon.GetNFrames();
+	m_loop_length = (icon.GetFrameLength() > 0) ? icon.GetFrameLength() : 1;
+	m_anim_speed  = icon.GetAnimationSpeed();
+	m_play_offset = icon.GetPlayOffset();
+	//the header is read from the file; refuse animations that would take gigabytes to sample:
+	if(m_loop_length > MAX_LOOP_LENGTH) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Animation loop is too long" ) );
+	}
+	if(!(std::fabs(m_anim_speed) <= FLT_MAX)) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Animation speed is not finite" ) );
+	}
+	if( (m_anim_speed > 0.0f) &&
+	    (static_cast<float>(m_loop_length) > m_anim_speed * static_cast<float>(MAX_DISPLAY_FRAMES)) )
+	{
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Animation speed is too slow" ) );
+	}
+
+	//gather the keys of all frames in one field:
+	m_frame_shapes.resize(m_n_frames);
+	m_key_begin.resize(m_n_frames + 1);
+	for(int i=0; i<m_n_frames; i++) {
+		m_frame_shapes[i] = icon.GetFrameShape(i);
+		if(m_frame_shapes[i] >= m_n_shapes) {
+			throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Animation frame references a non-existing shape" ) );
+		}
+		m_key_begin[i] = static_cast<int>(m_keys.size());
+		for(int j=0; j<icon.GetNFrameKeys(i); j++) {
+			PS2Icon::Frame_Key key;
+			key.time  = icon.GetFrameKeyTime(i, j);
+			key.value = icon.GetFrameKeyValue(i, j);
+			m_keys.push_back(key);
+		}
+		std::stable_sort(m_keys.begin() + m_key_begin[i], m_keys.end(), key_time_less);
+	}
+	m_key_begin[m_n_frames] = static_cast<int>(m_keys.size());
+
+	//read the geometry of lazily loaded icons now, so the Evaluate functions only ever read the icon:
+	if(m_n_shapes > 0) {
+		icon.GetShapePlane(0, 0);
+	}
+
+	//lookup table for integral ticks:
+	m_weight_table.resize(static_cast<size_t>(m_loop_length) * m_n_shapes);
+	for(int t=0; t<m_loop_length; t++) {
+		ComputeShapeWeights( static_cast<float>(t), &m_weight_table[0] + static_cast<size_t>(t) * m_n_shapes );
+	}
+}
+
+IconAnimator::~IconAnimator()
+{
+}
+
+int IconAnimator::GetLoopLength() const {
+	return m_loop_length;
+}
+
+int IconAnimator::GetNDisplayFrames() const {
+	if(!(m_anim_speed > 0.0f)) { return 1; }
+	//the constructor ensured that this is at most MAX_DISPLAY_FRAMES:
+	int const n = static_cast<int>( std::ceil(static_cast<float>(m_loop_length) / m_anim_speed) );
+	return (n > 0) ? n : 1;
+}
+
+float IconAnimator::WrapTime(float t) const {
+	float const length = static_cast<float>(m_loop_length);
+	t = std::fmod(t, length);
+	if(t < 0.0f) { t += length; }
+	//fmod may return exactly length for tiny negative inputs:
+	return (t < length) ? t : 0.0f;
+}
+
+float IconAnimator::GetFrameTime(int frame) const {
+	return WrapTime( static_cast<float>(m_play_offset) + static_cast<float>(frame) * m_anim_speed );
+}
+
+void IconAnimator::ComputeShapeWeights(float t, float* weights) const {
+	for(int i=0; i<m_n_shapes; i++) {
+		weights[i] = 0.0f;
+	}
+	if(m_n_frames == 0) {
+		//unanimated icon:
+		if(m_n_shapes > 0) { weights[0] = 1.0f; }
+		return;
+	}
+	for(int i=0; i<m_n_frames; i++) {
+		int const begin = m_key_begin[i];
+		int const end   = m_key_begin[i + 1];
+		if(begin == end) { continue; }
+		float w;
+		if(t <= m_keys[begin].time) {
+			w = m_keys[begin].value;
+		} else if(t >= m_keys[end - 1].time) {
+			w = m_keys[end - 1].value;
+		} else {
+			int k = begin + 1;
+			while(m_keys[k].time < t) { k++; }
+			PS2Icon::Frame_Key const& k0 = m_keys[k - 1];
+			PS2Icon::Frame_Key const& k1 = m_keys[k];
+			float const span = k1.time - k0.time;
+			w = (span > 0.0f) ? (k0.value + (k1.value - k0.value) * ((t - k0.time) / span)) : k1.value;
+		}
+		weights[m_frame_shapes[i]] += w;
+	}
+}
+
+void IconAnimator::GetShapeWeights(float t, float* weights) const {
+	t = WrapTime(t);
+	float const tick = std::floor(t);
+	if(tick == t) {
+		memcpy(weights, &m_weight_table[0] + static_cast<size_t>(tick) * m_n_shapes, sizeof(float) * m_n_shapes);
+	} else {
+		ComputeShapeWeights(t, weights);
+	}
+}
+
+void IconAnimator::EvaluatePlanes(float t, float* x, float* y, float* z) const {
+	std::vector<float> weights(m_n_shapes + 1);
+	GetShapeWeights(t, &weights[0]);
+	float* const planes[3] = { x, y, z };
+	for(int c=0; c<3; c++) {
+		memset(planes[c], 0, sizeof(float) * m_n_vertices);
+		for(int s=0; s<m_n_shapes; s++) {
+			if(weights[s] != 0.0f) {
+				blend_plane(m_icon->GetShapePlane(s, c), weights[s], planes[c], m_n_vertices);
+			}
+		}
+	}
+}
+
+void IconAnimator::Evaluate(float t, float* data) const {
+	std::vector<float> planes(static_cast<size_t>(m_n_vertices) * 3 + 1);
+	float* x = &planes[0];
+	float* y = x + m_n_vertices;
+	float* z = y + m_n_vertices;
+	EvaluatePlanes(t, x, y, z);
+	for(int i=0; i<m_n_vertices; i++) {
+		data[i*3]     = x[i];
+		data[i*3 + 1] = y[i];
+		data[i*3 + 2] = z[i];
+	}
+}
+
+void IconAnimator::EvaluateFrame(int frame, float* data) const {
+	Evaluate(GetFrameTime(frame), data);
+}
@@ -0,0 +1,206 @@
+/**
+ * @file src/ps2_ecc.cpp
+ *
+ * @brief Implementation of the memory card page ECCbuild_header/
+ */
+#include "../include/ps2_ecc.hpp"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#	define PS2_ECC_SSE2
+#	include <emmintrin.h>
+#endif
+
+namespace PS2ECC {
+	/** Lookup tables for the per-byte contributions to a code
+	 */
+	class Tables {
+	public:
+		unsigned char parity[256];					///< parity of each byte value
+		unsigned char column[256];					///< column parity bits of each byte value
+		unsigned char bits[256];					///< number of set bits of each byte value
+		Tables() {
+			//bits 0..2 hold the parities of the even bit groups, bits 4..6 those of the odd groups:
+			static unsigned char const masks[7] = { 0x55, 0x33, 0x0F, 0x00, 0xAA, 0xCC, 0xF0 };
+			for(int b=0; b<256; b++) {
+				int n = 0;
+				for(int i=0; i<8; i++) { n += (b >> i) & 1; }
+				bits[b]   = static_cast<unsigned char>(n);
+				parity[b] = static_cast<unsigned char>(n & 1);
+			}
+			for(int b=0; b<256; b++) {
+				unsigned char mask = 0;
+				for(int i=0; i<7; i++) {
+					mask |= static_cast<unsigned char>(parity[b & masks[i]] << i);
+				}
+				column[b] = mask;
+			}
+		}
+	};
+	static Tables const tables;
+
+	/** Helper function: parity of a 32 bit word
+	 */
+	inline unsigned int word_parity(unsigned int x) {
+		x ^= x >> 16;
+		x ^= x >> 8;
+		return tables.parity[x & 0xFF];
+	}
+
+	/** Helper function: assembles the code from the XOR of all bytes of a chunk and the
+	 *                   line parity bits gathered from the bytes with odd parity
+	 */
+	inline void make_code(unsigned int xor_all, unsigned int lines, unsigned char* code) {
+		unsigned char const x = static_cast<unsigned char>(xor_all);
+		code[0] = static_cast<unsigned char>(0x77 ^ tables.column[x]);
+		code[1] = static_cast<unsigned char>((0x7F ^ lines ^ (tables.parity[x] ? 0x7F : 0x00)) & 0x7F);
+		code[2] = static_cast<unsigned char>(0x7F ^ lines);
+	}
+
+#ifdef PS2_ECC_SSE2
+	/** Helper function: XOR of the four 32 bit lanes of a vector
+	 */
+	inline unsigned int fold_lanes(__m128i v) {
+		v = _mm_xor_si128( v, _mm_srli_si128(v, 8) );
+		v = _mm_xor_si128( v, _mm_srli_si128(v, 4) );
+		return static_cast<unsigned int>( _mm_cvtsi128_si32(v) );
+	}
+#endif
+
+	void CalculateTable(void const* chunk, unsigned char* code) {
+		unsigned char const* p = static_cast<unsigned char const*>(chunk);
+		unsigned char column = 0x77;
+		unsigned char line0  = 0x7F;
+		unsigned char line1  = 0x7F;
+		for(int i=0; i<CHUNK_SIZE; i++) {
+			column ^= tables.column[p[i]];
+			if(tables.parity[p[i]]) {
+				line0 ^= static_cast<unsigned char>(~i);
+				line1 ^= static_cast<unsigned char>(i);
+			}
+		}
+		code[0] = column;
+		code[1] = line0 & 0x7F;
+		code[2] = line1;
+	}
+
+	void CalculateVector(void const* chunk, unsigned char* code) {
+		unsigned char const* p = static_cast<unsigned char const*>(chunk);
+		unsigned int lines = 0;
+		unsigned int xor_all;
+#ifdef PS2_ECC_SSE2
+		//index bits 4..6 select the block, bits 0..3 the byte within the block:
+		__m128i v[8];
+		for(int i=0; i<8; i++) {
+			v[i] = _mm_loadu_si128( reinterpret_cast<__m128i const*>(p + i*16) );
+		}
+		__m128i const odd_blocks = _mm_xor_si128( _mm_xor_si128(v[1], v[3]), _mm_xor_si128(v[5], v[7]) );
+		__m128i const blocks_23  = _mm_xor_si128( v[2], v[3] );
+		__m128i const blocks_67  = _mm_xor_si128( v[6], v[7] );
+		__m128i const blocks_45  = _mm_xor_si128( v[4], v[5] );
+		__m128i const all = _mm_xor_si128( _mm_xor_si128( _mm_xor_si128(v[0], v[1]), blocks_23 ),
+		                                   _mm_xor_si128( blocks_45, blocks_67 ) );
+		lines |= word_parity( fold_lanes( _mm_and_si128(all, _mm_set1_epi16(static_cast<short>(0xFF00))) ) );
+		lines |= word_parity( fold_lanes( _mm_and_si128(all, _mm_set1_epi32(static_cast<int>(0xFFFF0000))) ) ) << 1;
+		lines |= word_parity( fold_lanes( _mm_and_si128(all, _mm_set_epi32(-1, 0, -1, 0)) ) ) << 2;
+		lines |= word_parity( fold_lanes( _mm_and_si128(all, _mm_set_epi32(-1, -1, 0, 0)) ) ) << 3;
+		lines |= word_parity( fold_lanes(odd_blocks) ) << 4;
+		lines |= word_parity( fold_lanes( _mm_xor_si128(blocks_23, blocks_67) ) ) << 5;
+		lines |= word_parity( fold_lanes( _mm_xor_si128(blocks_45, blocks_67) ) ) << 6;
+		xor_all = fold_lanes(all);
+#else
+		//index bits 2..6 select the word, bits 0..1 the byte within the word:
+		unsigned int w[CHUNK_SIZE / 4];
+		memcpy(w, p, CHUNK_SIZE);
+		unsigned int all = 0;
+		unsigned int by_word[5] = { 0, 0, 0, 0, 0 };
+		for(int i=0; i<CHUNK_SIZE / 4; i++) {
+			all ^= w[i];
+			for(int k=0; k<5; k++) {
+				if(i & (1 << k)) { by_word[k] ^= w[i]; }
+			}
+		}
+		lines |= word_parity(all & 0xFF00FF00);
+		lines |= word_parity(all & 0xFFFF0000) << 1;
+		for(int k=0; k<5; k++) {
+			lines |= word_parity(by_word[k]) << (k + 2);
+		}
+		xor_all = all;
+#endif
+		xor_all ^= xor_all >> 16;
+		xor_all ^= xor_all >> 8;
+		make_code(xor_all & 0xFF, lines, code);
+	}
+
+	bool HasSSE2() {
+#ifdef PS2_ECC_SSE2
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	void Calculate(void const* chunk, unsigned char* code) {
+		CalculateVector(chunk, code);
+	}
+
+	bool Verify(void const* chunk, unsigned char const* code) {
+		unsigned char computed[CODE_SIZE];
+		Calculate(chunk, computed);
+		return (memcmp(computed, code, CODE_SIZE) == 0);
+	}
+
+	CheckResult Correct(unsigned char* chunk, unsigned char* code) {
+		unsigned char computed[CODE_SIZE];
+		Calculate(chunk, computed);
+		if(memcmp(computed, code, CODE_SIZE) == 0) {
+			return CHECK_OK;
+		}
+		unsigned int const cp_diff  = (computed[0] ^ code[0]) & 0x77;
+		unsigned int const lp0_diff = (computed[1] ^ code[1]) & 0x7F;
+		unsigned int const lp1_diff = (computed[2] ^ code[2]) & 0x7F;
+		unsigned int const lp_comp  = lp0_diff ^ lp1_diff;
+		unsigned int const cp_comp  = (cp_diff >> 4) ^ (cp_diff & 0x07);
+		if((lp_comp == 0x7F) && (cp_comp == 0x07)) {
+			//single bit error in the data; the differences name the byte and the bit:
+			chunk[lp1_diff] ^= static_cast<unsigned char>(1 << (cp_diff >> 4));
+			return CHECK_CORRECTED;
+		}
+		if( ((cp_diff == 0) && (lp0_diff == 0) && (lp1_diff == 0)) ||
+		    (tables.bits[lp_comp] + tables.bits[cp_comp] == 1) )
+		{
+			//single bit error in the code, or one of its unused bits was set:
+			memcpy(code, computed, CODE_SIZE);
+			return CHECK_CORRECTED;
+		}
+		return CHECK_FAILED;
+	}
+
+	void CalculatePage(void const* page, size_t page_len, unsigned char* spare) {
+		unsigned char const* p = static_cast<unsigned char const*>(page);
+		size_t const n_chunks = page_len / CHUNK_SIZE;
+		memset(spare, 0, page_len / 32);
+		for(size_t i=0; i<n_chunks; i++) {
+			Calculate(p + i*CHUNK_SIZE, spare + i*CODE_SIZE);
+		}
+	}
+
+	bool VerifyPage(void const* page, size_t page_len, unsigned char const* spare) {
+		unsigned char const* p = static_cast<unsigned char const*>(page);
+		size_t const n_chunks = page_len / CHUNK_SIZE;
+		for(size_t i=0; i<n_chunks; i++) {
+			if(!Verify(p + i*CHUNK_SIZE, spare + i*CODE_SIZE)) { return false; }
+		}
+		return true;
+	}
+
+	CheckResult CorrectPage(unsigned char* page, size_t page_len, unsigned char* spare) {
+		size_t const n_chunks = page_len / CHUNK_SIZE;
+		CheckResult ret = CHECK_OK;
+		for(size_t i=0; i<n_chunks; i++) {
+			CheckResult const res = Correct(page + i*CHUNK_SIZE, spare + i*CODE_SIZE);
+			if(res > ret) { ret = res; }
+		}
+		return ret;
+	}
+}
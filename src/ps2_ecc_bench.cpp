@@ -0,0 +1,120 @@
+/**
+ * @file src/ps2_ecc_bench.cpp
+ *
+ * @brief A microbenchmark for the memory card page ECCbuild_header/
+ */
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+#include "../include/ps2_ecc.hpp"
+
+size_t const PAGE_LEN   = 512;						///< data bytes per page
+size_t const SPARE_SIZE = PAGE_LEN / 32;			///< spare bytes per page
+
+/** Signature of a chunk code function
+ */
+typedef void (*CalculateFunc)(void const*, unsigned char*);
+
+/** Compute the spare areas of all pages with the given implementation
+ * @param[in] func The implementation
+ * @param[in] data The page data
+ * @param[in] n_pages Number of pages
+ * @param[out] spare A field of (n_pages * SPARE_SIZE) bytes
+ */
+void CalculateAll(CalculateFunc func, unsigned char const* data, size_t n_pages, unsigned char* spare)
+{
+	for(size_t p=0; p<n_pages; p++) {
+		unsigned char const* page = data + p*PAGE_LEN;
+		for(size_t c=0; c<PAGE_LEN / PS2ECC::CHUNK_SIZE; c++) {
+			func(page + c*PS2ECC::CHUNK_SIZE, spare + p*SPARE_SIZE + c*PS2ECC::CODE_SIZE);
+		}
+	}
+}
+
+/** Print the throughput of a benchmark run
+ * @param[in] name Name of the benchmark
+ * @param[in] bytes Number of data bytes processed
+ * @param[in] ticks Processor time used
+ */
+void PrintThroughput(char const* name, double bytes, clock_t ticks)
+{
+	double const seconds = static_cast<double>(ticks) / CLOCKS_PER_SEC;
+	std::cout << "  " << std::left << std::setw(20) << name << std::right << std::fixed << std::setprecision(3)
+	          << std::setw(9) << ((seconds > 0.0) ? (bytes / seconds / 1.0e9) : 0.0) << " GB/s" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	int const n_megabytes = (argc > 1) ? atoi(argv[1]) : 8;
+	int const n_runs      = (argc > 2) ? atoi(argv[2]) : 20;
+	if((n_megabytes <= 0) || (n_runs <= 0)) {
+		std::cout << "Usage: " << argv[0] << " [megabytes (8)] [runs (20)]" << std::endl;
+		return 1;
+	}
+	size_t const n_pages = static_cast<size_t>(n_megabytes) * 1024 * 1024 / PAGE_LEN;
+	double const bytes = static_cast<double>(n_pages) * PAGE_LEN * n_runs;
+
+	std::vector<unsigned char> data(n_pages * PAGE_LEN);
+	unsigned int seed = 12345;
+	for(size_t i=0; i<data.size(); i++) {
+		seed = seed * 1103515245 + 12345;
+		data[i] = static_cast<unsigned char>(seed >> 16);
+	}
+	std::vector<unsigned char> spare_table(n_pages * SPARE_SIZE, 0);
+	std::vector<unsigned char> spare_vector(n_pages * SPARE_SIZE, 0);
+
+	std::cout << "PS2 memory card ECC benchmark: " << n_megabytes << " MB x " << n_runs << " runs ("
+	          << (PS2ECC::HasSSE2() ? "SSE2" : "32 bit words") << ")" << std::endl;
+
+	clock_t start = clock();
+	for(int r=0; r<n_runs; r++) {
+		CalculateAll(PS2ECC::CalculateTable, &data[0], n_pages, &spare_table[0]);
+	}
+	PrintThroughput("generate (table)", bytes, clock() - start);
+
+	start = clock();
+	for(int r=0; r<n_runs; r++) {
+		CalculateAll(PS2ECC::CalculateVector, &data[0], n_pages, &spare_vector[0]);
+	}
+	PrintThroughput("generate (vector)", bytes, clock() - start);
+
+	if(spare_table != spare_vector) {
+		std::cout << "Error: implementations disagree" << std::endl;
+		return 1;
+	}
+
+	start = clock();
+	size_t n_bad = 0;
+	for(int r=0; r<n_runs; r++) {
+		for(size_t p=0; p<n_pages; p++) {
+			if(!PS2ECC::VerifyPage(&data[p*PAGE_LEN], PAGE_LEN, &spare_vector[p*SPARE_SIZE])) { n_bad++; }
+		}
+	}
+	PrintThroughput("verify", bytes, clock() - start);
+	if(n_bad != 0) {
+		std::cout << "Error: " << n_bad << " pages failed to verify" << std::endl;
+		return 1;
+	}
+
+	//flip one bit in every chunk; correction must restore the original data:
+	std::vector<unsigned char> damaged(data);
+	for(size_t i=0; i<damaged.size() / PS2ECC::CHUNK_SIZE; i++) {
+		damaged[i*PS2ECC::CHUNK_SIZE + (i*37) % PS2ECC::CHUNK_SIZE] ^= static_cast<unsigned char>(1 << (i % 8));
+	}
+	start = clock();
+	size_t n_failed = 0;
+	for(size_t p=0; p<n_pages; p++) {
+		if(PS2ECC::CorrectPage(&damaged[p*PAGE_LEN], PAGE_LEN, &spare_vector[p*SPARE_SIZE]) != PS2ECC::CHECK_CORRECTED) {
+			n_failed++;
+		}
+	}
+	PrintThroughput("correct", static_cast<double>(n_pages) * PAGE_LEN, clock() - start);
+	if((n_failed != 0) || (damaged != data)) {
+		std::cout << "Error: " << n_failed << " pages could not be corrected" << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,525 @@
+/**
+ * @file src/ps2_fixedpoint.cpp
+ *
+ * @brief Implementation of the fixed point conversion kernelsbuild_header/
+ */
+#include "../include/ps2_fixedpoint.hpp"
+#include <cstring>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#	define PS2_FIXEDPOINT_SSE2
+#	include <emmintrin.h>
+	//AVX2 needs per-function target attributes and runtime CPU detection (gcc 4.9, clang 8, VS2012):
+#	if (defined(__clang__) && (__clang_major__ >= 8)) || \
+	   (!defined(__clang__) && defined(__GNUC__) && ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))) || \
+	   (defined(_MSC_VER) && (_MSC_VER >= 1700))
+#		define PS2_FIXEDPOINT_AVX2
+#		include <immintrin.h>
+#		ifdef _MSC_VER
+#			include <intrin.h>
+#			define PS2_TARGET_AVX2
+#		else
+#			define PS2_TARGET_AVX2 __attribute__((target("avx2")))
+#		endif
+#	endif
+#endif
+
+namespace PS2FixedPoint {
+	////////////
+	// Scalar //
+	////////////
+	/** Helper function: converts a single fixed point value to float
+	 */
+	inline float fixed_to_float(short i) {
+		//multiplication by a power of two is exact, so this equals i / 4096.0f:
+		return static_cast<float>(i) * (1.0f / 4096.0f);
+	}
+	/** Helper function: converts a single float to fixed point with rounding and saturation
+	 */
+	inline short float_to_fixed(float f) {
+		float v = f * 4096.0f;
+		if(!(v >= -32768.0f)) { v = -32768.0f; }		//also catches NaN
+		if(v > 32767.0f)      { v =  32767.0f; }
+		//v + 0.5 is exact in double; halfway cases round to even, like the SSE2 and AVX2 kernels:
+		double r = std::floor(static_cast<double>(v) + 0.5);
+		if( (r - static_cast<double>(v) == 0.5) && (std::fmod(r, 2.0) != 0.0) ) { r -= 1.0; }
+		return static_cast<short>(r);
+	}
+	/** Helper function: unaligned load of a short
+	 */
+	inline short load_short(unsigned char const* p) {
+		short s;
+		memcpy(&s, p, sizeof(short));
+		return s;
+	}
+	/** Helper function: unaligned store of a short
+	 */
+	inline void store_short(unsigned char* p, short s) {
+		memcpy(p, &s, sizeof(short));
+	}
+
+	static void ToFloat_Scalar(short const* src, float* dst, size_t n) {
+		for(size_t i=0; i<n; i++) {
+			dst[i] = fixed_to_float(src[i]);
+		}
+	}
+	static void FromFloat_Scalar(float const* src, short* dst, size_t n) {
+		for(size_t i=0; i<n; i++) {
+			dst[i] = float_to_fixed(src[i]);
+		}
+	}
+	static void CoordsToFloat_Scalar(void const* src, size_t src_stride, float* dst, size_t n) {
+		unsigned char const* p = static_cast<unsigned char const*>(src);
+		for(size_t i=0; i<n; i++, p+=src_stride) {
+			dst[i*3]     = fixed_to_float( load_short(p) );
+			dst[i*3 + 1] = fixed_to_float( load_short(p + 2) );
+			dst[i*3 + 2] = fixed_to_float( load_short(p + 4) );
+		}
+	}
+	static void CoordsToPlanes_Scalar(void const* src, size_t src_stride, float* x, float* y, float* z, size_t n) {
+		unsigned char const* p = static_cast<unsigned char const*>(src);
+		for(size_t i=0; i<n; i++, p+=src_stride) {
+			x[i] = fixed_to_float( load_short(p) );
+			y[i] = fixed_to_float( load_short(p + 2) );
+			z[i] = fixed_to_float( load_short(p + 4) );
+		}
+	}
+	static void FloatToCoords_Scalar(float const* src, void* dst, size_t dst_stride, size_t n) {
+		unsigned char* p = static_cast<unsigned char*>(dst);
+		for(size_t i=0; i<n; i++, p+=dst_stride) {
+			store_short(p,     float_to_fixed(src[i*3]));
+			store_short(p + 2, float_to_fixed(src[i*3 + 1]));
+			store_short(p + 4, float_to_fixed(src[i*3 + 2]));
+			store_short(p + 6, 0);
+		}
+	}
+	static void TexCoordsToFloat_Scalar(void const* src, size_t src_stride, float* dst, size_t n) {
+		unsigned char const* p = static_cast<unsigned char const*>(src);
+		for(size_t i=0; i<n; i++, p+=src_stride) {
+			dst[i*2]     = fixed_to_float( load_short(p) );
+			dst[i*2 + 1] = fixed_to_float( load_short(p + 2) );
+		}
+	}
+	static void FloatToTexCoords_Scalar(float const* src, void* dst, size_t dst_stride, size_t n) {
+		unsigned char* p = static_cast<unsigned char*>(dst);
+		for(size_t i=0; i<n; i++, p+=dst_stride) {
+			store_short(p,     float_to_fixed(src[i*2]));
+			store_short(p + 2, float_to_fixed(src[i*2 + 1]));
+		}
+	}
+
+#ifdef PS2_FIXEDPOINT_SSE2
+	//////////
+	// SSE2 //
+	//////////
+	/** Helper function: sign extends the lower four shorts of v and converts them to float
+	 */
+	static inline __m128 sse2_lo_to_float(__m128i v) {
+		return _mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16) ),
+		                   _mm_set1_ps(1.0f / 4096.0f) );
+	}
+	/** Helper function: sign extends the upper four shorts of v and converts them to float
+	 */
+	static inline __m128 sse2_hi_to_float(__m128i v) {
+		return _mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16) ),
+		                   _mm_set1_ps(1.0f / 4096.0f) );
+	}
+	/** Helper function: scales, saturates and rounds four floats to int32
+	 */
+	static inline __m128i sse2_to_fixed(__m128 v) {
+		v = _mm_mul_ps(v, _mm_set1_ps(4096.0f));
+		v = _mm_max_ps(v, _mm_set1_ps(-32768.0f));		//maxps returns the 2nd operand for NaN
+		v = _mm_min_ps(v, _mm_set1_ps( 32767.0f));
+		return _mm_cvtps_epi32(v);
+	}
+
+	static void ToFloat_SSE2(short const* src, float* dst, size_t n) {
+		size_t i = 0;
+		for(; i+8 <= n; i+=8) {
+			__m128i v = _mm_loadu_si128( reinterpret_cast<__m128i const*>(src + i) );
+			_mm_storeu_ps(dst + i,     sse2_lo_to_float(v));
+			_mm_storeu_ps(dst + i + 4, sse2_hi_to_float(v));
+		}
+		ToFloat_Scalar(src + i, dst + i, n - i);
+	}
+	static void FromFloat_SSE2(float const* src, short* dst, size_t n) {
+		size_t i = 0;
+		for(; i+8 <= n; i+=8) {
+			__m128i lo = sse2_to_fixed( _mm_loadu_ps(src + i) );
+			__m128i hi = sse2_to_fixed( _mm_loadu_ps(src + i + 4) );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(lo, hi) );
+		}
+		FromFloat_Scalar(src + i, dst + i, n - i);
+	}
+	static void CoordsToFloat_SSE2(void const* src, size_t src_stride, float* dst, size_t n) {
+		unsigned char const* p = static_cast<unsigned char const*>(src);
+		size_t i = 0;
+		for(; i+4 <= n; i+=4, p+=4*src_stride, dst+=12) {
+			//load four x,y,z,w tuples:
+			__m128i v01 = _mm_unpacklo_epi64( _mm_loadl_epi64( reinterpret_cast<__m128i const*>(p) ),
+			                                  _mm_loadl_epi64( reinterpret_cast<__m128i const*>(p + src_stride) ) );
+			__m128i v23 = _mm_unpacklo_epi64( _mm_loadl_epi64( reinterpret_cast<__m128i const*>(p + 2*src_stride) ),
+			                                  _mm_loadl_epi64( reinterpret_cast<__m128i const*>(p + 3*src_stride) ) );
+			__m128 c0 = sse2_lo_to_float(v01);
+			__m128 c1 = sse2_hi_to_float(v01);
+			__m128 c2 = sse2_lo_to_float(v23);
+			__m128 c3 = sse2_hi_to_float(v23);
+			//drop the w components; each store overwrites the w lane of the previous one:
+			__m128 t = _mm_shuffle_ps(c2, c3, _MM_SHUFFLE(0, 0, 2, 2));		// z2 z2 x3 x3
+			_mm_storeu_ps(dst,     c0);
+			_mm_storeu_ps(dst + 3, c1);
+			_mm_storeu_ps(dst + 6, c2);
+			_mm_storeu_ps(dst + 8, _mm_shuffle_ps(t, c3, _MM_SHUFFLE(2, 1, 2, 0)));	// z2 x3 y3 z3
+		}
+		CoordsToFloat_Scalar(p, src_stride, dst, n - i);
+	}
+	static void CoordsToPlanes_SSE2(void const* src, size_t src_stride, float* x, float* y, float* z, size_t n) {
+		unsigned char const* p = static_cast<unsigned char const*>(src);
+		size_t i = 0;
+		for(; i+4 <= n; i+=4, p+=4*src_stride) {
+			//load four x,y,z,w tuples:
+			__m128i v01 = _mm_unpacklo_epi64( _mm_loadl_epi64( reinterpret_cast<__m128i const*>(p) ),
+			                                  _mm_loadl_epi64( reinterpret_cast<__m128i const*>(p + src_stride) ) );
+			__m128i v23 = _mm_unpacklo_epi64( _mm_loadl_epi64( reinterpret_cast<__m128i const*>(p + 2*src_stride) ),
+			                                  _mm_loadl_epi64( reinterpret_cast<__m128i const*>(p + 3*src_stride) ) );
+			//transpose to x0 x1 x2 x3 y0 y1 y2 y3 | z0 z1 z2 z3 w0 w1 w2 w3:
+			__m128i t0  = _mm_unpacklo_epi16(v01, v23);						// x0 x2 y0 y2 z0 z2 w0 w2
+			__m128i t1  = _mm_unpackhi_epi16(v01, v23);						// x1 x3 y1 y3 z1 z3 w1 w3
+			__m128i xy  = _mm_unpacklo_epi16(t0, t1);
+			__m128i zw  = _mm_unpackhi_epi16(t0, t1);
+			_mm_storeu_ps(x + i, sse2_lo_to_float(xy));
+			_mm_storeu_ps(y + i, sse2_hi_to_float(xy));
+			_mm_storeu_ps(z + i, sse2_lo_to_float(zw));
+		}
+		CoordsToPlanes_Scalar(p, src_stride, x + i, y + i, z + i, n - i);
+	}
+	static void FloatToCoords_SSE2(float const* src, void* dst, size_t dst_stride, size_t n) {
+		unsigned char* p = static_cast<unsigned char*>(dst);
+		__m128i const mask_w = _mm_set_epi32(0, -1, -1, -1);
+		size_t i = 0;
+		for(; i+4 <= n; i+=4, p+=4*dst_stride, src+=12) {
+			__m128 c3 = _mm_loadu_ps(src + 8);							// z2 x3 y3 z3
+			__m128i f0 = _mm_and_si128( sse2_to_fixed(_mm_loadu_ps(src)),     mask_w );
+			__m128i f1 = _mm_and_si128( sse2_to_fixed(_mm_loadu_ps(src + 3)), mask_w );
+			__m128i f2 = _mm_and_si128( sse2_to_fixed(_mm_loadu_ps(src + 6)), mask_w );
+			__m128i f3 = _mm_and_si128( sse2_to_fixed(_mm_shuffle_ps(c3, c3, _MM_SHUFFLE(0, 3, 2, 1))), mask_w );
+			__m128i v01 = _mm_packs_epi32(f0, f1);
+			__m128i v23 = _mm_packs_epi32(f2, f3);
+			_mm_storel_epi64( reinterpret_cast<__m128i*>(p),                v01 );
+			_mm_storel_epi64( reinterpret_cast<__m128i*>(p + dst_stride),   _mm_srli_si128(v01, 8) );
+			_mm_storel_epi64( reinterpret_cast<__m128i*>(p + 2*dst_stride), v23 );
+			_mm_storel_epi64( reinterpret_cast<__m128i*>(p + 3*dst_stride), _mm_srli_si128(v23, 8) );
+		}
+		FloatToCoords_Scalar(src, p, dst_stride, n - i);
+	}
+	static void TexCoordsToFloat_SSE2(void const* src, size_t src_stride, float* dst, size_t n) {
+		unsigned char const* p = static_cast<unsigned char const*>(src);
+		size_t i = 0;
+		for(; i+4 <= n; i+=4, p+=4*src_stride, dst+=8) {
+			int uv[4];
+			memcpy(&uv[0], p,                sizeof(int));
+			memcpy(&uv[1], p + src_stride,   sizeof(int));
+			memcpy(&uv[2], p + 2*src_stride, sizeof(int));
+			memcpy(&uv[3], p + 3*src_stride, sizeof(int));
+			__m128i v = _mm_set_epi32(uv[3], uv[2], uv[1], uv[0]);
+			_mm_storeu_ps(dst,     sse2_lo_to_float(v));
+			_mm_storeu_ps(dst + 4, sse2_hi_to_float(v));
+		}
+		TexCoordsToFloat_Scalar(p, src_stride, dst, n - i);
+	}
+	static void FloatToTexCoords_SSE2(float const* src, void* dst, size_t dst_stride, size_t n) {
+		unsigned char* p = static_cast<unsigned char*>(dst);
+		size_t i = 0;
+		for(; i+4 <= n; i+=4, p+=4*dst_stride, src+=8) {
+			__m128i v = _mm_packs_epi32( sse2_to_fixed(_mm_loadu_ps(src)), sse2_to_fixed(_mm_loadu_ps(src + 4)) );
+			int uv[4];
+			_mm_storeu_si128( reinterpret_cast<__m128i*>(uv), v );
+			memcpy(p,                &uv[0], sizeof(int));
+			memcpy(p + dst_stride,   &uv[1], sizeof(int));
+			memcpy(p + 2*dst_stride, &uv[2], sizeof(int));
+			memcpy(p + 3*dst_stride, &uv[3], sizeof(int));
+		}
+		FloatToTexCoords_Scalar(src, p, dst_stride, n - i);
+	}
+#endif
+
+#ifdef PS2_FIXEDPOINT_AVX2
+	//////////
+	// AVX2 //
+	//////////
+	PS2_TARGET_AVX2 static void ToFloat_AVX2(short const* src, float* dst, size_t n) {
+		__m256 const scale = _mm256_set1_ps(1.0f / 4096.0f);
+		size_t i = 0;
+		for(; i+16 <= n; i+=16) {
+			__m128i lo = _mm_loadu_si128( reinterpret_cast<__m128i const*>(src + i) );
+			__m128i hi = _mm_loadu_si128( reinterpret_cast<__m128i const*>(src + i + 8) );
+			_mm256_storeu_ps(dst + i,     _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(lo)), scale));
+			_mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(hi)), scale));
+		}
+		ToFloat_Scalar(src + i, dst + i, n - i);
+	}
+	PS2_TARGET_AVX2 static inline __m256i avx2_to_fixed(__m256 v) {
+		v = _mm256_mul_ps(v, _mm256_set1_ps(4096.0f));
+		v = _mm256_max_ps(v, _mm256_set1_ps(-32768.0f));
+		v = _mm256_min_ps(v, _mm256_set1_ps( 32767.0f));
+		return _mm256_cvtps_epi32(v);
+	}
+	PS2_TARGET_AVX2 static void FromFloat_AVX2(float const* src, short* dst, size_t n) {
+		size_t i = 0;
+		for(; i+16 <= n; i+=16) {
+			__m256i lo = avx2_to_fixed( _mm256_loadu_ps(src + i) );
+			__m256i hi = avx2_to_fixed( _mm256_loadu_ps(src + i + 8) );
+			//packs works per 128 bit lane; restore element order afterwards:
+			__m256i v = _mm256_permute4x64_epi64( _mm256_packs_epi32(lo, hi), _MM_SHUFFLE(3, 1, 2, 0) );
+			_mm256_storeu_si256( reinterpret_cast<__m256i*>(dst + i), v );
+		}
+		FromFloat_Scalar(src + i, dst + i, n - i);
+	}
+
+	/** Helper function: loads the x,y,z,w tuples of two records into the lower and upper half of a register
+	 */
+	PS2_TARGET_AVX2 static inline __m128i avx2_load_pair(unsigned char const* p, size_t stride) {
+		return _mm_unpacklo_epi64( _mm_loadl_epi64( reinterpret_cast<__m128i const*>(p) ),
+		                           _mm_loadl_epi64( reinterpret_cast<__m128i const*>(p + stride) ) );
+	}
+	/** Helper function: loads the u,v pairs of four records
+	 */
+	PS2_TARGET_AVX2 static inline __m128i avx2_load_uv(unsigned char const* p, size_t stride) {
+		int uv[4];
+		memcpy(&uv[0], p,            sizeof(int));
+		memcpy(&uv[1], p + stride,   sizeof(int));
+		memcpy(&uv[2], p + 2*stride, sizeof(int));
+		memcpy(&uv[3], p + 3*stride, sizeof(int));
+		//inserted from registers; storing the pairs and reloading them as a whole stalls store forwarding:
+		__m128i v = _mm_cvtsi32_si128(uv[0]);
+		v = _mm_insert_epi32(v, uv[1], 1);
+		v = _mm_insert_epi32(v, uv[2], 2);
+		return _mm_insert_epi32(v, uv[3], 3);
+	}
+	/** Helper function: stores the u,v pairs of four records
+	 */
+	PS2_TARGET_AVX2 static inline void avx2_store_uv(__m128i v, unsigned char* p, size_t stride) {
+		int uv[4];
+		uv[0] = _mm_cvtsi128_si32(v);
+		uv[1] = _mm_extract_epi32(v, 1);
+		uv[2] = _mm_extract_epi32(v, 2);
+		uv[3] = _mm_extract_epi32(v, 3);
+		memcpy(p,            &uv[0], sizeof(int));
+		memcpy(p + stride,   &uv[1], sizeof(int));
+		memcpy(p + 2*stride, &uv[2], sizeof(int));
+		memcpy(p + 3*stride, &uv[3], sizeof(int));
+	}
+	/** Helper function: sign extends eight shorts and converts them to float
+	 */
+	PS2_TARGET_AVX2 static inline __m256 avx2_to_float(__m128i v) {
+		return _mm256_mul_ps( _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v)), _mm256_set1_ps(1.0f / 4096.0f) );
+	}
+
+	//the strided kernels process eight records per iteration; the records are still
+	//loaded with 8 byte moves, the conversion and the stores use the full 256 bits
+	PS2_TARGET_AVX2 static void CoordsToFloat_AVX2(void const* src, size_t src_stride, float* dst, size_t n) {
+		unsigned char const* p = static_cast<unsigned char const*>(src);
+		//x y z of two records; the w lanes are moved to the end and overwritten by the next store:
+		__m256i const pick_xyz = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+		__m256i const mask_6   = _mm256_setr_epi32(-1, -1, -1, -1, -1, -1, 0, 0);
+		size_t i = 0;
+		for(; i+8 <= n; i+=8, p+=8*src_stride, dst+=24) {
+			for(int k=0; k<4; k++) {
+				__m128i v = avx2_load_pair(p + (2*k)*src_stride, src_stride);
+				__m256 f = _mm256_permutevar8x32_ps( avx2_to_float(v), pick_xyz );
+				if(k < 3) {
+					_mm256_storeu_ps(dst + 6*k, f);
+				} else {
+					//the last store must not write past the 24 floats of this block:
+					_mm256_maskstore_ps(dst + 6*k, mask_6, f);
+				}
+			}
+		}
+		_mm256_zeroupper();
+		CoordsToFloat_SSE2(p, src_stride, dst, n - i);
+	}
+	PS2_TARGET_AVX2 static void CoordsToPlanes_AVX2(void const* src, size_t src_stride, float* x, float* y, float* z, size_t n) {
+		unsigned char const* p = static_cast<unsigned char const*>(src);
+		size_t i = 0;
+		for(; i+8 <= n; i+=8, p+=8*src_stride) {
+			//records 0 1 | 4 5 and 2 3 | 6 7, transposed per 128 bit lane like in the SSE2 kernel:
+			__m256i a = _mm256_inserti128_si256( _mm256_castsi128_si256(avx2_load_pair(p, src_stride)),
+			                                     avx2_load_pair(p + 4*src_stride, src_stride), 1 );
+			__m256i b = _mm256_inserti128_si256( _mm256_castsi128_si256(avx2_load_pair(p + 2*src_stride, src_stride)),
+			                                     avx2_load_pair(p + 6*src_stride, src_stride), 1 );
+			__m256i t0 = _mm256_unpacklo_epi16(a, b);
+			__m256i t1 = _mm256_unpackhi_epi16(a, b);
+			//x0-3 y0-3 | x4-7 y4-7 and z0-3 w0-3 | z4-7 w4-7, reordered to x0-7 y0-7 and z0-7 w0-7:
+			__m256i xy = _mm256_permute4x64_epi64( _mm256_unpacklo_epi16(t0, t1), _MM_SHUFFLE(3, 1, 2, 0) );
+			__m256i zw = _mm256_permute4x64_epi64( _mm256_unpackhi_epi16(t0, t1), _MM_SHUFFLE(3, 1, 2, 0) );
+			_mm256_storeu_ps(x + i, avx2_to_float( _mm256_castsi256_si128(xy) ));
+			_mm256_storeu_ps(y + i, avx2_to_float( _mm256_extracti128_si256(xy, 1) ));
+			_mm256_storeu_ps(z + i, avx2_to_float( _mm256_castsi256_si128(zw) ));
+		}
+		_mm256_zeroupper();
+		CoordsToPlanes_SSE2(p, src_stride, x + i, y + i, z + i, n - i);
+	}
+	PS2_TARGET_AVX2 static void FloatToCoords_AVX2(float const* src, void* dst, size_t dst_stride, size_t n) {
+		unsigned char* p = static_cast<unsigned char*>(dst);
+		//x y z of two records in the lower three lanes of each 128 bit half:
+		__m256i const spread = _mm256_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0);
+		__m256i const mask_6 = _mm256_setr_epi32(-1, -1, -1, -1, -1, -1, 0, 0);
+		size_t i = 0;
+		for(; i+8 <= n; i+=8, p+=8*dst_stride, src+=24) {
+			for(int k=0; k<4; k++) {
+				//the last load must not read past the 24 floats of this block:
+				__m256 f = (k < 3) ? _mm256_loadu_ps(src + 6*k) : _mm256_maskload_ps(src + 6*k, mask_6);
+				f = _mm256_blend_ps( _mm256_permutevar8x32_ps(f, spread), _mm256_setzero_ps(), 0x88 );
+				__m256i v = avx2_to_fixed(f);
+				v = _mm256_packs_epi32(v, v);
+				_mm_storel_epi64( reinterpret_cast<__m128i*>(p + (2*k)*dst_stride),     _mm256_castsi256_si128(v) );
+				_mm_storel_epi64( reinterpret_cast<__m128i*>(p + (2*k + 1)*dst_stride), _mm256_extracti128_si256(v, 1) );
+			}
+		}
+		_mm256_zeroupper();
+		FloatToCoords_SSE2(src, p, dst_stride, n - i);
+	}
+	PS2_TARGET_AVX2 static void TexCoordsToFloat_AVX2(void const* src, size_t src_stride, float* dst, size_t n) {
+		unsigned char const* p = static_cast<unsigned char const*>(src);
+		size_t i = 0;
+		for(; i+8 <= n; i+=8, p+=8*src_stride, dst+=16) {
+			_mm256_storeu_ps(dst,     avx2_to_float( avx2_load_uv(p, src_stride) ));
+			_mm256_storeu_ps(dst + 8, avx2_to_float( avx2_load_uv(p + 4*src_stride, src_stride) ));
+		}
+		_mm256_zeroupper();
+		TexCoordsToFloat_SSE2(p, src_stride, dst, n - i);
+	}
+	PS2_TARGET_AVX2 static void FloatToTexCoords_AVX2(float const* src, void* dst, size_t dst_stride, size_t n) {
+		unsigned char* p = static_cast<unsigned char*>(dst);
+		size_t i = 0;
+		for(; i+8 <= n; i+=8, p+=8*dst_stride, src+=16) {
+			__m256i lo = avx2_to_fixed( _mm256_loadu_ps(src) );
+			__m256i hi = avx2_to_fixed( _mm256_loadu_ps(src + 8) );
+			__m256i v  = _mm256_permute4x64_epi64( _mm256_packs_epi32(lo, hi), _MM_SHUFFLE(3, 1, 2, 0) );
+			avx2_store_uv(_mm256_castsi256_si128(v),      p,                dst_stride);
+			avx2_store_uv(_mm256_extracti128_si256(v, 1), p + 4*dst_stride, dst_stride);
+		}
+		_mm256_zeroupper();
+		FloatToTexCoords_SSE2(src, p, dst_stride, n - i);
+	}
+
+	/** Helper function: runtime check for AVX2 support
+	 */
+	static bool CpuSupportsAVX2() {
+#	ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if(info[0] < 7) { return false; }
+		__cpuid(info, 1);
+		//AVX and OSXSAVE are required for the OS to save the ymm registers:
+		if( ((info[2] & (1<<27)) == 0) || ((info[2] & (1<<28)) == 0) ) { return false; }
+		if((_xgetbv(0) & 0x6) != 0x6) { return false; }
+		__cpuidex(info, 7, 0);
+		return ((info[1] & (1<<5)) != 0);
+#	else
+		__builtin_cpu_init();
+		return (__builtin_cpu_supports("avx2") != 0);
+#	endif
+	}
+#endif
+
+	//////////////
+	// Dispatch //
+	//////////////
+	/** The set of active kernels
+	 */
+	struct KernelTable {
+		KernelType type;
+		void (*to_float)(short const*, float*, size_t);
+		void (*from_float)(float const*, short*, size_t);
+		void (*coords_to_float)(void const*, size_t, float*, size_t);
+		void (*coords_to_planes)(void const*, size_t, float*, float*, float*, size_t);
+		void (*float_to_coords)(float const*, void*, size_t, size_t);
+		void (*texcoords_to_float)(void const*, size_t, float*, size_t);
+		void (*float_to_texcoords)(float const*, void*, size_t, size_t);
+	};
+
+	/** Helper function: builds the kernel table for a kernel type
+	 * @param[in] type The kernel to use; falls back to the best one supported by the CPU
+	 */
+	static KernelTable SelectKernels(KernelType type) {
+		KernelTable k;
+		k.type               = KERNEL_SCALAR;
+		k.to_float           = ToFloat_Scalar;
+		k.from_float         = FromFloat_Scalar;
+		k.coords_to_float    = CoordsToFloat_Scalar;
+		k.coords_to_planes   = CoordsToPlanes_Scalar;
+		k.float_to_coords    = FloatToCoords_Scalar;
+		k.texcoords_to_float = TexCoordsToFloat_Scalar;
+		k.float_to_texcoords = FloatToTexCoords_Scalar;
+#ifdef PS2_FIXEDPOINT_SSE2
+		if(type >= KERNEL_SSE2) {
+			k.type               = KERNEL_SSE2;
+			k.to_float           = ToFloat_SSE2;
+			k.from_float         = FromFloat_SSE2;
+			k.coords_to_float    = CoordsToFloat_SSE2;
+			k.coords_to_planes   = CoordsToPlanes_SSE2;
+			k.float_to_coords    = FloatToCoords_SSE2;
+			k.texcoords_to_float = TexCoordsToFloat_SSE2;
+			k.float_to_texcoords = FloatToTexCoords_SSE2;
+		}
+#endif
+#ifdef PS2_FIXEDPOINT_AVX2
+		if((type >= KERNEL_AVX2) && CpuSupportsAVX2()) {
+			k.type               = KERNEL_AVX2;
+			k.to_float           = ToFloat_AVX2;
+			k.from_float         = FromFloat_AVX2;
+			k.coords_to_float    = CoordsToFloat_AVX2;
+			k.coords_to_planes   = CoordsToPlanes_AVX2;
+			k.float_to_coords    = FloatToCoords_AVX2;
+			k.texcoords_to_float = TexCoordsToFloat_AVX2;
+			k.float_to_texcoords = FloatToTexCoords_AVX2;
+		}
+#endif
+		return k;
+	}
+
+	/** Helper function: get the active kernel table
+	 * @note The table is selected on the first call, so callers from static initializers of
+	 *       other translation units never see an empty table.
+	 */
+	static KernelTable& GetKernels() {
+		static KernelTable kernels = SelectKernels(KERNEL_AVX2);
+		return kernels;
+	}
+	/** Makes the first call to GetKernels() during static initialization, before any threads
+	 *  are started; the (pre C++11) function-local static is not initialized thread-safely
+	 */
+	static KernelTable const& g_kernels_selected = GetKernels();
+
+	KernelType SetKernelType(KernelType type) {
+		GetKernels() = SelectKernels(type);
+		return GetKernels().type;
+	}
+	KernelType GetKernelType() {
+		return GetKernels().type;
+	}
+
+	void ToFloat(short const* src, float* dst, size_t n) {
+		GetKernels().to_float(src, dst, n);
+	}
+	void FromFloat(float const* src, short* dst, size_t n) {
+		GetKernels().from_float(src, dst, n);
+	}
+	void CoordsToFloat(void const* src, size_t src_stride, float* dst, size_t n) {
+		GetKernels().coords_to_float(src, src_stride, dst, n);
+	}
+	void CoordsToPlanes(void const* src, size_t src_stride, float* x, float* y, float* z, size_t n) {
+		GetKernels().coords_to_planes(src, src_stride, x, y, z, n);
+	}
+	void FloatToCoords(float const* src, void* dst, size_t dst_stride, size_t n) {
+		GetKernels().float_to_coords(src, dst, dst_stride, n);
+	}
+	void TexCoordsToFloat(void const* src, size_t src_stride, float* dst, size_t n) {
+		GetKernels().texcoords_to_float(src, src_stride, dst, n);
+	}
+	void FloatToTexCoords(float const* src, void* dst, size_t dst_stride, size_t n) {
+		GetKernels().float_to_texcoords(src, dst, dst_stride, n);
+	}
+};
@@ -21,6 +21,14 @@ bool IconSys::CheckValidity(IconSys::File_t const& f)
 	return true;
 }
 
+bool IconSys::CheckValidity(MemorySpan<unsigned char> const& data)
+{
+	if(data.GetSize() < sizeof(File_t)) { return false; }
+	File_t f;
+	memcpy(&f, data.GetData(), sizeof(File_t));
+	return CheckValidity(f);
+}
+
 void IconSys::DecodeTitle(unsigned char const * str_in, char* str_out)
 {
 	unsigned char t1, t2;
@@ -181,12 +189,27 @@ IconSys::IconSys(const char* fname)
 			                        "File seems to be corrupted") ); 
 	}*/
 
+	DecodeStrings();
+};
+
+IconSys::IconSys(MemorySpan<unsigned char> const& data)
+{
+	if(data.GetSize() < sizeof(File)) {
+		throw( Ghulbus::gbException(Ghulbus::gbException::GB_FAILED,
+		                            "File read error") );
+	}
+	memcpy(&File, data.GetData(), sizeof(File));
+	DecodeStrings();
+}
+
+void IconSys::DecodeStrings()
+{
 	DecodeTitle(File.title, decoded_title);
 	GetTitleString(decoded_title, File.offset_2nd_line, title_str);
 	strcpy(title_str_single_line, title_str);
 	char* tmp = strchr(title_str_single_line, '\n');
 	if(tmp) { *tmp = ' '; }
-};
+}
 
 IconSys::~IconSys()
 {
@@ -411,6 +434,48 @@ void IconSys::WriteFile(const char * fname) {
 	fout.close();
 }
 
+/** Helper function: zeroes the bytes of a string field following the terminating null
+ */
+static void clear_string_tail(unsigned char* str, size_t size, size_t char_size) {
+	size_t i = 0;
+	while((i + char_size <= size) && ((str[i] != 0) || ((char_size == 2) && (str[i+1] != 0)))) { i += char_size; }
+	if(i < size) { memset(str + i, 0, size - i); }
+}
+
+IconSys::Fingerprint IconSys::GetFingerprint() const {
+	File_t f = File;
+	f.reserve1 = 0;
+	f.reserve2 = 0;
+	memset(f.reserve3, 0, sizeof(f.reserve3));
+	clear_string_tail(f.title, sizeof(f.title), 2);
+	clear_string_tail(f.icon_file, sizeof(f.icon_file), 1);
+	clear_string_tail(f.icon_copy_file, sizeof(f.icon_copy_file), 1);
+	clear_string_tail(f.icon_delete_file, sizeof(f.icon_delete_file), 1);
+
+	//the display settings are the contiguous fields from bg_opacity to light_ambient_color:
+	unsigned char const* display_begin = reinterpret_cast<unsigned char const*>(&f.bg_opacity);
+	unsigned char const* display_end   = reinterpret_cast<unsigned char const*>(&f.title);
+	//the strings are preceded by the position of the line break:
+	unsigned char names[sizeof(f.offset_2nd_line) + sizeof(f.title) + 3 * sizeof(f.icon_file)];
+	unsigned char* p = names;
+	memcpy(p, &f.offset_2nd_line, sizeof(f.offset_2nd_line));   p += sizeof(f.offset_2nd_line);
+	memcpy(p, f.title, sizeof(f.title));                         p += sizeof(f.title);
+	memcpy(p, f.icon_file, sizeof(f.icon_file));                 p += sizeof(f.icon_file);
+	memcpy(p, f.icon_copy_file, sizeof(f.icon_copy_file));       p += sizeof(f.icon_copy_file);
+	memcpy(p, f.icon_delete_file, sizeof(f.icon_delete_file));
+
+	Fingerprint ret;
+	ret.display = ContentHash::Compute(display_begin, display_end - display_begin, 5);
+	ret.names   = ContentHash::Compute(names, sizeof(names), 6);
+	ContentHash::Hash128 const parts[2] = { ret.display, ret.names };
+	ret.file    = ContentHash::Combine(parts, 2, 7);
+	return ret;
+}
+
+void IconSys::WriteData(std::vector<unsigned char>* data) const {
+	unsigned char const* p = reinterpret_cast<unsigned char const*>(&File);
+	data->assign(p, p + sizeof(File));
+}
 
 //IMPLEMENTATION of IconSys_Color:
 IconSys::IconSys_Color::IconSys_Color(int const * p): R(p[0]), G(p[1]), B(p[2]), X(p[3])
@@ -0,0 +1,200 @@
+/**
+ * @file src/ps2_iconview.cpp
+ *
+ * @brief Implementation of the PS2IconView classbuild_header/
+ */
+#include "../include/ps2_iconview.hpp"
+#include "../include/ps2_texture.hpp"
+#include <climits>
+#include <cstring>
+
+PS2IconView::PS2IconView(char const* fname): m_file(NULL), m_data(NULL), m_size(0),
+m_record_size(0), m_anim_offset(0), m_texture_offset(0)
+{
+	m_file = new MappedFile(fname);
+	m_data = m_file->GetData();
+	m_size = m_file->GetSize();
+	try {
+		ParseLayout();
+	} catch(...) {
+		delete m_file;
+		m_file = NULL;
+		throw;
+	}
+}
+
+PS2IconView::PS2IconView(MemorySpan<unsigned char> const& data): m_file(NULL), m_data(data.GetData()),
+m_size(data.GetSize()), m_record_size(0), m_anim_offset(0), m_texture_offset(0)
+{
+	ParseLayout();
+}
+
+PS2IconView::~PS2IconView()
+{
+	if(m_file) { delete m_file;  m_file = NULL; }
+}
+
+void PS2IconView::ParseLayout()
+{
+	//header:
+	if(m_size < sizeof(PS2Icon::Icon_Header)) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "File is too small to hold an icon header" ) );
+	}
+	PS2Icon::Icon_Header const& header = GetHeader();
+	if(!PS2Icon::CheckValidity(header)) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Icon Header seems to be corrupted" ) );
+	}
+	if((header.n_vertices > INT_MAX) || (header.animation_shapes > INT_MAX)) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Icon Header seems to be corrupted" ) );
+	}
+
+	//vertex segment; all sizes are checked against the remaining file size to rule out overflows:
+	size_t offset = sizeof(PS2Icon::Icon_Header);
+	if(header.animation_shapes > (m_size - offset) / sizeof(PS2Icon::Vertex_Coord)) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Vertex segment exceeds file size" ) );
+	}
+	m_record_size = sizeof(PS2Icon::Vertex_Coord) * (header.animation_shapes + 1) + sizeof(PS2Icon::Texture_Data);
+	if(header.n_vertices > (m_size - offset) / m_record_size) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Vertex segment exceeds file size" ) );
+	}
+	offset += m_record_size * header.n_vertices;
+
+	//animation segment:
+	if(m_size - offset < sizeof(PS2Icon::Animation_Header)) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Animation header exceeds file size" ) );
+	}
+	m_anim_offset = offset;
+	offset += sizeof(PS2Icon::Animation_Header);
+	PS2Icon::Animation_Header const& anim_header = GetAnimationHeader();
+	if(anim_header.n_frames > (m_size - offset) / sizeof(PS2Icon::Frame_Data)) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Animation segment exceeds file size" ) );
+	}
+	m_frame_offsets.resize(anim_header.n_frames);
+	for(unsigned int i=0; i<anim_header.n_frames; i++) {
+		if(m_size - offset < sizeof(PS2Icon::Frame_Data)) {
+			throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Animation segment exceeds file size" ) );
+		}
+		m_frame_offsets[i] = offset;
+		PS2Icon::Frame_Data const* frame = reinterpret_cast<PS2Icon::Frame_Data const*>(m_data + offset);
+		offset += sizeof(PS2Icon::Frame_Data);
+		if(frame->n_keys > (m_size - offset) / sizeof(PS2Icon::Frame_Key)) {
+			throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Animation segment exceeds file size" ) );
+		}
+		offset += sizeof(PS2Icon::Frame_Key) * frame->n_keys;
+	}
+
+	//texture segment:
+	m_texture_offset = offset;
+	if(IsTextureCompressed()) {
+		if(m_size - offset < 4) {
+			throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Texture segment exceeds file size" ) );
+		}
+		unsigned int data_size = *reinterpret_cast<unsigned int const*>(m_data + offset);
+		if(data_size > m_size - offset - 4) {
+			throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Texture segment exceeds file size" ) );
+		}
+	} else {
+		if(m_size - offset < 16384 * 2) {
+			throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Texture segment exceeds file size" ) );
+		}
+	}
+}
+
+PS2Icon::Icon_Header const& PS2IconView::GetHeader() const {
+	return *reinterpret_cast<PS2Icon::Icon_Header const*>(m_data);
+}
+int PS2IconView::GetNVertices() const {
+	return static_cast<int>(GetHeader().n_vertices);
+}
+int PS2IconView::GetNShapes() const {
+	return static_cast<int>(GetHeader().animation_shapes);
+}
+size_t PS2IconView::GetVertexRecordSize() const {
+	return m_record_size;
+}
+MemorySpan<unsigned char> PS2IconView::GetVertexSegment() const {
+	return MemorySpan<unsigned char>(m_data + sizeof(PS2Icon::Icon_Header),
+	                                 m_record_size * GetHeader().n_vertices);
+}
+MemorySpan<PS2Icon::Vertex_Coord> PS2IconView::GetVertexShapes(int vertex) const {
+	if(static_cast<unsigned int>(vertex) >= GetHeader().n_vertices) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER ) );
+	}
+	unsigned char const* record = m_data + sizeof(PS2Icon::Icon_Header) + m_record_size * vertex;
+	return MemorySpan<PS2Icon::Vertex_Coord>( reinterpret_cast<PS2Icon::Vertex_Coord const*>(record),
+	                                          GetHeader().animation_shapes );
+}
+PS2Icon::Vertex_Coord const& PS2IconView::GetVertexNormal(int vertex) const {
+	if(static_cast<unsigned int>(vertex) >= GetHeader().n_vertices) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER ) );
+	}
+	unsigned char const* record = m_data + sizeof(PS2Icon::Icon_Header) + m_record_size * vertex;
+	return *reinterpret_cast<PS2Icon::Vertex_Coord const*>( record +
+	                                sizeof(PS2Icon::Vertex_Coord) * GetHeader().animation_shapes );
+}
+PS2Icon::Texture_Data const& PS2IconView::GetVertexTexture(int vertex) const {
+	if(static_cast<unsigned int>(vertex) >= GetHeader().n_vertices) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER ) );
+	}
+	unsigned char const* record = m_data + sizeof(PS2Icon::Icon_Header) + m_record_size * vertex;
+	return *reinterpret_cast<PS2Icon::Texture_Data const*>( record +
+	                                sizeof(PS2Icon::Vertex_Coord) * (GetHeader().animation_shapes + 1) );
+}
+PS2Icon::Animation_Header const& PS2IconView::GetAnimationHeader() const {
+	return *reinterpret_cast<PS2Icon::Animation_Header const*>(m_data + m_anim_offset);
+}
+int PS2IconView::GetNFrames() const {
+	return static_cast<int>(m_frame_offsets.size());
+}
+MemorySpan<unsigned char> PS2IconView::GetAnimationSegment() const {
+	size_t begin = m_anim_offset + sizeof(PS2Icon::Animation_Header);
+	return MemorySpan<unsigned char>(m_data + begin, m_texture_offset - begin);
+}
+PS2Icon::Frame_Data const& PS2IconView::GetFrameData(int frame) const {
+	if(static_cast<size_t>(frame) >= m_frame_offsets.size()) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER ) );
+	}
+	return *reinterpret_cast<PS2Icon::Frame_Data const*>(m_data + m_frame_offsets[frame]);
+}
+MemorySpan<PS2Icon::Frame_Key> PS2IconView::GetFrameKeys(int frame) const {
+	PS2Icon::Frame_Data const& frame_data = GetFrameData(frame);
+	return MemorySpan<PS2Icon::Frame_Key>( reinterpret_cast<PS2Icon::Frame_Key const*>(
+	                                           m_data + m_frame_offsets[frame] + sizeof(PS2Icon::Frame_Data) ),
+	                                       frame_data.n_keys );
+}
+bool PS2IconView::IsTextureCompressed() const {
+	return (GetHeader().texture_type > 0x07);
+}
+MemorySpan<unsigned char> PS2IconView::GetTextureSegment() const {
+	if(IsTextureCompressed()) {
+		unsigned int data_size = *reinterpret_cast<unsigned int const*>(m_data + m_texture_offset);
+		return MemorySpan<unsigned char>(m_data + m_texture_offset, 4 + static_cast<size_t>(data_size));
+	} else {
+		return MemorySpan<unsigned char>(m_data + m_texture_offset, 16384 * 2);
+	}
+}
+
+PS2Icon::Fingerprint PS2IconView::GetFingerprint() const {
+	PS2Icon::Fingerprint ret;
+	ret.geometry = PS2Icon::HashGeometry(GetHeader(), GetVertexSegment().GetData());
+	MemorySpan<unsigned char> const animation = GetAnimationSegment();
+	ret.animation = PS2Icon::HashAnimation(GetAnimationHeader(), animation.GetData(), animation.GetSize());
+
+	//the texture is hashed as written by PS2Icon::WriteFile(), regardless of its encoding:
+	MemorySpan<unsigned char> const segment = GetTextureSegment();
+	std::vector<unsigned short> plane(PS2Texture::N_TEXELS);
+	if(!IsTextureCompressed()) {
+		memcpy(&plane[0], segment.GetData(), segment.GetSize());
+		for(int i=0; i<PS2Texture::N_TEXELS; i++) {
+			plane[i] &= 0x7FFF;
+		}
+	} else {
+		std::vector<unsigned int> texels(PS2Texture::N_TEXELS);
+		PS2Texture::DecodeRLE(segment.GetData() + 4, segment.GetSize() - 4, &texels[0], PS2Texture::ALPHA_OPAQUE);
+		PS2Texture::Pack(&texels[0], &plane[0], PS2Texture::N_TEXELS, PS2Texture::ALPHA_OPAQUE);
+	}
+	ret.texture = PS2Icon::HashTexture(&plane[0]);
+
+	PS2Icon::CombineFingerprint(&ret);
+	return ret;
+}
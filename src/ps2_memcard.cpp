@@ -0,0 +1,265 @@
+/**
+ * @file src/ps2_memcard.cpp
+ *
+ * @brief Implementation of the PS2MemoryCard classbuild_header/
+ */
+#include "../include/ps2_memcard.hpp"
+#include "../include/ps2_ecc.hpp"
+#include <cctype>
+#include <cstring>
+
+/** Helper function: compares two strings ignoring the case of ASCII letters
+ */
+static bool equal_ignore_case(char const* a, char const* b) {
+	for(; *a && *b; a++, b++) {
+		if(tolower(static_cast<unsigned char>(*a)) != tolower(static_cast<unsigned char>(*b))) { return false; }
+	}
+	return (*a == *b);
+}
+
+/** Helper function: copies a name field that is not necessarily null terminated
+ */
+inline std::string entry_name(char const* name, size_t max_len) {
+	size_t len = 0;
+	while((len < max_len) && name[len]) { len++; }
+	return std::string(name, len);
+}
+
+PS2MemoryCard::PS2MemoryCard(char const* fname): m_file(NULL), m_data(NULL), m_size(0),
+m_raw_page_size(0), m_cluster_size(0), m_n_pages(0)
+{
+	m_file = new MappedFile(fname);
+	m_data = m_file->GetData();
+	m_size = m_file->GetSize();
+	try {
+		ParseCard();
+	} catch(...) {
+		delete m_file;
+		m_file = NULL;
+		throw;
+	}
+}
+
+PS2MemoryCard::PS2MemoryCard(MemorySpan<unsigned char> const& data): m_file(NULL), m_data(data.GetData()),
+m_size(data.GetSize()), m_raw_page_size(0), m_cluster_size(0), m_n_pages(0)
+{
+	ParseCard();
+}
+
+PS2MemoryCard::~PS2MemoryCard()
+{
+	if(m_file) { delete m_file;  m_file = NULL; }
+}
+
+void PS2MemoryCard::ParseCard()
+{
+	//superblock:
+	if(m_size < sizeof(Superblock)) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "File is too small to hold a memory card superblock" ) );
+	}
+	memcpy(&m_superblock, m_data, sizeof(Superblock));
+	Superblock const& sb = m_superblock;
+	if(memcmp(sb.magic, "Sony PS2 Memory Card Format ", 28) != 0) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Not a PS2 memory card image" ) );
+	}
+	if( ((sb.page_len != 512) && (sb.page_len != 1024)) ||
+	    (sb.pages_per_cluster == 0) || (sb.pages_per_cluster > 16) ||
+	    (sb.clusters_per_card == 0) || (sb.clusters_per_card > (1u << 24)) ||
+	    (sb.alloc_offset >= sb.clusters_per_card) ||
+	    (sb.alloc_end > sb.clusters_per_card - sb.alloc_offset) ||
+	    (sb.rootdir_cluster >= sb.alloc_end) )
+	{
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Memory card superblock seems to be corrupted" ) );
+	}
+	m_cluster_size = static_cast<size_t>(sb.page_len) * sb.pages_per_cluster;
+	m_n_pages = sb.clusters_per_card * sb.pages_per_cluster;
+
+	//the image size tells whether the pages carry their spare areas:
+	size_t const spare_size = sb.page_len / 32;
+	if(m_size / m_n_pages >= sb.page_len + spare_size) {
+		m_raw_page_size = sb.page_len + spare_size;
+	} else if(m_size / m_n_pages >= sb.page_len) {
+		m_raw_page_size = sb.page_len;
+	} else {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Memory card image is truncated" ) );
+	}
+
+	//directory tree; saves are the subdirectories of the root directory:
+	std::vector<Dir_Entry> root;
+	ReadDirectory(sb.rootdir_cluster, &root);
+	std::vector<Dir_Entry> dir;
+	for(size_t i=2; i<root.size(); i++) {
+		Dir_Entry const& e = root[i];
+		if(((e.mode & DF_EXISTS) == 0) || ((e.mode & DF_DIRECTORY) == 0)) { continue; }
+		Save_Dir save;
+		save.name = entry_name(e.name, sizeof(e.name));
+		ReadDirectory(e.cluster, &dir);
+		for(size_t j=2; j<dir.size(); j++) {
+			Dir_Entry const& f = dir[j];
+			if(((f.mode & DF_EXISTS) == 0) || ((f.mode & DF_FILE) == 0)) { continue; }
+			Save_File file;
+			file.name    = entry_name(f.name, sizeof(f.name));
+			file.length  = f.length;
+			file.cluster = f.cluster;
+			save.files.push_back(file);
+		}
+		m_saves.push_back(save);
+	}
+}
+
+unsigned char const* PS2MemoryCard::GetPage(unsigned int page) const {
+	if(page >= m_n_pages) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Page index exceeds card size" ) );
+	}
+	return m_data + static_cast<size_t>(page) * m_raw_page_size;
+}
+
+unsigned int PS2MemoryCard::ReadClusterWord(unsigned int cluster, unsigned int index) const {
+	size_t const words_per_page = m_superblock.page_len / 4;
+	if((cluster >= m_superblock.clusters_per_card) || (index >= m_cluster_size / 4)) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "FAT references a cluster outside of the card" ) );
+	}
+	unsigned char const* page = GetPage( static_cast<unsigned int>(cluster * m_superblock.pages_per_cluster +
+	                                                               index / words_per_page) );
+	unsigned int ret;
+	memcpy(&ret, page + (index % words_per_page) * 4, 4);
+	return ret;
+}
+
+unsigned int PS2MemoryCard::GetFATEntry(unsigned int cluster) const {
+	unsigned int const entries_per_cluster = static_cast<unsigned int>(m_cluster_size / 4);
+	unsigned int const fat_index = cluster / entries_per_cluster;
+	unsigned int const ifc_index = fat_index / entries_per_cluster;
+	if(ifc_index >= 32) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "FAT references a cluster outside of the card" ) );
+	}
+	unsigned int const fat_cluster = ReadClusterWord(m_superblock.ifc_list[ifc_index], fat_index % entries_per_cluster);
+	return ReadClusterWord(fat_cluster, cluster % entries_per_cluster);
+}
+
+void PS2MemoryCard::ReadChain(unsigned int cluster, size_t length, std::vector<unsigned char>* data) const {
+	//the length comes from a directory entry; check it before allocating the buffer:
+	size_t const n_clusters = length / m_cluster_size + ((length % m_cluster_size != 0) ? 1 : 0);
+	if(n_clusters > m_superblock.alloc_end) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "File length exceeds the card size" ) );
+	}
+	data->resize(length);
+	size_t const page_len = m_superblock.page_len;
+	size_t offset = 0;
+	//a valid chain never visits more clusters than the card has; this also stops FAT loops:
+	unsigned int n_visited = 0;
+	while(offset < length) {
+		if((cluster >= m_superblock.alloc_end) || (++n_visited > m_superblock.alloc_end)) {
+			throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Cluster chain seems to be corrupted" ) );
+		}
+		unsigned int const first_page = (m_superblock.alloc_offset + cluster) * m_superblock.pages_per_cluster;
+		for(unsigned int p=0; (p<m_superblock.pages_per_cluster) && (offset < length); p++) {
+			size_t const n = (length - offset < page_len) ? (length - offset) : page_len;
+			memcpy(&(*data)[offset], GetPage(first_page + p), n);
+			offset += n;
+		}
+		if(offset < length) {
+			unsigned int const entry = GetFATEntry(cluster);
+			if( ((entry & FAT_ALLOCATED) == 0) || ((entry & ~FAT_ALLOCATED) == FAT_CHAIN_END) ) {
+				throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Cluster chain ends before the end of the file" ) );
+			}
+			cluster = entry & ~FAT_ALLOCATED;
+		}
+	}
+}
+
+void PS2MemoryCard::ReadDirectory(unsigned int cluster, std::vector<Dir_Entry>* entries) const {
+	//the "." entry at the start of the first cluster holds the number of entries:
+	std::vector<unsigned char> buffer;
+	ReadChain(cluster, sizeof(Dir_Entry), &buffer);
+	Dir_Entry self;
+	memcpy(&self, &buffer[0], sizeof(Dir_Entry));
+	if((self.length < 2) || (self.length > m_superblock.alloc_end * (m_cluster_size / sizeof(Dir_Entry)))) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Directory entry seems to be corrupted" ) );
+	}
+	ReadChain(cluster, static_cast<size_t>(self.length) * sizeof(Dir_Entry), &buffer);
+	entries->resize(self.length);
+	memcpy(&(*entries)[0], &buffer[0], buffer.size());
+}
+
+PS2MemoryCard::Superblock const& PS2MemoryCard::GetSuperblock() const {
+	return m_superblock;
+}
+bool PS2MemoryCard::HasECC() const {
+	return (m_raw_page_size > m_superblock.page_len);
+}
+unsigned int PS2MemoryCard::VerifyECC() const {
+	if(!HasECC()) { return 0; }
+	size_t const page_len = m_superblock.page_len;
+	size_t const code_len = (page_len / PS2ECC::CHUNK_SIZE) * PS2ECC::CODE_SIZE;
+	unsigned int n_bad = 0;
+	for(unsigned int p=0; p<m_n_pages; p++) {
+		unsigned char const* page  = GetPage(p);
+		unsigned char const* spare = page + page_len;
+		size_t i = 0;
+		while((i < code_len) && (spare[i] == 0xFF)) { i++; }
+		if((i < code_len) && !PS2ECC::VerifyPage(page, page_len, spare)) { n_bad++; }
+	}
+	return n_bad;
+}
+int PS2MemoryCard::GetNSaves() const {
+	return static_cast<int>(m_saves.size());
+}
+char const* PS2MemoryCard::GetSaveName(int save) const {
+	if(static_cast<size_t>(save) >= m_saves.size()) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER ) );
+	}
+	return m_saves[save].name.c_str();
+}
+int PS2MemoryCard::FindSave(char const* name) const {
+	for(size_t i=0; i<m_saves.size(); i++) {
+		if(m_saves[i].name == name) { return static_cast<int>(i); }
+	}
+	return -1;
+}
+int PS2MemoryCard::GetNFiles(int save) const {
+	if(static_cast<size_t>(save) >= m_saves.size()) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER ) );
+	}
+	return static_cast<int>(m_saves[save].files.size());
+}
+char const* PS2MemoryCard::GetFileName(int save, int file) const {
+	if(static_cast<unsigned int>(file) >= static_cast<unsigned int>(GetNFiles(save))) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER ) );
+	}
+	return m_saves[save].files[file].name.c_str();
+}
+size_t PS2MemoryCard::GetFileSize(int save, int file) const {
+	if(static_cast<unsigned int>(file) >= static_cast<unsigned int>(GetNFiles(save))) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER ) );
+	}
+	return m_saves[save].files[file].length;
+}
+int PS2MemoryCard::FindFile(int save, char const* name) const {
+	int const n_files = GetNFiles(save);
+	for(int i=0; i<n_files; i++) {
+		if(equal_ignore_case(m_saves[save].files[i].name.c_str(), name)) { return i; }
+	}
+	return -1;
+}
+
+void PS2MemoryCard::ReadFile(int save, int file, std::vector<unsigned char>* data) const {
+	if(static_cast<unsigned int>(file) >= static_cast<unsigned int>(GetNFiles(save))) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER ) );
+	}
+	Save_File const& f = m_saves[save].files[file];
+	ReadChain(f.cluster, f.length, data);
+}
+
+void PS2MemoryCard::ReadFile(char const* path, std::vector<unsigned char>* data) const {
+	char const* separator = strchr(path, '/');
+	if(!separator) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER, "Path must be of the form directory/file" ) );
+	}
+	int const save = FindSave( std::string(path, separator - path).c_str() );
+	int const file = (save >= 0) ? FindFile(save, separator + 1) : -1;
+	if(file < 0) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER, "File not found on memory card" ) );
+	}
+	ReadFile(save, file, data);
+}
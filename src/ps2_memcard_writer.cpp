@@ -0,0 +1,299 @@
+/**
+ * @file src/ps2_memcard_writer.cpp
+ *
+ * @brief Implementation of the PS2MemoryCardWriter classbuild_header/
+ */
+#include "../include/ps2_memcard_writer.hpp"
+#include "../include/ps2_ecc.hpp"
+#include <cstring>
+#include <ctime>
+#include <fstream>
+
+static unsigned int const CLUSTER_SIZE  = PS2MemoryCardWriter::PAGE_LEN * PS2MemoryCardWriter::PAGES_PER_CLUSTER;
+static unsigned int const SPARE_SIZE    = PS2MemoryCardWriter::PAGE_LEN / 32;
+static unsigned int const IFC_CLUSTER   = 8;				///< cluster of the indirect FAT
+static unsigned int const FAT_CLUSTER   = 9;				///< first cluster of the FAT
+static unsigned int const FAT_CLUSTERS  = 32;				///< clusters of the FAT
+static unsigned int const BACKUP_BLOCKS = 2;				///< erase blocks reserved for backup at the end of the card
+static unsigned int const PAGES_PER_ERASE_BLOCK = 16;
+static unsigned int const ENTRIES_PER_CLUSTER = CLUSTER_SIZE / sizeof(PS2MemoryCard::Dir_Entry);
+
+/** Mode of "." entries and of subdirectories */
+static unsigned short const MODE_DIR    = PS2MemoryCard::DF_READ | PS2MemoryCard::DF_WRITE | PS2MemoryCard::DF_EXECUTE |
+                                        PS2MemoryCard::DF_DIRECTORY | PS2MemoryCard::DF_0400 | PS2MemoryCard::DF_EXISTS;
+/** Mode of ".." entries */
+static unsigned short const MODE_PARENT = PS2MemoryCard::DF_WRITE | PS2MemoryCard::DF_EXECUTE | PS2MemoryCard::DF_DIRECTORY |
+                                        PS2MemoryCard::DF_0400 | PS2MemoryCard::DF_HIDDEN | PS2MemoryCard::DF_EXISTS;
+/** Mode of files */
+static unsigned short const MODE_FILE   = PS2MemoryCard::DF_READ | PS2MemoryCard::DF_WRITE | PS2MemoryCard::DF_EXECUTE |
+                                        PS2MemoryCard::DF_FILE | PS2MemoryCard::DF_0080 | PS2MemoryCard::DF_EXISTS;
+
+PS2MemoryCardWriter::PS2MemoryCardWriter(): m_n_used(0)
+{
+	PS2MemoryCard::Superblock& sb = m_superblock;
+	memset(&sb, 0, sizeof(sb));
+	memcpy(sb.magic, "Sony PS2 Memory Card Format ", 28);
+	memcpy(sb.version, "1.2.0.0", 7);
+	sb.page_len              = PAGE_LEN;
+	sb.pages_per_cluster     = PAGES_PER_CLUSTER;
+	sb.pages_per_erase_block = PAGES_PER_ERASE_BLOCK;
+	sb.unknown               = 0xFF00;
+	sb.clusters_per_card     = CLUSTERS_PER_CARD;
+	sb.alloc_offset          = FAT_CLUSTER + FAT_CLUSTERS;
+	sb.alloc_end             = CLUSTERS_PER_CARD - sb.alloc_offset -
+	                           BACKUP_BLOCKS * PAGES_PER_ERASE_BLOCK / PAGES_PER_CLUSTER;
+	sb.rootdir_cluster       = 0;
+	sb.backup_block1         = CLUSTERS_PER_CARD * PAGES_PER_CLUSTER / PAGES_PER_ERASE_BLOCK - 1;
+	sb.backup_block2         = sb.backup_block1 - 1;
+	sb.ifc_list[0]           = IFC_CLUSTER;
+	memset(sb.bad_block_list, 0xFF, sizeof(sb.bad_block_list));
+	sb.card_type             = 2;
+	sb.card_flags            = 0x52;
+	//the empty root directory:
+	Allocate(DirClustersFor(2));
+}
+
+unsigned int PS2MemoryCardWriter::ClustersFor(size_t size) {
+	return static_cast<unsigned int>((size + CLUSTER_SIZE - 1) / CLUSTER_SIZE);
+}
+
+unsigned int PS2MemoryCardWriter::DirClustersFor(size_t n_entries) {
+	return static_cast<unsigned int>((n_entries + ENTRIES_PER_CLUSTER - 1) / ENTRIES_PER_CLUSTER);
+}
+
+void PS2MemoryCardWriter::Allocate(unsigned int n_clusters) {
+	if(n_clusters > m_superblock.alloc_end - m_n_used) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Memory card is full" ) );
+	}
+	m_n_used += n_clusters;
+}
+
+void PS2MemoryCardWriter::CheckName(char const* name, std::vector<std::string> const& taken) {
+	size_t const len = strlen(name);
+	if( (len == 0) || (len > MAX_NAME_LEN) || (strchr(name, '/') != NULL) ||
+	    (strcmp(name, ".") == 0) || (strcmp(name, "..") == 0) )
+	{
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER, "Invalid memory card entry name" ) );
+	}
+	for(size_t i=0; i<taken.size(); i++) {
+		if(taken[i] == name) {
+			throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER, "Duplicate memory card entry name" ) );
+		}
+	}
+}
+
+int PS2MemoryCardWriter::AddSave(char const* name) {
+	std::vector<std::string> taken;
+	taken.reserve(m_saves.size());
+	for(size_t i=0; i<m_saves.size(); i++) {
+		taken.push_back(m_saves[i].name);
+	}
+	CheckName(name, taken);
+	//the new directory plus the growth of the root directory:
+	size_t const n_root = m_saves.size() + 2;
+	Allocate( DirClustersFor(2) + DirClustersFor(n_root + 1) - DirClustersFor(n_root) );
+	m_saves.push_back(Save_Dir());
+	m_saves.back().name = name;
+	return static_cast<int>(m_saves.size() - 1);
+}
+
+int PS2MemoryCardWriter::GetNSaves() const {
+	return static_cast<int>(m_saves.size());
+}
+
+void PS2MemoryCardWriter::AddFile(int save, char const* name, MemorySpan<unsigned char> const& data) {
+	if(static_cast<size_t>(save) >= m_saves.size()) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER ) );
+	}
+	Save_Dir& dir = m_saves[save];
+	std::vector<std::string> taken;
+	taken.reserve(dir.files.size());
+	for(size_t i=0; i<dir.files.size(); i++) {
+		taken.push_back(dir.files[i].name);
+	}
+	CheckName(name, taken);
+	if(data.GetSize() > 0xFFFFFFFFu) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Memory card is full" ) );
+	}
+	//the file plus the growth of its directory:
+	size_t const n_dir = dir.files.size() + 2;
+	unsigned int const n_clusters = ClustersFor(data.GetSize()) + DirClustersFor(n_dir + 1) - DirClustersFor(n_dir);
+	Allocate(n_clusters);
+	try {
+		dir.files.push_back(Save_File());
+		dir.files.back().name = name;
+		dir.files.back().data.assign(data.GetData(), data.GetData() + data.GetSize());
+	} catch(...) {
+		if(dir.files.size() > n_dir - 2) { dir.files.pop_back(); }
+		m_n_used -= n_clusters;
+		throw;
+	}
+}
+
+void PS2MemoryCardWriter::AddIconSys(int save, IconSys const& icon_sys) {
+	std::vector<unsigned char> data;
+	icon_sys.WriteData(&data);
+	AddFile(save, "icon.sys", MemorySpan<unsigned char>(&data[0], data.size()));
+}
+
+void PS2MemoryCardWriter::AddIcon(int save, char const* name, PS2Icon const& icon, PS2Icon::TextureEncoding encoding) {
+	std::vector<unsigned char> data;
+	icon.WriteData(&data, encoding);
+	AddFile(save, name, MemorySpan<unsigned char>(&data[0], data.size()));
+}
+
+unsigned int PS2MemoryCardWriter::GetNUsedClusters() const {
+	return m_n_used;
+}
+
+unsigned int PS2MemoryCardWriter::GetNClusters() const {
+	return m_superblock.alloc_end;
+}
+
+void PS2MemoryCardWriter::MakeEntry(PS2MemoryCard::Dir_Entry* entry, char const* name, unsigned short mode,
+                                    unsigned int length, unsigned int cluster, unsigned int dir_entry,
+                                    PS2MemoryCard::Time_Stamp const& time)
+{
+	memset(entry, 0, sizeof(PS2MemoryCard::Dir_Entry));
+	entry->mode      = mode;
+	entry->length    = length;
+	entry->created   = time;
+	entry->cluster   = cluster;
+	entry->dir_entry = dir_entry;
+	entry->modified  = time;
+	strncpy(entry->name, name, sizeof(entry->name) - 1);
+}
+
+void PS2MemoryCardWriter::Write(char const* fname, bool with_ecc) const {
+	PS2MemoryCard::Superblock const& sb = m_superblock;
+	PS2MemoryCard::Time_Stamp now;
+	memset(&now, 0, sizeof(now));
+	time_t const t = time(NULL);
+	struct tm const* tm = gmtime(&t);
+	if(tm) {
+		now.second = static_cast<unsigned char>(tm->tm_sec);
+		now.minute = static_cast<unsigned char>(tm->tm_min);
+		now.hour   = static_cast<unsigned char>(tm->tm_hour);
+		now.day    = static_cast<unsigned char>(tm->tm_mday);
+		now.month  = static_cast<unsigned char>(tm->tm_mon + 1);
+		now.year   = static_cast<unsigned short>(tm->tm_year + 1900);
+	}
+
+	//lay out all directories and files as contiguous extents, in order of allocation:
+	std::vector<Extent> extents;
+	std::vector< std::vector<unsigned char> > dirs(m_saves.size() + 1);
+	std::vector<unsigned int> dir_clusters(m_saves.size());
+	std::vector< std::vector<unsigned int> > file_clusters(m_saves.size());
+	unsigned int next = sb.rootdir_cluster + DirClustersFor(m_saves.size() + 2);
+	for(size_t i=0; i<m_saves.size(); i++) {
+		Save_Dir const& dir = m_saves[i];
+		dir_clusters[i] = next;
+		next += DirClustersFor(dir.files.size() + 2);
+		file_clusters[i].resize(dir.files.size());
+		for(size_t j=0; j<dir.files.size(); j++) {
+			//empty files own no cluster:
+			file_clusters[i][j] = dir.files[j].data.empty() ? PS2MemoryCard::FAT_CHAIN_END : next;
+			next += ClustersFor(dir.files[j].data.size());
+		}
+	}
+
+	//directory contents:
+	PS2MemoryCard::Dir_Entry entry;
+	std::vector<unsigned char>& root = dirs[0];
+	root.resize((m_saves.size() + 2) * sizeof(entry));
+	MakeEntry(&entry, ".", MODE_DIR, static_cast<unsigned int>(m_saves.size() + 2), 0, 0, now);
+	memcpy(&root[0], &entry, sizeof(entry));
+	MakeEntry(&entry, "..", MODE_PARENT, 0, 0, 0, now);
+	memcpy(&root[sizeof(entry)], &entry, sizeof(entry));
+	Extent e;
+	e.cluster    = sb.rootdir_cluster;
+	e.n_clusters = DirClustersFor(m_saves.size() + 2);
+	e.data       = &root;
+	extents.push_back(e);
+	for(size_t i=0; i<m_saves.size(); i++) {
+		Save_Dir const& dir = m_saves[i];
+		unsigned int const n_entries = static_cast<unsigned int>(dir.files.size() + 2);
+		MakeEntry(&entry, dir.name.c_str(), MODE_DIR, n_entries, dir_clusters[i], 0, now);
+		memcpy(&root[(i + 2) * sizeof(entry)], &entry, sizeof(entry));
+
+		std::vector<unsigned char>& buffer = dirs[i + 1];
+		buffer.resize(n_entries * sizeof(entry));
+		//"." refers to the entry of the directory in its parent:
+		MakeEntry(&entry, ".", MODE_DIR, n_entries, sb.rootdir_cluster, static_cast<unsigned int>(i + 2), now);
+		memcpy(&buffer[0], &entry, sizeof(entry));
+		MakeEntry(&entry, "..", MODE_PARENT, 0, 0, 0, now);
+		memcpy(&buffer[sizeof(entry)], &entry, sizeof(entry));
+		e.cluster    = dir_clusters[i];
+		e.n_clusters = DirClustersFor(n_entries);
+		e.data       = &buffer;
+		extents.push_back(e);
+		for(size_t j=0; j<dir.files.size(); j++) {
+			Save_File const& f = dir.files[j];
+			MakeEntry(&entry, f.name.c_str(), MODE_FILE, static_cast<unsigned int>(f.data.size()),
+			          file_clusters[i][j], 0, now);
+			memcpy(&buffer[(j + 2) * sizeof(entry)], &entry, sizeof(entry));
+			if(!f.data.empty()) {
+				e.cluster    = file_clusters[i][j];
+				e.n_clusters = ClustersFor(f.data.size());
+				e.data       = &f.data;
+				extents.push_back(e);
+			}
+		}
+	}
+
+	//FAT; every extent is a single chain:
+	std::vector<unsigned int> fat(FAT_CLUSTERS * CLUSTER_SIZE / 4, 0xFFFFFFFF);
+	for(unsigned int i=0; i<sb.alloc_end; i++) {
+		fat[i] = PS2MemoryCard::FAT_CHAIN_END;
+	}
+	for(size_t i=0; i<extents.size(); i++) {
+		for(unsigned int c=0; c<extents[i].n_clusters; c++) {
+			unsigned int const cluster = extents[i].cluster + c;
+			fat[cluster] = PS2MemoryCard::FAT_ALLOCATED |
+			               ((c + 1 < extents[i].n_clusters) ? (cluster + 1) : PS2MemoryCard::FAT_CHAIN_END);
+		}
+	}
+
+	std::ofstream fout(fname, std::ios_base::out | std::ios_base::binary);
+	if(fout.fail()) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Output memory card file could not be opened" ) );
+	}
+	//emit the card cluster by cluster; unused space is left in the erased state (0xFF):
+	unsigned char cluster[CLUSTER_SIZE];
+	unsigned char spare[SPARE_SIZE];
+	size_t current_extent = 0;
+	for(unsigned int c=0; c<CLUSTERS_PER_CARD; c++) {
+		memset(cluster, 0xFF, sizeof(cluster));
+		if(c == 0) {
+			memcpy(cluster, &sb, sizeof(sb));
+		} else if(c == IFC_CLUSTER) {
+			memset(cluster, 0, sizeof(cluster));
+			for(unsigned int i=0; i<FAT_CLUSTERS; i++) {
+				unsigned int const fat_cluster = FAT_CLUSTER + i;
+				memcpy(cluster + i*4, &fat_cluster, 4);
+			}
+		} else if((c >= FAT_CLUSTER) && (c < FAT_CLUSTER + FAT_CLUSTERS)) {
+			memcpy(cluster, &fat[(c - FAT_CLUSTER) * (CLUSTER_SIZE / 4)], CLUSTER_SIZE);
+		} else if((c >= sb.alloc_offset) && (current_extent < extents.size())) {
+			Extent const& x = extents[current_extent];
+			unsigned int const rel = c - sb.alloc_offset;
+			if(rel >= x.cluster) {
+				size_t const offset = static_cast<size_t>(rel - x.cluster) * CLUSTER_SIZE;
+				size_t const n = (x.data->size() - offset < CLUSTER_SIZE) ? (x.data->size() - offset) : CLUSTER_SIZE;
+				memcpy(cluster, &(*x.data)[offset], n);
+				if(rel + 1 == x.cluster + x.n_clusters) { current_extent++; }
+			}
+		}
+		for(unsigned int p=0; p<PAGES_PER_CLUSTER; p++) {
+			fout.write(reinterpret_cast<char const*>(cluster + p*PAGE_LEN), PAGE_LEN);
+			if(with_ecc) {
+				PS2ECC::CalculatePage(cluster + p*PAGE_LEN, PAGE_LEN, spare);
+				fout.write(reinterpret_cast<char const*>(spare), SPARE_SIZE);
+			}
+		}
+	}
+	fout.close();
+	if(fout.fail()) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Error while writing output memory card file" ) );
+	}
+}
@@ -0,0 +1,174 @@
+/**
+ * @file src/ps2_preview.cpp
+ *
+ * @brief Implementation of the IconPreviewRenderer classbuild_header/
+ */
+#include "../include/ps2_preview.hpp"
+#include "../gbLib/include/gbImageLoader.hpp"
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+/** Samples the geometry of one displayed frame per item
+ */
+class PreviewGeometryJob: public ThreadPool::Job {
+private:
+	IconAnimator const& m_animator;
+	float* m_geometry;
+	size_t m_frame_size;
+public:
+	PreviewGeometryJob(IconAnimator const& animator, float* geometry, size_t frame_size)
+		:m_animator(animator), m_geometry(geometry), m_frame_size(frame_size) {}
+	void Run(int item, int /* thread */) {
+		m_animator.EvaluateFrame(item, m_geometry + static_cast<size_t>(item) * m_frame_size);
+	}
+private:
+	PreviewGeometryJob& operator=(PreviewGeometryJob const&);	///< private copy assignment (not implemented!)
+};
+
+/** Renders one displayed frame per item with the rasterizer of the executing thread
+ */
+class PreviewRenderJob: public ThreadPool::Job {
+private:
+	PS2Icon const& m_icon;
+	std::vector<IconRasterizer*> const& m_rasterizers;
+	float const* m_geometry;
+	size_t m_frame_size;
+	unsigned int* m_frames;
+	size_t m_image_size;
+public:
+	PreviewRenderJob(PS2Icon const& icon, std::vector<IconRasterizer*> const& rasterizers,
+	                 float const* geometry, size_t frame_size, unsigned int* frames, size_t image_size)
+		:m_icon(icon), m_rasterizers(rasterizers), m_geometry(geometry), m_frame_size(frame_size),
+		 m_frames(frames), m_image_size(image_size) {}
+	void Run(int item, int thread) {
+		IconRasterizer* rasterizer = m_rasterizers[thread];
+		rasterizer->Render(m_icon, m_geometry + static_cast<size_t>(item) * m_frame_size);
+		rasterizer->GetImage(m_frames + static_cast<size_t>(item) * m_image_size);
+	}
+private:
+	PreviewRenderJob& operator=(PreviewRenderJob const&);		///< private copy assignment (not implemented!)
+};
+
+IconPreviewRenderer::IconPreviewRenderer(PS2Icon const& icon, int width, int height, int n_threads)
+	:m_icon(&icon), m_width(width), m_height(height), m_n_frames(0), m_animator(icon), m_pool(n_threads)
+{
+	if( (width <= 0) || (width > IconRasterizer::MAX_SIZE) ||
+	    (height <= 0) || (height > IconRasterizer::MAX_SIZE) )
+	{
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER, "Invalid preview size" ) );
+	}
+	m_n_frames = m_animator.GetNDisplayFrames();
+	int const n_vertices = icon.GetNVertices();
+
+	//read the lazily loaded texture now (the animator already read the geometry);
+	//the worker threads only ever read the icon:
+	icon.GetTextureData(0, 0);
+
+	size_t const frame_size = static_cast<size_t>(n_vertices) * 3;
+	try {
+		m_rasterizers.reserve(m_pool.GetNThreads());
+		for(int i=0; i<m_pool.GetNThreads(); i++) {
+			m_rasterizers.push_back(new IconRasterizer(width, height));
+		}
+		m_geometry.resize(frame_size * m_n_frames + 1);
+		m_frames.resize(static_cast<size_t>(width) * height * m_n_frames);
+		PreviewGeometryJob job(m_animator, &m_geometry[0], frame_size);
+		m_pool.Run(job, m_n_frames);
+	} catch(...) {
+		for(size_t i=0; i<m_rasterizers.size(); i++) {
+			delete m_rasterizers[i];
+		}
+		throw;
+	}
+
+	//one view for the whole loop, fitted to the vertices of all frames:
+	for(size_t i=0; i<m_rasterizers.size(); i++) {
+		m_rasterizers[i]->FitView(&m_geometry[0], n_vertices * m_n_frames);
+	}
+}
+
+IconPreviewRenderer::~IconPreviewRenderer()
+{
+	for(size_t i=0; i<m_rasterizers.size(); i++) {
+		delete m_rasterizers[i];
+	}
+}
+
+int IconPreviewRenderer::GetWidth() const {
+	return m_width;
+}
+
+int IconPreviewRenderer::GetHeight() const {
+	return m_height;
+}
+
+int IconPreviewRenderer::GetNFrames() const {
+	return m_n_frames;
+}
+
+int IconPreviewRenderer::GetNThreads() const {
+	return m_pool.GetNThreads();
+}
+
+void IconPreviewRenderer::SetLighting(IconSys const& icon_sys) {
+	for(size_t i=0; i<m_rasterizers.size(); i++) {
+		m_rasterizers[i]->SetLighting(icon_sys);
+	}
+}
+
+void IconPreviewRenderer::RenderFrames() {
+	size_t const frame_size = static_cast<size_t>(m_icon->GetNVertices()) * 3;
+	size_t const image_size = static_cast<size_t>(m_width) * m_height;
+	PreviewRenderJob job(*m_icon, m_rasterizers, &m_geometry[0], frame_size, &m_frames[0], image_size);
+	m_pool.Run(job, m_n_frames);
+}
+
+void IconPreviewRenderer::GetFrame(int frame, unsigned int* data) const {
+	if((frame < 0) || (frame >= m_n_frames)) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER, "Frame index out of range" ) );
+	}
+	size_t const image_size = static_cast<size_t>(m_width) * m_height;
+	memcpy(data, &m_frames[0] + static_cast<size_t>(frame) * image_size, sizeof(unsigned int) * image_size);
+}
+
+void IconPreviewRenderer::WriteSpriteSheet(char const* fname, int columns) const {
+	if(columns <= 0) {
+		columns = static_cast<int>( std::ceil(std::sqrt(static_cast<double>(m_n_frames))) );
+	}
+	if(columns > m_n_frames) {
+		columns = m_n_frames;
+	}
+	int const rows = (m_n_frames + columns - 1) / columns;
+	if( (columns > USHRT_MAX / m_width) || (rows > USHRT_MAX / m_height) ) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER, "Sprite sheet too large" ) );
+	}
+	int const sheet_width  = columns * m_width;
+	int const sheet_height = rows * m_height;
+	size_t const image_size = static_cast<size_t>(m_width) * m_height;
+	//cells without a frame stay transparent:
+	std::vector<unsigned int> sheet(static_cast<size_t>(sheet_width) * sheet_height, 0);
+	for(int f=0; f<m_n_frames; f++) {
+		unsigned int const* src = &m_frames[0] + static_cast<size_t>(f) * image_size;
+		unsigned int* dst = &sheet[0] + static_cast<size_t>(f / columns) * m_height * sheet_width
+		                              + static_cast<size_t>(f % columns) * m_width;
+		for(int y=0; y<m_height; y++) {
+			memcpy(dst + static_cast<size_t>(y) * sheet_width, src + static_cast<size_t>(y) * m_width,
+			       sizeof(unsigned int) * m_width);
+		}
+	}
+	GhulbusUtil::WriteImage(fname, &sheet[0], sheet_width, sheet_height);
+}
+
+void IconPreviewRenderer::WriteFrameSequence(char const* prefix) const {
+	size_t const image_size = static_cast<size_t>(m_width) * m_height;
+	for(int f=0; f<m_n_frames; f++) {
+		std::ostringstream fname;
+		fname << prefix << "_" << std::setw(4) << std::setfill('0') << f << ".tga";
+		GhulbusUtil::WriteImage(fname.str().c_str(), &m_frames[0] + static_cast<size_t>(f) * image_size,
+		                        m_width, m_height);
+	}
+}
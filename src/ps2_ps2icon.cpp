@@ -4,20 +4,12 @@
  * @brief Implementation of the PS2Icon classbuild_header/
  */
 #include "../include/ps2_ps2icon.hpp"
+#include "../include/ps2_iconview.hpp"
+#include "../include/ps2_fixedpoint.hpp"
+#include "../include/ps2_texture.hpp"
 #include <cstring>
 #include <climits>
-
-/** Helper function: converts float32 to float16
- */
-inline short convert_f32_to_f16(float const& f) {
-	return( static_cast<short>(f * 4096.0f) );
-}
-
-/** Helper function: converts float16 to float32
- */
-inline float convert_f16_to_f32(short const& i) {
-	return( static_cast<float>(i) / 4096.0f );	
-}
+#include <vector>
 
 bool PS2Icon::CheckValidity(PS2Icon::Icon_Header const& p) {
 	if( (p.file_id != 0x010000) ||
@@ -37,24 +29,53 @@ bool PS2Icon::CheckValidity(PS2Icon::Icon_Header const& p) {
 	return true;
 }
 
-PS2Icon::PS2Icon(const char *fname): vertices(NULL), normals(NULL), vert_texture(NULL),
-fvertices(NULL), fnormals(NULL), animation(NULL), anim_keys(NULL)
+PS2Icon::PS2Icon(const char *fname): arena(NULL), vertices(NULL), normals(NULL), vert_texture(NULL),
+fvertices(NULL), fnormals(NULL), animation(NULL), anim_keys(NULL), texture(NULL), anim_data_offset(0),
+texture_offset(0), geometry_loaded(true), keys_loaded(true), texture_loaded(true)
 {
-	std::ifstream fin(fname, std::ios_base::in | std::ios_base::binary);
-	if(fin.fail()) { throw( Ghulbus::gbException(Ghulbus::gbException::GB_FAILED,
-	                                             "Could not open icon file for read") ); }
-	//read icon data from file:
-	try {
-		ReadFile(fin);
-	} catch(std::exception) {
-		fin.close();
-		throw;
+	OpenFile(fname, LOAD_EAGER);
+}
+
+PS2Icon::PS2Icon(const char *fname, LoadMode mode): arena(NULL), vertices(NULL), normals(NULL), vert_texture(NULL),
+fvertices(NULL), fnormals(NULL), animation(NULL), anim_keys(NULL), texture(NULL), anim_data_offset(0),
+texture_offset(0), geometry_loaded(true), keys_loaded(true), texture_loaded(true)
+{
+	OpenFile(fname, mode);
+}
+
+PS2Icon::PS2Icon(PS2IconView const& view): arena(NULL), vertices(NULL), normals(NULL), vert_texture(NULL),
+fvertices(NULL), fnormals(NULL), animation(NULL), anim_keys(NULL), texture(NULL), anim_data_offset(0),
+texture_offset(0), geometry_loaded(true), keys_loaded(true), texture_loaded(true)
+{
+	//the view has already validated the complete file layout:
+	header = view.GetHeader();
+	anim_header = view.GetAnimationHeader();
+	std::vector<Frame_Data> frames(anim_header.n_frames);
+	for(unsigned int i=0; i<anim_header.n_frames; i++) {
+		frames[i] = view.GetFrameData(i);
+	}
+	AllocateArena( frames.empty() ? NULL : &frames[0] );
+	DecodeVertexSegment( view.GetVertexSegment().GetData() );
+
+	//animation keys:
+	for(unsigned int i=0; i<anim_header.n_frames; i++) {
+		MemorySpan<Frame_Key> keys = view.GetFrameKeys(i);
+		memcpy(anim_keys[i], keys.GetData(), sizeof(Frame_Key) * keys.GetSize());
+	}
+
+	//texture data:
+	MemorySpan<unsigned char> segment = view.GetTextureSegment();
+	if(!view.IsTextureCompressed()) {
+		PS2Texture::Unpack(segment.GetData(), texture, PS2Texture::N_TEXELS, PS2Texture::ALPHA_OPAQUE);
+	} else {
+		//simple rle encoding; skip the 32 bit size field:
+		PS2Texture::DecodeRLE(segment.GetData() + 4, segment.GetSize() - 4, texture, PS2Texture::ALPHA_OPAQUE);
 	}
-	fin.close();
 }
 
-PS2Icon::PS2Icon(): vertices(NULL), normals(NULL), vert_texture(NULL), 
-fvertices(NULL), fnormals(NULL), animation(NULL), anim_keys(NULL)
+PS2Icon::PS2Icon(): arena(NULL), vertices(NULL), normals(NULL), vert_texture(NULL),
+fvertices(NULL), fnormals(NULL), animation(NULL), anim_keys(NULL), texture(NULL), anim_data_offset(0),
+texture_offset(0), geometry_loaded(true), keys_loaded(true), texture_loaded(true)
 {
 	header.file_id          = 0x010000;
 	header.animation_shapes = 1;
@@ -68,273 +89,370 @@ fvertices(NULL), fnormals(NULL), animation(NULL), anim_keys(NULL)
 	anim_header.play_offset  = 0;
 	anim_header.n_frames     = 0;
 	
-	memset(texture, 0, sizeof(unsigned int)*16384);
+	AllocateArena(NULL);
 }
 
-void PS2Icon::ReadFile(std::ifstream & fin)
+void PS2Icon::OpenFile(char const* fname, LoadMode mode)
 {
+	std::ifstream fin(fname, std::ios_base::in | std::ios_base::binary);
+	if(fin.fail()) { throw( Ghulbus::gbException(Ghulbus::gbException::GB_FAILED,
+	                                             "Could not open icon file for read") ); }
+	//read icon data from file:
+	try {
+		ReadFile(fin, (mode == LOAD_LAZY));
+	} catch(std::exception) {
+		fin.close();
+		//the destructor is not run for a failed constructor:
+		if(arena) { delete[] arena;  arena = NULL; }
+		throw;
+	}
+	fin.close();
+	if(mode == LOAD_LAZY) {
+		source_file = fname;
+	}
+}
+
+void PS2Icon::ReadFile(std::ifstream & fin, bool lazy)
+{
+	//all segment sizes are checked against the file size before anything is allocated:
+	fin.seekg(0, std::ios_base::end);
+	std::streamoff const file_end = fin.tellg();
+	fin.seekg(0, std::ios_base::beg);
+
 	//read header:
 	fin.read( reinterpret_cast<char*>(&header), sizeof(header) );
+	if(fin.fail()) { throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "File read error" ) ); }
 
 	if(!CheckValidity(header)) {
 		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Icon Header seems to be corrupted" ) );
 	}
 
-	//allocate memory for vertex data:
-	AllocateVertexMemory();
-
-	//read icon data from file:
-	///Vertex data
-	// each vertex consists of animation_shapes tuples for vertex coordinates,
-	// followed by one vertex coordinate tuple for normal coordinates
-	// followed by one texture data tuple for texture coordinates and color
-	for(unsigned int i=0; i<header.n_vertices; i++) {
-		fin.read( reinterpret_cast<char*>(&vertices[i*header.animation_shapes]), 
-			      sizeof(Vertex_Coord) * header.animation_shapes );
-		fin.read( reinterpret_cast<char*>(&normals[i]), sizeof(Vertex_Coord) );
-		fin.read( reinterpret_cast<char*>(&vert_texture[i]), sizeof(Texture_Data) );
-		
-		for(unsigned int j=0; j<header.animation_shapes; j++) {
-			fvertices[(i*header.animation_shapes + j) * 3] = 
-				convert_f16_to_f32(vertices[i*header.animation_shapes + j].f16_x);
-			fvertices[(i*header.animation_shapes + j) * 3 + 1] = 
-				convert_f16_to_f32(vertices[i*header.animation_shapes + j].f16_y);
-			fvertices[(i*header.animation_shapes + j) * 3 + 2] = 
-				convert_f16_to_f32(vertices[i*header.animation_shapes + j].f16_z);
-		}
-		fnormals[i*3]     = convert_f16_to_f32(normals[i].f16_x);
-		fnormals[i*3 + 1] = convert_f16_to_f32(normals[i].f16_y);
-		fnormals[i*3 + 2] = convert_f16_to_f32(normals[i].f16_z);
+	//vertex data
+	// the complete segment is read with a single call and decoded from memory
+	size_t record_size = sizeof(Vertex_Coord) * (header.animation_shapes + 1) + sizeof(Texture_Data);
+	std::streamoff const segment_start = fin.tellg();
+	if( (header.animation_shapes > static_cast<unsigned int>(INT_MAX / sizeof(Vertex_Coord))) ||
+	    (header.n_vertices > static_cast<unsigned long long>(file_end - segment_start) / record_size) )
+	{
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Vertex segment exceeds file size" ) );
 	}
+	fin.seekg(record_size * header.n_vertices, std::ios_base::cur);
 
 	//animation data
 	// preceeded by an animation header, there is a frame data/key set for every frame:
 	fin.read( reinterpret_cast<char*>(&anim_header), sizeof(Animation_Header) );
-
-	//allocate memory for animation data:
-	animation = new Frame_Data[anim_header.n_frames];
-	anim_keys = new Frame_Key*[anim_header.n_frames];
-	//read animation data:
+	anim_data_offset = fin.tellg();
+	if( fin.fail() || 
+	    (anim_header.n_frames > static_cast<unsigned long long>(file_end - anim_data_offset) / sizeof(Frame_Data)) ) 
+	{
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Animation segment exceeds file size" ) );
+	}
+	//read the frame data; the keys are skipped, since their total number is required for allocation:
+	std::vector<Frame_Data> frames(anim_header.n_frames);
 	for(unsigned int i=0; i<anim_header.n_frames; i++) {
-		fin.read( reinterpret_cast<char*>(&animation[i]), sizeof(Frame_Data) );
-		if(animation[i].n_keys > 0) {
-			anim_keys[i] = new Frame_Key[animation[i].n_keys];
-			fin.read( reinterpret_cast<char*>(anim_keys[i]), sizeof(Frame_Key)*animation[i].n_keys);
-		} else {
-			anim_keys[i] = NULL;
+		fin.read( reinterpret_cast<char*>(&frames[i]), sizeof(Frame_Data) );
+		std::streamoff const keys_start = fin.tellg();
+		if( fin.fail() ||
+		    (frames[i].n_keys > static_cast<unsigned long long>(file_end - keys_start) / sizeof(Frame_Key)) )
+		{
+			throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Animation segment exceeds file size" ) );
 		}
+		fin.seekg(sizeof(Frame_Key) * frames[i].n_keys, std::ios_base::cur);
+	}
+	texture_offset = fin.tellg();
+	if(fin.fail()) { throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "File read error" ) ); }
+
+	//all storage is allocated at once; the segments are filled in now or on first access (lazy mode):
+	AllocateArena( frames.empty() ? NULL : &frames[0] );
+	geometry_loaded = false;
+	keys_loaded     = false;
+	texture_loaded  = false;
+	if(!lazy) {
+		fin.seekg(segment_start, std::ios_base::beg);
+		ReadVertexSegment(fin);
+		fin.seekg(anim_data_offset, std::ios_base::beg);
+		ReadAnimationKeys(fin);
+		ReadTextureSegment(fin, file_end);
+	}
+}
+
+void PS2Icon::ReadVertexSegment(std::ifstream & fin) const
+{
+	size_t const segment_size = (sizeof(Vertex_Coord) * (header.animation_shapes + 1) + sizeof(Texture_Data)) * header.n_vertices;
+	std::vector<char> segment(segment_size + 1);
+	fin.read( &segment[0], segment_size );
+	if(fin.fail()) { throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "File read error" ) ); }
+
+	DecodeVertexSegment( reinterpret_cast<unsigned char const*>(&segment[0]) );
+	geometry_loaded = true;
+}
+
+void PS2Icon::ReadAnimationKeys(std::ifstream & fin) const
+{
+	//read all frames at once and pick the keys from memory:
+	size_t const segment_size = static_cast<size_t>(texture_offset - anim_data_offset);
+	std::vector<char> segment(segment_size + 1);
+	fin.read( &segment[0], segment_size );
+	if(fin.fail()) { throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "File read error" ) ); }
+	size_t pos = 0;
+	for(unsigned int i=0; i<anim_header.n_frames; i++) {
+		pos += sizeof(Frame_Data);
+		memcpy(anim_keys[i], &segment[pos], sizeof(Frame_Key) * animation[i].n_keys);
+		pos += sizeof(Frame_Key) * animation[i].n_keys;
 	}
+	keys_loaded = true;
+}
 
-	//read texture data:
+void PS2Icon::ReadTextureSegment(std::ifstream & fin, std::streamoff file_end) const
+{
 	if(header.texture_type <= 0x07) {	//uncompressed textures
-		unsigned short c;
-		for(int i=0; i<16384; i++) {
-			fin.read( reinterpret_cast<char*>(&c), 2 );
-			unsigned char r = static_cast<unsigned char>( ( c        & 0x1f) << 3 );
-			unsigned char g = static_cast<unsigned char>( ((c >> 5)  & 0x1f) << 3 );
-			unsigned char b = static_cast<unsigned char>( ((c >> 10)       ) << 3 );
-			texture[i] =  static_cast<unsigned int>( (    (0xff)<<24) |
-				                                     (((r)&0xff)<<16) | 
-										             (((g)&0xff)<<8)  |
-										             ( (b)&0xff)  );
-		}
+		unsigned short plane[PS2Texture::N_TEXELS];
+		fin.read( reinterpret_cast<char*>(plane), sizeof(plane) );
+		if(fin.fail()) { throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "File read error" ) ); }
+		PS2Texture::Unpack(plane, texture, PS2Texture::N_TEXELS, PS2Texture::ALPHA_OPAQUE);
 	} else {							//compressed textures
 		//simple rle encoding:
-		// first 32 bits hold size of texture data
-		unsigned int data_size;
+		// first 32 bits hold size of texture data; the payload is read
+		// with a single call and decoded from memory
+		unsigned int data_size = 0;
 		fin.read( reinterpret_cast<char*>(&data_size), 4 );
-		unsigned int limit = fin.tellg();
-		limit += data_size;
-		if(limit > INT_MAX) { throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, 
-			                                               "File size is bigger than INT_MAX" ) ); }
-		unsigned int index = 0;
-		while( fin.tellg() < static_cast<int>(limit) ) {
-			//next 16 bits indicate the type of data to follow:
-			unsigned short rep_count;
-			fin.read( reinterpret_cast<char*>(&rep_count), 2 );
-			if(rep_count < 0xFF00) {			//repeat the pixel rep_count times
-				unsigned short c;
-				fin.read( reinterpret_cast<char*>(&c), 2 );
-				unsigned char r = static_cast<unsigned char>( ( c        & 0x1f) << 3 );
-				unsigned char g = static_cast<unsigned char>( ((c >> 5)  & 0x1f) << 3 );
-				unsigned char b = static_cast<unsigned char>( ((c >> 10)       ) << 3 );
-				for(int i=0; i<rep_count; i++) {
-					texture[index++] = static_cast<unsigned int> (     ((0xff)<<24) |
-				                                                   (((r)&0xff)<<16) | 
-										                           (((g)&0xff)<<8)  |
-										                           ( (b)&0xff)  );
-				}
-			} else {							//copy the next rep_count pixels directly
-				for(unsigned int i=0; i<=(0xFFFF ^ static_cast<unsigned int>(rep_count)); i++) {
-					unsigned short c;
-					fin.read( reinterpret_cast<char*>(&c), 2 );
-					unsigned char r = static_cast<unsigned char>( ( c        & 0x1f) << 3 );
-					unsigned char g = static_cast<unsigned char>( ((c >> 5)  & 0x1f) << 3 );
-					unsigned char b = static_cast<unsigned char>( ((c >> 10)       ) << 3 );
-					texture[index++] = static_cast<unsigned int>(     ((0xff)<<24) |
-				                                                  (((r)&0xff)<<16) | 
-										                          (((g)&0xff)<<8)  |
-										                          ( (b)&0xff)  );
-				}
-			}
+		std::streamoff const payload_start = fin.tellg();
+		if( fin.fail() || (data_size > static_cast<unsigned long long>(file_end - payload_start)) ) {
+			throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Texture segment exceeds file size" ) );
 		}
+		std::vector<char> payload(data_size + 1);
+		fin.read( &payload[0], data_size );
+		if(fin.fail()) { throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "File read error" ) ); }
+		PS2Texture::DecodeRLE(&payload[0], data_size, texture, PS2Texture::ALPHA_OPAQUE);
 	}
+	texture_loaded = true;
+}
 
-	if(fin.fail()) { throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED,
-	                                              "File read error" ) ); }
+void PS2Icon::OpenSourceFile(std::ifstream & fin, std::streamoff offset, std::streamoff* file_end) const
+{
+	fin.open(source_file.c_str(), std::ios_base::in | std::ios_base::binary);
+	if(fin.fail()) { throw( Ghulbus::gbException(Ghulbus::gbException::GB_FAILED,
+	                                             "Could not open icon file for read") ); }
+	fin.seekg(0, std::ios_base::end);
+	*file_end = fin.tellg();
+	fin.seekg(offset, std::ios_base::beg);
+	if(fin.fail()) { throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "File read error" ) ); }
 }
 
-void PS2Icon::AllocateVertexMemory() 
+void PS2Icon::EnsureGeometry() const
 {
-	//helper function that reallocates all per-vertex storage fields based 
-	//on the information stored in the header struct
-	if(vertices)     { delete[] vertices;          vertices = NULL; }
-	if(fvertices)    { delete[] fvertices;        fvertices = NULL; }
-	if(normals)      { delete[] normals;            normals = NULL; }
-	if(fnormals)     { delete[] fnormals;          fnormals = NULL; }
-	if(vert_texture) { delete[] vert_texture;  vert_texture = NULL; }
-	vertices     = new Vertex_Coord[header.n_vertices * header.animation_shapes];
-	fvertices    = new        float[header.n_vertices * header.animation_shapes * 3];
-	normals      = new Vertex_Coord[header.n_vertices];
-	fnormals     = new        float[header.n_vertices * 3];
-	vert_texture = new Texture_Data[header.n_vertices];
+	if(geometry_loaded) { return; }
+	//the vertex segment size has already been checked when the file was opened:
+	std::ifstream fin;
+	std::streamoff file_end;
+	OpenSourceFile(fin, sizeof(Icon_Header), &file_end);
+	ReadVertexSegment(fin);
 }
 
-void PS2Icon::SetGeometry(OBJ_Mesh const& mesh)
+void PS2Icon::EnsureAnimationKeys() const
 {
-	SetGeometry(mesh, 1.0f);
+	if(keys_loaded) { return; }
+	std::ifstream fin;
+	std::streamoff file_end;
+	OpenSourceFile(fin, anim_data_offset, &file_end);
+	ReadAnimationKeys(fin);
 }
 
-void PS2Icon::SetGeometry(OBJ_Mesh const& mesh, float scale_factor)
+void PS2Icon::EnsureTexture() const
+{
+	if(texture_loaded) { return; }
+	std::ifstream fin;
+	std::streamoff file_end;
+	OpenSourceFile(fin, texture_offset, &file_end);
+	ReadTextureSegment(fin, file_end);
+}
+
+void PS2Icon::DecodeVertexSegment(unsigned char const* data) const
+{
+	//each vertex record consists of animation_shapes tuples for vertex coordinates,
+	//followed by one vertex coordinate tuple for normal coordinates
+	//followed by one texture data tuple for texture coordinates and color;
+	//records are de-interleaved and converted in blocks that stay in the L1 cache
+	unsigned int const n_shapes = header.animation_shapes;
+	size_t const shapes_size = sizeof(Vertex_Coord) * n_shapes;
+	unsigned int const block_size = 256;
+	for(unsigned int block=0; block<header.n_vertices; block+=block_size) {
+		unsigned int const block_end = (header.n_vertices - block > block_size) ? (block + block_size) : header.n_vertices;
+		for(unsigned int i=block; i<block_end; i++) {
+			memcpy(&vertices[i*n_shapes], data, shapes_size);
+			data += shapes_size;
+			memcpy(&normals[i], data, sizeof(Vertex_Coord));
+			data += sizeof(Vertex_Coord);
+			memcpy(&vert_texture[i], data, sizeof(Texture_Data));
+			data += sizeof(Texture_Data);
+		}
+		for(unsigned int j=0; j<n_shapes; j++) {
+			float* x = fvertices + GetPlaneStride() * (j*3);
+			PS2FixedPoint::CoordsToPlanes( &vertices[block*n_shapes + j], shapes_size, 
+			                               x + block, x + GetPlaneStride() + block, x + 2*GetPlaneStride() + block,
+			                               block_end - block );
+		}
+		PS2FixedPoint::CoordsToFloat( &normals[block], sizeof(Vertex_Coord), &fnormals[block*3], block_end - block );
+	}
+}
+
+/** Helper function: rounds an arena offset up to the next cache line
+ */
+inline size_t align_arena_offset(size_t offset) {
+	return (offset + 63) & ~static_cast<size_t>(63);
+}
+
+void PS2Icon::AllocateArena(Frame_Data const* frames) 
+{
+	//helper function that allocates a single block for all storage fields based on the
+	//information stored in the header structs; each field starts on its own cache line
+	size_t const n_vertices = header.n_vertices;
+	size_t const n_shapes   = header.animation_shapes;
+	size_t const n_frames   = anim_header.n_frames;
+	size_t n_keys = 0;
+	for(size_t i=0; i<n_frames; i++) {
+		n_keys += frames[i].n_keys;
+	}
+	size_t offset = 0;
+	size_t const texture_offset      = offset;  offset = align_arena_offset(offset + sizeof(unsigned int) * PS2Texture::N_TEXELS);
+	size_t const fvertices_offset    = offset;  offset = align_arena_offset(offset + sizeof(float) * GetPlaneStride() * n_shapes * 3);
+	size_t const fnormals_offset     = offset;  offset = align_arena_offset(offset + sizeof(float) * n_vertices * 3);
+	size_t const vertices_offset     = offset;  offset = align_arena_offset(offset + sizeof(Vertex_Coord) * n_vertices * n_shapes);
+	size_t const normals_offset      = offset;  offset = align_arena_offset(offset + sizeof(Vertex_Coord) * n_vertices);
+	size_t const vert_texture_offset = offset;  offset = align_arena_offset(offset + sizeof(Texture_Data) * n_vertices);
+	size_t const animation_offset    = offset;  offset = align_arena_offset(offset + sizeof(Frame_Data) * n_frames);
+	size_t const anim_keys_offset    = offset;  offset = align_arena_offset(offset + sizeof(Frame_Key*) * n_frames);
+	size_t const keys_offset         = offset;  offset = align_arena_offset(offset + sizeof(Frame_Key) * n_keys);
+
+	unsigned char* new_arena = new unsigned char[offset + 63];
+	unsigned char* base = new_arena + ((64 - (reinterpret_cast<size_t>(new_arena) & 63)) & 63);
+
+	//the texture survives reallocation:
+	unsigned int* new_texture = reinterpret_cast<unsigned int*>(base + texture_offset);
+	if(texture) {
+		memcpy(new_texture, texture, sizeof(unsigned int) * PS2Texture::N_TEXELS);
+	} else {
+		memset(new_texture, 0, sizeof(unsigned int) * PS2Texture::N_TEXELS);
+	}
+	if(arena) { delete[] arena; }
+	arena        = new_arena;
+	texture      = new_texture;
+	fvertices    = reinterpret_cast<float*>(base + fvertices_offset);
+	fnormals     = reinterpret_cast<float*>(base + fnormals_offset);
+	vertices     = reinterpret_cast<Vertex_Coord*>(base + vertices_offset);
+	normals      = reinterpret_cast<Vertex_Coord*>(base + normals_offset);
+	vert_texture = reinterpret_cast<Texture_Data*>(base + vert_texture_offset);
+	animation    = reinterpret_cast<Frame_Data*>(base + animation_offset);
+	anim_keys    = reinterpret_cast<Frame_Key**>(base + anim_keys_offset);
+	Frame_Key* keys = reinterpret_cast<Frame_Key*>(base + keys_offset);
+	for(size_t i=0; i<n_frames; i++) {
+		animation[i] = frames[i];
+		anim_keys[i] = keys;
+		keys += frames[i].n_keys;
+	}
+}
+
+void PS2Icon::ResetGeometry(unsigned int n_vertices)
 {
 	//rewrite header:
 	header.file_id = 0x010000;	header.reserved = 0x3F800000;
 	header.animation_shapes = 1;
-	header.n_vertices = mesh.GetNFaces() * 3;
+	header.n_vertices = n_vertices;
 
-	//copy animation data:
-	AllocateVertexMemory();
-	float* tmptexture = new float[mesh.GetNFaces() * 9];
+	//insert default values for no animation:
+	anim_header.n_frames = 1;
+	Frame_Data frame;
+	frame.n_keys   = 1;
+	frame.shape_id = 0;
+	AllocateArena(&frame);
+	anim_keys[0]->time  = 0.0f;
+	anim_keys[0]->value = 1.0f;
+	geometry_loaded = true;
+	keys_loaded     = true;
+}
+
+void PS2Icon::SetGeometry(OBJ_Mesh const& mesh)
+{
+	SetGeometry(mesh, 1.0f);
+}
 
-	mesh.GetMeshGeometryUnindexed(fvertices, fnormals, tmptexture, scale_factor);
-	for(int i=0; i<mesh.GetNFaces() * 3; i++) {
-		vertices[i].f16_x = convert_f32_to_f16(fvertices[i*3]);
-		vertices[i].f16_y = convert_f32_to_f16(fvertices[i*3 + 1]);
-		vertices[i].f16_z = convert_f32_to_f16(fvertices[i*3 + 2]);
-		vertices[i].f16_unknown = 0;
+void PS2Icon::SetGeometry(OBJ_Mesh const& mesh, float scale_factor)
+{
+	ResetGeometry(mesh.GetNFaces() * 3);
 
-		normals[i].f16_x = convert_f32_to_f16(fnormals[i*3]);
-		normals[i].f16_y = convert_f32_to_f16(fnormals[i*3 + 1]);
-		normals[i].f16_z = convert_f32_to_f16(fnormals[i*3 + 2]);
-		normals[i].f16_unknown = 0;
+	//copy geometry data:
+	float* tmpverts   = new float[mesh.GetNFaces() * 9];
+	float* tmptexture = new float[mesh.GetNFaces() * 9];
 
-		vert_texture[i].f16_u = convert_f32_to_f16(tmptexture[i*3]);
-		vert_texture[i].f16_v = convert_f32_to_f16(tmptexture[i*3 + 1]);
+	mesh.GetMeshGeometryUnindexed(tmpverts, fnormals, tmptexture, scale_factor);
+	PS2FixedPoint::FloatToCoords(tmpverts, vertices, sizeof(Vertex_Coord), header.n_vertices);
+	SetShapePlanes(0, tmpverts);
+	delete[] tmpverts;
+	PS2FixedPoint::FloatToCoords(fnormals, normals, sizeof(Vertex_Coord), header.n_vertices);
+	//texture coordinates are 3D in the mesh; compact them to u,v pairs in place:
+	for(unsigned int i=0; i<header.n_vertices; i++) {
+		tmptexture[i*2]     = tmptexture[i*3];
+		tmptexture[i*2 + 1] = tmptexture[i*3 + 1];
+	}
+	PS2FixedPoint::FloatToTexCoords(tmptexture, vert_texture, sizeof(Texture_Data), header.n_vertices);
+	for(unsigned int i=0; i<header.n_vertices; i++) {
 		vert_texture[i].color = 0xFFFFFFFF;
 	}
 	delete[] tmptexture;
-
-	//rewrite animation data:
-	if(animation)    { delete[] animation;        animation = NULL; }
-	if(anim_keys)    {
-		for(unsigned int i=0; i<anim_header.n_frames; i++) {
-			if(anim_keys[i]) {
-				delete[] anim_keys[i];
-				anim_keys[i] = NULL;
-			}
-		}
-		delete[] anim_keys;
-		anim_keys = NULL;
-	}
-	//insert default values for no animation:
-	anim_header.n_frames = 1;
-	animation = new Frame_Data[1];
-	animation->n_keys   = 1;
-	animation->shape_id = 0;
-	anim_keys = new Frame_Key*[1];
-	anim_keys[0] = new Frame_Key[1];
-	anim_keys[0]->time  = 0.0f;
-	anim_keys[0]->value = 1.0f;
 }
 
 void PS2Icon::SetGeometry(float const* pverts, float const* pnormals, float const* ptexture, int n_vertices) 
 {
-	//rewrite header:
-	header.file_id = 0x010000;	header.reserved = 0x3F800000;
-	header.animation_shapes = 1;
-	header.n_vertices = n_vertices;
+	ResetGeometry(n_vertices);
 
-	//copy animation data:
-	AllocateVertexMemory();
-	memcpy(fvertices, pverts, sizeof(float) * 3 * n_vertices);
+	//copy geometry data:
+	SetShapePlanes(0, pverts);
 	memcpy(fnormals, pnormals, sizeof(float) * 3 * n_vertices);
-	float* tmptexture = new float[2*n_vertices];
-	memcpy(vert_texture, ptexture, sizeof(float) * 2 * n_vertices);
-
+	PS2FixedPoint::FloatToCoords(pverts, vertices, sizeof(Vertex_Coord), n_vertices);
+	PS2FixedPoint::FloatToCoords(fnormals, normals, sizeof(Vertex_Coord), n_vertices);
+	PS2FixedPoint::FloatToTexCoords(ptexture, vert_texture, sizeof(Texture_Data), n_vertices);
 	for(int i=0; i<n_vertices; i++) {
-		vertices[i].f16_x = convert_f32_to_f16(fvertices[i*3]);
-		vertices[i].f16_y = convert_f32_to_f16(fvertices[i*3 + 1]);
-		vertices[i].f16_z = convert_f32_to_f16(fvertices[i*3 + 2]);
-		vertices[i].f16_unknown = 0;
-
-		normals[i].f16_x = convert_f32_to_f16(fnormals[i*3]);
-		normals[i].f16_y = convert_f32_to_f16(fnormals[i*3 + 1]);
-		normals[i].f16_z = convert_f32_to_f16(fnormals[i*3 + 2]);
-		normals[i].f16_unknown = 0;
-
-		vert_texture[i].f16_u = convert_f32_to_f16(tmptexture[i*2]);
-		vert_texture[i].f16_v = convert_f32_to_f16(tmptexture[i*2 + 1]);
 		vert_texture[i].color = 0xFFFFFFFF;
 	}
-	delete[] tmptexture;
+}
 
-	//rewrite animation data:
-	if(animation)    { delete[] animation;        animation = NULL; }
-	if(anim_keys)    {
-		for(unsigned int i=0; i<anim_header.n_frames; i++) {
-			if(anim_keys[i]) {
-				delete[] anim_keys[i];
-				anim_keys[i] = NULL;
-			}
-		}
-		delete[] anim_keys;
-		anim_keys = NULL;
+void PS2Icon::SetShapePlanes(int shape, float const* data)
+{
+	float* x = fvertices + GetPlaneStride() * (shape*3);
+	float* y = x + GetPlaneStride();
+	float* z = y + GetPlaneStride();
+	for(unsigned int i=0; i<header.n_vertices; i++) {
+		x[i] = data[i*3];
+		y[i] = data[i*3 + 1];
+		z[i] = data[i*3 + 2];
 	}
-	//insert default values for no animation:
-	anim_header.n_frames = 1;
-	animation = new Frame_Data[1];
-	animation->n_keys   = 1;
-	animation->shape_id = 0;
-	anim_keys = new Frame_Key*[1];
-	anim_keys[0] = new Frame_Key[1];
-	anim_keys[0]->time  = 0.0f;
-	anim_keys[0]->value = 1.0f;
 }
 
 void PS2Icon::SetTextureData(unsigned int const* data) {
+	texture_loaded = true;
 	for(unsigned int i=0; i<16384; i++) {
 		texture[i] = data[i];
 	}
 }
 
 void PS2Icon::BuildMesh(OBJ_Mesh* mesh) {
+	EnsureGeometry();
 	float* tf = new float[header.n_vertices*3];
 	this->GetVertexData(tf, 0);
 	mesh->SetGeometry(tf, header.n_vertices*3);
 	delete[] tf;
 	mesh->SetNormals(fnormals, header.n_vertices*3);
 	
-	mesh->ClearTextureData();
-	float tmp;
+	//texture data has to be expanded by hand (2D -> 3D)
+	tf = new float[header.n_vertices*3 + 1];
+	PS2FixedPoint::TexCoordsToFloat(vert_texture, sizeof(Texture_Data), tf + header.n_vertices, header.n_vertices);
 	for(unsigned int i=0; i<header.n_vertices; i++) {
-		//texture data has to be converted by hand (2D -> 3D)
-		tmp = convert_f16_to_f32(vert_texture[i].f16_u);
-		mesh->AddTextureData(&tmp, 1);
-		tmp = convert_f16_to_f32(vert_texture[i].f16_v);
-		mesh->AddTextureData(&tmp, 1);
-		tmp = 0.0f;
-		mesh->AddTextureData(&tmp, 1);
+		tf[i*3]     = tf[header.n_vertices + i*2];
+		tf[i*3 + 1] = tf[header.n_vertices + i*2 + 1];
+		tf[i*3 + 2] = 0.0f;
 	}
+	mesh->SetTextureData(tf, header.n_vertices*3);
+	delete[] tf;
 
 	mesh->ClearFaceData();
 	OBJ_Mesh::Face face;
@@ -352,22 +470,8 @@ void PS2Icon::BuildMesh(OBJ_Mesh* mesh) {
 
 PS2Icon::~PS2Icon() 
 {
-	if(vertices)     { delete[] vertices;          vertices = NULL; }
-	if(fvertices)    { delete[] fvertices;        fvertices = NULL; }
-	if(normals)      { delete[] normals;            normals = NULL; }
-	if(fnormals)     { delete[] fnormals;          fnormals = NULL; }
-	if(vert_texture) { delete[] vert_texture;  vert_texture = NULL; }
-	if(animation)    { delete[] animation;        animation = NULL; }
-	if(anim_keys)    {
-		for(unsigned int i=0; i<anim_header.n_frames; i++) {
-			if(anim_keys[i]) {
-				delete[] anim_keys[i];
-				anim_keys[i] = NULL;
-			}
-		}
-		delete[] anim_keys;
-		anim_keys = NULL;
-	}
+	//all fields point into the arena:
+	if(arena) { delete[] arena;  arena = NULL; }
 }
 
 int PS2Icon::GetNVertices() const {
@@ -382,6 +486,17 @@ int PS2Icon::GetNFrames() const {
 	if(anim_header.n_frames > INT_MAX) { throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED ) ); }
 	return static_cast<int>(anim_header.n_frames);
 }
+int PS2Icon::GetFrameLength() const {
+	if(anim_header.frame_length > INT_MAX) { throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED ) ); }
+	return static_cast<int>(anim_header.frame_length);
+}
+float PS2Icon::GetAnimationSpeed() const {
+	return anim_header.anim_speed;
+}
+int PS2Icon::GetPlayOffset() const {
+	if(anim_header.play_offset > INT_MAX) { throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED ) ); }
+	return static_cast<int>(anim_header.play_offset);
+}
 int PS2Icon::GetFrameShape(int frame) const {
 	if(static_cast<unsigned int>(frame) >= anim_header.n_frames) { 
 		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER ) ); 
@@ -401,6 +516,7 @@ float PS2Icon::GetFrameKeyTime(int frame, int key) const {
 	   (static_cast<unsigned int>(key) >= animation[frame].n_keys) ) {
 		   throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER ) );;
 	}
+	EnsureAnimationKeys();
 	return anim_keys[frame][key].time;
 }
 float PS2Icon::GetFrameKeyValue(int frame, int key) const {
@@ -408,6 +524,7 @@ float PS2Icon::GetFrameKeyValue(int frame, int key) const {
 	   (static_cast<unsigned int>(key) >= animation[frame].n_keys) ) {
 		   throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER ) );
 	}
+	EnsureAnimationKeys();
 	return anim_keys[frame][key].value;
 }
 int PS2Icon::GetTextureType() const {
@@ -418,43 +535,58 @@ void PS2Icon::GetVertexData(float* data, int shape) const {
 	if(shape >= static_cast<int>(header.animation_shapes)) {
 		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER ) ); 
 	}
-	if(shape >= 0) {	//copy specified shape
+	EnsureGeometry();
+	//shapes are stored as x, y and z planes; interleave them to x,y,z triples:
+	unsigned int const first_shape = (shape >= 0) ? shape : 0;
+	unsigned int const n_shapes    = (shape >= 0) ? 1 : header.animation_shapes;
+	for(unsigned int j=first_shape; j<first_shape+n_shapes; j++) {
+		float const* x = fvertices + GetPlaneStride() * (j*3);
+		float const* y = x + GetPlaneStride();
+		float const* z = y + GetPlaneStride();
 		for(unsigned int i=0; i<header.n_vertices; i++) {
-			data[i*3]     = fvertices[(i*header.animation_shapes + shape) * 3];
-			data[i*3 + 1] = fvertices[(i*header.animation_shapes + shape) * 3 + 1];
-			data[i*3 + 2] = fvertices[(i*header.animation_shapes + shape) * 3 + 2];
-		}
-	} else {			//copy *all* shapes one after the other
-		for(unsigned int j=0; j<header.animation_shapes; j++) {
-			for(unsigned int i=0; i<header.n_vertices; i++) {
-				data[j*header.n_vertices*3 + i*3]     = fvertices[(i*header.animation_shapes + j) * 3];
-				data[j*header.n_vertices*3 + i*3 + 1] = fvertices[(i*header.animation_shapes + j) * 3 + 1];
-				data[j*header.n_vertices*3 + i*3 + 2] = fvertices[(i*header.animation_shapes + j) * 3 + 2];
-			}
+			data[i*3]     = x[i];
+			data[i*3 + 1] = y[i];
+			data[i*3 + 2] = z[i];
 		}
+		data += header.n_vertices * 3;
 	}
 }
+float const* PS2Icon::GetShapePlane(int shape, int component) const {
+	if( (shape < 0) || (shape >= static_cast<int>(header.animation_shapes)) || 
+	    (component < 0) || (component > 2) ) 
+	{
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER ) ); 
+	}
+	EnsureGeometry();
+	return fvertices + GetPlaneStride() * (shape*3 + component);
+}
+size_t PS2Icon::GetPlaneStride() const {
+	//each plane starts on a cache line:
+	return (static_cast<size_t>(header.n_vertices) + 15) & ~static_cast<size_t>(15);
+}
 void PS2Icon::GetVertexColorData(unsigned int* data) const {
+	EnsureGeometry();
 	for(unsigned int i=0; i<header.n_vertices; i++) {
 		data[i] = vert_texture[i].color;
 	}
 }
 void PS2Icon::GetNormalData(float* data) const {
+	EnsureGeometry();
 	memcpy(data, fnormals, sizeof(float)*header.n_vertices*3);
 }
 void PS2Icon::GetVertexTextureData(float* data) const {
-	for(unsigned int i=0; i<header.n_vertices; i++) {
-		data[i*2]   = convert_f16_to_f32(vert_texture[i].f16_u);
-		data[i*2+1] = convert_f16_to_f32(vert_texture[i].f16_v);
-	}
+	EnsureGeometry();
+	PS2FixedPoint::TexCoordsToFloat(vert_texture, sizeof(Texture_Data), data, header.n_vertices);
 }
 void PS2Icon::GetTextureData(unsigned int* data) const {
+	EnsureTexture();
 	memcpy(data, texture, sizeof(unsigned int)*16384);
 }
 void PS2Icon::GetTextureData(unsigned int* data, int pitch) const {
 	if((pitch < 512) || (pitch % 4 != 0)) { 
 		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER ) );
 	}
+	EnsureTexture();
 	for(int i=0; i<128; i++) {
 		memcpy(&(data[i*(pitch>>2)]), &(texture[i*128]), sizeof(unsigned int)*128);
 	}
@@ -463,101 +595,173 @@ unsigned int PS2Icon::GetTextureData(int x, int y) const {
 	if((x < 0) || (x >= 128) || (y < 0) || (y >= 128)) {
 		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER ) );
 	}
+	EnsureTexture();
 	return texture[y*128 + x];
 }
 
+float PS2Icon::GetTextureCompressionRatio() const {
+	EnsureTexture();
+	unsigned short plane[PS2Texture::N_TEXELS];
+	PS2Texture::Pack(texture, plane, PS2Texture::N_TEXELS, PS2Texture::ALPHA_OPAQUE);
+	std::vector<unsigned char> encoded(PS2Texture::RLE_MAX_SIZE);
+	int const size = PS2Texture::EncodeRLE(plane, &encoded[0]);
+	return static_cast<float>(4 + size) / static_cast<float>(sizeof(plane));
+}
+
 void PS2Icon::WriteFile(const char * fname) const {
+	WriteFile(fname, TEXTURE_KEEP);
+}
+
+void PS2Icon::WriteFile(const char * fname, TextureEncoding encoding) const {
+	std::vector<unsigned char> data;
+	WriteData(&data, encoding);
+
 	std::ofstream fout(fname, std::ios_base::out | std::ios_base::binary);
 	if(fout.fail()) { 
 		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED,
 			                         "Output icon file could not be opened") );
 	}
 	fout.seekp(std::ios::beg);
+	fout.write( reinterpret_cast<char const*>(&data[0]), data.size() );
+	fout.close();
+	if(fout.fail()) { 
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED,
+			                         "Error while writing output icon file") );
+	}
+}
+
+/** Helper function: appends raw bytes to a buffer
+ */
+inline void append_bytes(std::vector<unsigned char>* data, void const* src, size_t size) {
+	unsigned char const* p = static_cast<unsigned char const*>(src);
+	data->insert(data->end(), p, p + size);
+}
+
+void PS2Icon::WriteData(std::vector<unsigned char>* data, TextureEncoding encoding) const {
+	EnsureGeometry();
+	EnsureAnimationKeys();
+	EnsureTexture();
+	//encode the texture first, since the encoding determines the texture_type in the header:
+	unsigned short plane[PS2Texture::N_TEXELS];
+	PS2Texture::Pack(texture, plane, PS2Texture::N_TEXELS, PS2Texture::ALPHA_OPAQUE);
+	std::vector<unsigned char> rle_segment;
+	if( (encoding == TEXTURE_RLE) || (encoding == TEXTURE_AUTO) ||
+	    ((encoding == TEXTURE_KEEP) && (header.texture_type > 0x07)) )
+	{
+		//rle segment is preceeded by the 32 bit size of the encoded data:
+		rle_segment.resize(4 + PS2Texture::RLE_MAX_SIZE);
+		unsigned int size = static_cast<unsigned int>( PS2Texture::EncodeRLE(plane, &rle_segment[4]) );
+		memcpy(&rle_segment[0], &size, 4);
+		rle_segment.resize(4 + size);
+		if((encoding == TEXTURE_AUTO) && (rle_segment.size() >= sizeof(plane))) {
+			rle_segment.clear();
+		}
+	}
+	Icon_Header file_header = header;
+	if(rle_segment.empty()) {
+		if(file_header.texture_type > 0x07) { file_header.texture_type &= 0x07; }
+	} else {
+		file_header.texture_type |= 0x08;
+	}
+
+	size_t n_keys = 0;
+	for(unsigned int i=0; i<anim_header.n_frames; i++) {
+		n_keys += animation[i].n_keys;
+	}
+	data->clear();
+	data->reserve( sizeof(Icon_Header) +
+	               (sizeof(Vertex_Coord) * (header.animation_shapes + 1) + sizeof(Texture_Data)) * header.n_vertices +
+	               sizeof(Animation_Header) + sizeof(Frame_Data) * anim_header.n_frames + sizeof(Frame_Key) * n_keys +
+	               (rle_segment.empty() ? sizeof(plane) : rle_segment.size()) );
 
 	//write header:
-	fout.write( reinterpret_cast<char const*>(&header), sizeof(Icon_Header) );
+	append_bytes(data, &file_header, sizeof(Icon_Header));
 
 	//write vertex segment:
 	for(unsigned int i=0; i<header.n_vertices; i++) {
 		//vertex coordinates, one for each shape:
-		fout.write( reinterpret_cast<char*>(&vertices[i*header.animation_shapes]),
-			        sizeof(Vertex_Coord) * header.animation_shapes );
+		append_bytes(data, &vertices[i*header.animation_shapes], sizeof(Vertex_Coord) * header.animation_shapes);
 		//normal coordinates:
-		fout.write( reinterpret_cast<char*>(&normals[i]), sizeof(Vertex_Coord) );
+		append_bytes(data, &normals[i], sizeof(Vertex_Coord));
 		//texture coordinates:
-		fout.write( reinterpret_cast<char*>(&vert_texture[i]), sizeof(Texture_Data) );
+		append_bytes(data, &vert_texture[i], sizeof(Texture_Data));
 	}
 
 	//write animation segment:
 	//header:
-	fout.write( reinterpret_cast<char const*>(&anim_header), sizeof(Animation_Header) );
+	append_bytes(data, &anim_header, sizeof(Animation_Header));
 	//data:
 	for(unsigned int i=0; i<anim_header.n_frames; i++) {
-		fout.write( reinterpret_cast<char*>(&animation[i]), sizeof(Frame_Data) );
-		fout.write( reinterpret_cast<char*>(anim_keys[i]), sizeof(Frame_Key) * animation[i].n_keys );
+		append_bytes(data, &animation[i], sizeof(Frame_Data));
+		append_bytes(data, anim_keys[i], sizeof(Frame_Key) * animation[i].n_keys);
 	}
 
 	//write texture segment:
-	if(header.texture_type <= 0x07) {
-		//uncompressed:
-		unsigned short c;
-		for(int i=0; i<16384; i++) {
-			unsigned char r = static_cast<unsigned char>( (texture[i] >> 16) & 0xff );
-			unsigned char g = static_cast<unsigned char>( (texture[i] >>  8) & 0xff );
-			unsigned char b = static_cast<unsigned char>(  texture[i]        & 0xff );
-			c = static_cast<unsigned short>( ((r >> 3) & 0x001f) | ((g << 2) & 0x03e0) | ((b << 7) & 0x7c00) );
-			fout.write( reinterpret_cast<char*>(&c), 2 );
-		}
+	if(rle_segment.empty()) {
+		append_bytes(data, plane, sizeof(plane));
 	} else {
-		//compressed textures:
-		//allocate space for size info:
-		int base = fout.tellp();
-		unsigned int size = 0;
-		fout.write( reinterpret_cast<char*>(&base), 4 );	//dummy data
-		//rle main loop:
-		int i=0;
-		while(i<16384) {
-			//rle step 1: count replication
-			int rep_count = 1;
-			while( (texture[i] == texture[i+rep_count]) ) { rep_count++; }
-			if(rep_count > 1) {		//pixels are replicated rep_count times
-				unsigned char r = static_cast<unsigned char>( (texture[i] >> 16) & 0xff );
-				unsigned char g = static_cast<unsigned char>( (texture[i] >>  8) & 0xff );
-				unsigned char b = static_cast<unsigned char>(  texture[i]        & 0xff );
-				unsigned short c = ((unsigned short)(r >> 3) | (g << 2) | (b << 7) );
-				fout.write( reinterpret_cast<char*>(&rep_count), 2 );
-				fout.write( reinterpret_cast<char*>(&c), 2 );
-				i += rep_count;
-			} else {				//no replication
-				unsigned short pix_count = 0;	//number of non equal subsequent pixels
-				while((texture[i+pix_count] != texture[i+pix_count+1]) &&
-				      (pix_count < 255) ) { pix_count++; }
-				pix_count = 0xFFFF ^ (pix_count-1);
-				fout.write( reinterpret_cast<char*>(&pix_count), 2 );
-				pix_count ^= 0xFFFF;
-				for(unsigned short j=0; j<=pix_count; j++) {		//insert pixels:
-					unsigned char r = static_cast<unsigned char>( (texture[i] >> 16) & 0xff );
-					unsigned char g = static_cast<unsigned char>( (texture[i] >>  8) & 0xff );
-					unsigned char b = static_cast<unsigned char>(  texture[i]        & 0xff );
-					unsigned short c = ((unsigned short)(r >> 3) | (g << 2) | (b << 7) );
-					fout.write( reinterpret_cast<char*>(&c), 2 );
-					i++;
-				}
-			}
-		}
-		//finalize: write size of the encoded segment to base:
-		size = fout.tellp();
-		size -= (base + 4);
+		append_bytes(data, &rle_segment[0], rle_segment.size());
+	}
+}
+
+///@todo support for alpha bit (bit #16) in texture
+
+ContentHash::Hash128 PS2Icon::HashGeometry(Icon_Header const& header, unsigned char const* segment) {
+	unsigned int const counts[2] = { header.n_vertices, header.animation_shapes };
+	size_t const record_size = sizeof(Vertex_Coord) * (header.animation_shapes + 1) + sizeof(Texture_Data);
+	ContentHash::Hash128 const parts[2] = {
+		ContentHash::Compute(counts, sizeof(counts), 1),
+		ContentHash::Compute(segment, record_size * header.n_vertices, 1)
+	};
+	return ContentHash::Combine(parts, 2, 1);
+}
+
+ContentHash::Hash128 PS2Icon::HashAnimation(Animation_Header const& anim_header, unsigned char const* segment, size_t size) {
+	ContentHash::Hash128 const parts[2] = {
+		ContentHash::Compute(&anim_header, sizeof(Animation_Header), 2),
+		ContentHash::Compute(segment, size, 2)
+	};
+	return ContentHash::Combine(parts, 2, 2);
+}
+
+ContentHash::Hash128 PS2Icon::HashTexture(unsigned short const* plane) {
+	return ContentHash::Compute(plane, sizeof(unsigned short) * PS2Texture::N_TEXELS, 3);
+}
+
+void PS2Icon::CombineFingerprint(Fingerprint* fingerprint) {
+	ContentHash::Hash128 const parts[3] = { fingerprint->geometry, fingerprint->animation, fingerprint->texture };
+	fingerprint->icon = ContentHash::Combine(parts, 3, 4);
+}
 
-		fout.seekp(base);
-		fout.write( reinterpret_cast<char*>(&size), 4 );
+PS2Icon::Fingerprint PS2Icon::GetFingerprint() const {
+	EnsureGeometry();
+	EnsureAnimationKeys();
+	EnsureTexture();
+	Fingerprint ret;
+
+	//the hashes are defined over the segments as they are stored in the file:
+	std::vector<unsigned char> segment;
+	segment.reserve( (sizeof(Vertex_Coord) * (header.animation_shapes + 1) + sizeof(Texture_Data)) * header.n_vertices + 1 );
+	for(unsigned int i=0; i<header.n_vertices; i++) {
+		append_bytes(&segment, &vertices[i*header.animation_shapes], sizeof(Vertex_Coord) * header.animation_shapes);
+		append_bytes(&segment, &normals[i], sizeof(Vertex_Coord));
+		append_bytes(&segment, &vert_texture[i], sizeof(Texture_Data));
 	}
+	segment.push_back(0);
+	ret.geometry = HashGeometry(header, &segment[0]);
 
-	fout.close();
-	if(fout.fail()) { 
-		throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED,
-			                         "Error while writing output icon file") );
+	segment.clear();
+	for(unsigned int i=0; i<anim_header.n_frames; i++) {
+		append_bytes(&segment, &animation[i], sizeof(Frame_Data));
+		append_bytes(&segment, anim_keys[i], sizeof(Frame_Key) * animation[i].n_keys);
 	}
-}
+	segment.push_back(0);
+	ret.animation = HashAnimation(anim_header, &segment[0], segment.size() - 1);
 
-///@todo support for alpha bit (bit #16) in texture
+	unsigned short plane[PS2Texture::N_TEXELS];
+	PS2Texture::Pack(texture, plane, PS2Texture::N_TEXELS, PS2Texture::ALPHA_OPAQUE);
+	ret.texture = HashTexture(plane);
+
+	CombineFingerprint(&ret);
+	return ret;
+}
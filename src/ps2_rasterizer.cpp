@@ -0,0 +1,413 @@
+/**
+ * @file src/ps2_rasterizer.cpp
+ *
+ * @brief Implementation of the IconRasterizer classbuild_header/
+ */
+#include "../include/ps2_rasterizer.hpp"
+#include "../include/ps2_texture.hpp"
+#include "../gbLib/include/gbImageLoader.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#	define PS2_RASTERIZER_SSE2
+#	include <emmintrin.h>
+#endif
+
+/** Helper function: looks up the texel for a texture coordinate (nearest neighbour, wrapping)
+ * @note The offset keeps the argument of the conversion positive for coordinates > -64.
+ */
+inline int texel_index(float u, float v) {
+	int const tx = static_cast<int>(u * 128.0f + 8192.0f) & 127;
+	int const ty = static_cast<int>(v * 128.0f + 8192.0f) & 127;
+	return ((ty << 7) | tx);
+}
+
+/** Helper function: modulates a texel with a light color
+ */
+inline unsigned int shade_texel(unsigned int texel, float r, float g, float b) {
+	float c[3] = { ((texel >> 16) & 0xff) * r, ((texel >> 8) & 0xff) * g, (texel & 0xff) * b };
+	unsigned int ret = 0xff000000;
+	for(int i=0; i<3; i++) {
+		float const f = (c[i] < 255.0f) ? ((c[i] > 0.0f) ? c[i] : 0.0f) : 255.0f;
+		ret |= static_cast<unsigned int>(f + 0.5f) << (16 - i*8);
+	}
+	return ret;
+}
+
+IconRasterizer::IconRasterizer(int width, int height): m_width(width), m_height(height), m_stride(0),
+m_tiles_x(0), m_tiles_y(0), m_center_x(0.0f), m_center_y(0.0f), m_scale(1.0f)
+{
+	if((width <= 0) || (width > MAX_SIZE) || (height <= 0) || (height > MAX_SIZE)) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER ) );
+	}
+	m_stride  = (width + 3) & ~3;
+	m_tiles_x = (width  + TILE_SIZE - 1) / TILE_SIZE;
+	m_tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+	m_background.resize(static_cast<size_t>(m_stride) * height);
+	m_color.resize(static_cast<size_t>(m_stride) * height);
+	m_depth.resize(static_cast<size_t>(m_stride) * height);
+	m_texture.resize(PS2Texture::N_TEXELS);
+	m_bins.resize(m_tiles_x * m_tiles_y);
+	m_scale = static_cast<float>(std::min(width, height)) * 0.5f;
+	IconSys default_sys;
+	SetLighting(default_sys);
+	std::copy(m_background.begin(), m_background.end(), m_color.begin());
+}
+
+IconRasterizer::~IconRasterizer()
+{
+}
+
+int IconRasterizer::GetWidth() const {
+	return m_width;
+}
+
+int IconRasterizer::GetHeight() const {
+	return m_height;
+}
+
+void IconRasterizer::SetLighting(IconSys const& icon_sys) {
+	float dir[3][4], color[3][4], ambient[4];
+	icon_sys.GetLight1Dir().Get(dir[0]);
+	icon_sys.GetLight2Dir().Get(dir[1]);
+	icon_sys.GetLight3Dir().Get(dir[2]);
+	icon_sys.GetLight1Color().Get(color[0]);
+	icon_sys.GetLight2Color().Get(color[1]);
+	icon_sys.GetLight3Color().Get(color[2]);
+	icon_sys.GetLightAmbientColor().Get(ambient);
+	for(int i=0; i<3; i++) {
+		float const len = std::sqrt(dir[i][0]*dir[i][0] + dir[i][1]*dir[i][1] + dir[i][2]*dir[i][2]);
+		for(int j=0; j<3; j++) {
+			m_light_dir[i][j]   = (len > 0.0f) ? (dir[i][j] / len) : 0.0f;
+			m_light_color[i][j] = color[i][j];
+		}
+		m_ambient[i] = ambient[i];
+	}
+	BuildBackground(icon_sys);
+}
+
+void IconRasterizer::BuildBackground(IconSys const& icon_sys) {
+	IconSys::IconSys_Color const corner[4] = { icon_sys.GetBackgroundColor_UL(), icon_sys.GetBackgroundColor_UR(),
+	                                           icon_sys.GetBackgroundColor_LL(), icon_sys.GetBackgroundColor_LR() };
+	float c[4][3];
+	for(int i=0; i<4; i++) {
+		c[i][0] = static_cast<float>(corner[i].GetR8());
+		c[i][1] = static_cast<float>(corner[i].GetG8());
+		c[i][2] = static_cast<float>(corner[i].GetB8());
+	}
+	for(int y=0; y<m_height; y++) {
+		float const fy = (m_height > 1) ? (static_cast<float>(y) / (m_height - 1)) : 0.0f;
+		float left[3], right[3];
+		for(int j=0; j<3; j++) {
+			left[j]  = c[0][j] + (c[2][j] - c[0][j]) * fy;
+			right[j] = c[1][j] + (c[3][j] - c[1][j]) * fy;
+		}
+		unsigned int* row = &m_background[0] + static_cast<size_t>(y) * m_stride;
+		for(int x=0; x<m_stride; x++) {
+			float const fx = (m_width > 1) ? (static_cast<float>(std::min(x, m_width - 1)) / (m_width - 1)) : 0.0f;
+			unsigned int pixel = 0xff000000;
+			for(int j=0; j<3; j++) {
+				pixel |= static_cast<unsigned int>(left[j] + (right[j] - left[j]) * fx + 0.5f) << (16 - j*8);
+			}
+			row[x] = pixel;
+		}
+	}
+}
+
+void IconRasterizer::SetView(float center_x, float center_y, float scale) {
+	m_center_x = center_x;
+	m_center_y = center_y;
+	m_scale    = scale;
+}
+
+void IconRasterizer::FitView(float const* data, int n_vertices) {
+	if(n_vertices <= 0) {
+		SetView(0.0f, 0.0f, 1.0f);
+		return;
+	}
+	float min_x = data[0], max_x = data[0];
+	float min_y = data[1], max_y = data[1];
+	for(int i=1; i<n_vertices; i++) {
+		min_x = std::min(min_x, data[i*3]);     max_x = std::max(max_x, data[i*3]);
+		min_y = std::min(min_y, data[i*3 + 1]); max_y = std::max(max_y, data[i*3 + 1]);
+	}
+	float const extent_x = (max_x - min_x) / static_cast<float>(m_width);
+	float const extent_y = (max_y - min_y) / static_cast<float>(m_height);
+	float const extent   = std::max(extent_x, extent_y);
+	//leave a border of 5% on each side:
+	SetView( (min_x + max_x) * 0.5f, (min_y + max_y) * 0.5f, (extent > 0.0f) ? (0.9f / extent) : 1.0f );
+}
+
+void IconRasterizer::Render(PS2Icon const& icon) {
+	if(icon.GetNShapes() == 0) {
+		//no vertex positions to draw:
+		std::copy(m_background.begin(), m_background.end(), m_color.begin());
+		std::fill(m_depth.begin(), m_depth.end(), FLT_MAX);
+		return;
+	}
+	int const n_vertices = icon.GetNVertices();
+	std::vector<float> data(static_cast<size_t>(n_vertices) * 3 + 1);
+	icon.GetVertexData(&data[0], 0);
+	FitView(&data[0], n_vertices);
+	Render(icon, &data[0]);
+}
+
+void IconRasterizer::Render(PS2Icon const& icon, float const* data) {
+	SetupTriangles(icon, data);
+	std::copy(m_background.begin(), m_background.end(), m_color.begin());
+	std::fill(m_depth.begin(), m_depth.end(), FLT_MAX);
+	for(int ty=0; ty<m_tiles_y; ty++) {
+		for(int tx=0; tx<m_tiles_x; tx++) {
+			RasterizeTile(tx, ty);
+		}
+	}
+}
+
+void IconRasterizer::SetupTriangles(PS2Icon const& icon, float const* data) {
+	int const n_vertices = icon.GetNVertices();
+	std::vector<float> normals(static_cast<size_t>(n_vertices) * 3 + 1);
+	std::vector<float> tex_coords(static_cast<size_t>(n_vertices) * 2 + 1);
+	std::vector<unsigned int> colors(n_vertices + 1);
+	icon.GetNormalData(&normals[0]);
+	icon.GetVertexTextureData(&tex_coords[0]);
+	icon.GetVertexColorData(&colors[0]);
+	icon.GetTextureData(&m_texture[0]);
+
+	m_triangles.clear();
+	m_order.clear();
+	for(size_t i=0; i<m_bins.size(); i++) {
+		m_bins[i].clear();
+	}
+	float const half_w = static_cast<float>(m_width)  * 0.5f;
+	float const half_h = static_cast<float>(m_height) * 0.5f;
+	for(int t=0; t<n_vertices/3; t++) {
+		//projected vertices: x, y, followed by the interpolated attributes z, u, v, r, g, b
+		float v[3][8];
+		for(int k=0; k<3; k++) {
+			int const i = t*3 + k;
+			float const* n = &normals[i*3];
+			v[k][0] = (data[i*3]     - m_center_x) * m_scale + half_w;
+			v[k][1] = (data[i*3 + 1] - m_center_y) * m_scale + half_h;
+			v[k][2] = data[i*3 + 2];
+			v[k][3] = tex_coords[i*2];
+			v[k][4] = tex_coords[i*2 + 1];
+			float light[3] = { m_ambient[0], m_ambient[1], m_ambient[2] };
+			for(int l=0; l<3; l++) {
+				float const d = n[0]*m_light_dir[l][0] + n[1]*m_light_dir[l][1] + n[2]*m_light_dir[l][2];
+				if(d > 0.0f) {
+					for(int j=0; j<3; j++) { light[j] += d * m_light_color[l][j]; }
+				}
+			}
+			for(int j=0; j<3; j++) {
+				v[k][5 + j] = light[j] * static_cast<float>((colors[i] >> (j*8)) & 0xff) * (1.0f / 255.0f);
+			}
+		}
+		float area = (v[1][0] - v[0][0]) * (v[2][1] - v[0][1]) - (v[1][1] - v[0][1]) * (v[2][0] - v[0][0]);
+		if(!(std::fabs(area) > 0.0f)) { continue; }
+		if(area < 0.0f) {
+			//no culling; bring all triangles to the same orientation
+			for(int j=0; j<8; j++) { std::swap(v[1][j], v[2][j]); }
+			area = -area;
+		}
+
+		Triangle tri;
+		float const lo_x = std::ceil(std::min(v[0][0], std::min(v[1][0], v[2][0])) - 0.5f);
+		float const hi_x = std::floor(std::max(v[0][0], std::max(v[1][0], v[2][0])) - 0.5f);
+		float const lo_y = std::ceil(std::min(v[0][1], std::min(v[1][1], v[2][1])) - 0.5f);
+		float const hi_y = std::floor(std::max(v[0][1], std::max(v[1][1], v[2][1])) - 0.5f);
+		if(!((lo_x <= hi_x) && (lo_y <= hi_y) && (hi_x >= 0.0f) && (hi_y >= 0.0f) &&
+		     (lo_x < static_cast<float>(m_width)) && (lo_y < static_cast<float>(m_height)))) { continue; }
+		tri.min_x = (lo_x > 0.0f) ? static_cast<int>(lo_x) : 0;
+		tri.min_y = (lo_y > 0.0f) ? static_cast<int>(lo_y) : 0;
+		tri.max_x = (hi_x < static_cast<float>(m_width - 1))  ? static_cast<int>(hi_x) : (m_width - 1);
+		tri.max_y = (hi_y < static_cast<float>(m_height - 1)) ? static_cast<int>(hi_y) : (m_height - 1);
+
+		for(int k=0; k<3; k++) {
+			//edge opposite of vertex k; the constant term is always computed from the same
+			//end point, so an edge shared by two triangles yields exactly negated values
+			float const* a = v[(k+1)%3];
+			float const* b = v[(k+2)%3];
+			float const ea = a[1] - b[1];
+			float const eb = b[0] - a[0];
+			bool const a_first = (a[0] < b[0]) || ((a[0] == b[0]) && (a[1] < b[1]));
+			float const* s = a_first ? a : b;
+			tri.edge[k][0] = ea;
+			tri.edge[k][1] = eb;
+			tri.edge[k][2] = -(ea * s[0] + eb * s[1]);
+			//top-left fill rule:
+			tri.owner[k] = (ea > 0.0f) || ((ea == 0.0f) && (eb > 0.0f));
+		}
+		float const inv_area = 1.0f / area;
+		for(int j=0; j<6; j++) {
+			for(int c=0; c<3; c++) {
+				tri.attrib[j][c] = ( v[0][2 + j] * tri.edge[0][c] + v[1][2 + j] * tri.edge[1][c] +
+				                     v[2][2 + j] * tri.edge[2][c] ) * inv_area;
+			}
+		}
+
+		m_order.push_back( std::make_pair(std::min(v[0][2], std::min(v[1][2], v[2][2])), static_cast<int>(m_triangles.size())) );
+		m_triangles.push_back(tri);
+	}
+
+	//bin front to back, so that hidden pixels fail the depth test before they are shaded:
+	std::sort(m_order.begin(), m_order.end());
+	for(size_t i=0; i<m_order.size(); i++) {
+		int const index = m_order[i].second;
+		Triangle const& tri = m_triangles[index];
+		for(int ty=tri.min_y/TILE_SIZE; ty<=tri.max_y/TILE_SIZE; ty++) {
+			for(int tx=tri.min_x/TILE_SIZE; tx<=tri.max_x/TILE_SIZE; tx++) {
+				m_bins[ty*m_tiles_x + tx].push_back(index);
+			}
+		}
+	}
+}
+
+void IconRasterizer::RasterizeTile(int tile_x, int tile_y) {
+	std::vector<int> const& bin = m_bins[tile_y*m_tiles_x + tile_x];
+	int const tile_x0 = tile_x * TILE_SIZE;
+	int const tile_y0 = tile_y * TILE_SIZE;
+	int const tile_x1 = std::min(tile_x0 + TILE_SIZE, m_width)  - 1;
+	int const tile_y1 = std::min(tile_y0 + TILE_SIZE, m_height) - 1;
+	unsigned int const* texture = &m_texture[0];
+	for(size_t i=0; i<bin.size(); i++) {
+		Triangle const& tri = m_triangles[bin[i]];
+		int const x0 = std::max(tri.min_x, tile_x0);
+		int const x1 = std::min(tri.max_x, tile_x1);
+		int const y0 = std::max(tri.min_y, tile_y0);
+		int const y1 = std::min(tri.max_y, tile_y1);
+		//reject the triangle if one edge function is negative in all corners of the covered rect:
+		bool outside = false;
+		for(int k=0; k<3; k++) {
+			float const cx = static_cast<float>((tri.edge[k][0] > 0.0f) ? x1 : x0) + 0.5f;
+			float const cy = static_cast<float>((tri.edge[k][1] > 0.0f) ? y1 : y0) + 0.5f;
+			if(tri.edge[k][0] * cx + tri.edge[k][1] * cy + tri.edge[k][2] < 0.0f) { outside = true; }
+		}
+		if(outside) { continue; }
+
+		//reciprocals for finding the covered span of each row:
+		float inv_a[3];
+		for(int k=0; k<3; k++) {
+			inv_a[k] = (tri.edge[k][0] != 0.0f) ? (1.0f / tri.edge[k][0]) : 0.0f;
+		}
+#ifdef PS2_RASTERIZER_SSE2
+		__m128 const lane = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+		__m128 const zero = _mm_setzero_ps();
+		//an edge that does not own its pixels requires e > 0, i.e. e >= FLT_MIN:
+		__m128 const bias[3] = { _mm_set1_ps(tri.owner[0] ? 0.0f : FLT_MIN),
+		                         _mm_set1_ps(tri.owner[1] ? 0.0f : FLT_MIN),
+		                         _mm_set1_ps(tri.owner[2] ? 0.0f : FLT_MIN) };
+		__m128 edge_a[3], attrib_a[6];
+		for(int k=0; k<3; k++) { edge_a[k]   = _mm_set1_ps(tri.edge[k][0]); }
+		for(int j=0; j<6; j++) { attrib_a[j] = _mm_set1_ps(tri.attrib[j][0]); }
+		__m128 const tex_scale  = _mm_set1_ps(128.0f);
+		__m128 const tex_offset = _mm_set1_ps(8192.0f);
+		__m128i const tex_mask  = _mm_set1_epi32(127);
+		__m128i const byte_mask = _mm_set1_epi32(0xff);
+		__m128i const alpha     = _mm_set1_epi32(static_cast<int>(0xff000000));
+		__m128 const max_c      = _mm_set1_ps(255.0f);
+#endif
+		for(int y=y0; y<=y1; y++) {
+			float const py = static_cast<float>(y) + 0.5f;
+			//conservative span of the row inside all edges, widened by a pixel to absorb rounding;
+			//coverage is decided per pixel below. lo and hi are clamped to the tile, so the
+			//conversion to int rounds down.
+			float row[3];
+			float lo = static_cast<float>(x0);
+			float hi = static_cast<float>(x1);
+			bool empty = false;
+			for(int k=0; k<3; k++) {
+				row[k] = tri.edge[k][1] * py + tri.edge[k][2];
+				if(tri.edge[k][0] > 0.0f) {
+					lo = std::max(lo, -row[k] * inv_a[k] - 1.5f);
+				} else if(tri.edge[k][0] < 0.0f) {
+					hi = std::min(hi, -row[k] * inv_a[k] + 0.5f);
+				} else if(row[k] < 0.0f) {
+					empty = true;
+				}
+			}
+			if(empty || !(lo <= hi)) { continue; }
+			int const span_x0 = static_cast<int>(lo);
+			int const span_x1 = static_cast<int>(hi);
+			unsigned int* color_row = &m_color[0] + static_cast<size_t>(y) * m_stride;
+			float* depth_row        = &m_depth[0] + static_cast<size_t>(y) * m_stride;
+#ifdef PS2_RASTERIZER_SSE2
+			//groups of four pixels never cross tile boundaries; pixels written beyond the
+			//image width fall into the padding of the rows
+			__m128 edge_row[3], attrib_row[6];
+			for(int k=0; k<3; k++) { edge_row[k]   = _mm_set1_ps(row[k]); }
+			for(int j=0; j<6; j++) { attrib_row[j] = _mm_set1_ps(tri.attrib[j][1] * py + tri.attrib[j][2]); }
+			for(int x=(span_x0 & ~3); x<=span_x1; x+=4) {
+				__m128 const px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lane);
+				__m128 cover = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edge_a[0], px), edge_row[0]), bias[0]);
+				cover = _mm_and_ps(cover, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edge_a[1], px), edge_row[1]), bias[1]));
+				cover = _mm_and_ps(cover, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edge_a[2], px), edge_row[2]), bias[2]));
+				if(_mm_movemask_ps(cover) == 0) { continue; }
+				__m128 const z     = _mm_add_ps(_mm_mul_ps(attrib_a[0], px), attrib_row[0]);
+				__m128 const old_z = _mm_loadu_ps(depth_row + x);
+				__m128 const pass  = _mm_and_ps(cover, _mm_cmplt_ps(z, old_z));
+				if(_mm_movemask_ps(pass) == 0) { continue; }
+				_mm_storeu_ps(depth_row + x, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, old_z)));
+
+				//texel lookup; the gather itself has to be done lane by lane
+				__m128 const u = _mm_add_ps(_mm_mul_ps(attrib_a[1], px), attrib_row[1]);
+				__m128 const v = _mm_add_ps(_mm_mul_ps(attrib_a[2], px), attrib_row[2]);
+				__m128i const tu = _mm_and_si128(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(u, tex_scale), tex_offset)), tex_mask);
+				__m128i const tv = _mm_and_si128(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, tex_scale), tex_offset)), tex_mask);
+				int index[4];
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(index), _mm_or_si128(_mm_slli_epi32(tv, 7), tu));
+				__m128i const texel = _mm_set_epi32( static_cast<int>(texture[index[3]]), static_cast<int>(texture[index[2]]),
+				                                     static_cast<int>(texture[index[1]]), static_cast<int>(texture[index[0]]) );
+
+				//modulate each channel with the interpolated light; shift counts must be immediates
+				__m128 r = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(texel, 16), byte_mask));
+				__m128 g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(texel, 8),  byte_mask));
+				__m128 b = _mm_cvtepi32_ps(_mm_and_si128(texel, byte_mask));
+				r = _mm_mul_ps(r, _mm_add_ps(_mm_mul_ps(attrib_a[3], px), attrib_row[3]));
+				g = _mm_mul_ps(g, _mm_add_ps(_mm_mul_ps(attrib_a[4], px), attrib_row[4]));
+				b = _mm_mul_ps(b, _mm_add_ps(_mm_mul_ps(attrib_a[5], px), attrib_row[5]));
+				r = _mm_min_ps(_mm_max_ps(r, zero), max_c);
+				g = _mm_min_ps(_mm_max_ps(g, zero), max_c);
+				b = _mm_min_ps(_mm_max_ps(b, zero), max_c);
+				__m128i const result = _mm_or_si128( _mm_or_si128(alpha, _mm_slli_epi32(_mm_cvtps_epi32(r), 16)),
+				                                     _mm_or_si128(_mm_slli_epi32(_mm_cvtps_epi32(g), 8), _mm_cvtps_epi32(b)) );
+				__m128i const pass_i = _mm_castps_si128(pass);
+				__m128i const old_c  = _mm_loadu_si128(reinterpret_cast<__m128i const*>(color_row + x));
+				_mm_storeu_si128( reinterpret_cast<__m128i*>(color_row + x),
+				                  _mm_or_si128(_mm_and_si128(pass_i, result), _mm_andnot_si128(pass_i, old_c)) );
+			}
+#else
+			for(int x=span_x0; x<=span_x1; x++) {
+				float const px = static_cast<float>(x) + 0.5f;
+				bool covered = true;
+				for(int k=0; k<3; k++) {
+					float const e = tri.edge[k][0] * px + row[k];
+					covered = covered && ((e > 0.0f) || ((e == 0.0f) && tri.owner[k]));
+				}
+				if(!covered) { continue; }
+				float attrib[6];
+				for(int j=0; j<6; j++) {
+					attrib[j] = tri.attrib[j][0] * px + (tri.attrib[j][1] * py + tri.attrib[j][2]);
+				}
+				if(!(attrib[0] < depth_row[x])) { continue; }
+				depth_row[x] = attrib[0];
+				color_row[x] = shade_texel(texture[texel_index(attrib[1], attrib[2])], attrib[3], attrib[4], attrib[5]);
+			}
+#endif
+		}
+	}
+}
+
+void IconRasterizer::GetImage(unsigned int* data) const {
+	for(int y=0; y<m_height; y++) {
+		memcpy(data + static_cast<size_t>(y) * m_width, &m_color[0] + static_cast<size_t>(y) * m_stride, sizeof(unsigned int) * m_width);
+	}
+}
+
+void IconRasterizer::WriteImage(char const* fname) const {
+	std::vector<unsigned int> image(static_cast<size_t>(m_width) * m_height);
+	GetImage(&image[0]);
+	GhulbusUtil::WriteImage(fname, &image[0], m_width, m_height);
+}
@@ -0,0 +1,245 @@
+/**
+ * @file src/ps2_texture.cpp
+ *
+ * @brief Implementation of the texture codecbuild_header/
+ */
+#include "../include/ps2_texture.hpp"
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#	define PS2_TEXTURE_SSE2
+#	include <emmintrin.h>
+#endif
+
+namespace PS2Texture {
+	/** Helper function: scalar conversion of the texels that do not fill a complete vector
+	 */
+	static void Unpack_Scalar(unsigned char const* src, unsigned int* dst, size_t n, AlphaMode mode) {
+		for(size_t i=0; i<n; i++) {
+			unsigned short c;
+			memcpy(&c, src + i*2, 2);
+			dst[i] = ToARGB(c, mode);
+		}
+	}
+	/** Helper function: scalar conversion of the texels that do not fill a complete vector
+	 */
+	static void Pack_Scalar(unsigned int const* src, unsigned char* dst, size_t n, AlphaMode mode) {
+		for(size_t i=0; i<n; i++) {
+			unsigned short c = ToRGB555(src[i], mode);
+			memcpy(dst + i*2, &c, 2);
+		}
+	}
+
+	void Unpack(void const* src, unsigned int* dst, size_t n, AlphaMode mode) {
+		unsigned char const* p = static_cast<unsigned char const*>(src);
+		size_t i = 0;
+#ifdef PS2_TEXTURE_SSE2
+		__m128i const mask5  = _mm_set1_epi16(0x1f);
+		__m128i const opaque = _mm_set1_epi16( (mode == ALPHA_OPAQUE) ? 0xff : 0x00 );
+		for(; i+8 <= n; i+=8) {
+			__m128i v = _mm_loadu_si128( reinterpret_cast<__m128i const*>(p + i*2) );
+			__m128i r = _mm_slli_epi16( _mm_and_si128(v, mask5), 3 );
+			__m128i g = _mm_slli_epi16( _mm_and_si128(_mm_srli_epi16(v, 5), mask5), 3 );
+			__m128i b = _mm_slli_epi16( _mm_and_si128(_mm_srli_epi16(v, 10), mask5), 3 );
+			//bit 15 is replicated to all bits of the lane; keep the lower byte as alpha:
+			__m128i a = _mm_or_si128( opaque, _mm_srli_epi16(_mm_srai_epi16(v, 15), 8) );
+			//little endian ARGB is stored as B,G,R,A in memory:
+			__m128i bg = _mm_or_si128( b, _mm_slli_epi16(g, 8) );
+			__m128i ra = _mm_or_si128( r, _mm_slli_epi16(a, 8) );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>(dst + i),     _mm_unpacklo_epi16(bg, ra) );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(bg, ra) );
+		}
+#endif
+		Unpack_Scalar(p + i*2, dst + i, n - i, mode);
+	}
+
+	void Pack(unsigned int const* src, void* dst, size_t n, AlphaMode mode) {
+		unsigned char* p = static_cast<unsigned char*>(dst);
+		size_t i = 0;
+#ifdef PS2_TEXTURE_SSE2
+		__m128i const mask_r = _mm_set1_epi32(0x001f);
+		__m128i const mask_g = _mm_set1_epi32(0x03e0);
+		__m128i const mask_b = _mm_set1_epi32(0x7c00);
+		__m128i const mask_a = _mm_set1_epi32( (mode == ALPHA_BIT15) ? 0x8000 : 0x0000 );
+		for(; i+8 <= n; i+=8) {
+			__m128i c[2];
+			for(int j=0; j<2; j++) {
+				__m128i v = _mm_loadu_si128( reinterpret_cast<__m128i const*>(src + i + j*4) );
+				__m128i t = _mm_or_si128( _mm_and_si128(_mm_srli_epi32(v, 19), mask_r),
+				                          _mm_and_si128(_mm_srli_epi32(v, 6),  mask_g) );
+				t = _mm_or_si128( t, _mm_and_si128(_mm_slli_epi32(v, 7), mask_b) );
+				t = _mm_or_si128( t, _mm_and_si128(_mm_srli_epi32(v, 16), mask_a) );
+				//sign extend so the signed saturation of packs leaves bit 15 intact:
+				c[j] = _mm_srai_epi32( _mm_slli_epi32(t, 16), 16 );
+			}
+			_mm_storeu_si128( reinterpret_cast<__m128i*>(p + i*2), _mm_packs_epi32(c[0], c[1]) );
+		}
+#endif
+		Pack_Scalar(src + i, p + i*2, n - i, mode);
+	}
+
+	/** Helper function: fills n texels with the same value
+	 */
+	static void Fill(unsigned int* dst, unsigned int c, size_t n) {
+		size_t i = 0;
+#ifdef PS2_TEXTURE_SSE2
+		__m128i const v = _mm_set1_epi32(static_cast<int>(c));
+		for(; i+16 <= n; i+=16) {
+			_mm_storeu_si128( reinterpret_cast<__m128i*>(dst + i),      v );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>(dst + i + 4),  v );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>(dst + i + 8),  v );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>(dst + i + 12), v );
+		}
+		for(; i+4 <= n; i+=4) {
+			_mm_storeu_si128( reinterpret_cast<__m128i*>(dst + i), v );
+		}
+#endif
+		for(; i<n; i++) {
+			dst[i] = c;
+		}
+	}
+
+	int DecodeRLE(void const* src, size_t size, unsigned int* dst, AlphaMode mode) {
+		unsigned char const* p   = static_cast<unsigned char const*>(src);
+		unsigned char const* end = p + size;
+		size_t index = 0;
+		while((end - p >= 2) && (index < static_cast<size_t>(N_TEXELS))) {
+			//next 16 bits indicate the type of data to follow:
+			unsigned short rep_count;
+			memcpy(&rep_count, p, 2);
+			p += 2;
+			size_t const remaining = N_TEXELS - index;
+			if(rep_count < 0xFF00) {			//repeat the next texel rep_count times
+				if(end - p < 2) { break; }
+				unsigned short c;
+				memcpy(&c, p, 2);
+				p += 2;
+				size_t const n = (rep_count < remaining) ? rep_count : remaining;
+				Fill(dst + index, ToARGB(c, mode), n);
+				index += n;
+			} else {							//copy the next (rep_count ^ 0xFFFF) + 1 texels directly
+				size_t n = (0xFFFF ^ static_cast<size_t>(rep_count)) + 1;
+				size_t const available = static_cast<size_t>(end - p) / 2;
+				if(n > available) { n = available; }
+				size_t const n_write = (n < remaining) ? n : remaining;
+				Unpack(p, dst + index, n_write, mode);
+				p += n * 2;
+				index += n_write;
+			}
+		}
+		Fill(dst + index, 0, N_TEXELS - index);
+		return static_cast<int>(index);
+	}
+
+	/** Helper function: finds the start of the run of equal texels that each texel belongs to
+	 * @param[in] plane A field of N_TEXELS texels
+	 * @param[out] run_start A field of N_TEXELS indices
+	 */
+	static void FindRuns(unsigned short const* plane, int* run_start) {
+		int start = 0;
+		run_start[0] = 0;
+		int i = 1;
+#ifdef PS2_TEXTURE_SSE2
+		//compare 8 texels against their predecessors at once; 
+		//runs of flat color are skipped without looking at single texels
+		for(; i+8 <= N_TEXELS; i+=8) {
+			__m128i cur  = _mm_loadu_si128( reinterpret_cast<__m128i const*>(plane + i) );
+			__m128i prev = _mm_loadu_si128( reinterpret_cast<__m128i const*>(plane + i - 1) );
+			int const mask = _mm_movemask_epi8( _mm_cmpeq_epi16(cur, prev) );
+			if(mask == 0xFFFF) {
+				for(int j=0; j<8; j++) { run_start[i + j] = start; }
+			} else {
+				for(int j=0; j<8; j++) {
+					if( ((mask >> (j*2)) & 1) == 0 ) { start = i + j; }
+					run_start[i + j] = start;
+				}
+			}
+		}
+#endif
+		for(; i<N_TEXELS; i++) {
+			if(plane[i] != plane[i-1]) { start = i; }
+			run_start[i] = start;
+		}
+	}
+
+	int EncodeRLE(unsigned short const* plane, void* dst) {
+		std::vector<int> run_start(N_TEXELS);
+		FindRuns(plane, &run_start[0]);
+
+		//cost[i]: minimal size in bytes of an encoding for the first i texels;
+		//from[i]: start of the last segment in that encoding (negative for literal segments)
+		std::vector<int> cost(N_TEXELS + 1);
+		std::vector<int> from(N_TEXELS + 1);
+		//sliding window minimum of (cost[k] - 2*k) over the last 256 k for literal segments:
+		std::vector<int> window(N_TEXELS + 1);
+		int window_begin = 0, window_end = 0;
+		int run_min = 0;
+		cost[0] = 0;
+		for(int i=1; i<=N_TEXELS; i++) {
+			//repeat segment: may start anywhere in the run that texel (i-1) belongs to
+			int const k = i - 1;
+			if((k == 0) || (run_start[k] != run_start[k-1])) {
+				run_min = k;
+			} else if(cost[k] < cost[run_min]) {
+				run_min = k;
+			}
+			int const repeat_cost = cost[run_min] + 4;
+			//literal segment: may start at most 256 texels before i
+			while((window_end > window_begin) && (cost[window[window_end-1]] - 2*window[window_end-1] >= cost[k] - 2*k)) {
+				window_end--;
+			}
+			window[window_end++] = k;
+			if(window[window_begin] < i - 256) { window_begin++; }
+			int const l = window[window_begin];
+			int const literal_cost = cost[l] + 2 + 2*(i - l);
+			//prefer repeats on ties; they decode faster
+			if(repeat_cost <= literal_cost) {
+				cost[i] = repeat_cost;
+				from[i] = run_min;
+			} else {
+				cost[i] = literal_cost;
+				from[i] = -1 - l;
+			}
+		}
+
+		//walk back the chosen segments and emit them in file order:
+		std::vector<int> segments;
+		for(int i=N_TEXELS; i>0; ) {
+			segments.push_back(i);
+			i = (from[i] >= 0) ? from[i] : (-1 - from[i]);
+		}
+		unsigned char* p = static_cast<unsigned char*>(dst);
+		int begin = 0;
+		for(size_t s=segments.size(); s>0; s--) {
+			int const end = segments[s-1];
+			unsigned short header;
+			if(from[end] >= 0) {				//repeat the texel (end - begin) times
+				header = static_cast<unsigned short>(end - begin);
+				memcpy(p, &header, 2);
+				memcpy(p + 2, &plane[begin], 2);
+				p += 4;
+			} else {							//copy (end - begin) texels directly
+				header = static_cast<unsigned short>( 0xFFFF ^ (end - begin - 1) );
+				memcpy(p, &header, 2);
+				memcpy(p + 2, &plane[begin], (end - begin) * 2);
+				p += 2 + (end - begin) * 2;
+			}
+			begin = end;
+		}
+		return static_cast<int>( p - static_cast<unsigned char*>(dst) );
+	}
+
+	void FlipRows(unsigned int* data, int width, int height) {
+		unsigned int row[WIDTH];
+		unsigned int* tmp = (width > WIDTH) ? (new unsigned int[width]) : row;
+		for(int i=0; i<height/2; i++) {
+			unsigned int* top    = data + i * width;
+			unsigned int* bottom = data + (height - 1 - i) * width;
+			memcpy(tmp, top, sizeof(unsigned int) * width);
+			memcpy(top, bottom, sizeof(unsigned int) * width);
+			memcpy(bottom, tmp, sizeof(unsigned int) * width);
+		}
+		if(tmp != row) { delete[] tmp; }
+	}
+};
@@ -0,0 +1,629 @@
+/**
+ * @file src/ps2icon_scan.cpp
+ *
+ * @brief A tool for validating and cataloguing large collections of PS2 Icons and icon.sys filesbuild_header/
+ */
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "../include/ps2_ps2icon.hpp"
+#include "../include/ps2_iconsys.hpp"
+#include "../include/ps2_iconview.hpp"
+#include "../include/ps2_texture.hpp"
+#include "../include/mapped_file.hpp"
+#include "../include/directory_walker.hpp"
+#include "../include/thread_pool.hpp"
+#include "../include/content_hash.hpp"
+#include "../gbLib/include/gbException.hpp"
+
+std::vector<char const*> scan_inputs;		///< files and directories to scan
+char const* scan_output_file = NULL;		///< path to the output file (NULL = stdout)
+char const* dedup_report_file = NULL;		///< path to the dedup report (NULL = no fingerprints)
+bool jsonl_output            = false;		///< flag for JSON Lines instead of CSV output
+bool scan_all_files          = false;		///< flag for treating files of any name as icons
+int n_threads                = 0;			///< number of scanning threads (0 = one per processor)
+int const BATCH_SIZE         = 4096;		///< number of files listed resp. scanned between two writes of the output
+
+/** Kind of a scanned file
+ */
+typedef enum {
+	KIND_ICON=0,							///< icon file
+	KIND_ICONSYS							///< icon.sys file
+} FileKind;
+
+/** Outcome of scanning a file
+ */
+typedef enum {
+	STATUS_OK=0,							///< the file is valid
+	STATUS_INVALID_HEADER,					///< the header failed CheckValidity()
+	STATUS_CORRUPTED,						///< the header is valid, but the segments do not fit the file
+	STATUS_READ_ERROR						///< the file could not be opened
+} ScanStatus;
+
+/** Result of scanning a single file
+ */
+typedef struct ScanRecord_t {
+	FileKind kind;							///< kind of the file
+	ScanStatus status;						///< outcome of the scan
+	size_t size;							///< file size in bytes
+	unsigned int n_vertices;				///< number of vertices (icons with a readable header only)
+	unsigned int n_shapes;					///< number of animation shapes (icons with a readable header only)
+	unsigned int n_frames;					///< number of animation frames (valid icons only)
+	unsigned int texture_type;				///< texture type field of the header (icons with a readable header only)
+	double rle_ratio;						///< size of the texture segment relative to a raw texture (valid icons only)
+	bool has_header;						///< true if the icon fields are set
+	bool has_layout;						///< true if n_frames and rle_ratio are set
+	bool has_fingerprint;					///< true if hashes is set
+	ContentHash::Hash128 hashes[4];			///< fingerprint in the order of DedupEntry::hashes
+} ScanRecord;
+
+/** Fingerprint of a valid file, kept for the dedup report
+ */
+typedef struct DedupEntry_t {
+	FileKind kind;							///< kind of the file
+	ContentHash::Hash128 hashes[4];			///< icons: icon, geometry, animation, texture;
+											///  icon.sys: file, display, names (last one unused)
+} DedupEntry;
+
+/** Print a help text on screen
+ * @param[in] self Name of the executable (e.g. obtained from argv[0])
+ */
+void PrintHelp(char* self)
+{
+	std::cout << "********************************************************"  << "\n"
+		      << " *** PS2Icon Corpus Scanner  V-1.0                  ***"   << "\n"
+		      << "  **  by Ghulbus Inc.  (http://www.ghulbus-inc.de/) **"    << "\n"
+			  << "   **************************************************"     << "\n"
+			  << "\n"
+			  << " Usage: " << self << " [OPTION]..."                        << "\n"
+			  << "Validate PS2Icon and icon.sys files and write one record per file."  << "\n"
+			  << "\n"
+			  << "  -h,   --help         display this help"                  << "\n"
+			  << "  -d,   --input        File or directory to scan recursively (repeatable)" << "\n"
+			  << "  -o,   --output-file  Name of the destination file (default: stdout)"      << "\n"
+			  << "  -fmt, --format       Output format: csv (default) or jsonl"               << "\n"
+			  << "  -j,   --threads      Threads for scanning (one per processor)"            << "\n"
+			  << "  -a,   --all-files    Scan files of any name as icons, not only .icn/.ico" << "\n"
+			  << "  -dup, --dedup-report Fingerprint valid files and write groups of identical"  << "\n"
+			  << "                       content to the given file"                           << "\n"
+			  << "\n"
+			  << " Files named icon.sys are checked as icon.sys, all others as icons."        << "\n"
+			  << " Records hold: path, kind, size, status (ok, invalid_header, corrupted,"   << "\n"
+			  << " read_error), vertices, shapes, frames, texture_type, rle_ratio."          << "\n"
+			  << "\n"
+			  << " Examples:"                                                              << "\n"
+			  << "  " << self << " -d saves -o saves.csv"                                 << "\n"
+			  << "Scans all icons and icon.sys files below the directory saves and writes"  << "\n"
+			  << "a CSV table to saves.csv."                                              << "\n"
+			  << "\n"
+			  << "  " << self << " -d a -d b -fmt jsonl -j 4"                             << "\n"
+			  << "Scans the directories a and b with 4 threads and writes JSON Lines to"   << "\n"
+			  << "the standard output."                                                   << "\n"
+			  << "\n"
+			  << "  " << self << " -d saves -o saves.csv -dup dups.txt"                   << "\n"
+			  << "Additionally lists icons and icon.sys files of identical content, as well"  << "\n"
+			  << "as icons sharing only their geometry, animation or texture, in dups.txt."  << "\n"
+			  << std::endl;
+}
+
+/** Parse the command line arguments and set globals accordingly
+ * @param[in] argc argc
+ * @param[in] argv argv
+ */
+void ParseCommandLine(int argc, char* argv[])
+{
+	for(int i=1; i<argc; i++) {
+		if( (strcmp( argv[i], "-h" ) == 0) || (strcmp( argv[i], "--help" ) == 0) ) {
+			PrintHelp(argv[0]);
+			exit(0);
+		} else if( (strcmp( argv[i], "-a" ) == 0) || (strcmp( argv[i], "--all-files" ) == 0) ) {
+			scan_all_files = true;
+		} else if(i+1 < argc) {
+			if( (strcmp( argv[i], "-d" ) == 0) || (strcmp( argv[i], "--input" ) == 0) ) {
+				scan_inputs.push_back(argv[++i]);
+			} else if( (strcmp( argv[i], "-o" ) == 0) || (strcmp( argv[i], "--output-file" ) == 0) ) {
+				scan_output_file = argv[++i];
+			} else if( (strcmp( argv[i], "-dup" ) == 0) || (strcmp( argv[i], "--dedup-report" ) == 0) ) {
+				dedup_report_file = argv[++i];
+			} else if( (strcmp( argv[i], "-j" ) == 0) || (strcmp( argv[i], "--threads" ) == 0) ) {
+				n_threads = atoi(argv[++i]);
+			} else if( (strcmp( argv[i], "-fmt" ) == 0) || (strcmp( argv[i], "--format" ) == 0) ) {
+				i++;
+				if(strcmp( argv[i], "csv" ) == 0) {
+					jsonl_output = false;
+				} else if(strcmp( argv[i], "jsonl" ) == 0) {
+					jsonl_output = true;
+				} else {
+					std::cout << "Invalid output format \"" << argv[i] << "\"." << std::endl << std::endl;
+					PrintHelp(argv[0]);
+					exit(1);
+				}
+			} else {
+				std::cout << "Invalid argument.\n" << std::endl;
+				PrintHelp(argv[0]);
+				exit(1);
+			}
+		} else {
+			std::cout << "Invalid argument.\n" << std::endl;
+			PrintHelp(argv[0]);
+			exit(1);
+		}
+	}
+}
+
+/** Compare the end of a string ignoring the case of ASCII letters
+ * @param[in] str The string to check
+ * @param[in] suffix The expected end of str (lower case)
+ * @return True if str ends with suffix
+ */
+bool EndsWithIgnoreCase(std::string const& str, char const* suffix)
+{
+	size_t const len = strlen(suffix);
+	if(str.size() < len) { return false; }
+	for(size_t i=0; i<len; i++) {
+		if(tolower(static_cast<unsigned char>(str[str.size() - len + i])) != suffix[i]) { return false; }
+	}
+	return true;
+}
+
+/** Decide whether and how a file is scanned
+ * @param[in] path Path of the file
+ * @param[out] kind Receives the kind of the file
+ * @return False if the file is skipped
+ */
+bool ClassifyFile(std::string const& path, FileKind* kind)
+{
+	size_t const separator = path.find_last_of("/\\");
+	std::string const name = (separator == std::string::npos) ? path : path.substr(separator + 1);
+	if((name.size() == 8) && EndsWithIgnoreCase(name, "icon.sys")) {
+		*kind = KIND_ICONSYS;
+		return true;
+	}
+	*kind = KIND_ICON;
+	return scan_all_files || EndsWithIgnoreCase(name, ".icn") || EndsWithIgnoreCase(name, ".ico");
+}
+
+/** Deletes a mapped file when it goes out of scope
+ */
+class MappedFileGuard {
+private:
+	MappedFile* m_file;
+public:
+	MappedFileGuard(MappedFile* file): m_file(file) {}
+	~MappedFileGuard() { delete m_file; }
+private:
+	MappedFileGuard(MappedFileGuard const&);				///< private copy constructor (not implemented!)
+	MappedFileGuard& operator=(MappedFileGuard const&);		///< private copy assignment (not implemented!)
+};
+
+/** Validate a single file
+ * @param[in] path Path of the file
+ * @param[in] kind Kind of the file
+ * @param[out] record Receives the result
+ * @note The icon header is checked before the layout of the remaining segments is parsed;
+ *       no segment is decoded, except for rle encoded textures when fingerprinting.
+ */
+void ScanFile(std::string const& path, FileKind kind, ScanRecord* record)
+{
+	memset(record, 0, sizeof(ScanRecord));
+	record->kind = kind;
+	MappedFile* file = NULL;
+	try {
+		file = new MappedFile(path.c_str());
+	} catch( Ghulbus::gbException& ) {
+		record->status = STATUS_READ_ERROR;
+		return;
+	}
+	//fingerprinting may throw std::bad_alloc; the mapping must not leak in that case:
+	MappedFileGuard const file_guard(file);
+	MemorySpan<unsigned char> const data = file->GetSpan();
+	record->size = data.GetSize();
+	if(kind == KIND_ICONSYS) {
+		record->status = IconSys::CheckValidity(data) ? STATUS_OK : STATUS_INVALID_HEADER;
+		if((record->status == STATUS_OK) && dedup_report_file) {
+			IconSys::Fingerprint const fingerprint = IconSys(data).GetFingerprint();
+			record->hashes[0] = fingerprint.file;
+			record->hashes[1] = fingerprint.display;
+			record->hashes[2] = fingerprint.names;
+			record->has_fingerprint = true;
+		}
+	} else if(data.GetSize() < sizeof(PS2Icon::Icon_Header)) {
+		record->status = STATUS_INVALID_HEADER;
+	} else {
+		PS2Icon::Icon_Header header;
+		memcpy(&header, data.GetData(), sizeof(header));
+		record->has_header   = true;
+		record->n_vertices   = header.n_vertices;
+		record->n_shapes     = header.animation_shapes;
+		record->texture_type = header.texture_type;
+		if(!PS2Icon::CheckValidity(header)) {
+			record->status = STATUS_INVALID_HEADER;
+		} else {
+			try {
+				PS2IconView view(data);
+				record->has_layout = true;
+				record->n_frames   = view.GetNFrames();
+				record->rle_ratio  = static_cast<double>(view.GetTextureSegment().GetSize()) /
+				                     (PS2Texture::N_TEXELS * 2);
+				record->status     = STATUS_OK;
+				if(dedup_report_file) {
+					PS2Icon::Fingerprint const fingerprint = view.GetFingerprint();
+					record->hashes[0] = fingerprint.icon;
+					record->hashes[1] = fingerprint.geometry;
+					record->hashes[2] = fingerprint.animation;
+					record->hashes[3] = fingerprint.texture;
+					record->has_fingerprint = true;
+				}
+			} catch( Ghulbus::gbException& ) {
+				record->status = STATUS_CORRUPTED;
+			} catch( std::bad_alloc& ) {
+				record->status = STATUS_CORRUPTED;
+			}
+		}
+	}
+}
+
+/** Append a string to a line of output, quoted for CSV resp. JSON
+ * @param[in] str The string
+ * @param[in,out] line The output line
+ */
+void AppendQuoted(std::string const& str, std::string* line)
+{
+	if(jsonl_output) {
+		line->push_back('"');
+		for(size_t i=0; i<str.size(); i++) {
+			unsigned char const c = static_cast<unsigned char>(str[i]);
+			if((c == '"') || (c == '\\')) {
+				line->push_back('\\');
+				line->push_back(c);
+			} else if(c < 0x20) {
+				char buffer[8];
+				sprintf(buffer, "\\u%04x", c);
+				line->append(buffer);
+			} else {
+				line->push_back(c);
+			}
+		}
+		line->push_back('"');
+	} else if(str.find_first_of(",\"\r\n") != std::string::npos) {
+		line->push_back('"');
+		for(size_t i=0; i<str.size(); i++) {
+			if(str[i] == '"') { line->push_back('"'); }
+			line->push_back(str[i]);
+		}
+		line->push_back('"');
+	} else {
+		line->append(str);
+	}
+}
+
+/** Format the output line of a file
+ * @param[in] path Path of the file
+ * @param[in] record Result of the scan
+ * @param[out] line Receives the line, including the line break
+ */
+void FormatRecord(std::string const& path, ScanRecord const& record, std::string* line)
+{
+	static char const* const kind_names[] = { "icon", "iconsys" };
+	static char const* const status_names[] = { "ok", "invalid_header", "corrupted", "read_error" };
+	char buffer[256];
+	line->clear();
+	if(jsonl_output) {
+		line->append("{\"path\":");
+		AppendQuoted(path, line);
+		sprintf(buffer, ",\"kind\":\"%s\",\"size\":%lu,\"status\":\"%s\"", kind_names[record.kind],
+		        static_cast<unsigned long>(record.size), status_names[record.status]);
+		line->append(buffer);
+		if(record.has_header) {
+			sprintf(buffer, ",\"vertices\":%u,\"shapes\":%u,\"texture_type\":%u",
+			        record.n_vertices, record.n_shapes, record.texture_type);
+			line->append(buffer);
+		}
+		if(record.has_layout) {
+			sprintf(buffer, ",\"frames\":%u,\"rle_ratio\":%.4f", record.n_frames, record.rle_ratio);
+			line->append(buffer);
+		}
+		line->append("}\n");
+	} else {
+		AppendQuoted(path, line);
+		sprintf(buffer, ",%s,%lu,%s,", kind_names[record.kind], static_cast<unsigned long>(record.size),
+		        status_names[record.status]);
+		line->append(buffer);
+		if(record.has_header) {
+			sprintf(buffer, "%u,%u,", record.n_vertices, record.n_shapes);
+			line->append(buffer);
+		} else {
+			line->append(",,");
+		}
+		if(record.has_layout) {
+			sprintf(buffer, "%u,", record.n_frames);
+			line->append(buffer);
+		} else {
+			line->append(",");
+		}
+		if(record.has_header) {
+			sprintf(buffer, "%u,", record.texture_type);
+			line->append(buffer);
+		} else {
+			line->append(",");
+		}
+		if(record.has_layout) {
+			sprintf(buffer, "%.4f", record.rle_ratio);
+			line->append(buffer);
+		}
+		line->append("\n");
+	}
+}
+
+/** Lists the files to scan below all inputs, one batch at a time
+ */
+class FileLister {
+private:
+	std::vector<char const*> const& m_inputs;	///< files and directories to walk
+	size_t m_input;								///< index of the input currently walked
+	DirectoryWalker* m_walker;					///< walker of the current input (NULL = not opened yet)
+	bool m_error;								///< an input or a directory below it could not be read
+public:
+	/** Constructor
+	 * @param[in] inputs Files and directories to walk; must outlive the lister
+	 */
+	FileLister(std::vector<char const*> const& inputs): m_inputs(inputs), m_input(0), m_walker(NULL), m_error(false) {}
+	/** Destructor
+	 */
+	~FileLister() { delete m_walker; }
+	/** Get the next batch of files to scan
+	 * @param[out] paths Receives up to BATCH_SIZE paths; empty if all inputs have been walked
+	 * @param[out] kinds Receives the kind of each file in paths
+	 * @throw std::bad_alloc
+	 * @note Unreadable inputs and directories are reported on std::cerr and skipped.
+	 */
+	void NextBatch(std::vector<std::string>* paths, std::vector<FileKind>* kinds) {
+		paths->clear();
+		kinds->clear();
+		while((static_cast<int>(paths->size()) < BATCH_SIZE) && (m_input < m_inputs.size())) {
+			if(!m_walker) {
+				try {
+					m_walker = new DirectoryWalker(m_inputs[m_input]);
+				} catch( Ghulbus::gbException& ) {
+					std::cerr << "File read error: \"" << m_inputs[m_input] << "\"" << std::endl;
+					m_error = true;
+					m_input++;
+					continue;
+				}
+			}
+			std::string path;
+			try {
+				if(!m_walker->Next(&path)) {
+					delete m_walker;
+					m_walker = NULL;
+					m_input++;
+					continue;
+				}
+			} catch( Ghulbus::gbException& e ) {
+				std::cerr << "Warning: skipping a directory below \"" << m_inputs[m_input] << "\": "
+				          << e.GetErrorString() << std::endl;
+				m_error = true;
+				continue;
+			}
+			FileKind kind;
+			if(ClassifyFile(path, &kind)) {
+				paths->push_back(path);
+				kinds->push_back(kind);
+			}
+		}
+	}
+	/** Check for read errors
+	 * @return True if an input or a directory below it could not be read
+	 */
+	bool HadError() const { return m_error; }
+private:
+	FileLister(FileLister const&);				///< private copy constructor (not implemented!)
+	FileLister& operator=(FileLister const&);	///< private copy assignment (not implemented!)
+};
+
+/** Scans one file of the current batch per item and formats its output line;
+ *  item 0 lists the next batch meanwhile
+ */
+class ScanJob: public ThreadPool::Job {
+private:
+	FileLister& m_lister;
+	std::vector<std::string> const& m_paths;
+	std::vector<FileKind> const& m_kinds;
+	std::vector<ScanRecord>& m_records;
+	std::vector<std::string>& m_lines;
+	std::vector<std::string>& m_next_paths;
+	std::vector<FileKind>& m_next_kinds;
+public:
+	ScanJob(FileLister& lister, std::vector<std::string> const& paths, std::vector<FileKind> const& kinds,
+	        std::vector<ScanRecord>& records, std::vector<std::string>& lines,
+	        std::vector<std::string>& next_paths, std::vector<FileKind>& next_kinds)
+		:m_lister(lister), m_paths(paths), m_kinds(kinds), m_records(records), m_lines(lines),
+		 m_next_paths(next_paths), m_next_kinds(next_kinds) {}
+	void Run(int item, int /* thread */) {
+		//items are handed out in order, so the walk starts first and overlaps the scans:
+		if(item == 0) {
+			m_lister.NextBatch(&m_next_paths, &m_next_kinds);
+			return;
+		}
+		ScanFile(m_paths[item - 1], m_kinds[item - 1], &m_records[item - 1]);
+		FormatRecord(m_paths[item - 1], m_records[item - 1], &m_lines[item - 1]);
+	}
+private:
+	ScanJob& operator=(ScanJob const&);		///< private copy assignment (not implemented!)
+};
+
+/** Orders dedup entries by one of their hashes, then by path
+ */
+class DedupOrder {
+private:
+	std::vector<DedupEntry> const& m_entries;
+	int m_hash;
+public:
+	DedupOrder(std::vector<DedupEntry> const& entries, int hash): m_entries(entries), m_hash(hash) {}
+	bool operator()(unsigned int a, unsigned int b) const {
+		if(m_entries[a].hashes[m_hash] != m_entries[b].hashes[m_hash]) {
+			return m_entries[a].hashes[m_hash] < m_entries[b].hashes[m_hash];
+		}
+		return a < b;
+	}
+};
+
+/** Write the dedup report
+ * @param[in] out The destination stream
+ * @param[in] paths Paths of all fingerprinted files, in scan order
+ * @param[in] entries Fingerprints of all fingerprinted files, in the order of paths
+ * @note For every kind of content, the report states how many files are duplicates of an
+ *       earlier one. It then lists the groups of files with identical content; the first
+ *       path of a group is the file that was scanned first. Groups of identical geometry,
+ *       animation, texture or icon.sys parts are only listed if they are not already
+ *       covered by a single group of identical files.
+ */
+void WriteDedupReport(std::ostream& out, std::vector<std::string> const& paths, std::vector<DedupEntry> const& entries)
+{
+	static FileKind const content_kinds[] = { KIND_ICON, KIND_ICON, KIND_ICON, KIND_ICON, KIND_ICONSYS, KIND_ICONSYS, KIND_ICONSYS };
+	static int const content_hashes[] = { 0, 1, 2, 3, 0, 1, 2 };
+	static char const* const content_names[] = { "icon", "geometry", "animation", "texture",
+	                                              "iconsys", "iconsys_display", "iconsys_names" };
+	int const N_CONTENTS = 7;
+	char buffer[256];
+
+	//sort the files of each kind of content, so identical hashes are adjacent:
+	std::vector< std::vector<unsigned int> > orders(N_CONTENTS);
+	for(int c=0; c<N_CONTENTS; c++) {
+		for(unsigned int i=0; i<entries.size(); i++) {
+			if(entries[i].kind == content_kinds[c]) { orders[c].push_back(i); }
+		}
+		std::sort(orders[c].begin(), orders[c].end(), DedupOrder(entries, content_hashes[c]));
+	}
+
+	out << "# ps2icon_scan dedup report\n";
+	out << "# content                 files   distinct  duplicates\n";
+	for(int c=0; c<N_CONTENTS; c++) {
+		std::vector<unsigned int> const& order = orders[c];
+		int const h = content_hashes[c];
+		unsigned long n_distinct = 0;
+		for(size_t i=0; i<order.size(); i++) {
+			if((i == 0) || (entries[order[i]].hashes[h] != entries[order[i-1]].hashes[h])) { n_distinct++; }
+		}
+		unsigned long const n_duplicates = static_cast<unsigned long>(order.size()) - n_distinct;
+		sprintf(buffer, "%-20s %10lu %10lu  %10lu (%.1f%%)\n", content_names[c], static_cast<unsigned long>(order.size()),
+		        n_distinct, n_duplicates, order.empty() ? 0.0 : (100.0 * n_duplicates / order.size()));
+		out << buffer;
+	}
+
+	for(int c=0; c<N_CONTENTS; c++) {
+		std::vector<unsigned int> const& order = orders[c];
+		int const h = content_hashes[c];
+		for(size_t begin=0, end=0; begin<order.size(); begin=end) {
+			bool same_file = true;
+			for(end=begin+1; (end < order.size()) && (entries[order[end]].hashes[h] == entries[order[begin]].hashes[h]); end++) {
+				same_file = same_file && (entries[order[end]].hashes[0] == entries[order[begin]].hashes[0]);
+			}
+			if((end - begin < 2) || ((h != 0) && same_file)) { continue; }
+			out << "\n" << content_names[c] << " " << ContentHash::ToString(entries[order[begin]].hashes[h])
+			    << " (" << (end - begin) << " files)\n";
+			for(size_t i=begin; i<end; i++) {
+				out << "\t" << paths[order[i]] << "\n";
+			}
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	ParseCommandLine(argc, argv);
+
+	if(scan_inputs.empty()) {
+		std::cout << "No input specified." << std::endl << std::endl;
+		PrintHelp(argv[0]);
+		exit(1);
+	}
+
+	std::ofstream fout;
+	if(scan_output_file) {
+		fout.open(scan_output_file, std::ios_base::out | std::ios_base::binary);
+		if(fout.fail()) {
+			std::cerr << "Error while opening \"" << scan_output_file << "\"" << std::endl;
+			exit(1);
+		}
+	}
+	std::ostream& out = scan_output_file ? static_cast<std::ostream&>(fout) : std::cout;
+	std::ofstream fdedup;
+	if(dedup_report_file) {
+		fdedup.open(dedup_report_file, std::ios_base::out | std::ios_base::binary);
+		if(fdedup.fail()) {
+			std::cerr << "Error while opening \"" << dedup_report_file << "\"" << std::endl;
+			exit(1);
+		}
+	}
+	if(!jsonl_output) {
+		out << "path,kind,size,status,vertices,shapes,frames,texture_type,rle_ratio\n";
+	}
+
+	ThreadPool* pool = NULL;
+	try {
+		pool = new ThreadPool(n_threads);
+	} catch( Ghulbus::gbException& e ) {
+		std::cerr << "Error while starting threads: " << e.what() << std::endl;
+		exit(1);
+	}
+
+	//files are collected in batches, so output is written while the walk goes on
+	//and the memory used does not depend on the size of the corpus; the next batch
+	//is listed while the current one is scanned:
+	FileLister lister(scan_inputs);
+	std::vector<std::string> paths[2];
+	std::vector<FileKind> kinds[2];
+	std::vector<ScanRecord> records(BATCH_SIZE);
+	std::vector<std::string> lines(BATCH_SIZE);
+	std::vector<std::string> dedup_paths;
+	std::vector<DedupEntry> dedup_entries;
+	unsigned long n_scanned[2] = { 0, 0 };
+	unsigned long n_failed = 0;
+	lister.NextBatch(&paths[0], &kinds[0]);
+	for(int cur=0; !paths[cur].empty(); cur=1-cur) {
+		ScanJob job(lister, paths[cur], kinds[cur], records, lines, paths[1-cur], kinds[1-cur]);
+		try {
+			pool->Run(job, static_cast<int>(paths[cur].size()) + 1);
+		} catch( Ghulbus::gbException& e ) {
+			std::cerr << "Error while scanning: " << e.what() << std::endl;
+			exit(1);
+		}
+		for(size_t j=0; j<paths[cur].size(); j++) {
+			out.write(lines[j].data(), lines[j].size());
+			n_scanned[kinds[cur][j]]++;
+			if(records[j].status != STATUS_OK) { n_failed++; }
+			if(records[j].has_fingerprint) {
+				DedupEntry entry;
+				entry.kind = kinds[cur][j];
+				memcpy(entry.hashes, records[j].hashes, sizeof(entry.hashes));
+				dedup_entries.push_back(entry);
+				dedup_paths.push_back(paths[cur][j]);
+			}
+		}
+	}
+	out.flush();
+	delete pool;
+	if(out.fail()) {
+		std::cerr << "Error while writing the output" << std::endl;
+		exit(1);
+	}
+	if(dedup_report_file) {
+		WriteDedupReport(fdedup, dedup_paths, dedup_entries);
+		fdedup.flush();
+		if(fdedup.fail()) {
+			std::cerr << "Error while writing the dedup report" << std::endl;
+			exit(1);
+		}
+	}
+
+	std::cerr << "Scanned " << n_scanned[KIND_ICON] << " icons and " << n_scanned[KIND_ICONSYS]
+	          << " icon.sys files; " << n_failed << " failed validation." << std::endl;
+	return lister.HadError() ? 1 : 0;
+}
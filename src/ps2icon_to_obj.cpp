@@ -4,8 +4,16 @@
  * @brief A tool for converting PS2 Icons to OBJbuild_header/
  */
 #include <iostream>
+#include <new>
 #include "../include/ps2_ps2icon.hpp"
+#include "../include/ps2_texture.hpp"
+#include "../include/ps2_iconsys.hpp"
+#include "../include/ps2_rasterizer.hpp"
+#include "../include/ps2_preview.hpp"
+#include "../include/ps2_memcard.hpp"
+#include "../include/ps2_iconview.hpp"
 #include "../include/obj_loader.hpp"
+#include "../include/conversion_cache.hpp"
 #include "../gbLib/include/gbException.hpp"
 #include "../gbLib/include/gbColor.hpp"
 #include "../gbLib/include/gbImageLoader.hpp"
@@ -13,7 +21,18 @@
 char const* ps2_input_file      = NULL;		///< path to the input file
 char const* obj_output_file     = NULL;		///< path to the output file
 char const* texture_output_file = NULL;		///< path to the output texture file
+char const* preview_output_file = NULL;		///< path to the output preview image file
+char const* animation_output_file = NULL;	///< path to the output animation sprite sheet
+char const* sequence_output_prefix = NULL;	///< path prefix of the output animation frame images
+char const* iconsys_input_file  = NULL;		///< path to the icon.sys used for lighting the preview
+char const* memcard_input_file  = NULL;		///< path to a memory card image holding the input files
+int preview_size                = 256;		///< width and height of the preview image
+int n_threads                   = 0;		///< number of threads for rendering the animation (0 = one per processor)
 bool verbose_output             = false;	///< flag for verbose output
+char const* cache_directory     = NULL;		///< path to the conversion cache (NULL = no caching)
+int cache_size                  = 256;		///< size limit of the conversion cache in MB
+bool cache_hard_links           = false;	///< flag for hard linking outputs from the cache
+PS2MemoryCard* memory_card      = NULL;		///< the opened memory card image, if any
 
 /** Print a help text on screen
  * @param[in] self Name of the executable (e.g. obtained from argv[0])
@@ -32,6 +51,16 @@ void PrintHelp(char* self)
 			  << "  -f,  --input-file      PS2Icon file used as input"         << "\n"
 			  << "  -o,  --output-file     Name of the OBJ destination file"   << "\n"
 			  << "  -ot, --output-texture  Texture file output (TGA)"          << "\n"
+			  << "  -op, --output-preview  Rendered preview output (TGA)"      << "\n"
+			  << "  -oa, --output-anim     Animation sprite sheet output (TGA)" << "\n"
+			  << "  -of, --output-frames   Animation frames output prefix (prefix_0000.tga, ...)" << "\n"
+			  << "  -ps, --preview-size    Preview width and height (256)"     << "\n"
+			  << "  -j,  --threads         Threads for rendering the animation (one per processor)" << "\n"
+			  << "  -s,  --icon-sys        icon.sys used for lighting the preview" << "\n"
+			  << "  -mc, --memory-card     Read -f and -s as directory/file from a card image" << "\n"
+			  << "  -c,  --cache-dir       Directory of the conversion cache for -o and -ot" << "\n"
+			  << "  -cs, --cache-size      Size limit of the conversion cache in MB (256)" << "\n"
+			  << "  -cl, --cache-links     Hard link outputs from the cache instead of copying" << "\n"
 			  << "  -v,  --verbose         activate verbose output"            << "\n"
 			  << "\n"
 			  << " Examples:"                                                             << "\n"
@@ -42,6 +71,21 @@ void PrintHelp(char* self)
 			  << "  " << self << " -f foo.icn -o out.obj -ot out.tga"                     << "\n"
 			  << "Extracts geometry and texture info from foo.icn and saves it out to"    << "\n"
 			  << "out.obj and out.tga."                                                   << "\n"
+			  << "\n"
+			  << "  " << self << " -f foo.icn -s icon.sys -op preview.tga"                << "\n"
+			  << "Additionally renders foo.icn as lit by icon.sys to preview.tga."        << "\n"
+			  << "\n"
+			  << "  " << self << " -f foo.icn -ps 128 -oa anim.tga"                      << "\n"
+			  << "Additionally renders each frame of the animation loop of foo.icn to a"  << "\n"
+			  << "sprite sheet of 128x128 cells in anim.tga."                            << "\n"
+			  << "\n"
+			  << "  " << self << " -mc card.ps2 -f SAVE/foo.icn -s SAVE/icon.sys -op p.tga" << "\n"
+			  << "Reads foo.icn and icon.sys of the save SAVE directly from card.ps2."     << "\n"
+			  << "\n"
+			  << "  " << self << " -f foo.icn -c cache"                                   << "\n"
+			  << "Extracts default.obj and default.tga as above, unless the conversion of"  << "\n"
+			  << "the same foo.icn is found in the directory cache; then both are copied" << "\n"
+			  << "from there."                                                            << "\n"
 			  << std::endl;
 }
 
@@ -58,6 +102,8 @@ void ParseCommandLine(int argc, char* argv[])
 			exit(0);
 		} else if( (strcmp( argv[i], "-v" ) == 0) || (strcmp( argv[i], "--verbose" ) == 0) ) {
 			verbose_output = true;
+		} else if( (strcmp( argv[i], "-cl" ) == 0) || (strcmp( argv[i], "--cache-links" ) == 0) ) {
+			cache_hard_links = true;
 		} else if(i < argc-1) {
 		//Parameters with 1 argument
 			if( (strcmp( argv[i], "-f" ) == 0) || (strcmp( argv[i], "--input-file" ) == 0) ) {
@@ -66,6 +112,39 @@ void ParseCommandLine(int argc, char* argv[])
 				obj_output_file = argv[++i];
 			} else if( (strcmp( argv[i], "-ot" ) == 0) || (strcmp( argv[i], "--output-texture" ) == 0) ) {
 				texture_output_file = argv[++i];
+			} else if( (strcmp( argv[i], "-op" ) == 0) || (strcmp( argv[i], "--output-preview" ) == 0) ) {
+				preview_output_file = argv[++i];
+			} else if( (strcmp( argv[i], "-ps" ) == 0) || (strcmp( argv[i], "--preview-size" ) == 0) ) {
+				preview_size = atoi(argv[++i]);
+				if((preview_size <= 0) || (preview_size > IconRasterizer::MAX_SIZE)) {
+					std::cout << "Invalid preview size.\n" << std::endl;
+					PrintHelp(argv[0]);
+					exit(1);
+				}
+			} else if( (strcmp( argv[i], "-oa" ) == 0) || (strcmp( argv[i], "--output-anim" ) == 0) ) {
+				animation_output_file = argv[++i];
+			} else if( (strcmp( argv[i], "-of" ) == 0) || (strcmp( argv[i], "--output-frames" ) == 0) ) {
+				sequence_output_prefix = argv[++i];
+			} else if( (strcmp( argv[i], "-j" ) == 0) || (strcmp( argv[i], "--threads" ) == 0) ) {
+				n_threads = atoi(argv[++i]);
+				if(n_threads < 0) {
+					std::cout << "Invalid number of threads.\n" << std::endl;
+					PrintHelp(argv[0]);
+					exit(1);
+				}
+			} else if( (strcmp( argv[i], "-mc" ) == 0) || (strcmp( argv[i], "--memory-card" ) == 0) ) {
+				memcard_input_file = argv[++i];
+			} else if( (strcmp( argv[i], "-s" ) == 0) || (strcmp( argv[i], "--icon-sys" ) == 0) ) {
+				iconsys_input_file = argv[++i];
+			} else if( (strcmp( argv[i], "-c" ) == 0) || (strcmp( argv[i], "--cache-dir" ) == 0) ) {
+				cache_directory = argv[++i];
+			} else if( (strcmp( argv[i], "-cs" ) == 0) || (strcmp( argv[i], "--cache-size" ) == 0) ) {
+				cache_size = atoi(argv[++i]);
+				if(cache_size <= 0) {
+					std::cout << "Invalid cache size.\n" << std::endl;
+					PrintHelp(argv[0]);
+					exit(1);
+				}
 			} else {
 				std::cout << "Invalid argument.\n" << std::endl;
 				PrintHelp(argv[0]);
@@ -79,13 +158,57 @@ void ParseCommandLine(int argc, char* argv[])
 	}
 }
 
+/** Open the memory card image given on the command line
+ */
+void OpenMemoryCard()
+{
+	if(verbose_output)
+		std::cout << " * Opening memory card image \"" << memcard_input_file << "\"...";
+	try {
+		memory_card = new PS2MemoryCard(memcard_input_file);
+	} catch( Ghulbus::gbException const& ) {
+		std::cout << "\nFile read error: \"" << memcard_input_file << "\"" << std::endl;
+		exit(1);
+	}
+	if(verbose_output)
+		std::cout << "done (" << memory_card->GetNSaves() << " saves)." << std::endl;
+}
+
+/** Load the icon.sys given on the command line, either from a file or from the memory card
+ * @return A new IconSys object; NULL if no icon.sys was specified
+ */
+IconSys* LoadIconSys()
+{
+	if(!iconsys_input_file) { return NULL; }
+	try {
+		if(memory_card) {
+			std::vector<unsigned char> data;
+			memory_card->ReadFile(iconsys_input_file, &data);
+			return new IconSys( MemorySpan<unsigned char>(data.empty() ? NULL : &data[0], data.size()) );
+		} else {
+			return new IconSys(iconsys_input_file);
+		}
+	} catch( Ghulbus::gbException const& ) {
+		std::cout << "\nFile read error: \"" << iconsys_input_file << "\"" << std::endl;
+		exit(1);
+	}
+	return NULL;
+}
+
 PS2Icon* LoadPS2Icon()
 {
 	PS2Icon* ret = NULL;
 	if(verbose_output)
 		std::cout << " * Reading PS2Icon file \"" << ps2_input_file << "\"...\n";
 	try {
-		ret = new PS2Icon(ps2_input_file);
+		if(memory_card) {
+			std::vector<unsigned char> data;
+			memory_card->ReadFile(ps2_input_file, &data);
+			PS2IconView view( MemorySpan<unsigned char>(data.empty() ? NULL : &data[0], data.size()) );
+			ret = new PS2Icon(view);
+		} else {
+			ret = new PS2Icon(ps2_input_file);
+		}
 	} catch( std::exception e ) {
 		std::cout << "File read error: \"" << ps2_input_file << "\"" << std::endl;
 		exit(1);
@@ -107,7 +230,12 @@ void WriteOBJFile(PS2Icon* ps2_icon)
 	OBJ_Mesh obj_mesh(ps2_input_file);
 	if(verbose_output)
 		std::cout << " * Convert geometry data from \"" << ps2_input_file << "\"...";
-	ps2_icon->BuildMesh(&obj_mesh);
+	try {
+		ps2_icon->BuildMesh(&obj_mesh);
+	} catch( Ghulbus::gbException const& ) {
+		std::cout << "\nError while converting the geometry of \"" << ps2_input_file << "\"" << std::endl;
+		exit(1);
+	}
 	if(verbose_output)
 		std::cout << "done." << std::endl;
 
@@ -126,25 +254,13 @@ void WriteOBJFile(PS2Icon* ps2_icon)
 
 void WriteTextureFile(PS2Icon* ps2_icon)
 {
-	unsigned int texture_data[128*128];
+	unsigned int texture_data[PS2Texture::N_TEXELS];
 	if(verbose_output)
 		std::cout << " * Convert texture data from \"" << ps2_input_file << "\"..." ;
 	ps2_icon->GetTextureData(texture_data);
-	//manual conversion required, since WriteImage() requires 
-	// GBCOLOR32 data, whose bit pattern is not fix;
-	for(int i=0; i<16384; i++) {
-		texture_data[i] = GhulbusGraphics::GBCOLOR32::ARGB( static_cast<int>((texture_data[i] >> 24) & 0xff),
-															static_cast<int>((texture_data[i] >> 16) & 0xff),
-															static_cast<int>((texture_data[i] >>  8) & 0xff),
-															static_cast<int>((texture_data[i])       & 0xff) );
-	}
+	//the texture is already in ARGB format, which matches GBCOLOR32::ARGB();
 	//in addition the texture is flipped horizontally:
-	for(int row=0; row<64; row++) {
-		for(int i=0; i<128; i++) {
-			texture_data[row*128 + i] ^= texture_data[(127-row)*128 + i] 
-				^= texture_data[row*128 + i] ^= texture_data[(127-row)*128 + i];
-		}
-	}
+	PS2Texture::FlipRows(texture_data, PS2Texture::WIDTH, PS2Texture::HEIGHT);
 
 	if(verbose_output)
 		std::cout << "done." << std::endl;
@@ -161,6 +277,116 @@ void WriteTextureFile(PS2Icon* ps2_icon)
 		std::cout << "done." << std::endl;
 }
 
+void WriteAnimationFiles(PS2Icon* ps2_icon)
+{
+	if(verbose_output)
+		std::cout << " * Rendering animation of \"" << ps2_input_file << "\"...";
+	IconSys* icon_sys = LoadIconSys();
+	IconPreviewRenderer* renderer = NULL;
+	try {
+		renderer = new IconPreviewRenderer(*ps2_icon, preview_size, preview_size, n_threads);
+		if(icon_sys) {
+			renderer->SetLighting(*icon_sys);
+		}
+		renderer->RenderFrames();
+	} catch( Ghulbus::gbException const& ) {
+		std::cout << "\nError while rendering the animation of \"" << ps2_input_file << "\"" << std::endl;
+		exit(1);
+	} catch( std::bad_alloc const& ) {
+		std::cout << "\nOut of memory while rendering the animation of \"" << ps2_input_file << "\"" << std::endl;
+		exit(1);
+	}
+	delete icon_sys;
+	if(verbose_output)
+		std::cout << "done (" << renderer->GetNFrames() << " frames, " << renderer->GetNThreads() << " threads)." << std::endl;
+
+	if(animation_output_file) {
+		if(verbose_output)
+			std::cout << " * Writing animation to file \"" << animation_output_file << "\"...";
+		try {
+			renderer->WriteSpriteSheet(animation_output_file, 0);
+		} catch( Ghulbus::gbException const& ) {
+			std::cout << "\nError while writing to \"" << animation_output_file << "\"" << std::endl;
+			exit(1);
+		}
+		if(verbose_output)
+			std::cout << "done." << std::endl;
+	}
+	if(sequence_output_prefix) {
+		if(verbose_output)
+			std::cout << " * Writing animation frames to \"" << sequence_output_prefix << "_*.tga\"...";
+		try {
+			renderer->WriteFrameSequence(sequence_output_prefix);
+		} catch( Ghulbus::gbException const& ) {
+			std::cout << "\nError while writing to \"" << sequence_output_prefix << "_*.tga\"" << std::endl;
+			exit(1);
+		}
+		if(verbose_output)
+			std::cout << "done." << std::endl;
+	}
+	delete renderer;
+}
+
+void WritePreviewFile(PS2Icon* ps2_icon)
+{
+	if(verbose_output)
+		std::cout << " * Rendering preview of \"" << ps2_input_file << "\"...";
+	IconRasterizer rasterizer(preview_size, preview_size);
+	IconSys* icon_sys = LoadIconSys();
+	if(icon_sys) {
+		rasterizer.SetLighting(*icon_sys);
+		delete icon_sys;
+	}
+	try {
+		rasterizer.Render(*ps2_icon);
+	} catch( Ghulbus::gbException const& ) {
+		std::cout << "\nError while rendering the preview of \"" << ps2_input_file << "\"" << std::endl;
+		exit(1);
+	}
+	if(verbose_output)
+		std::cout << "done." << std::endl;
+
+	if(verbose_output)
+		std::cout << " * Writing preview to file \"" << preview_output_file << "\"...";
+	try {
+		rasterizer.WriteImage(preview_output_file);
+	} catch( Ghulbus::gbException const& ) {
+		std::cout << "\nError while writing to \"" << preview_output_file << "\"" << std::endl;
+		exit(1);
+	}
+	if(verbose_output)
+		std::cout << "done." << std::endl;
+}
+
+/** Open the conversion cache and build the key of the OBJ and texture conversion
+ * @param[out] key Receives the key
+ * @return The cache; NULL if it can not be used, in which case the conversion is done uncached
+ */
+ConversionCache* OpenCache(ConversionCache::Key* key)
+{
+	ConversionCache* ret = NULL;
+	try {
+		ret = new ConversionCache(cache_directory, static_cast<unsigned long long>(cache_size) << 20);
+		ret->SetHardLinks(cache_hard_links);
+		if(memory_card) {
+			std::vector<unsigned char> data;
+			memory_card->ReadFile(ps2_input_file, &data);
+			key->AddBytes(data.empty() ? NULL : &data[0], data.size());
+		} else {
+			key->AddFile(ps2_input_file);
+		}
+		//the input path is written to the OBJ file as mesh name:
+		key->AddString(ps2_input_file);
+	} catch( Ghulbus::gbException& ) {
+		//missing input files are reported by the conversion itself:
+		if(verbose_output)
+			std::cout << " * Conversion cache \"" << cache_directory << "\" not used." << std::endl;
+		delete ret;
+		return NULL;
+	}
+	return ret;
+}
+
 int main(int argc, char* argv[])
 {
 	ParseCommandLine(argc, argv);
@@ -174,12 +400,64 @@ int main(int argc, char* argv[])
 	if(!obj_output_file)     { obj_output_file = "default.obj"; }
 	if(!texture_output_file) { texture_output_file = "default.tga"; }
 
-	PS2Icon* ps2_icon = LoadPS2Icon();
+	if(memcard_input_file) {
+		OpenMemoryCard();
+	}
+
+	ConversionCache* cache = NULL;
+	ConversionCache::Key cache_key("ps2icon_to_obj/1");
+	char const* cached_outputs[] = { obj_output_file, texture_output_file };
+	bool cache_hit = false;
+	if(cache_directory) {
+		cache = OpenCache(&cache_key);
+	}
+	if(cache) {
+		try {
+			cache_hit = cache->Retrieve(cache_key, cached_outputs, 2);
+		} catch( Ghulbus::gbException& ) {
+			std::cout << "Error while writing to \"" << obj_output_file << "\" or \"" << texture_output_file << "\"" << std::endl;
+			exit(1);
+		}
+		if(cache_hit && verbose_output)
+			std::cout << " * Outputs \"" << obj_output_file << "\" and \"" << texture_output_file
+				<< "\" taken from the conversion cache." << std::endl;
+	}
+
+	//previews are not cached, they still need the icon:
+	PS2Icon* ps2_icon = NULL;
+	if(!cache_hit || preview_output_file || animation_output_file || sequence_output_prefix) {
+		ps2_icon = LoadPS2Icon();
+	}
+
+	if(!cache_hit) {
+		if(cache) {
+			//old outputs may be hard linked to the cache and must not be written through:
+			remove(obj_output_file);
+			remove(texture_output_file);
+		}
+		WriteOBJFile(ps2_icon);
+		WriteTextureFile(ps2_icon);
+		if(cache) {
+			try {
+				cache->Store(cache_key, cached_outputs, 2);
+			} catch( Ghulbus::gbException& ) {
+				std::cout << "Warning: could not add the outputs to the conversion cache" << std::endl;
+			}
+		}
+	}
+
+	if(preview_output_file) {
+		WritePreviewFile(ps2_icon);
+	}
+
+	if(animation_output_file || sequence_output_prefix) {
+		WriteAnimationFiles(ps2_icon);
+	}
 
-	WriteOBJFile(ps2_icon);
+	delete ps2_icon;
+	delete cache;
+	delete memory_card;
 
-	WriteTextureFile(ps2_icon);
-	
 	std::cout << "Success :)" << std::endl;
 
 	return 0;
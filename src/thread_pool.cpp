@@ -0,0 +1,260 @@
+/**
+ * @file src/thread_pool.cpp
+ *
+ * @brief Implementation of the ThreadPool classbuild_header/
+ */
+#include "../include/thread_pool.hpp"
+#include <new>
+#include <vector>
+#ifdef _WIN32
+#	include <windows.h>
+#else
+#	include <pthread.h>
+#	include <unistd.h>
+#endif
+
+/** Start parameters of a worker thread
+ */
+typedef struct ThreadPoolWorker_t {
+	ThreadPool* pool;								///< the owning pool
+	int thread;										///< thread index [1..(n_threads-1)]
+} ThreadPoolWorker;
+
+struct ThreadPool::Shared {
+#ifdef _WIN32
+	//condition variables need Windows Vista; auto-reset events keep a wakeup that arrives
+	//between Unlock() and the wait, and the callers recheck their condition anyway:
+	CRITICAL_SECTION mutex;							///< guards all members below
+	std::vector<HANDLE> work_events;				///< one per worker; set when a job is posted or on shutdown
+	HANDLE done_event;								///< set when the last worker finished a job
+	std::vector<HANDLE> threads;					///< started worker threads
+	void Lock()       { EnterCriticalSection(&mutex); }
+	void Unlock()     { LeaveCriticalSection(&mutex); }
+	void WaitWork(int thread) { Unlock(); WaitForSingleObject(work_events[thread - 1], INFINITE); Lock(); }
+	void WaitDone()   { Unlock(); WaitForSingleObject(done_event, INFINITE); Lock(); }
+	void SignalWork() { for(size_t i=0; i<threads.size(); i++) { SetEvent(work_events[i]); } }
+	void SignalDone() { SetEvent(done_event); }
+#else
+	pthread_mutex_t mutex;							///< guards all members below
+	pthread_cond_t work_cond;						///< signaled when a job is posted or on shutdown
+	pthread_cond_t done_cond;						///< signaled when the last worker finished a job
+	std::vector<pthread_t> threads;					///< started worker threads
+	void Lock()       { pthread_mutex_lock(&mutex); }
+	void Unlock()     { pthread_mutex_unlock(&mutex); }
+	void WaitWork(int) { pthread_cond_wait(&work_cond, &mutex); }
+	void WaitDone()   { pthread_cond_wait(&done_cond, &mutex); }
+	void SignalWork() { pthread_cond_broadcast(&work_cond); }
+	void SignalDone() { pthread_cond_signal(&done_cond); }
+#endif
+	std::vector<ThreadPoolWorker> workers;			///< start parameters of the worker threads
+	Job* job;										///< job currently processed; NULL if idle
+	int n_items;									///< number of items of the current job
+	int next_item;									///< next item to hand out
+	int n_busy;										///< workers that have not finished the current job yet
+	unsigned int generation;						///< incremented for each posted job
+	bool shutdown;									///< workers exit when set
+	bool failed;									///< an item of the current job threw
+	Ghulbus::gbException error;						///< first exception thrown by the current job
+};
+
+ThreadPool::ThreadPool(int n_threads): m_n_threads(n_threads), m_shared(NULL)
+{
+	if(n_threads < 0) {
+		throw( Ghulbus::gbException( Ghulbus::gbException::GB_ILLEGALPARAMETER, "Number of threads must not be negative" ) );
+	}
+	if(m_n_threads == 0) {
+		m_n_threads = GetHardwareConcurrency();
+	}
+	m_shared = new Shared;
+	m_shared->job        = NULL;
+	m_shared->n_items    = 0;
+	m_shared->next_item  = 0;
+	m_shared->n_busy     = 0;
+	m_shared->generation = 0;
+	m_shared->shutdown   = false;
+	m_shared->failed     = false;
+#ifdef _WIN32
+	InitializeCriticalSection(&m_shared->mutex);
+	m_shared->done_event = CreateEventA(NULL, FALSE, FALSE, NULL);
+#else
+	pthread_mutex_init(&m_shared->mutex, NULL);
+	pthread_cond_init(&m_shared->work_cond, NULL);
+	pthread_cond_init(&m_shared->done_cond, NULL);
+#endif
+	try {
+#ifdef _WIN32
+		m_shared->work_events.reserve(m_n_threads - 1);
+		for(int i=1; i<m_n_threads; i++) {
+			HANDLE const work_event = CreateEventA(NULL, FALSE, FALSE, NULL);
+			if(work_event == NULL) {
+				throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not create worker event" ) );
+			}
+			m_shared->work_events.push_back(work_event);
+		}
+		if(m_shared->done_event == NULL) {
+			throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not create worker event" ) );
+		}
+#endif
+		//the parameters must not move once the threads are running:
+		m_shared->workers.resize(m_n_threads - 1);
+		m_shared->threads.reserve(m_n_threads - 1);
+		for(int i=1; i<m_n_threads; i++) {
+			ThreadPoolWorker& w = m_shared->workers[i - 1];
+			w.pool   = this;
+			w.thread = i;
+#ifdef _WIN32
+			HANDLE thread = CreateThread(NULL, 0, WorkerEntry, &w, 0, NULL);
+			if(thread == NULL) {
+#else
+			pthread_t thread;
+			if(pthread_create(&thread, NULL, WorkerEntry, &w) != 0) {
+#endif
+				throw( Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Could not create worker thread" ) );
+			}
+			m_shared->threads.push_back(thread);
+		}
+	} catch(...) {
+		StopWorkers();
+		throw;
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	StopWorkers();
+}
+
+void ThreadPool::StopWorkers() {
+	m_shared->Lock();
+	m_shared->shutdown = true;
+	m_shared->SignalWork();
+	m_shared->Unlock();
+	for(size_t i=0; i<m_shared->threads.size(); i++) {
+#ifdef _WIN32
+		WaitForSingleObject(m_shared->threads[i], INFINITE);
+		CloseHandle(m_shared->threads[i]);
+#else
+		pthread_join(m_shared->threads[i], NULL);
+#endif
+	}
+#ifdef _WIN32
+	if(m_shared->done_event) { CloseHandle(m_shared->done_event); }
+	for(size_t i=0; i<m_shared->work_events.size(); i++) {
+		CloseHandle(m_shared->work_events[i]);
+	}
+	DeleteCriticalSection(&m_shared->mutex);
+#else
+	pthread_cond_destroy(&m_shared->done_cond);
+	pthread_cond_destroy(&m_shared->work_cond);
+	pthread_mutex_destroy(&m_shared->mutex);
+#endif
+	delete m_shared;
+	m_shared = NULL;
+}
+
+int ThreadPool::GetNThreads() const {
+	return m_n_threads;
+}
+
+int ThreadPool::GetHardwareConcurrency() {
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	int const n = static_cast<int>(info.dwNumberOfProcessors);
+#else
+	int const n = static_cast<int>( sysconf(_SC_NPROCESSORS_ONLN) );
+#endif
+	return (n > 0) ? n : 1;
+}
+
+void ThreadPool::Run(Job& job, int n_items) {
+	if(n_items <= 0) { return; }
+	Shared& s = *m_shared;
+	s.Lock();
+	s.job       = &job;
+	s.n_items   = n_items;
+	s.next_item = 0;
+	s.failed    = false;
+	s.n_busy    = static_cast<int>(s.threads.size());
+	s.generation++;
+	s.SignalWork();
+	s.Unlock();
+
+	ProcessItems(0);
+
+	s.Lock();
+	while(s.n_busy > 0) {
+		s.WaitDone();
+	}
+	s.job = NULL;
+	bool const failed = s.failed;
+	s.Unlock();
+	if(failed) {
+		throw( Ghulbus::gbException(s.error) );
+	}
+}
+
+void ThreadPool::ProcessItems(int thread) {
+	Shared& s = *m_shared;
+	for(;;) {
+		s.Lock();
+		if(s.failed || (s.next_item >= s.n_items)) {
+			s.Unlock();
+			return;
+		}
+		int const item = s.next_item++;
+		Job* const job = s.job;
+		s.Unlock();
+		//exceptions must not leave the worker threads; keep the first one for Run():
+		try {
+			job->Run(item, thread);
+		} catch(Ghulbus::gbException& e) {
+			s.Lock();
+			if(!s.failed) { s.failed = true; s.error = e; }
+			s.Unlock();
+		} catch(std::bad_alloc&) {
+			s.Lock();
+			if(!s.failed) { s.failed = true; s.error = Ghulbus::gbException( Ghulbus::gbException::GB_OUTOFMEMORY, "Out of memory in worker thread" ); }
+			s.Unlock();
+		} catch(...) {
+			s.Lock();
+			if(!s.failed) { s.failed = true; s.error = Ghulbus::gbException( Ghulbus::gbException::GB_FAILED, "Unknown exception in worker thread" ); }
+			s.Unlock();
+		}
+	}
+}
+
+void ThreadPool::WorkerLoop(int thread) {
+	Shared& s = *m_shared;
+	unsigned int seen = 0;
+	for(;;) {
+		s.Lock();
+		while(!s.shutdown && (s.generation == seen)) {
+			s.WaitWork(thread);
+		}
+		if(s.shutdown) {
+			s.Unlock();
+			return;
+		}
+		seen = s.generation;
+		s.Unlock();
+
+		ProcessItems(thread);
+
+		s.Lock();
+		if(--s.n_busy == 0) {
+			s.SignalDone();
+		}
+		s.Unlock();
+	}
+}
+
+#ifdef _WIN32
+unsigned long __stdcall ThreadPool::WorkerEntry(void* param) {
+#else
+void* ThreadPool::WorkerEntry(void* param) {
+#endif
+	ThreadPoolWorker* w = static_cast<ThreadPoolWorker*>(param);
+	w->pool->WorkerLoop(w->thread);
+	return 0;
+}